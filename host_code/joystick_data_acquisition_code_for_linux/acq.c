@@ -0,0 +1,599 @@
+/* Acquisition engine. See acq.h.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "acq.h"
+#include "evcap.h"
+
+#define MAX_EVENTS 64
+
+static volatile sig_atomic_t stop_requested;
+
+static size_t queue_size;
+static rt_cfg_t reader_rt;
+static rt_cfg_t writer_rt;
+
+typedef struct
+{
+	device_t *devs;
+	int num_devs;
+	unsigned int tick_ms;
+	sem_t wake;
+	int stop;
+	int err_code;
+} writer_t;
+
+static const source_ops_t *const sources[] =
+{
+	&joydev_source,
+	&evdev_source,
+	&hidraw_source,
+	&replay_source,
+};
+
+#define NUM_SOURCES (sizeof(sources)/sizeof(sources[0]))
+
+void acq_stop(void)
+{
+	stop_requested = 1;
+}
+
+/* Runs the sinks on a writer thread fed through a ring of samples per
+ * device, or from the event loop itself for 0 (the default). */
+void acq_set_queue(size_t samples)
+{
+	queue_size = samples;
+}
+
+/* Scheduling of the thread running acq_run(), which reads the devices,
+ * and of the writer thread. The writer is started before the reader's
+ * settings are applied, so it doesn't inherit them. If either can't be
+ * applied acq_run() records nothing and fails. */
+void acq_set_sched(const rt_cfg_t *reader, const rt_cfg_t *writer)
+{
+	reader_rt = *reader;
+	writer_rt = *writer;
+}
+
+/* Picks the source backend for a device. The backend can be named in front
+ * of the path, e.g. evdev:/dev/input/by-id/usb-...-event-joystick, which is
+ * then stripped from *path. Otherwise it follows from the name of the device
+ * node: eventN is read with evdev, hidrawN with hidraw, a capture *.evc is
+ * replayed and anything else is read with joydev. */
+const source_ops_t *source_for_path(const char **path)
+{
+	const char *colon = strchr(*path, ':');
+	const char *base;
+	size_t i;
+
+	if (colon != NULL)
+	{
+		for (i = 0; i < NUM_SOURCES; i++)
+		{
+			if (strlen(sources[i]->name) == (size_t)(colon - *path) &&
+			    strncmp(sources[i]->name, *path, colon - *path) == 0)
+			{
+				*path = colon + 1;
+				return sources[i];
+			}
+		}
+	}
+
+	base = strrchr(*path, '/');
+	base = (base != NULL) ? base + 1 : *path;
+	if (strlen(base) > 4 && strcmp(base + strlen(base) - 4, ".evc") == 0)
+	{
+		return &replay_source;
+	}
+	if (strstr(base, "event") != NULL)
+	{
+		return &evdev_source;
+	}
+	if (strstr(base, "hidraw") != NULL)
+	{
+		return &hidraw_source;
+	}
+
+	return &joydev_source;
+}
+
+int device_add_sink(device_t *d, sink_t *s)
+{
+	if (s == NULL || d->num_sinks >= MAX_SINKS)
+	{
+		return -1;
+	}
+	d->sinks[d->num_sinks++] = s;
+
+	return 0;
+}
+
+/* Source backends read their device with this instead of read(), so what
+ * they read can be captured, or can come from a capture. */
+ssize_t device_read(device_t *d, void *buf, size_t len)
+{
+	ssize_t n;
+
+	if (d->replay != NULL)
+	{
+		return replay_read(d, buf, len);
+	}
+
+	n = read(d->fd, buf, len);
+	if (n > 0 && d->capture != NULL && evcap_write(d->capture, EVCAP_READ, buf, n) != 0)
+	{
+		fprintf(stderr, "Couldn't write the capture of %s.\n", d->path);
+		errno = EIO;
+		return -1;
+	}
+
+	return n;
+}
+
+/* Stops writing the recordings of a device whose sink failed. The reading
+ * thread then drops the device, whichever thread found the error. */
+static void fail_sinks(device_t *d)
+{
+	fprintf(stderr, "Couldn't write the recording of %s, dropping it.\n", d->path);
+	__atomic_store_n(&d->sink_failed, 1, __ATOMIC_RELEASE);
+}
+
+static int write_sinks(device_t *d, const sample_t *samples, size_t n)
+{
+	uint64_t t0 = 0;
+	int i;
+	int err_code = 0;
+
+	if (metrics_enabled)
+	{
+		t0 = metrics_now_ns();
+	}
+	for (i = 0; i < d->num_sinks; i++)
+	{
+		err_code |= d->sinks[i]->write(d->sinks[i], samples, n);
+	}
+	if (metrics_enabled)
+	{
+		metrics_latency(&d->metrics, metrics_now_ns() - t0);
+	}
+
+	return err_code;
+}
+
+/* Hands samples from a source backend to every sink of the device. Once
+ * max_samples have been delivered the rest are dropped and the device is
+ * marked done. */
+int device_emit(device_t *d, const sample_t *samples, size_t n)
+{
+	int err_code = 0;
+
+	if (__atomic_load_n(&d->sink_failed, __ATOMIC_ACQUIRE))
+	{
+		return -1;
+	}
+
+	if (d->max_samples > 0)
+	{
+		if (d->num_samples >= d->max_samples)
+		{
+			return 0;
+		}
+		if (n > d->max_samples - d->num_samples)
+		{
+			n = d->max_samples - d->num_samples;
+		}
+	}
+
+	if (metrics_enabled)
+	{
+		metrics_samples(&d->metrics, samples, n);
+	}
+
+	if (d->q != NULL)
+	{
+		/* what the ring had no room for is counted in its overflows */
+		n = spsc_push(d->q, samples, n);
+		if (metrics_enabled)
+		{
+			metrics_set(&d->metrics.queue_dropped, d->q->overflows);
+		}
+	}
+	else if (write_sinks(d, samples, n) != 0)
+	{
+		fail_sinks(d);
+		err_code = -1;
+	}
+	d->num_samples += n;
+
+	if (d->max_samples > 0 && d->num_samples >= d->max_samples)
+	{
+		d->done = 1;
+	}
+
+	return err_code;
+}
+
+static void device_finish(int epfd, device_t *d)
+{
+	d->done = 1;
+	if (d->fd >= 0)
+	{
+		epoll_ctl(epfd, EPOLL_CTL_DEL, d->fd, NULL);
+	}
+}
+
+static int tick_sinks(device_t *devs, int num_devs)
+{
+	uint64_t bytes;
+	int i, j;
+	int err_code = 0;
+
+	for (i = 0; i < num_devs; i++)
+	{
+		if (__atomic_load_n(&devs[i].sink_failed, __ATOMIC_ACQUIRE))
+		{
+			continue;
+		}
+		bytes = 0;
+		for (j = 0; j < devs[i].num_sinks; j++)
+		{
+			if (devs[i].sinks[j]->tick != NULL && devs[i].sinks[j]->tick(devs[i].sinks[j]) != 0)
+			{
+				fail_sinks(&devs[i]);
+				err_code = -1;
+				break;
+			}
+			if (devs[i].sinks[j]->bytes != NULL)
+			{
+				bytes += devs[i].sinks[j]->bytes(devs[i].sinks[j]);
+			}
+		}
+		if (metrics_enabled)
+		{
+			metrics_set(&devs[i].metrics.bytes, bytes);
+		}
+	}
+
+	return err_code;
+}
+
+static uint64_t now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+/* Waits until the semaphore is posted or ms have passed on the monotonic
+ * clock, so that the wall clock being set (by NTP or by hand) neither
+ * stalls the writer nor makes it spin. Without sem_clockwait() (glibc
+ * before 2.30, other C libraries) the semaphore is polled every
+ * millisecond until the deadline. */
+static void wait_ms(sem_t *sem, unsigned int ms)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 30))
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += ms/1000;
+	deadline.tv_nsec += (ms % 1000)*1000000L;
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+	while (sem_clockwait(sem, CLOCK_MONOTONIC, &deadline) != 0 && errno == EINTR)
+	{
+	}
+#else
+	struct timespec nap = { 0, 1000000L };
+	uint64_t deadline = now_ms() + ms;
+
+	while (sem_trywait(sem) != 0 && now_ms() < deadline)
+	{
+		nanosleep(&nap, NULL);
+	}
+#endif
+}
+
+/* Hands everything waiting in the rings to the sinks. */
+static int drain_queues(device_t *devs, int num_devs)
+{
+	const sample_t *s;
+	device_t *d;
+	size_t n;
+	int i;
+	int err_code = 0;
+
+	for (i = 0; i < num_devs; i++)
+	{
+		d = &devs[i];
+		if (d->q == NULL)
+		{
+			continue;
+		}
+		/* after a sink failed the samples are only taken off the ring */
+		while ((n = spsc_peek(d->q, &s)) > 0)
+		{
+			if (!__atomic_load_n(&d->sink_failed, __ATOMIC_ACQUIRE) && write_sinks(d, s, n) != 0)
+			{
+				fail_sinks(d);
+				err_code = -1;
+			}
+			spsc_release(d->q, n);
+		}
+		if (metrics_enabled)
+		{
+			metrics_set(&d->metrics.queued, __atomic_load_n(&d->q->head, __ATOMIC_ACQUIRE) - d->q->tail);
+			metrics_set(&d->metrics.queue_high_water, d->q->high_water);
+		}
+	}
+
+	return err_code;
+}
+
+static void *writer_main(void *arg)
+{
+	writer_t *w = arg;
+	uint64_t last_tick = now_ms();
+	int stop;
+
+	for (;;)
+	{
+		wait_ms(&w->wake, w->tick_ms);
+
+		/* everything pushed before stop was set is drained below */
+		stop = __atomic_load_n(&w->stop, __ATOMIC_ACQUIRE);
+		w->err_code |= drain_queues(w->devs, w->num_devs);
+		if (stop)
+		{
+			break;
+		}
+		if (now_ms() - last_tick >= w->tick_ms)
+		{
+			w->err_code |= tick_sinks(w->devs, w->num_devs);
+			last_tick = now_ms();
+		}
+		aio_kick();
+	}
+
+	return NULL;
+}
+
+/* Runs until every device is done or acq_stop() is called, e.g. from a
+ * signal handler. A device that fails is dropped and the others carry on.
+ * The sinks are ticked at least every tick_ms. Devices are opened before
+ * and closed, together with their sinks and captures, after the loop. */
+int acq_run(device_t *devs, int num_devs, unsigned int tick_ms)
+{
+	struct epoll_event ev;
+	struct epoll_event events[MAX_EVENTS];
+	device_t *d;
+	writer_t w;
+	pthread_t writer;
+	int threaded = 0;
+	int have_sem = 0;
+	int epfd;
+	int active = 0;
+	uint64_t before, now;
+	int err;
+	int err_code = 0;
+	int i, j, n;
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd == -1)
+	{
+		fprintf(stderr, "Couldn't create epoll instance: %s.\n", strerror(errno));
+		return -1;
+	}
+
+	for (i = 0; i < num_devs; i++)
+	{
+		d = &devs[i];
+		d->index = i;
+		d->fd = -1;
+		if (d->ops->open(d) != 0)
+		{
+			d->done = 1;
+			err_code = -1;
+			continue;
+		}
+		if (d->capture != NULL && evcap_write_header(d->capture, d->ops->name, d->path, d->name, &d->initial) != 0)
+		{
+			fprintf(stderr, "Couldn't write the capture of %s.\n", d->path);
+			d->done = 1;
+			err_code = -1;
+			continue;
+		}
+
+		ev.events = EPOLLIN;
+		ev.data.ptr = d;
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, d->fd, &ev) != 0)
+		{
+			fprintf(stderr, "Couldn't poll %s: %s.\n", d->path, strerror(errno));
+			d->done = 1;
+			err_code = -1;
+			continue;
+		}
+		active++;
+	}
+
+	if (queue_size > 0)
+	{
+		memset(&w, 0, sizeof(w));
+		w.devs = devs;
+		w.num_devs = num_devs;
+		w.tick_ms = tick_ms;
+		have_sem = (sem_init(&w.wake, 0, 0) == 0);
+		threaded = have_sem;
+		for (i = 0; i < num_devs && threaded; i++)
+		{
+			devs[i].q = spsc_open(queue_size);
+			threaded = (devs[i].q != NULL);
+		}
+		if (threaded && pthread_create(&writer, NULL, writer_main, &w) != 0)
+		{
+			threaded = 0;
+		}
+		if (!threaded)
+		{
+			fprintf(stderr, "Couldn't start the writer thread, writing from the reading thread.\n");
+			for (i = 0; i < num_devs; i++)
+			{
+				spsc_close(devs[i].q);
+				devs[i].q = NULL;
+			}
+		}
+	}
+	if ((threaded && rt_apply(&writer_rt, writer, "writer") != 0) ||
+	    rt_apply(&reader_rt, pthread_self(), "reading") != 0)
+	{
+		fprintf(stderr, "Not recording without the scheduling asked for.\n");
+		err_code = -1;
+		active = 0;
+	}
+
+	while (active > 0 && !stop_requested)
+	{
+		n = epoll_wait(epfd, events, MAX_EVENTS, tick_ms);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			fprintf(stderr, "epoll_wait failed: %s.\n", strerror(errno));
+			err_code = -1;
+			break;
+		}
+
+		for (j = 0; j < n; j++)
+		{
+			d = events[j].data.ptr;
+			if (d->done)
+			{
+				continue;
+			}
+
+			before = d->num_samples;
+			err = d->ops->drain(d);
+			if (d->num_samples > before)
+			{
+				now = jitter_now_us();
+				jitter_add(&d->arrivals, now);
+				if (metrics_enabled)
+				{
+					metrics_arrival(&d->metrics, now);
+				}
+			}
+			if (__atomic_load_n(&d->sink_failed, __ATOMIC_ACQUIRE))
+			{
+				err_code = -1;
+				device_finish(epfd, d);
+				active--;
+			}
+			else if (err != 0)
+			{
+				fprintf(stderr, "Error reading from %s, dropping it.\n", d->path);
+				err_code = -1;
+				device_finish(epfd, d);
+				active--;
+			}
+			else if (d->done)
+			{
+				device_finish(epfd, d);
+				active--;
+			}
+			else if (events[j].events & (EPOLLHUP | EPOLLERR))
+			{
+				fprintf(stderr, "%s went away.\n", d->path);
+				err_code = -1;
+				device_finish(epfd, d);
+				active--;
+			}
+		}
+
+		if (threaded)
+		{
+			if (n > 0)
+			{
+				sem_post(&w.wake);
+			}
+		}
+		else
+		{
+			err_code |= tick_sinks(devs, num_devs);
+			aio_kick();
+		}
+
+		/* devices whose sinks failed outside of drain(), in the writer
+		 * thread or on a tick */
+		for (i = 0; i < num_devs; i++)
+		{
+			if (!devs[i].done && __atomic_load_n(&devs[i].sink_failed, __ATOMIC_ACQUIRE))
+			{
+				err_code = -1;
+				device_finish(epfd, &devs[i]);
+				active--;
+			}
+		}
+	}
+
+	for (i = 0; i < num_devs; i++)
+	{
+		devs[i].ops->close(&devs[i]);
+	}
+	if (threaded)
+	{
+		__atomic_store_n(&w.stop, 1, __ATOMIC_RELEASE);
+		sem_post(&w.wake);
+		pthread_join(writer, NULL);
+		err_code |= w.err_code;
+	}
+	if (have_sem)
+	{
+		sem_destroy(&w.wake);
+	}
+
+	for (i = 0; i < num_devs; i++)
+	{
+		d = &devs[i];
+		if (d->q != NULL)
+		{
+			d->queue_high_water = d->q->high_water;
+			d->queue_dropped = d->q->overflows;
+			spsc_close(d->q);
+			d->q = NULL;
+		}
+		for (j = 0; j < d->num_sinks; j++)
+		{
+			err_code |= d->sinks[j]->close(d->sinks[j]);
+		}
+		d->num_sinks = 0;
+		if (d->capture != NULL)
+		{
+			if (fclose(d->capture) != 0)
+			{
+				fprintf(stderr, "Couldn't write the capture of %s.\n", d->path);
+				err_code = -1;
+			}
+			d->capture = NULL;
+		}
+	}
+	close(epfd);
+
+	return err_code;
+}
@@ -0,0 +1,137 @@
+/* Acquisition engine shared by the recording tools.
+ *
+ * A device is an input device node read by a source backend, which turns
+ * whatever the kernel delivers into samples. Every sample a device produces
+ * is handed to each of the device's sinks, e.g. a recording file. One
+ * event loop waits on all the devices at once with epoll and drains each
+ * device completely whenever it is ready, so a stalled device never holds
+ * up the others.
+ *
+ * With a queue (see acq_set_queue()) the sinks run on a writer thread of
+ * their own instead, fed through a lock-free ring per device (see spsc.h),
+ * so a slow disk can never hold up reading. A ring that fills drops
+ * samples rather than block the reader; the drops and how full each ring
+ * got are kept in the device.
+ *
+ * The reading and writer threads can be given real-time priorities and
+ * cores of their own (see acq_set_sched() and rt.h). How regularly the
+ * reader gets to each device is kept in the device (see jitter.h), along
+ * with the counters exported by metrics_start() (see metrics.h).
+ *
+ * What a device returns can be captured as it is read and replayed later
+ * in place of the device (see evcap.h).
+ */
+
+#ifndef ACQ_H
+#define ACQ_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "sample.h"
+#include "bufwriter.h"
+#include "jitter.h"
+#include "metrics.h"
+#include "rt.h"
+#include "spsc.h"
+#include "trigger.h"
+
+#define MAX_SINKS 8
+#define MAX_DEVICES 256
+
+typedef struct sink sink_t;
+typedef struct device device_t;
+
+/* A sink consumes the samples of one device. Concrete sinks embed sink_t
+ * as their first member. */
+struct sink
+{
+	int (*write)(sink_t *s, const sample_t *samples, size_t n);
+	int (*tick)(sink_t *s);      /* called periodically, may be NULL */
+	int (*close)(sink_t *s);     /* flushes and frees the sink */
+	uint64_t (*bytes)(sink_t *s);  /* bytes written so far, may be NULL */
+};
+
+typedef struct
+{
+	const char *name;
+	int (*open)(device_t *d);    /* opens d->path non-blocking into d->fd */
+	int (*drain)(device_t *d);   /* device_read()s until it would block */
+	void (*close)(device_t *d);
+} source_ops_t;
+
+struct device
+{
+	int index;
+	const char *path;
+	char name[80];
+	int fd;
+	const source_ops_t *ops;
+	void *priv;                  /* source backend state */
+	sample_t initial;            /* axes read on open, kept in a capture */
+	FILE *capture;               /* raw reads are appended, NULL = none */
+	void *replay;                /* replaying a capture, NULL = live */
+
+	sink_t *sinks[MAX_SINKS];
+	int num_sinks;
+
+	uint64_t num_samples;        /* samples delivered to the sinks */
+	uint64_t max_samples;        /* stop after this many, 0 = never */
+	int done;                    /* finished or failed, no longer polled */
+	int sink_failed;             /* a sink failed, nothing more is written */
+
+	spsc_t *q;                   /* to the writer thread, NULL without one */
+	uint64_t queue_high_water;   /* most samples waiting in q */
+	uint64_t queue_dropped;      /* samples q had no room for */
+
+	jitter_t arrivals;           /* intervals between reads that found samples */
+	dev_metrics_t metrics;       /* see metrics.h */
+};
+
+extern const source_ops_t joydev_source;
+extern const source_ops_t evdev_source;
+extern const source_ops_t hidraw_source;
+extern const source_ops_t replay_source;
+
+const source_ops_t *source_for_path(const char **path);
+void replay_set_speed(double speed);
+ssize_t replay_read(device_t *d, void *buf, size_t len);
+int replay_state(device_t *d, void *buf, size_t len);
+
+int device_add_sink(device_t *d, sink_t *s);
+int device_emit(device_t *d, const sample_t *samples, size_t n);
+ssize_t device_read(device_t *d, void *buf, size_t len);
+
+void acq_set_queue(size_t samples);
+void acq_set_sched(const rt_cfg_t *reader, const rt_cfg_t *writer);
+int acq_run(device_t *devs, int num_devs, unsigned int tick_ms);
+void acq_stop(void);
+
+/* raw recording sink, see sample.h for the format */
+sink_t *rawsink_open(const char *path, const bufwriter_cfg_t *cfg);
+
+/* columnar recording sink, see colrec.h for the format */
+typedef struct
+{
+	const char *device;
+	const char *filter;
+	double sample_rate;
+	uint32_t codec;           /* COLREC_CODEC_NONE or COLREC_CODEC_DELTA */
+	uint64_t created_us;      /* wall clock time for the header, 0 for the time of opening */
+} colsink_info_t;
+
+sink_t *colsink_open(const char *path, const colsink_info_t *info, const bufwriter_cfg_t *cfg);
+
+/* columnar segments with a segment index, see segidx.h */
+sink_t *segsink_open(const char *dir, const char *prefix, unsigned int seg_s,
+                     const colsink_info_t *info, const bufwriter_cfg_t *cfg);
+
+/* resamples onto a regular grid before another sink, see resample.h */
+sink_t *resink_open(double rate, int method, int absolute, sink_t *next);
+
+/* STA/LTA triggers written to an event log, see trigger.h */
+sink_t *trigsink_open(const char *device, const trig_rule_t *rules, size_t num_rules, FILE *log);
+
+#endif
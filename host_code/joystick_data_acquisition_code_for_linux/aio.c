@@ -0,0 +1,838 @@
+/* Asynchronous writes for bufwriter. See aio.h.
+ */
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "aio.h"
+
+#define POOL_ALIGN 4096
+#define MIN_ENTRIES 64
+
+typedef struct aio_req
+{
+	struct aio_req *next;
+	aio_file_t *f;
+	char *buf;                /* NULL for an fsync on its own */
+	size_t len;
+	uint64_t offset;
+	int sync;
+	int res_write;            /* bytes written or -errno */
+	int res_sync;             /* 0 or -errno */
+	int left;                 /* completions still to come */
+} aio_req_t;
+
+aio_stats_t aio_stats;
+
+static int backend = AIO_SYNC;
+static size_t buf_size;
+static char *pool;
+static int num_bufs;
+static char **free_bufs;
+static int num_free;
+static aio_req_t *free_reqs;
+static aio_file_t *ready_head, *ready_tail;
+static int in_flight;         /* requests handed to the backend */
+
+/* uring */
+static int ring_fd = -1;
+static int fixed;
+static void *sq_ptr, *cq_ptr;
+static size_t sq_map_size, cq_map_size;
+static struct io_uring_sqe *sqes;
+static size_t sqes_size;
+static unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+static unsigned *cq_head, *cq_tail, *cq_mask;
+static struct io_uring_cqe *cqes;
+static unsigned sq_entries;
+static unsigned sqes_in_flight;
+static unsigned to_submit;
+
+/* threads */
+static pthread_t threads[AIO_NUM_THREADS];
+static int num_threads;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static aio_req_t *work_head, *work_tail;
+static aio_req_t *done_list;
+static int quit;
+
+int aio_backend_of(const char *name)
+{
+	if (strcmp(name, "sync") == 0)
+	{
+		return AIO_SYNC;
+	}
+	if (strcmp(name, "uring") == 0)
+	{
+		return AIO_URING;
+	}
+	if (strcmp(name, "threads") == 0)
+	{
+		return AIO_THREADS;
+	}
+
+	return -1;
+}
+
+const char *aio_backend_name(int b)
+{
+	static const char *const names[] = { "sync", "uring", "threads" };
+
+	return names[b];
+}
+
+int aio_backend(void)
+{
+	return backend;
+}
+
+size_t aio_buf_size(void)
+{
+	return buf_size;
+}
+
+static int pwrite_all(int fd, const char *p, size_t len, uint64_t offset)
+{
+	ssize_t n;
+	size_t done = 0;
+
+	while (done < len)
+	{
+		n = pwrite(fd, p + done, len - done, offset + done);
+		__sync_fetch_and_add(&aio_stats.syscalls, 1);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return -errno;
+		}
+		done += n;
+	}
+
+	return done;
+}
+
+static int datasync(int fd)
+{
+	__sync_fetch_and_add(&aio_stats.syscalls, 1);
+	return (fdatasync(fd) == 0) ? 0 : -errno;
+}
+
+/* uring */
+
+static int uring_enter(unsigned submit, unsigned min_complete, unsigned flags)
+{
+	int n;
+
+	do
+	{
+		n = syscall(__NR_io_uring_enter, ring_fd, submit, min_complete, flags, NULL, 0);
+		aio_stats.syscalls++;
+	} while (n < 0 && errno == EINTR);
+
+	return n;
+}
+
+static void uring_close(void)
+{
+	if (sqes != NULL)
+	{
+		munmap(sqes, sqes_size);
+	}
+	if (cq_ptr != NULL && cq_ptr != sq_ptr)
+	{
+		munmap(cq_ptr, cq_map_size);
+	}
+	if (sq_ptr != NULL)
+	{
+		munmap(sq_ptr, sq_map_size);
+	}
+	if (ring_fd >= 0)
+	{
+		close(ring_fd);
+	}
+	sqes = NULL;
+	sq_ptr = cq_ptr = NULL;
+	ring_fd = -1;
+}
+
+/* Whether the kernel has the opcodes the backend uses. IORING_OP_WRITE
+ * only came in 5.6, a year after io_uring itself, and so did the probe, so
+ * a kernel that can't be probed doesn't have it either. */
+static int uring_has_ops(void)
+{
+	static const int ops[] = { IORING_OP_WRITE, IORING_OP_WRITE_FIXED, IORING_OP_FSYNC };
+	struct io_uring_probe *probe;
+	size_t size = sizeof(*probe) + 256*sizeof(struct io_uring_probe_op);
+	int ok;
+	int i;
+
+	probe = calloc(1, size);
+	if (probe == NULL)
+	{
+		return 0;
+	}
+	ok = (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, 256) == 0);
+	for (i = 0; ok && i < (int)(sizeof(ops)/sizeof(ops[0])); i++)
+	{
+		ok = (ops[i] < probe->ops_len && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED));
+	}
+	free(probe);
+
+	return ok;
+}
+
+static int uring_open(void)
+{
+	struct io_uring_params p;
+	struct iovec *iov;
+	unsigned entries = MIN_ENTRIES;
+	int i;
+
+	/* every request in flight takes two entries at most */
+	while (entries < 2*(unsigned)num_bufs)
+	{
+		entries *= 2;
+	}
+
+	memset(&p, 0, sizeof(p));
+	ring_fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (ring_fd < 0)
+	{
+		return -1;
+	}
+
+	sq_map_size = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+	cq_map_size = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (cq_map_size > sq_map_size)
+		{
+			sq_map_size = cq_map_size;
+		}
+		cq_map_size = sq_map_size;
+	}
+
+	sq_ptr = mmap(NULL, sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+	              ring_fd, IORING_OFF_SQ_RING);
+	if (sq_ptr == MAP_FAILED)
+	{
+		sq_ptr = NULL;
+		uring_close();
+		return -1;
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		cq_ptr = sq_ptr;
+	}
+	else
+	{
+		cq_ptr = mmap(NULL, cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		              ring_fd, IORING_OFF_CQ_RING);
+		if (cq_ptr == MAP_FAILED)
+		{
+			cq_ptr = NULL;
+			uring_close();
+			return -1;
+		}
+	}
+	sqes_size = p.sq_entries*sizeof(struct io_uring_sqe);
+	sqes = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+	            ring_fd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED)
+	{
+		sqes = NULL;
+		uring_close();
+		return -1;
+	}
+
+	sq_head = (unsigned *)((char *)sq_ptr + p.sq_off.head);
+	sq_tail = (unsigned *)((char *)sq_ptr + p.sq_off.tail);
+	sq_mask = (unsigned *)((char *)sq_ptr + p.sq_off.ring_mask);
+	sq_array = (unsigned *)((char *)sq_ptr + p.sq_off.array);
+	cq_head = (unsigned *)((char *)cq_ptr + p.cq_off.head);
+	cq_tail = (unsigned *)((char *)cq_ptr + p.cq_off.tail);
+	cq_mask = (unsigned *)((char *)cq_ptr + p.cq_off.ring_mask);
+	cqes = (struct io_uring_cqe *)((char *)cq_ptr + p.cq_off.cqes);
+	sq_entries = p.sq_entries;
+	sqes_in_flight = 0;
+	to_submit = 0;
+
+	if (!uring_has_ops())
+	{
+		uring_close();
+		return -1;
+	}
+
+	/* registering pins the pool, which RLIMIT_MEMLOCK may not allow */
+	iov = malloc(num_bufs*sizeof(struct iovec));
+	fixed = 0;
+	if (iov != NULL)
+	{
+		for (i = 0; i < num_bufs; i++)
+		{
+			iov[i].iov_base = pool + (size_t)i*buf_size;
+			iov[i].iov_len = buf_size;
+		}
+		fixed = (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, iov, num_bufs) == 0);
+		free(iov);
+	}
+
+	return 0;
+}
+
+static struct io_uring_sqe *uring_sqe(aio_req_t *r, unsigned long long tag)
+{
+	unsigned tail = *sq_tail;
+	unsigned i = tail & *sq_mask;
+	struct io_uring_sqe *sqe = &sqes[i];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->user_data = (uintptr_t)r | tag;
+	sq_array[i] = i;
+	__atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+	to_submit++;
+	sqes_in_flight++;
+
+	return sqe;
+}
+
+static int uring_submit(aio_req_t *r)
+{
+	struct io_uring_sqe *sqe;
+	unsigned need = (r->buf != NULL) + r->sync;
+
+	if (sqes_in_flight + need > sq_entries)
+	{
+		return -1;
+	}
+
+	r->left = need;
+	if (r->buf != NULL)
+	{
+		sqe = uring_sqe(r, 0);
+		sqe->opcode = fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+		sqe->fd = r->f->fd;
+		sqe->addr = (uintptr_t)r->buf;
+		sqe->len = r->len;
+		sqe->off = r->offset;
+		if (fixed)
+		{
+			sqe->buf_index = (r->buf - pool)/buf_size;
+		}
+		if (r->sync)
+		{
+			/* the fsync only starts once the write is done */
+			sqe->flags = IOSQE_IO_LINK;
+		}
+	}
+	if (r->sync)
+	{
+		sqe = uring_sqe(r, 1);
+		sqe->opcode = IORING_OP_FSYNC;
+		sqe->fd = r->f->fd;
+		sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+	}
+
+	return 0;
+}
+
+/* threads */
+
+static void *worker_main(void *arg)
+{
+	aio_req_t *r;
+
+	(void)arg;
+	pthread_mutex_lock(&lock);
+	for (;;)
+	{
+		while (work_head == NULL && !quit)
+		{
+			pthread_cond_wait(&work_cond, &lock);
+		}
+		if (work_head == NULL)
+		{
+			break;
+		}
+		r = work_head;
+		work_head = r->next;
+		pthread_mutex_unlock(&lock);
+
+		r->res_write = 0;
+		r->res_sync = 0;
+		if (r->buf != NULL)
+		{
+			r->res_write = pwrite_all(r->f->fd, r->buf, r->len, r->offset);
+		}
+		if (r->sync)
+		{
+			r->res_sync = (r->res_write < 0) ? -ECANCELED : datasync(r->f->fd);
+		}
+
+		pthread_mutex_lock(&lock);
+		r->next = done_list;
+		done_list = r;
+		pthread_cond_signal(&done_cond);
+	}
+	pthread_mutex_unlock(&lock);
+
+	return NULL;
+}
+
+static void threads_submit(aio_req_t *r)
+{
+	pthread_mutex_lock(&lock);
+	r->next = NULL;
+	if (work_head == NULL)
+	{
+		work_head = r;
+	}
+	else
+	{
+		work_tail->next = r;
+	}
+	work_tail = r;
+	pthread_cond_signal(&work_cond);
+	pthread_mutex_unlock(&lock);
+}
+
+static void threads_stop(void)
+{
+	int i;
+
+	pthread_mutex_lock(&lock);
+	quit = 1;
+	pthread_cond_broadcast(&work_cond);
+	pthread_mutex_unlock(&lock);
+	for (i = 0; i < num_threads; i++)
+	{
+		pthread_join(threads[i], NULL);
+	}
+	num_threads = 0;
+	quit = 0;
+}
+
+/* both */
+
+static void set_error(aio_file_t *f, int err)
+{
+	if (f->error == 0)
+	{
+		f->error = err;
+	}
+}
+
+static void make_ready(aio_file_t *f)
+{
+	if (f->ready || f->busy || f->head == NULL)
+	{
+		return;
+	}
+	f->ready = 1;
+	f->next_ready = NULL;
+	if (ready_head == NULL)
+	{
+		ready_head = f;
+	}
+	else
+	{
+		ready_tail->next_ready = f;
+	}
+	ready_tail = f;
+}
+
+/* Hands the first request of each file that has nothing in flight to the
+ * backend, for as long as there is room. */
+static void submit_ready(void)
+{
+	aio_file_t *f;
+	aio_req_t *r;
+
+	while ((f = ready_head) != NULL)
+	{
+		r = f->head;
+		if (backend == AIO_URING && uring_submit(r) != 0)
+		{
+			break;
+		}
+		ready_head = f->next_ready;
+		f->ready = 0;
+		f->head = r->next;
+		f->busy = 1;
+		in_flight++;
+		if (backend == AIO_THREADS)
+		{
+			threads_submit(r);
+		}
+	}
+}
+
+static void finish(aio_req_t *r)
+{
+	aio_file_t *f = r->f;
+	int n;
+
+	if (r->buf != NULL)
+	{
+		if (r->res_write < 0)
+		{
+			set_error(f, -r->res_write);
+		}
+		else
+		{
+			if ((size_t)r->res_write < r->len)
+			{
+				/* rare for a regular file, so the rest is written here */
+				n = pwrite_all(f->fd, r->buf + r->res_write, r->len - r->res_write,
+				               r->offset + r->res_write);
+				if (n < 0)
+				{
+					set_error(f, -n);
+				}
+			}
+			aio_stats.writes++;
+			aio_stats.bytes += r->len;
+		}
+		aio_put_buf(r->buf);
+	}
+
+	if (r->sync)
+	{
+		/* a linked fsync is cancelled when its write comes up short */
+		if (r->res_sync == -ECANCELED && f->error == 0)
+		{
+			r->res_sync = datasync(f->fd);
+		}
+		if (r->res_sync < 0 && r->res_sync != -ECANCELED)
+		{
+			set_error(f, -r->res_sync);
+		}
+		aio_stats.fsyncs++;
+	}
+
+	f->busy = 0;
+	f->pending--;
+	in_flight--;
+	make_ready(f);
+
+	r->next = free_reqs;
+	free_reqs = r;
+}
+
+/* Fails the requests the kernel hasn't taken from the submission queue
+ * with err, after io_uring_enter itself failed. Otherwise a lasting error,
+ * such as ENOMEM, would leave them queued and aio_wait() waiting for them
+ * for ever. */
+static void uring_fail_unsubmitted(int err)
+{
+	struct io_uring_sqe *sqe;
+	aio_req_t *r;
+	unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+	unsigned tail = *sq_tail;
+
+	__atomic_store_n(sq_tail, head, __ATOMIC_RELEASE);
+	to_submit = 0;
+	for (; head != tail; head++)
+	{
+		sqe = &sqes[sq_array[head & *sq_mask]];
+		r = (aio_req_t *)(uintptr_t)(sqe->user_data & ~1ULL);
+		if (sqe->user_data & 1)
+		{
+			r->res_sync = -err;
+		}
+		else
+		{
+			r->res_write = -err;
+		}
+		sqes_in_flight--;
+		if (--r->left == 0)
+		{
+			finish(r);
+		}
+	}
+}
+
+/* Finishes the requests that are done, waiting for at least one if wait
+ * is set, then submits whatever can go next. */
+static void reap(int wait)
+{
+	struct io_uring_cqe *cqe;
+	aio_req_t *r, *next;
+	unsigned head;
+
+	if (in_flight == 0)
+	{
+		wait = 0;
+	}
+
+	if (backend == AIO_URING)
+	{
+		if (to_submit > 0 || wait)
+		{
+			int n = uring_enter(to_submit, wait, wait ? IORING_ENTER_GETEVENTS : 0);
+
+			if (n > 0)
+			{
+				to_submit -= n;
+			}
+			else if (n < 0 && to_submit > 0)
+			{
+				uring_fail_unsubmitted(errno);
+			}
+		}
+
+		head = *cq_head;
+		while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+		{
+			cqe = &cqes[head & *cq_mask];
+			r = (aio_req_t *)(uintptr_t)(cqe->user_data & ~1ULL);
+			if (cqe->user_data & 1)
+			{
+				r->res_sync = cqe->res;
+			}
+			else
+			{
+				r->res_write = cqe->res;
+			}
+			head++;
+			sqes_in_flight--;
+			if (--r->left == 0)
+			{
+				finish(r);
+			}
+		}
+		__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+	}
+	else if (backend == AIO_THREADS)
+	{
+		pthread_mutex_lock(&lock);
+		while (wait && done_list == NULL)
+		{
+			pthread_cond_wait(&done_cond, &lock);
+		}
+		r = done_list;
+		done_list = NULL;
+		pthread_mutex_unlock(&lock);
+
+		for (; r != NULL; r = next)
+		{
+			next = r->next;
+			finish(r);
+		}
+	}
+
+	submit_ready();
+}
+
+/* Starts a backend with a pool of num_bufs buffers of buf_size bytes.
+ * AIO_URING falls back to AIO_THREADS when io_uring can't be set up.
+ * Returns the backend started, or -1. */
+int aio_init(int b, size_t size, int n)
+{
+	void *p;
+	int i;
+
+	if (b == AIO_SYNC)
+	{
+		backend = AIO_SYNC;
+		return backend;
+	}
+
+	buf_size = (size + POOL_ALIGN - 1) & ~(size_t)(POOL_ALIGN - 1);
+	num_bufs = n;
+	if (posix_memalign(&p, POOL_ALIGN, (size_t)n*buf_size) != 0)
+	{
+		return -1;
+	}
+	pool = p;
+	memset(pool, 0, (size_t)n*buf_size);
+	free_bufs = malloc(n*sizeof(char *));
+	if (free_bufs == NULL)
+	{
+		free(pool);
+		pool = NULL;
+		return -1;
+	}
+	for (i = 0; i < n; i++)
+	{
+		free_bufs[i] = pool + (size_t)i*buf_size;
+	}
+	num_free = n;
+
+	if (b == AIO_URING && uring_open() != 0)
+	{
+		b = AIO_THREADS;
+	}
+	if (b == AIO_THREADS)
+	{
+		for (num_threads = 0; num_threads < AIO_NUM_THREADS; num_threads++)
+		{
+			if (pthread_create(&threads[num_threads], NULL, worker_main, NULL) != 0)
+			{
+				break;
+			}
+		}
+		if (num_threads == 0)
+		{
+			free(free_bufs);
+			free(pool);
+			pool = NULL;
+			return -1;
+		}
+	}
+	backend = b;
+
+	return backend;
+}
+
+/* Stops the backend once every file has been waited for. */
+void aio_shutdown(void)
+{
+	aio_req_t *r;
+
+	if (backend == AIO_URING)
+	{
+		uring_close();
+	}
+	else if (backend == AIO_THREADS)
+	{
+		threads_stop();
+	}
+	backend = AIO_SYNC;
+
+	while ((r = free_reqs) != NULL)
+	{
+		free_reqs = r->next;
+		free(r);
+	}
+	free(free_bufs);
+	free(pool);
+	free_bufs = NULL;
+	pool = NULL;
+}
+
+void aio_open(aio_file_t *f, int fd)
+{
+	memset(f, 0, sizeof(*f));
+	f->fd = fd;
+}
+
+/* Takes a buffer from the pool, waiting for a write to finish if none is
+ * free. Returns NULL if none ever will be. */
+char *aio_get_buf(void)
+{
+	while (num_free == 0 && in_flight + (ready_head != NULL) > 0)
+	{
+		reap(1);
+	}
+
+	return (num_free > 0) ? free_bufs[--num_free] : NULL;
+}
+
+void aio_put_buf(char *buf)
+{
+	free_bufs[num_free++] = buf;
+}
+
+static int queue(aio_file_t *f, char *buf, size_t len, uint64_t offset, int sync)
+{
+	aio_req_t *r = free_reqs;
+
+	if (r != NULL)
+	{
+		free_reqs = r->next;
+	}
+	else if ((r = malloc(sizeof(*r))) == NULL)
+	{
+		if (buf != NULL)
+		{
+			aio_put_buf(buf);
+		}
+		set_error(f, ENOMEM);
+		return -1;
+	}
+
+	memset(r, 0, sizeof(*r));
+	r->f = f;
+	r->buf = buf;
+	r->len = len;
+	r->offset = offset;
+	r->sync = sync;
+	if (f->head == NULL)
+	{
+		f->head = r;
+	}
+	else
+	{
+		f->tail->next = r;
+	}
+	f->tail = r;
+	f->pending++;
+	make_ready(f);
+	if (backend == AIO_THREADS)
+	{
+		submit_ready();
+	}
+
+	return 0;
+}
+
+/* Writes len bytes of buf, a buffer from the pool that goes back to it
+ * once written, at offset, followed by an fdatasync if sync is set.
+ * Returns -1 if an earlier request for the file failed. */
+int aio_write(aio_file_t *f, char *buf, size_t len, uint64_t offset, int sync)
+{
+	if (f->error != 0)
+	{
+		aio_put_buf(buf);
+		return -1;
+	}
+
+	return queue(f, buf, len, offset, sync);
+}
+
+/* fdatasyncs the file once the writes before it are done. */
+int aio_sync(aio_file_t *f)
+{
+	if (f->error != 0)
+	{
+		return -1;
+	}
+
+	return queue(f, NULL, 0, 0, 1);
+}
+
+/* Waits for every request for the file. Returns -1 if one failed. */
+int aio_wait(aio_file_t *f)
+{
+	while (f->pending > 0)
+	{
+		reap(1);
+	}
+
+	return (f->error != 0) ? -1 : 0;
+}
+
+/* Submits what has been queued since the last call and finishes what is
+ * done, without waiting. Call it once per round of writes, so the writes
+ * of all the files go to the kernel together. */
+void aio_kick(void)
+{
+	if (backend != AIO_SYNC)
+	{
+		reap(0);
+	}
+}
@@ -0,0 +1,84 @@
+/* Asynchronous writes for bufwriter.
+ *
+ * Without aio_init() a bufwriter writes and fsyncs in the thread that
+ * calls it, so a slow fdatasync (hundreds of milliseconds on some SD cards)
+ * holds up the recording. With it, a full buffer is handed off and filling
+ * goes on in another one while the write, and the fdatasync that may follow
+ * it, are done in the background.
+ *
+ * The buffers come from one pool shared by every file. Two backends do the
+ * writing:
+ *
+ *   uring    io_uring, through the raw system calls. The pool is registered
+ *            with the kernel so the writes don't have to map it each time,
+ *            and an fdatasync is linked to the write in front of it so both
+ *            go in one submission. Submissions from all the files are
+ *            entered together by aio_kick(), so many streams cost a few
+ *            system calls per round. If the pool can't be registered plain
+ *            writes are used. A kernel without the opcodes it needs (older
+ *            than 5.6) gets the threads instead. If io_uring_enter fails,
+ *            the requests it didn't take fail with its error.
+ *   threads  a few threads doing pwrite and fdatasync, used when io_uring
+ *            is unavailable.
+ *
+ * Each file has at most one request in flight and the rest wait their turn,
+ * so a file's writes and fsyncs are done in order while different files are
+ * written at the same time. An error is kept in the file and returned by
+ * the next call for it.
+ *
+ * All the functions must be called from the same thread. The pool needs a
+ * buffer for every open file plus one for each write that may be in
+ * flight; aio_get_buf() waits for a write to finish when none is free.
+ */
+
+#ifndef AIO_H
+#define AIO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define AIO_SYNC 0
+#define AIO_URING 1
+#define AIO_THREADS 2
+
+#define AIO_NUM_THREADS 4
+
+struct aio_req;
+
+typedef struct aio_file
+{
+	int fd;
+	int pending;              /* requests not yet finished */
+	int error;                /* errno of the first request that failed */
+	int busy;                 /* a request is in flight */
+	int ready;                /* on the list of files to submit */
+	struct aio_req *head, *tail;
+	struct aio_file *next_ready;
+} aio_file_t;
+
+typedef struct
+{
+	uint64_t syscalls;        /* to write and fsync, counting io_uring_enter */
+	uint64_t writes;
+	uint64_t fsyncs;
+	uint64_t bytes;
+} aio_stats_t;
+
+extern aio_stats_t aio_stats;
+
+int aio_backend_of(const char *name);
+const char *aio_backend_name(int backend);
+int aio_init(int backend, size_t buf_size, int num_bufs);
+void aio_shutdown(void);
+int aio_backend(void);
+size_t aio_buf_size(void);
+
+void aio_open(aio_file_t *f, int fd);
+char *aio_get_buf(void);
+void aio_put_buf(char *buf);
+int aio_write(aio_file_t *f, char *buf, size_t len, uint64_t offset, int sync);
+int aio_sync(aio_file_t *f);
+int aio_wait(aio_file_t *f);
+void aio_kick(void);
+
+#endif
@@ -0,0 +1,884 @@
+/* Microbenchmarks of the processing stages, so their speed can be tracked
+ * from commit to commit.
+ *
+ * Every benchmark runs over a synthetic recording of each of the sizes
+ * asked for: samples 8 ms apart with a little jitter, the resting values
+ * of a nunchuk plus noise and a slow swell. A benchmark is repeated until
+ * it has run for at least the minimum time and the fastest run is kept.
+ * For each benchmark and size it prints a line of name=value pairs:
+ *
+ *   bench          the stage, see below
+ *   samples        size of the recording
+ *   runs           times it was run
+ *   ns_per_sample  of the fastest run
+ *   samples_s      samples/s of the fastest run
+ *   mb_s           MB/s of the stage's input: the reports for the
+ *                  decoders, the encoded blocks for codec_decode, what
+ *                  was written for the writers and 16 bytes per sample,
+ *                  the size of a raw record, for the rest
+ *
+ * The stages:
+ *
+ *   decode_nunchuk   the firmware's Nunchuk_Decode() over 6 byte reports
+ *                    with a 0xFE spike in every 100
+ *   decode_joydev, decode_evdev
+ *                    the joydev and evdev backends turning captured
+ *                    js_events and input_events into samples, fed by the
+ *                    replay backend (see evcap.h)
+ *   resample_hold, resample_linear, resample_sinc
+ *                    resample.h onto a 125 samples/s grid
+ *   filter_chebyshev the firmware's 4 pole Chebyshev filter, its dsp.c
+ *                    built for the PC
+ *   filter_moving_average
+ *                    the moving average firmware's sum of 8 readings
+ *   filter_sta_lta   the STA/LTA trigger (trigger.h) on every axis
+ *   codec_encode, codec_decode
+ *                    codec.h over whole blocks of a columnar recording
+ *   write_csv        export_csv's text, one file per axis
+ *   write_raw, write_col, write_col_z
+ *                    the raw and columnar sinks, uncompressed and
+ *                    compressed, through bufwriter without fsync
+ *   psd              Welch's PSD (welch.h) of one axis, 1024 point Hann
+ *                    segments with 50% overlap
+ *
+ * The files written go to a directory (default the current one) and are
+ * removed afterwards. Only the stages whose name contains one of the -b
+ * arguments are run, e.g. -b write for the writers.
+ *
+ * To compile: make bench
+ * To run: ./bench
+ *         ./bench -n 4096,1048576 -b codec -b filter
+ *
+ * Options:
+ *   -n N[,N...] sizes in samples (default 4096,65536,1048576)
+ *   -b name     only the stages whose name contains name, may be given
+ *               more than once
+ *   -t secs     minimum time for each benchmark and size (default 0.2)
+ *   -d dir      directory for the files written
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/input.h>
+#include <linux/joystick.h>
+
+#include "acq.h"
+#include "codec.h"
+#include "colrec.h"
+#include "evcap.h"
+#include "resample.h"
+#include "sample.h"
+#include "trigger.h"
+#include "welch.h"
+
+/* from the chebyshev firmware */
+#include "sensor.h"
+#include "dsp.h"
+
+#define MAX_SIZES 16
+#define MAX_FILTERS 16
+#define PERIOD_US 8000
+#define REPORTS_PER_READ 16
+#define MA_READINGS 8
+#define PSD_SEGMENT 1024
+
+typedef struct
+{
+	const char *name;
+	/* runs the stage over the n samples, returns its input bytes or -1 */
+	double (*run)(size_t n);
+} bench_t;
+
+static sample_t *samples;
+static const char *dir = ".";
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static char *bench_path(const char *name)
+{
+	char *path = malloc(strlen(dir) + strlen(name) + 2);
+
+	if (path != NULL)
+	{
+		sprintf(path, "%s/%s", dir, name);
+	}
+	return path;
+}
+
+static int make_samples(size_t n)
+{
+	uint32_t r = 1;
+	size_t i;
+	int a;
+
+	samples = malloc(n*sizeof(sample_t));
+	if (samples == NULL)
+	{
+		return -1;
+	}
+	for (i = 0; i < n; i++)
+	{
+		r = r*1664525 + 1013904223;
+		samples[i].t_us = 1000000 + (uint64_t)i*PERIOD_US + (r >> 28);
+		for (a = 0; a < NUM_AXES; a++)
+		{
+			r = r*1664525 + 1013904223;
+			samples[i].axis[a] = (a == 2 ? 716 : 512) + (int)(r >> 30) - 2 + (int)(20*sin(i*0.01 + a));
+		}
+		samples[i].dev = 0;
+		samples[i].updated = (1 << NUM_AXES) - 1;
+	}
+
+	return 0;
+}
+
+static double bench_decode_nunchuk(size_t n)
+{
+	static uint8_t *raw;
+	static size_t raw_n;
+	Sensor_Sample_t s;
+	volatile int32_t sink = 0;
+	size_t i;
+
+	if (raw_n != n)
+	{
+		free(raw);
+		raw = malloc(n*NUM_BYTES);
+		if (raw == NULL)
+		{
+			raw_n = 0;
+			return -1;
+		}
+		raw_n = n;
+		for (i = 0; i < n; i++)
+		{
+			raw[i*NUM_BYTES + 0] = 128;
+			raw[i*NUM_BYTES + 1] = 128;
+			raw[i*NUM_BYTES + 2] = samples[i].axis[0] >> 2;
+			raw[i*NUM_BYTES + 3] = samples[i].axis[1] >> 2;
+			raw[i*NUM_BYTES + 4] = samples[i].axis[2] >> 2;
+			raw[i*NUM_BYTES + 5] = (samples[i].axis[0] & 3) << 2 | (samples[i].axis[1] & 3) << 4 | (samples[i].axis[2] & 3) << 6;
+			if (i % 100 == 99)
+			{
+				raw[i*NUM_BYTES + 4] = raw[i*NUM_BYTES + 5] = 0xFE;
+			}
+		}
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		if (Nunchuk_Decode(&raw[i*NUM_BYTES], &s))
+		{
+			sink += s.x + s.y + s.z;
+		}
+	}
+
+	return (double)n*NUM_BYTES;
+}
+
+/* Writes a capture of the samples as the given backend would have read
+ * them, REPORTS_PER_READ reports per read. */
+static int make_capture(const char *path, const char *source, size_t n, size_t *bytes)
+{
+	struct js_event jse[REPORTS_PER_READ*NUM_AXES];
+	struct input_event ie[REPORTS_PER_READ*(NUM_AXES + 1)];
+	static const int code[NUM_AXES] = { ABS_X, ABS_Y, ABS_Z };
+	sample_t initial;
+	FILE *f;
+	size_t i, j, m;
+	int a;
+	int err_code = 0;
+
+	f = evcap_create(path);
+	if (f == NULL)
+	{
+		return -1;
+	}
+	memset(&initial, 0, sizeof(initial));
+	err_code |= evcap_write_header(f, source, "bench", "bench", &initial);
+
+	*bytes = 0;
+	for (i = 0; i < n && err_code == 0; i += REPORTS_PER_READ)
+	{
+		m = 0;
+		memset(ie, 0, sizeof(ie));
+		for (j = i; j < n && j < i + REPORTS_PER_READ; j++)
+		{
+			for (a = 0; a < NUM_AXES; a++)
+			{
+				if (strcmp(source, "joydev") == 0)
+				{
+					jse[m].time = samples[j].t_us/1000;
+					jse[m].value = samples[j].axis[a];
+					jse[m].type = JS_EVENT_AXIS;
+					jse[m].number = a;
+				}
+				else
+				{
+					ie[m].input_event_sec = samples[j].t_us/1000000;
+					ie[m].input_event_usec = samples[j].t_us % 1000000;
+					ie[m].type = EV_ABS;
+					ie[m].code = code[a];
+					ie[m].value = samples[j].axis[a];
+				}
+				m++;
+			}
+			if (strcmp(source, "evdev") == 0)
+			{
+				ie[m] = ie[m - 1];
+				ie[m].type = EV_SYN;
+				ie[m].code = SYN_REPORT;
+				ie[m].value = 0;
+				m++;
+			}
+		}
+		if (strcmp(source, "joydev") == 0)
+		{
+			err_code |= evcap_write(f, EVCAP_READ, jse, m*sizeof(jse[0]));
+			*bytes += m*sizeof(jse[0]);
+		}
+		else
+		{
+			err_code |= evcap_write(f, EVCAP_READ, ie, m*sizeof(ie[0]));
+			*bytes += m*sizeof(ie[0]);
+		}
+	}
+
+	if (fclose(f) != 0)
+	{
+		err_code = -1;
+	}
+
+	return err_code;
+}
+
+typedef struct
+{
+	sink_t base;
+	uint64_t num;
+} count_sink_t;
+
+static int count_write(sink_t *s, const sample_t *in, size_t n)
+{
+	(void)in;
+	((count_sink_t *)s)->num += n;
+	return 0;
+}
+
+static int count_close(sink_t *s)
+{
+	(void)s;
+	return 0;
+}
+
+static double bench_decode(size_t n, const char *source)
+{
+	static size_t made_n[2];
+	static size_t bytes[2];
+	int k = (strcmp(source, "joydev") == 0) ? 0 : 1;
+	count_sink_t counter = { { count_write, NULL, count_close, NULL }, 0 };
+	char name[32];
+	device_t d;
+	char *path;
+	int out;
+	int err_code = 0;
+
+	sprintf(name, "bench_%s.evc", source);
+	path = bench_path(name);
+	if (path == NULL)
+	{
+		return -1;
+	}
+	if (made_n[k] != n)
+	{
+		made_n[k] = 0;
+		if (make_capture(path, source, n, &bytes[k]) != 0)
+		{
+			fprintf(stderr, "Couldn't write %s.\n", path);
+			free(path);
+			return -1;
+		}
+		made_n[k] = n;
+	}
+
+	memset(&d, 0, sizeof(d));
+	d.path = path;
+	d.fd = -1;
+	device_add_sink(&d, &counter.base);
+	replay_set_speed(0);
+
+	/* the replay backend reports on stdout */
+	fflush(stdout);
+	out = dup(STDOUT_FILENO);
+	if (freopen("/dev/null", "w", stdout) == NULL)
+	{
+		err_code = -1;
+	}
+	if (err_code == 0 && replay_source.open(&d) != 0)
+	{
+		err_code = -1;
+	}
+	while (err_code == 0 && !d.done)
+	{
+		err_code = replay_source.drain(&d);
+	}
+	replay_source.close(&d);
+	fflush(stdout);
+	dup2(out, STDOUT_FILENO);
+	close(out);
+
+	free(path);
+	if (err_code != 0 || counter.num != n)
+	{
+		return -1;
+	}
+
+	return bytes[k];
+}
+
+static double bench_decode_joydev(size_t n)
+{
+	return bench_decode(n, "joydev");
+}
+
+static double bench_decode_evdev(size_t n)
+{
+	return bench_decode(n, "evdev");
+}
+
+static int discard(void *ctx, const rsample_t *out, size_t n)
+{
+	(void)out;
+	*(size_t *)ctx += n;
+	return 0;
+}
+
+static double bench_resample(size_t n, int method)
+{
+	resampler_t r;
+	size_t num_out = 0;
+
+	if (resampler_init(&r, 125, method, RESAMPLE_DEFAULT_TAPS, RESAMPLE_DEFAULT_MAX_GAP_US, discard, &num_out) != 0)
+	{
+		return -1;
+	}
+	resampler_push(&r, samples, n);
+	resampler_flush(&r);
+	resampler_free(&r);
+
+	return (double)n*sizeof(rawrec_t);
+}
+
+static double bench_resample_hold(size_t n)
+{
+	return bench_resample(n, RESAMPLE_HOLD);
+}
+
+static double bench_resample_linear(size_t n)
+{
+	return bench_resample(n, RESAMPLE_LINEAR);
+}
+
+static double bench_resample_sinc(size_t n)
+{
+	return bench_resample(n, RESAMPLE_SINC);
+}
+
+/* the firmware's filter core (dsp.h), as the ISR runs it */
+static double bench_filter_chebyshev(size_t n)
+{
+	Dsp_Filter_t f;
+	Sensor_Sample_t s;
+	Dsp_Output_t out;
+	volatile float sink = 0;
+	size_t j;
+
+	Dsp_Init(&f);
+	for (j = 0; j < n; j++)
+	{
+		s.x = samples[j].axis[0];
+		s.y = samples[j].axis[1];
+		s.z = samples[j].axis[2];
+		Dsp_Filter(&f, &s, &out);
+		sink += out.x + out.y + out.z;
+	}
+
+	return (double)n*sizeof(rawrec_t);
+}
+
+/* the moving average firmware's sum of its last 8 readings, rounded */
+static double bench_filter_moving_average(size_t n)
+{
+	uint16_t buff[NUM_AXES][MA_READINGS];
+	volatile uint16_t sink = 0;
+	uint16_t sum;
+	uint8_t cbi = 0;
+	size_t j;
+	int a, i;
+
+	memset(buff, 0, sizeof(buff));
+	for (j = 0; j < n; j++)
+	{
+		cbi = (cbi == MA_READINGS-1) ? 0 : cbi+1;
+		for (a = 0; a < NUM_AXES; a++)
+		{
+			buff[a][cbi] = samples[j].axis[a];
+			sum = 0;
+			for (i = 0; i < MA_READINGS; i++)
+			{
+				sum = sum + buff[a][i];
+			}
+			sink += (sum + MA_READINGS/2) >> 3;
+		}
+	}
+
+	return (double)n*sizeof(rawrec_t);
+}
+
+static double bench_filter_sta_lta(size_t n)
+{
+	trig_cfg_t cfg = { 1.0, 30.0, 4.0, 1.5 };
+	trig_chan_t c[NUM_AXES];
+	size_t j;
+	int a;
+
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		trig_init(&c[a], &cfg);
+	}
+	for (j = 0; j < n; j++)
+	{
+		for (a = 0; a < NUM_AXES; a++)
+		{
+			trig_update(&c[a], samples[j].t_us, samples[j].axis[a]);
+		}
+	}
+
+	return (double)n*sizeof(rawrec_t);
+}
+
+/* the columns of the samples in blocks, and their encodings */
+static uint64_t *col_t;
+static int16_t *col_axis[NUM_AXES];
+static uint8_t *col_updated;
+static uint8_t *encoded;
+static size_t *encoded_len;
+static size_t cols_n;
+
+static int make_columns(size_t n)
+{
+	size_t j;
+	int a;
+
+	if (cols_n == n)
+	{
+		return 0;
+	}
+	free(col_t);
+	free(col_updated);
+	free(encoded);
+	free(encoded_len);
+	col_t = malloc(n*sizeof(uint64_t));
+	col_updated = malloc(n);
+	encoded = malloc(((n + COLREC_BLOCK_SAMPLES - 1)/COLREC_BLOCK_SAMPLES)*CODEC_MAX_SIZE(COLREC_BLOCK_SAMPLES));
+	encoded_len = calloc((n + COLREC_BLOCK_SAMPLES - 1)/COLREC_BLOCK_SAMPLES, sizeof(size_t));
+	cols_n = 0;
+	if (col_t == NULL || col_updated == NULL || encoded == NULL || encoded_len == NULL)
+	{
+		return -1;
+	}
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		free(col_axis[a]);
+		col_axis[a] = malloc(n*sizeof(int16_t));
+		if (col_axis[a] == NULL)
+		{
+			return -1;
+		}
+	}
+	for (j = 0; j < n; j++)
+	{
+		col_t[j] = samples[j].t_us;
+		for (a = 0; a < NUM_AXES; a++)
+		{
+			col_axis[a][j] = samples[j].axis[a];
+		}
+		col_updated[j] = samples[j].updated;
+	}
+	cols_n = n;
+
+	return 0;
+}
+
+static void block_cols(size_t first, codec_cols_t *c)
+{
+	int a;
+
+	c->t = col_t + first;
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		c->axis[a] = col_axis[a] + first;
+	}
+	c->updated = col_updated + first;
+}
+
+static double bench_codec_encode(size_t n)
+{
+	codec_cols_t c;
+	size_t first, b;
+
+	if (make_columns(n) != 0)
+	{
+		return -1;
+	}
+	for (first = 0, b = 0; first < n; first += COLREC_BLOCK_SAMPLES, b++)
+	{
+		block_cols(first, &c);
+		encoded_len[b] = codec_encode(&c, (n - first < COLREC_BLOCK_SAMPLES) ? n - first : COLREC_BLOCK_SAMPLES,
+		                              encoded + b*CODEC_MAX_SIZE(COLREC_BLOCK_SAMPLES));
+	}
+
+	return (double)n*sizeof(rawrec_t);
+}
+
+static double bench_codec_decode(size_t n)
+{
+	static uint64_t t[COLREC_BLOCK_SAMPLES];
+	static int16_t axis[NUM_AXES][COLREC_BLOCK_SAMPLES];
+	static uint8_t updated[COLREC_BLOCK_SAMPLES];
+	codec_cols_t c = { t, { axis[0], axis[1], axis[2] }, updated };
+	double bytes = 0;
+	size_t first, b, m;
+
+	/* decodes what codec_encode made */
+	if (cols_n != n && bench_codec_encode(n) < 0)
+	{
+		return -1;
+	}
+	for (first = 0, b = 0; first < n; first += COLREC_BLOCK_SAMPLES, b++)
+	{
+		m = (n - first < COLREC_BLOCK_SAMPLES) ? n - first : COLREC_BLOCK_SAMPLES;
+		if (codec_decode(encoded + b*CODEC_MAX_SIZE(COLREC_BLOCK_SAMPLES), encoded_len[b], m, &c) != 0 ||
+		    memcmp(t, col_t + first, m*sizeof(uint64_t)) != 0)
+		{
+			fprintf(stderr, "codec_decode didn't give back the samples.\n");
+			return -1;
+		}
+		bytes += encoded_len[b];
+	}
+
+	return bytes;
+}
+
+static double bench_write_csv(size_t n)
+{
+	static const char axis_name[NUM_AXES] = { 'x', 'y', 'z' };
+	char name[32];
+	char *path[NUM_AXES];
+	FILE *f[NUM_AXES];
+	double bytes = 0;
+	size_t j;
+	int a;
+	int err_code = 0;
+
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		sprintf(name, "bench_%c-axis.csv", axis_name[a]);
+		path[a] = bench_path(name);
+		f[a] = (path[a] != NULL) ? fopen(path[a], "w") : NULL;
+		if (f[a] == NULL)
+		{
+			err_code = -1;
+		}
+	}
+	for (j = 0; j < n && err_code == 0; j++)
+	{
+		for (a = 0; a < NUM_AXES; a++)
+		{
+			fprintf(f[a], "%llu, %d\n", (unsigned long long)(samples[j].t_us/1000), samples[j].axis[a]);
+		}
+	}
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		if (f[a] != NULL)
+		{
+			bytes += ftell(f[a]);
+			if (fclose(f[a]) != 0)
+			{
+				err_code = -1;
+			}
+		}
+		if (path[a] != NULL)
+		{
+			unlink(path[a]);
+		}
+		free(path[a]);
+	}
+
+	return (err_code == 0) ? bytes : -1;
+}
+
+static double bench_write_sink(size_t n, int format)
+{
+	bufwriter_cfg_t cfg = BUFWRITER_DEFAULT_CFG;
+	colsink_info_t info = { "bench", NULL, 125, COLREC_CODEC_NONE, 0 };
+	char *path;
+	sink_t *s;
+	size_t j;
+	double bytes;
+	int err_code = 0;
+
+	cfg.fsync_policy = FSYNC_NEVER;
+	path = bench_path("bench.rec");
+	if (path == NULL)
+	{
+		return -1;
+	}
+	if (format == 0)
+	{
+		s = rawsink_open(path, &cfg);
+	}
+	else
+	{
+		info.codec = (format == 2) ? COLREC_CODEC_DELTA : COLREC_CODEC_NONE;
+		s = colsink_open(path, &info, &cfg);
+	}
+	if (s == NULL)
+	{
+		free(path);
+		return -1;
+	}
+
+	/* in batches the size the writer thread takes them in */
+	for (j = 0; j < n && err_code == 0; j += 64)
+	{
+		err_code = s->write(s, samples + j, (n - j < 64) ? n - j : 64);
+	}
+	bytes = s->bytes(s);
+	err_code |= s->close(s);
+	unlink(path);
+	free(path);
+
+	return (err_code == 0) ? bytes : -1;
+}
+
+static double bench_write_raw(size_t n)
+{
+	return bench_write_sink(n, 0);
+}
+
+static double bench_write_col(size_t n)
+{
+	return bench_write_sink(n, 1);
+}
+
+static double bench_write_col_z(size_t n)
+{
+	return bench_write_sink(n, 2);
+}
+
+static double bench_psd(size_t n)
+{
+	static double x[PSD_SEGMENT];
+	static double psd[PSD_SEGMENT/2 + 1];
+	welch_t w;
+	size_t j, m;
+
+	if (welch_init(&w, PSD_SEGMENT, 0.5, WELCH_HANN, 125) != 0)
+	{
+		return -1;
+	}
+	for (j = 0; j < n; j += m)
+	{
+		for (m = 0; m < PSD_SEGMENT && j + m < n; m++)
+		{
+			x[m] = samples[j + m].axis[2];
+		}
+		welch_push(&w, x, m);
+	}
+	welch_psd(&w, psd);
+	welch_free(&w);
+
+	return (double)n*sizeof(rawrec_t);
+}
+
+static const bench_t benches[] =
+{
+	{ "decode_nunchuk", bench_decode_nunchuk },
+	{ "decode_joydev", bench_decode_joydev },
+	{ "decode_evdev", bench_decode_evdev },
+	{ "resample_hold", bench_resample_hold },
+	{ "resample_linear", bench_resample_linear },
+	{ "resample_sinc", bench_resample_sinc },
+	{ "filter_chebyshev", bench_filter_chebyshev },
+	{ "filter_moving_average", bench_filter_moving_average },
+	{ "filter_sta_lta", bench_filter_sta_lta },
+	{ "codec_encode", bench_codec_encode },
+	{ "codec_decode", bench_codec_decode },
+	{ "write_csv", bench_write_csv },
+	{ "write_raw", bench_write_raw },
+	{ "write_col", bench_write_col },
+	{ "write_col_z", bench_write_col_z },
+	{ "psd", bench_psd },
+};
+
+#define NUM_BENCHES (sizeof(benches)/sizeof(benches[0]))
+
+static int run(const bench_t *b, size_t n, double min_s)
+{
+	double t, best = INFINITY, total = 0, bytes;
+	int runs = 0;
+
+	/* the first run warms the caches and isn't counted */
+	if (b->run(n) < 0)
+	{
+		fprintf(stderr, "%s failed.\n", b->name);
+		return -1;
+	}
+	while (total < min_s || runs < 3)
+	{
+		t = now_s();
+		bytes = b->run(n);
+		t = now_s() - t;
+		if (bytes < 0)
+		{
+			fprintf(stderr, "%s failed.\n", b->name);
+			return -1;
+		}
+		best = (t < best) ? t : best;
+		total += t;
+		runs++;
+	}
+
+	printf("bench=%s samples=%zu runs=%d ns_per_sample=%.2f samples_s=%.0f mb_s=%.1f\n",
+	       b->name, n, runs, best*1e9/n, n/best, bytes/best/1e6);
+	fflush(stdout);
+
+	return 0;
+}
+
+static int parse_sizes(char *arg, size_t *sizes, int *num_sizes)
+{
+	char *p = arg;
+	long val;
+
+	*num_sizes = 0;
+	while (*p != '\0')
+	{
+		if (*num_sizes == MAX_SIZES)
+		{
+			return -1;
+		}
+		val = strtol(p, &p, 10);
+		if (val < 1 || (*p != ',' && *p != '\0'))
+		{
+			return -1;
+		}
+		sizes[(*num_sizes)++] = val;
+		if (*p == ',')
+		{
+			p++;
+		}
+	}
+
+	return (*num_sizes > 0) ? 0 : -1;
+}
+
+int main(int argc, char* argv[])
+{
+	size_t sizes[MAX_SIZES] = { 4096, 65536, 1048576 };
+	int num_sizes = 3;
+	const char *filters[MAX_FILTERS];
+	int num_filters = 0;
+	double min_s = 0.2;
+	char *path;
+	size_t i;
+	int j, k, opt;
+	int selected;
+	char *p;
+	int err_code = 0;
+
+	while ((opt = getopt(argc, argv, "n:b:t:d:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			if (parse_sizes(optarg, sizes, &num_sizes) != 0)
+			{
+				fprintf(stderr, "Invalid sizes, expected e.g. 4096,65536.\n");
+				return -1;
+			}
+			break;
+		case 'b':
+			if (num_filters == MAX_FILTERS)
+			{
+				fprintf(stderr, "Too many -b.\n");
+				return -1;
+			}
+			filters[num_filters++] = optarg;
+			break;
+		case 't':
+			min_s = strtod(optarg, &p);
+			if (*p != '\0' || min_s < 0)
+			{
+				fprintf(stderr, "Invalid time.\n");
+				return -1;
+			}
+			break;
+		case 'd':
+			dir = optarg;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n N[,N...]] [-b name] [-t secs] [-d dir]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	for (j = 0; j < num_sizes && err_code == 0; j++)
+	{
+		free(samples);
+		if (make_samples(sizes[j]) != 0)
+		{
+			fprintf(stderr, "Not enough memory for %zu samples.\n", sizes[j]);
+			return -1;
+		}
+		for (i = 0; i < NUM_BENCHES && err_code == 0; i++)
+		{
+			selected = (num_filters == 0);
+			for (k = 0; k < num_filters; k++)
+			{
+				selected |= (strstr(benches[i].name, filters[k]) != NULL);
+			}
+			if (selected)
+			{
+				err_code = run(&benches[i], sizes[j], min_s);
+			}
+		}
+	}
+
+	path = bench_path("bench_joydev.evc");
+	if (path != NULL)
+	{
+		unlink(path);
+	}
+	free(path);
+	path = bench_path("bench_evdev.evc");
+	if (path != NULL)
+	{
+		unlink(path);
+	}
+	free(path);
+	free(samples);
+
+	return err_code;
+}
@@ -0,0 +1,303 @@
+/* Buffered file writer for the acquisition tools. See bufwriter.h.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bufwriter.h"
+
+uint64_t bufwriter_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+static int write_all(int fd, const char *p, size_t len)
+{
+	ssize_t n;
+
+	while (len > 0)
+	{
+		n = write(fd, p, len);
+		aio_stats.syscalls++;
+		if (n < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return -1;
+		}
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static void release_buf(bufwriter_t *w)
+{
+	if (aio_backend() != AIO_SYNC)
+	{
+		aio_put_buf(w->buf);
+	}
+	else
+	{
+		free(w->buf);
+	}
+	w->buf = NULL;
+}
+
+int bufwriter_open(bufwriter_t *w, const char *path, const bufwriter_cfg_t *cfg)
+{
+	memset(w, 0, sizeof(*w));
+	w->fd = -1;
+	w->cfg = *cfg;
+	w->cfg.buf_size = (cfg->buf_size + BUFWRITER_ALIGN - 1) & ~(size_t)(BUFWRITER_ALIGN - 1);
+	if (w->cfg.buf_size == 0)
+	{
+		w->cfg.buf_size = BUFWRITER_ALIGN;
+	}
+
+	if (aio_backend() != AIO_SYNC)
+	{
+		w->cfg.buf_size = aio_buf_size();
+		w->buf = aio_get_buf();
+	}
+	else if (posix_memalign((void **)&w->buf, BUFWRITER_ALIGN, w->cfg.buf_size) != 0)
+	{
+		w->buf = NULL;
+	}
+	else
+	{
+		/* fault it in now rather than a page at a time while recording */
+		memset(w->buf, 0, w->cfg.buf_size);
+	}
+	if (w->buf == NULL)
+	{
+		fprintf(stderr, "Couldn't allocate write buffer for %s.\n", path);
+		return -1;
+	}
+
+	w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (w->fd == -1)
+	{
+		fprintf(stderr, "Couldn't open %s: %s.\n", path, strerror(errno));
+		release_buf(w);
+		return -1;
+	}
+	aio_open(&w->af, w->fd);
+
+	w->last_fsync_ms = bufwriter_now_ms();
+
+	return 0;
+}
+
+/* Writes the buffer out. With a backend the buffer is handed to it and
+ * filling goes on in a fresh one from the pool. */
+int bufwriter_flush(bufwriter_t *w)
+{
+	uint64_t now = bufwriter_now_ms();
+	int err_code;
+	int sync = (w->cfg.fsync_policy == FSYNC_ON_FLUSH ||
+	            (w->cfg.fsync_policy == FSYNC_INTERVAL && now - w->last_fsync_ms >= w->cfg.fsync_ms));
+
+	if (w->len == 0 && !(w->dirty && sync))
+	{
+		return 0;
+	}
+
+	if (aio_backend() != AIO_SYNC)
+	{
+		if (w->len > 0)
+		{
+			/* the buffer belongs to the pool again, even on error */
+			err_code = aio_write(&w->af, w->buf, w->len, w->bytes_written, sync);
+			w->buf = aio_get_buf();
+			if (err_code != 0 || w->buf == NULL)
+			{
+				fprintf(stderr, "Error writing recording: %s.\n", strerror(w->af.error));
+				return -1;
+			}
+		}
+		else if (aio_sync(&w->af) != 0)
+		{
+			fprintf(stderr, "Error writing recording: %s.\n", strerror(w->af.error));
+			return -1;
+		}
+	}
+	else
+	{
+		/* like a backend, the first error sticks: what follows a lost
+		 * write or fdatasync can't be trusted to be on disk either */
+		if (w->error != 0)
+		{
+			return -1;
+		}
+		if (w->len > 0 && write_all(w->fd, w->buf, w->len) != 0)
+		{
+			w->error = errno;
+			fprintf(stderr, "Error writing recording: %s.\n", strerror(w->error));
+			return -1;
+		}
+		aio_stats.writes += (w->len > 0);
+		aio_stats.bytes += w->len;
+		if (sync)
+		{
+			aio_stats.syscalls++;
+			aio_stats.fsyncs++;
+			if (fdatasync(w->fd) != 0)
+			{
+				w->error = errno;
+				fprintf(stderr, "Error writing recording: %s.\n", strerror(w->error));
+				return -1;
+			}
+		}
+	}
+
+	w->bytes_written += w->len;
+	w->dirty = (w->dirty || w->len > 0) && !sync;
+	w->len = 0;
+	if (sync)
+	{
+		w->last_fsync_ms = now;
+	}
+
+	return 0;
+}
+
+int bufwriter_write(bufwriter_t *w, const void *data, size_t len)
+{
+	const char *p = data;
+	size_t n;
+
+	if (w->buf == NULL)
+	{
+		return -1;
+	}
+
+	while (len > 0)
+	{
+		if (w->len == 0)
+		{
+			w->first_ms = bufwriter_now_ms();
+		}
+
+		n = w->cfg.buf_size - w->len;
+		if (n > len)
+		{
+			n = len;
+		}
+		memcpy(w->buf + w->len, p, n);
+		w->len += n;
+		p += n;
+		len -= n;
+
+		if (w->len == w->cfg.buf_size && bufwriter_flush(w) != 0)
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Call periodically to enforce the flush and fsync intervals when data
+ * arrives too slowly to fill the buffer. */
+int bufwriter_tick(bufwriter_t *w)
+{
+	uint64_t now = bufwriter_now_ms();
+
+	if ((w->len > 0 && w->cfg.flush_ms > 0 && now - w->first_ms >= w->cfg.flush_ms) ||
+	    (w->dirty && w->cfg.fsync_policy == FSYNC_INTERVAL && now - w->last_fsync_ms >= w->cfg.fsync_ms))
+	{
+		return bufwriter_flush(w);
+	}
+
+	return 0;
+}
+
+int bufwriter_close(bufwriter_t *w)
+{
+	int err_code = 0;
+
+	if (w->fd < 0)
+	{
+		return 0;
+	}
+
+	err_code = (w->buf != NULL) ? bufwriter_flush(w) : -1;
+	if (aio_backend() != AIO_SYNC)
+	{
+		if (err_code == 0 && w->cfg.fsync_policy != FSYNC_NEVER && w->dirty)
+		{
+			aio_sync(&w->af);
+		}
+		if (aio_wait(&w->af) != 0 && err_code == 0)
+		{
+			fprintf(stderr, "Error writing recording: %s.\n", strerror(w->af.error));
+			err_code = -1;
+		}
+	}
+	else if (err_code == 0 && w->cfg.fsync_policy != FSYNC_NEVER && w->dirty)
+	{
+		aio_stats.syscalls++;
+		aio_stats.fsyncs++;
+		if (fdatasync(w->fd) != 0)
+		{
+			w->error = errno;
+			fprintf(stderr, "Error writing recording: %s.\n", strerror(w->error));
+			err_code = -1;
+		}
+	}
+	if (close(w->fd) != 0 && err_code == 0)
+	{
+		/* NFS and some FUSE file systems only report write errors here */
+		fprintf(stderr, "Error closing recording: %s.\n", strerror(errno));
+		err_code = -1;
+	}
+	w->fd = -1;
+	if (w->buf != NULL)
+	{
+		release_buf(w);
+	}
+
+	return err_code;
+}
+
+/* Parses "never", "flush" or an interval in milliseconds. */
+int parse_fsync_policy(const char *arg, bufwriter_cfg_t *cfg)
+{
+	char *p;
+	long ms;
+
+	if (strcmp(arg, "never") == 0)
+	{
+		cfg->fsync_policy = FSYNC_NEVER;
+		return 0;
+	}
+
+	if (strcmp(arg, "flush") == 0)
+	{
+		cfg->fsync_policy = FSYNC_ON_FLUSH;
+		return 0;
+	}
+
+	errno = 0;
+	ms = strtol(arg, &p, 10);
+	if (errno != 0 || *p != 0 || p == arg || ms <= 0)
+	{
+		return -1;
+	}
+	cfg->fsync_policy = FSYNC_INTERVAL;
+	cfg->fsync_ms = ms;
+
+	return 0;
+}
@@ -0,0 +1,61 @@
+/* Buffered file writer for the acquisition tools.
+ *
+ * Data is collected in a large page aligned buffer and only written out
+ * when the buffer fills or when it has held data for longer than the flush
+ * interval. How often the written data is forced to disk is set by the
+ * fsync policy. Once aio_init() has started a backend, the buffers come
+ * from its pool and are written and fsynced in the background (see aio.h).
+ */
+
+#ifndef BUFWRITER_H
+#define BUFWRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "aio.h"
+
+#define BUFWRITER_ALIGN 4096
+
+typedef enum
+{
+	FSYNC_NEVER,      /* leave it to the kernel */
+	FSYNC_ON_FLUSH,   /* fdatasync after every flush */
+	FSYNC_INTERVAL    /* fdatasync at most once per fsync_ms */
+} fsync_policy_t;
+
+typedef struct
+{
+	size_t buf_size;             /* bytes, rounded up to BUFWRITER_ALIGN */
+	unsigned int flush_ms;       /* longest time data may sit in the buffer, 0 = until full */
+	fsync_policy_t fsync_policy;
+	unsigned int fsync_ms;       /* used by FSYNC_INTERVAL */
+} bufwriter_cfg_t;
+
+typedef struct
+{
+	int fd;
+	char *buf;
+	size_t len;
+	bufwriter_cfg_t cfg;
+	uint64_t first_ms;           /* when the oldest buffered byte was added */
+	uint64_t last_fsync_ms;
+	int dirty;                   /* written since the last fdatasync */
+	uint64_t bytes_written;      /* also the offset of the next write */
+	int error;                   /* errno of the first failed write or fdatasync, without a backend */
+	aio_file_t af;               /* used once aio_init() has been called */
+} bufwriter_t;
+
+#define BUFWRITER_DEFAULT_CFG { 1 << 20, 1000, FSYNC_INTERVAL, 10000 }
+
+uint64_t bufwriter_now_ms(void);
+
+int bufwriter_open(bufwriter_t *w, const char *path, const bufwriter_cfg_t *cfg);
+int bufwriter_write(bufwriter_t *w, const void *data, size_t len);
+int bufwriter_tick(bufwriter_t *w);
+int bufwriter_flush(bufwriter_t *w);
+int bufwriter_close(bufwriter_t *w);
+
+int parse_fsync_policy(const char *arg, bufwriter_cfg_t *cfg);
+
+#endif
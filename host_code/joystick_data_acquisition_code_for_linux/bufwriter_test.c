@@ -0,0 +1,312 @@
+/* Tests of the buffered writer in bufwriter.c and the backends in aio.c.
+ * Built and run with
+ *
+ *   make check
+ *
+ * Each backend (sync, uring and threads; uring is skipped where the kernel
+ * hasn't got it) is checked for
+ *   - several files written at once, in pieces from a byte to several
+ *     buffers long, coming back byte for byte, with each fsync policy,
+ *   - a write that fails (/dev/full) failing the write or a later call,
+ *     every call after it, and the close,
+ *   - an fdatasync that fails (/dev/null can't be synced) failing the
+ *     close even though every write went through, and every write after
+ *     it.
+ * The fsync policies are parsed too.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bufwriter.h"
+
+#define NUM_FILES 3
+#define FILE_SIZE 300000
+#define BUF_SIZE 16384
+
+static int failures;
+static char dir[] = "/tmp/bufwriter_testXXXXXX";
+static int saved_stderr = -1;
+
+static void check(int ok, const char *what, int backend)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "FAIL: %s (%s)\n", what, aio_backend_name(backend));
+		failures++;
+	}
+}
+
+/* The error paths print their errors, which are expected here. */
+static void quiet(void)
+{
+	int fd = open("/dev/null", O_WRONLY);
+
+	fflush(stderr);
+	saved_stderr = dup(2);
+	dup2(fd, 2);
+	close(fd);
+}
+
+static void loud(void)
+{
+	fflush(stderr);
+	dup2(saved_stderr, 2);
+	close(saved_stderr);
+}
+
+/* the byte at offset i of file f */
+static char byte_at(int f, size_t i)
+{
+	uint32_t x = (uint32_t)(i*2654435761u) ^ (uint32_t)(f*40503);
+
+	return (char)(x >> 13);
+}
+
+static int read_back(const char *path, int f)
+{
+	static char data[FILE_SIZE + 1];
+	size_t i;
+	ssize_t n;
+	int fd;
+	int ok;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return 0;
+	}
+	n = read(fd, data, sizeof(data));
+	close(fd);
+	ok = (n == FILE_SIZE);
+	for (i = 0; ok && i < FILE_SIZE; i++)
+	{
+		ok = (data[i] == byte_at(f, i));
+	}
+
+	return ok;
+}
+
+static void test_round_trip(int backend, fsync_policy_t policy)
+{
+	static const size_t sizes[] = { 1, 100, 4095, 4096, 4097, 40000, 7 };
+	static char piece[40000];
+	bufwriter_cfg_t cfg = BUFWRITER_DEFAULT_CFG;
+	bufwriter_t w[NUM_FILES];
+	char path[NUM_FILES][64];
+	size_t done[NUM_FILES] = { 0 };
+	size_t n, j;
+	int num_done = 0;
+	int round = 0;
+	int ok = 1;
+	int f;
+
+	cfg.buf_size = BUF_SIZE;
+	cfg.fsync_policy = policy;
+	cfg.fsync_ms = 1;
+	for (f = 0; f < NUM_FILES; f++)
+	{
+		snprintf(path[f], sizeof(path[f]), "%s/%d", dir, f);
+		ok &= (bufwriter_open(&w[f], path[f], &cfg) == 0);
+	}
+	if (!ok)
+	{
+		check(0, "bufwriter_open", backend);
+		return;
+	}
+
+	/* the files take turns, each with its own run of piece sizes */
+	while (num_done < NUM_FILES)
+	{
+		for (f = 0; f < NUM_FILES; f++)
+		{
+			if (done[f] == FILE_SIZE)
+			{
+				continue;
+			}
+			n = sizes[(round + f) % (sizeof(sizes)/sizeof(sizes[0]))];
+			if (n > FILE_SIZE - done[f])
+			{
+				n = FILE_SIZE - done[f];
+			}
+			for (j = 0; j < n; j++)
+			{
+				piece[j] = byte_at(f, done[f] + j);
+			}
+			ok &= (bufwriter_write(&w[f], piece, n) == 0);
+			ok &= (bufwriter_tick(&w[f]) == 0);
+			done[f] += n;
+			num_done += (done[f] == FILE_SIZE);
+		}
+		aio_kick();
+		round++;
+	}
+	check(ok, "writes succeed", backend);
+
+	ok = 1;
+	for (f = 0; f < NUM_FILES; f++)
+	{
+		ok &= (bufwriter_close(&w[f]) == 0);
+	}
+	check(ok, "closes succeed", backend);
+
+	ok = 1;
+	for (f = 0; f < NUM_FILES; f++)
+	{
+		ok &= (w[f].bytes_written == FILE_SIZE && read_back(path[f], f));
+		unlink(path[f]);
+	}
+	check(ok, "what is written is read back", backend);
+}
+
+static void test_write_error(int backend)
+{
+	static char piece[BUF_SIZE];
+	bufwriter_cfg_t cfg = BUFWRITER_DEFAULT_CFG;
+	bufwriter_t w;
+	int failed = 0;
+	int later = 1;
+	int i;
+
+	cfg.buf_size = BUF_SIZE;
+	cfg.fsync_policy = FSYNC_NEVER;
+	if (bufwriter_open(&w, "/dev/full", &cfg) != 0)
+	{
+		check(0, "bufwriter_open /dev/full", backend);
+		return;
+	}
+
+	quiet();
+	for (i = 0; i < 20; i++)
+	{
+		if (bufwriter_write(&w, piece, sizeof(piece)) != 0)
+		{
+			failed = 1;
+		}
+		else if (failed)
+		{
+			later = 0;
+		}
+		aio_kick();
+	}
+	check(bufwriter_close(&w) != 0, "a failed write fails the close", backend);
+	loud();
+
+	check(failed, "a failed write fails a later write", backend);
+	check(later, "every write after a failed one fails", backend);
+	check((backend == AIO_SYNC ? w.error : w.af.error) == ENOSPC, "the error of the failed write is kept", backend);
+}
+
+static void test_sync_error(int backend)
+{
+	static char piece[1000];
+	bufwriter_cfg_t cfg = BUFWRITER_DEFAULT_CFG;
+	bufwriter_t w;
+	int err_code;
+	int i;
+
+	cfg.buf_size = BUF_SIZE;
+	cfg.fsync_policy = FSYNC_INTERVAL;
+	cfg.fsync_ms = 1000000;
+	if (bufwriter_open(&w, "/dev/null", &cfg) != 0)
+	{
+		check(0, "bufwriter_open /dev/null", backend);
+		return;
+	}
+
+	quiet();
+	err_code = bufwriter_write(&w, piece, sizeof(piece));
+	err_code |= bufwriter_flush(&w);
+	check(err_code == 0, "writes to /dev/null succeed", backend);
+	check(bufwriter_close(&w) != 0, "a failed fdatasync fails the close", backend);
+	loud();
+
+	check((backend == AIO_SYNC ? w.error : w.af.error) == EINVAL, "the error of the failed fdatasync is kept", backend);
+
+	/* syncing every flush: once one has failed, flushes that would
+	 * write fine on their own fail too */
+	cfg.fsync_policy = FSYNC_ON_FLUSH;
+	if (bufwriter_open(&w, "/dev/null", &cfg) != 0)
+	{
+		check(0, "bufwriter_open /dev/null", backend);
+		return;
+	}
+	quiet();
+	for (i = 0; i < 10 && err_code == 0; i++)
+	{
+		err_code = bufwriter_write(&w, piece, sizeof(piece));
+		err_code |= bufwriter_flush(&w);
+		if (err_code == 0 && backend != AIO_SYNC)
+		{
+			aio_wait(&w.af);
+		}
+	}
+	w.cfg.fsync_policy = FSYNC_NEVER;
+	err_code = bufwriter_write(&w, piece, sizeof(piece));
+	err_code |= bufwriter_flush(&w);
+	check(err_code != 0, "a write after a failed fdatasync fails", backend);
+	bufwriter_close(&w);
+	loud();
+}
+
+static void test_policy(void)
+{
+	bufwriter_cfg_t cfg = BUFWRITER_DEFAULT_CFG;
+
+	check(parse_fsync_policy("never", &cfg) == 0 && cfg.fsync_policy == FSYNC_NEVER, "never", AIO_SYNC);
+	check(parse_fsync_policy("flush", &cfg) == 0 && cfg.fsync_policy == FSYNC_ON_FLUSH, "flush", AIO_SYNC);
+	check(parse_fsync_policy("250", &cfg) == 0 && cfg.fsync_policy == FSYNC_INTERVAL && cfg.fsync_ms == 250,
+	      "an interval", AIO_SYNC);
+	check(parse_fsync_policy("0", &cfg) != 0, "an interval of 0 is rejected", AIO_SYNC);
+	check(parse_fsync_policy("10ms", &cfg) != 0, "an interval with junk after it is rejected", AIO_SYNC);
+	check(parse_fsync_policy("", &cfg) != 0, "an empty policy is rejected", AIO_SYNC);
+}
+
+int main(void)
+{
+	int backend;
+	int started;
+
+	if (mkdtemp(dir) == NULL)
+	{
+		fprintf(stderr, "Couldn't make a directory for the test files.\n");
+		return 1;
+	}
+
+	for (backend = AIO_SYNC; backend <= AIO_THREADS; backend++)
+	{
+		started = aio_init(backend, BUF_SIZE, 2*NUM_FILES + 2);
+		if (started != backend)
+		{
+			if (started >= 0)
+			{
+				aio_shutdown();
+			}
+			check(backend == AIO_URING && started == AIO_THREADS, "aio_init", backend);
+			continue;
+		}
+
+		test_round_trip(backend, FSYNC_NEVER);
+		test_round_trip(backend, FSYNC_ON_FLUSH);
+		test_round_trip(backend, FSYNC_INTERVAL);
+		test_write_error(backend);
+		test_sync_error(backend);
+		aio_shutdown();
+	}
+	test_policy();
+	rmdir(dir);
+
+	if (failures > 0)
+	{
+		fprintf(stderr, "bufwriter_test: %d check(s) failed.\n", failures);
+		return 1;
+	}
+	fprintf(stdout, "bufwriter_test: all checks passed.\n");
+
+	return 0;
+}
@@ -0,0 +1,295 @@
+/* Lossless codec for blocks of samples. See codec.h.
+ */
+
+#include "codec.h"
+
+static inline uint64_t zigzag64(int64_t v)
+{
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag64(uint64_t v)
+{
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static inline uint32_t zigzag32(int32_t v)
+{
+	return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag32(uint32_t v)
+{
+	return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static inline uint8_t *put_varint(uint8_t *p, uint64_t v)
+{
+	while (v >= 0x80)
+	{
+		*p++ = (uint8_t)v | 0x80;
+		v >>= 7;
+	}
+	*p++ = (uint8_t)v;
+
+	return p;
+}
+
+/* returns NULL if the varint runs past end */
+static inline const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint64_t *v)
+{
+	uint64_t x = 0;
+	int shift = 0;
+
+	while (p < end && shift < 64)
+	{
+		x |= (uint64_t)(*p & 0x7f) << shift;
+		if ((*p++ & 0x80) == 0)
+		{
+			*v = x;
+			return p;
+		}
+		shift += 7;
+	}
+
+	return NULL;
+}
+
+static inline int bit_width(uint32_t v)
+{
+	return (v == 0) ? 0 : 32 - __builtin_clz(v);
+}
+
+static inline int32_t predict(const int16_t *x, uint32_t i, int order)
+{
+	return (order == 1) ? x[i - 1] : 2*(int32_t)x[i - 1] - x[i - 2];
+}
+
+/* picks the predictor that leaves the smaller residuals */
+static int choose_order(const int16_t *x, uint32_t n)
+{
+	uint64_t sum1 = 0;
+	uint64_t sum2 = 0;
+	int32_t r;
+	uint32_t i;
+
+	for (i = 2; i < n; i++)
+	{
+		r = x[i] - x[i - 1];
+		sum1 += (r < 0) ? -r : r;
+		r = x[i] - (2*(int32_t)x[i - 1] - x[i - 2]);
+		sum2 += (r < 0) ? -r : r;
+	}
+
+	return (sum2 < sum1) ? 2 : 1;
+}
+
+static uint8_t *encode_axis(const int16_t *x, uint32_t n, uint8_t *p)
+{
+	uint32_t z[CODEC_FRAME];
+	uint32_t i, j, m;
+	uint32_t max;
+	uint64_t acc;
+	int bits;
+	int width;
+	int order;
+
+	order = choose_order(x, n);
+	*p++ = order;
+	for (i = 0; i < (uint32_t)order && i < n; i++)
+	{
+		p = put_varint(p, zigzag32(x[i]));
+	}
+
+	for (i = order; i < n; i += m)
+	{
+		m = (n - i < CODEC_FRAME) ? n - i : CODEC_FRAME;
+		max = 0;
+		for (j = 0; j < m; j++)
+		{
+			z[j] = zigzag32(x[i + j] - predict(x, i + j, order));
+			max |= z[j];
+		}
+
+		width = bit_width(max);
+		*p++ = width;
+		acc = 0;
+		bits = 0;
+		for (j = 0; j < m; j++)
+		{
+			acc |= (uint64_t)z[j] << bits;
+			bits += width;
+			while (bits >= 8)
+			{
+				*p++ = (uint8_t)acc;
+				acc >>= 8;
+				bits -= 8;
+			}
+		}
+		if (bits > 0)
+		{
+			*p++ = (uint8_t)acc;
+		}
+	}
+
+	return p;
+}
+
+static const uint8_t *decode_axis(const uint8_t *p, const uint8_t *end, uint32_t n, int16_t *x)
+{
+	uint32_t i, j, m;
+	uint64_t v;
+	uint64_t acc;
+	uint32_t mask;
+	int bits;
+	int width;
+	int order;
+
+	if (p >= end)
+	{
+		return NULL;
+	}
+	order = *p++;
+	if (order != 1 && order != 2)
+	{
+		return NULL;
+	}
+	for (i = 0; i < (uint32_t)order && i < n; i++)
+	{
+		if ((p = get_varint(p, end, &v)) == NULL)
+		{
+			return NULL;
+		}
+		x[i] = (int16_t)unzigzag32((uint32_t)v);
+	}
+
+	for (i = order; i < n; i += m)
+	{
+		m = (n - i < CODEC_FRAME) ? n - i : CODEC_FRAME;
+		if (p >= end)
+		{
+			return NULL;
+		}
+		width = *p++;
+		if (width > 32 || (size_t)(end - p) < (m*width + 7)/8)
+		{
+			return NULL;
+		}
+
+		mask = (width == 32) ? 0xffffffff : ((uint32_t)1 << width) - 1;
+		acc = 0;
+		bits = 0;
+		for (j = 0; j < m; j++)
+		{
+			while (bits < width)
+			{
+				acc |= (uint64_t)*p++ << bits;
+				bits += 8;
+			}
+			/* modulo 2^32, a damaged frame mustn't overflow */
+			x[i + j] = (int16_t)((uint32_t)predict(x, i + j, order) + (uint32_t)unzigzag32((uint32_t)acc & mask));
+			acc >>= width;
+			bits -= width;
+		}
+	}
+
+	return p;
+}
+
+size_t codec_encode(const codec_cols_t *c, uint32_t n, uint8_t *out)
+{
+	uint8_t *p = out;
+	int64_t delta = 0;
+	int64_t prev = 0;
+	uint32_t i, run;
+	int a;
+
+	if (n == 0)
+	{
+		return 0;
+	}
+
+	/* time stamps */
+	p = put_varint(p, c->t[0]);
+	for (i = 1; i < n; i++)
+	{
+		delta = (int64_t)(c->t[i] - c->t[i - 1]);
+		p = put_varint(p, zigzag64(delta - prev));
+		prev = delta;
+	}
+
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		p = encode_axis(c->axis[a], n, p);
+	}
+
+	/* updated flags */
+	for (i = 0; i < n; i += run)
+	{
+		for (run = 1; i + run < n && c->updated[i + run] == c->updated[i]; run++)
+			;
+		*p++ = c->updated[i];
+		p = put_varint(p, run);
+	}
+
+	return p - out;
+}
+
+/* Returns 0, or -1 if the encoding is damaged. */
+int codec_decode(const uint8_t *in, size_t len, uint32_t n, const codec_cols_t *c)
+{
+	const uint8_t *p = in;
+	const uint8_t *end = in + len;
+	int64_t delta = 0;
+	uint64_t v;
+	uint32_t i, j;
+	uint8_t u;
+	int a;
+
+	if (n == 0)
+	{
+		return 0;
+	}
+
+	if ((p = get_varint(p, end, &v)) == NULL)
+	{
+		return -1;
+	}
+	c->t[0] = v;
+	for (i = 1; i < n; i++)
+	{
+		if ((p = get_varint(p, end, &v)) == NULL)
+		{
+			return -1;
+		}
+		delta += unzigzag64(v);
+		c->t[i] = c->t[i - 1] + delta;
+	}
+
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		if ((p = decode_axis(p, end, n, c->axis[a])) == NULL)
+		{
+			return -1;
+		}
+	}
+
+	for (i = 0; i < n; i += v)
+	{
+		if (p >= end)
+		{
+			return -1;
+		}
+		u = *p++;
+		if ((p = get_varint(p, end, &v)) == NULL || v == 0 || v > n - i)
+		{
+			return -1;
+		}
+		for (j = 0; j < v; j++)
+		{
+			c->updated[i + j] = u;
+		}
+	}
+
+	return (p == end) ? 0 : -1;
+}
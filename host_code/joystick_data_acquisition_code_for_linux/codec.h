@@ -0,0 +1,44 @@
+/* Lossless codec for blocks of samples.
+ *
+ * A block is encoded column by column:
+ *
+ *   time stamps  the first one, the first difference and then the change
+ *                of the difference (delta of delta), each as a zigzag
+ *                varint. Evenly spaced reports cost one byte.
+ *   axes         predicted from the previous value (order 1) or from the
+ *                previous two (order 2, a straight line), whichever leaves
+ *                the smaller residuals for the block. The zigzag coded
+ *                residuals are bit packed in frames of CODEC_FRAME values,
+ *                each frame using just enough bits for its largest one.
+ *   updated      run length coded.
+ *
+ * Each block is encoded on its own so any block can be decoded without the
+ * ones before it.
+ */
+
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sample.h"
+
+#define CODEC_FRAME 32
+
+/* largest encoding of n samples */
+#define CODEC_MAX_SIZE(n) (10 + 3*10 + (size_t)(n)*10 + \
+                           NUM_AXES*(1 + 2*5 + ((size_t)(n) + CODEC_FRAME - 1)/CODEC_FRAME*(1 + 4*CODEC_FRAME)) + \
+                           (size_t)(n)*6)
+
+typedef struct
+{
+	uint64_t *t;
+	int16_t *axis[NUM_AXES];
+	uint8_t *updated;
+} codec_cols_t;
+
+size_t codec_encode(const codec_cols_t *c, uint32_t n, uint8_t *out);
+int codec_decode(const uint8_t *in, size_t len, uint32_t n, const codec_cols_t *c);
+
+#endif
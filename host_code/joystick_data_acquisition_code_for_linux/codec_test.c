@@ -0,0 +1,332 @@
+/* Round trip tests of the codec in codec.c. Built and run with
+ *
+ *   make check
+ *
+ * Every block is encoded, checked to fit in CODEC_MAX_SIZE(), decoded and
+ * compared with what went in. The encoding cut short by a byte or with a
+ * byte too many must be rejected. The blocks cover
+ *   - 1, 2 and 3 samples, fewer than the order 2 predictor needs,
+ *   - blocks ending either side of a frame boundary,
+ *   - axes that don't change, coded in frames of 0 bits,
+ *   - axes swinging between INT16_MIN and INT16_MAX, the widest residuals
+ *     the encoder makes (19 bits),
+ *   - time stamps whose differences jump by INT32_MIN and INT32_MAX,
+ *     go backwards and start above 2^63,
+ *   - runs of the updated flags as long as the block,
+ *   - pseudo random blocks of every size up to 300 samples.
+ * int16 axes never need 32 bit frames, so a block with 32 bit frames of
+ * INT32_MIN and INT32_MAX residuals is built by hand to check the decoder
+ * on its own.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "codec.h"
+
+#define MAX_N 4096
+
+static int failures;
+
+static uint64_t t_in[MAX_N], t_out[MAX_N];
+static int16_t axis_in[NUM_AXES][MAX_N], axis_out[NUM_AXES][MAX_N];
+static uint8_t updated_in[MAX_N], updated_out[MAX_N];
+static uint8_t buf[CODEC_MAX_SIZE(MAX_N) + 1];
+
+static void check(int ok, const char *what, uint32_t n)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "FAIL: %s (%u samples)\n", what, n);
+		failures++;
+	}
+}
+
+static void cols(codec_cols_t *c, uint64_t *t, int16_t axis[][MAX_N], uint8_t *updated)
+{
+	int a;
+
+	c->t = t;
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		c->axis[a] = axis[a];
+	}
+	c->updated = updated;
+}
+
+static int same(uint32_t n)
+{
+	int a;
+
+	if (memcmp(t_in, t_out, n*sizeof(t_in[0])) != 0 ||
+	    memcmp(updated_in, updated_out, n) != 0)
+	{
+		return 0;
+	}
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		if (memcmp(axis_in[a], axis_out[a], n*sizeof(axis_in[a][0])) != 0)
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/* Returns the size of the encoding of the first n samples. */
+static size_t round_trip(const char *what, uint32_t n)
+{
+	codec_cols_t in, out;
+	size_t len;
+
+	cols(&in, t_in, axis_in, updated_in);
+	cols(&out, t_out, axis_out, updated_out);
+
+	len = codec_encode(&in, n, buf);
+	check(len <= CODEC_MAX_SIZE(n), what, n);
+
+	memset(t_out, 0, sizeof(t_out));
+	memset(axis_out, 0, sizeof(axis_out));
+	memset(updated_out, 0, sizeof(updated_out));
+	check(codec_decode(buf, len, n, &out) == 0 && same(n), what, n);
+
+	if (len > 0)
+	{
+		check(codec_decode(buf, len - 1, n, &out) != 0, "cut short", n);
+		buf[len] = 0;
+		check(codec_decode(buf, len + 1, n, &out) != 0, "trailing byte", n);
+	}
+
+	return len;
+}
+
+static uint32_t lcg = 12345;
+
+static uint32_t next_random(void)
+{
+	lcg = lcg*1664525 + 1013904223;
+	return lcg >> 8;
+}
+
+static void fill_steady(uint32_t n)
+{
+	uint32_t i;
+	int a;
+
+	for (i = 0; i < n; i++)
+	{
+		t_in[i] = 1000000 + 8000*(uint64_t)i;
+		for (a = 0; a < NUM_AXES; a++)
+		{
+			axis_in[a][i] = 500 + a;
+		}
+		updated_in[i] = 0;
+	}
+}
+
+static void test_short_blocks(void)
+{
+	uint32_t n;
+
+	for (n = 0; n <= 3; n++)
+	{
+		fill_steady(n);
+		axis_in[0][n ? n - 1 : 0] = -3;
+		round_trip("short block", n);
+	}
+	check(codec_encode(NULL, 0, buf) == 0, "empty block", 0);
+}
+
+static void test_frame_boundaries(void)
+{
+	uint32_t n;
+	uint32_t i;
+
+	for (n = CODEC_FRAME - 1; n <= 2*CODEC_FRAME + 3; n++)
+	{
+		fill_steady(n);
+		for (i = 0; i < n; i++)
+		{
+			axis_in[1][i] = (int16_t)(i*i);
+		}
+		round_trip("frame boundary", n);
+	}
+}
+
+static void test_zero_bits(void)
+{
+	uint32_t n = MAX_N;
+	size_t len;
+
+	fill_steady(n);
+	len = round_trip("constant axes", n);
+
+	/* a byte per time stamp and per frame, the first values and one run */
+	check(len < n + NUM_AXES*(n/CODEC_FRAME + 8) + 8, "frames of 0 bits", n);
+}
+
+static void test_widest_residuals(void)
+{
+	uint32_t n = 3*CODEC_FRAME;
+	uint32_t i;
+	int a;
+
+	fill_steady(n);
+	for (i = 0; i < n; i++)
+	{
+		for (a = 0; a < NUM_AXES; a++)
+		{
+			axis_in[a][i] = ((i + a) & 1) ? INT16_MAX : INT16_MIN;
+		}
+		/* break up the pattern so order 2 gets picked for the last axis */
+		if (i % 5 == 0)
+		{
+			axis_in[NUM_AXES - 1][i] = 0;
+		}
+	}
+	round_trip("INT16_MIN/INT16_MAX axes", n);
+}
+
+static void test_time_deltas(void)
+{
+	static const int64_t steps[] =
+	{
+		8000, INT32_MAX, INT32_MIN, 0, INT32_MAX, INT32_MAX, INT32_MIN, INT32_MIN,
+		-1, 1, (int64_t)INT32_MAX + 1, (int64_t)INT32_MIN - 1, 8000, 8000,
+	};
+	uint32_t n = sizeof(steps)/sizeof(steps[0]) + 1;
+	uint32_t i;
+
+	fill_steady(n);
+	t_in[0] = ((uint64_t)1 << 63) + 17;
+	for (i = 1; i < n; i++)
+	{
+		t_in[i] = t_in[i - 1] + (uint64_t)steps[i - 1];
+	}
+	round_trip("INT32_MIN/INT32_MAX time deltas", n);
+
+	t_in[0] = 0;
+	for (i = 1; i < n; i++)
+	{
+		t_in[i] = t_in[i - 1] + (uint64_t)steps[i - 1];
+	}
+	round_trip("time stamps wrapping through 0", n);
+}
+
+static void test_random(void)
+{
+	uint32_t n;
+	uint32_t i;
+	int a;
+
+	for (n = 1; n <= 300; n++)
+	{
+		for (i = 0; i < n; i++)
+		{
+			t_in[i] = (i == 0) ? next_random() : t_in[i - 1] + 7000 + next_random() % 2000;
+			for (a = 0; a < NUM_AXES; a++)
+			{
+				axis_in[a][i] = (int16_t)next_random();
+			}
+			updated_in[i] = (next_random() % 4 == 0) ? next_random() & 7 : 7;
+		}
+		round_trip("random block", n);
+	}
+}
+
+/* Appends a frame of width bits holding the zigzag coded residuals z. */
+static uint8_t *put_frame(uint8_t *p, const uint32_t *z, uint32_t m, int width)
+{
+	uint64_t acc = 0;
+	int bits = 0;
+	uint32_t j;
+
+	*p++ = width;
+	for (j = 0; j < m; j++)
+	{
+		acc |= (uint64_t)z[j] << bits;
+		bits += width;
+		while (bits >= 8)
+		{
+			*p++ = (uint8_t)acc;
+			acc >>= 8;
+			bits -= 8;
+		}
+	}
+	if (bits > 0)
+	{
+		*p++ = (uint8_t)acc;
+	}
+
+	return p;
+}
+
+static void test_32_bit_frames(void)
+{
+	uint32_t z[4] =
+	{
+		0xffffffff,       /* INT32_MIN */
+		0xfffffffe,       /* INT32_MAX */
+		0xffffffff,
+		2,                /* 1 */
+	};
+	int16_t expected[5];
+	codec_cols_t out;
+	uint8_t *p = buf;
+	uint32_t n = 5;
+	uint32_t i;
+	int a;
+
+	/* x[0] = 100, then order 1 residuals wrapping modulo 2^16 */
+	expected[0] = 100;
+	expected[1] = (int16_t)(uint16_t)(100 + 0x80000000u);
+	expected[2] = (int16_t)(uint16_t)(expected[1] + 0x7fffffffu);
+	expected[3] = (int16_t)(uint16_t)(expected[2] + 0x80000000u);
+	expected[4] = (int16_t)(uint16_t)(expected[3] + 1);
+
+	*p++ = 0;                     /* time stamps, all 0 */
+	for (i = 1; i < n; i++)
+	{
+		*p++ = 0;
+	}
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		*p++ = 1;                 /* order */
+		*p++ = 0xc8;              /* 100, zigzag coded 200 as a varint */
+		*p++ = 0x01;
+		p = put_frame(p, z, n - 1, 32);
+	}
+	*p++ = 7;                     /* updated, one run */
+	*p++ = n;
+
+	cols(&out, t_out, axis_out, updated_out);
+	check(codec_decode(buf, p - buf, n, &out) == 0, "32 bit frames", n);
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		check(memcmp(axis_out[a], expected, sizeof(expected)) == 0,
+		      "INT32_MIN/INT32_MAX residuals", n);
+	}
+}
+
+int main(void)
+{
+	test_short_blocks();
+	test_frame_boundaries();
+	test_zero_bits();
+	test_widest_residuals();
+	test_time_deltas();
+	test_random();
+	test_32_bit_frames();
+
+	if (failures > 0)
+	{
+		fprintf(stderr, "codec_test: %d check(s) failed.\n", failures);
+		return 1;
+	}
+	fprintf(stdout, "codec_test: all checks passed.\n");
+
+	return 0;
+}
@@ -0,0 +1,477 @@
+/* Reader for columnar recordings. See colrec.h.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "codec.h"
+#include "colrec.h"
+
+/* Rebuilds the index of a recording that wasn't closed from the copies of
+ * the index entries at the start of the blocks. A block that was only
+ * partly written, whose columns don't match the hash in its header, ends
+ * the recording. */
+static int rebuild_index(colrec_t *c)
+{
+	const colrec_block_hdr_t *bh;
+	const colrec_index_t *e;
+	uint64_t n;
+	uint64_t i;
+
+	n = (c->size - COLREC_HEADER_SIZE)/COLREC_BLOCK_SIZE;
+	c->own_index = malloc((n > 0 ? n : 1)*sizeof(colrec_index_t));
+	if (c->own_index == NULL)
+	{
+		return -1;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		bh = (const colrec_block_hdr_t *)(c->map + COLREC_HEADER_SIZE + i*COLREC_BLOCK_SIZE);
+		e = &bh->e;
+		if (e->seq != i || e->count == 0 || e->count > COLREC_BLOCK_SAMPLES ||
+		    bh->check != colrec_hash((const uint8_t *)bh + COLREC_BLOCK_HDR_SIZE,
+		                             COLREC_BLOCK_SIZE - COLREC_BLOCK_HDR_SIZE))
+		{
+			break;
+		}
+		c->own_index[i] = *e;
+	}
+	c->num_blocks = i;
+	c->index = c->own_index;
+
+	return 0;
+}
+
+/* The same for a compressed recording, where the blocks have to be
+ * followed one after the other. A block is only accepted if all of it made
+ * it to disk. */
+static int rebuild_zindex(colrec_t *c)
+{
+	const colrec_zblock_t *zb;
+	uint64_t off = COLREC_HEADER_SIZE;
+	uint64_t n = 0;
+	uint64_t size = 256;
+	void *p;
+
+	/* allocated even for no blocks, which tells colrec_repair() to write
+	 * the trailer */
+	c->own_index = malloc(size*sizeof(colrec_index_t));
+	c->own_offsets = malloc(size*sizeof(uint64_t));
+	if (c->own_index == NULL || c->own_offsets == NULL)
+	{
+		return -1;
+	}
+
+	while (off + sizeof(colrec_zblock_t) <= c->size)
+	{
+		zb = (const colrec_zblock_t *)(c->map + off);
+		if (zb->e.seq != n || zb->e.count == 0 || zb->e.count > COLREC_BLOCK_SAMPLES ||
+		    zb->size > c->size - off - sizeof(colrec_zblock_t) ||
+		    zb->check != colrec_hash((const uint8_t *)(zb + 1), zb->size))
+		{
+			break;
+		}
+
+		if (n == size)
+		{
+			size *= 2;
+			if ((p = realloc(c->own_index, size*sizeof(colrec_index_t))) == NULL)
+			{
+				return -1;
+			}
+			c->own_index = p;
+			if ((p = realloc(c->own_offsets, size*sizeof(uint64_t))) == NULL)
+			{
+				return -1;
+			}
+			c->own_offsets = p;
+		}
+		c->own_index[n] = zb->e;
+		c->own_offsets[n] = off;
+		n++;
+		off += sizeof(colrec_zblock_t) + zb->size;
+	}
+	c->num_blocks = n;
+	c->index = c->own_index;
+	c->offsets = c->own_offsets;
+
+	return 0;
+}
+
+/* The index and trailer at the end of a recording that was closed. */
+static void find_index(colrec_t *c)
+{
+	const colrec_trailer_t *tr;
+	uint64_t n;
+	uint64_t index_size;
+	uint64_t blocks_end;
+
+	if (c->size < COLREC_HEADER_SIZE + sizeof(colrec_trailer_t))
+	{
+		return;
+	}
+	tr = (const colrec_trailer_t *)(c->map + c->size - sizeof(colrec_trailer_t));
+	if (memcmp(tr->magic, COLREC_TRAILER_MAGIC, sizeof(tr->magic)) != 0)
+	{
+		return;
+	}
+
+	n = tr->num_blocks;
+	index_size = n*sizeof(colrec_index_t);
+	if (c->hdr->codec == COLREC_CODEC_DELTA)
+	{
+		index_size += n*sizeof(uint64_t);
+	}
+	if (n > c->size || index_size > c->size - COLREC_HEADER_SIZE - sizeof(colrec_trailer_t))
+	{
+		return;
+	}
+	blocks_end = c->size - sizeof(colrec_trailer_t) - index_size;
+	if (c->hdr->codec == COLREC_CODEC_NONE && blocks_end != COLREC_HEADER_SIZE + n*COLREC_BLOCK_SIZE)
+	{
+		return;
+	}
+
+	c->num_blocks = n;
+	c->index = (const colrec_index_t *)(c->map + blocks_end);
+	if (c->hdr->codec == COLREC_CODEC_DELTA)
+	{
+		c->offsets = (const uint64_t *)(c->map + blocks_end + n*sizeof(colrec_index_t));
+	}
+}
+
+int colrec_open(colrec_t *c, const char *path)
+{
+	struct stat st;
+	uint64_t i;
+
+	memset(c, 0, sizeof(*c));
+
+	c->fd = open(path, O_RDONLY);
+	if (c->fd == -1)
+	{
+		fprintf(stderr, "Couldn't open %s: %s.\n", path, strerror(errno));
+		return -1;
+	}
+
+	if (fstat(c->fd, &st) != 0 || st.st_size < COLREC_HEADER_SIZE)
+	{
+		fprintf(stderr, "%s is not a columnar recording.\n", path);
+		goto failed;
+	}
+	c->size = st.st_size;
+
+	c->map = mmap(NULL, c->size, PROT_READ, MAP_SHARED, c->fd, 0);
+	if (c->map == MAP_FAILED)
+	{
+		fprintf(stderr, "Couldn't map %s: %s.\n", path, strerror(errno));
+		c->map = NULL;
+		goto failed;
+	}
+
+	c->hdr = (const colrec_header_t *)c->map;
+	if (memcmp(c->hdr->magic, COLREC_MAGIC, sizeof(c->hdr->magic)) != 0 ||
+	    c->hdr->header_size != COLREC_HEADER_SIZE ||
+	    c->hdr->block_size != COLREC_BLOCK_SIZE ||
+	    c->hdr->block_samples != COLREC_BLOCK_SAMPLES ||
+	    c->hdr->num_axes != NUM_AXES ||
+	    (c->hdr->codec != COLREC_CODEC_NONE && c->hdr->codec != COLREC_CODEC_DELTA))
+	{
+		fprintf(stderr, "%s is not a columnar recording.\n", path);
+		goto failed;
+	}
+
+	/* use the index at the end if the recording was closed properly */
+	find_index(c);
+	if (c->index == NULL)
+	{
+		fprintf(stderr, "%s wasn't closed properly, rebuilding its index.\n", path);
+		if ((c->hdr->codec == COLREC_CODEC_NONE ? rebuild_index(c) : rebuild_zindex(c)) != 0)
+		{
+			goto failed;
+		}
+	}
+
+	if (c->hdr->codec == COLREC_CODEC_DELTA)
+	{
+		c->buf = malloc(COLREC_BLOCK_SIZE);
+		c->buf_block = UINT64_MAX;
+		if (c->buf == NULL)
+		{
+			goto failed;
+		}
+	}
+
+	for (i = 0; i < c->num_blocks; i++)
+	{
+		c->num_samples += c->index[i].count;
+	}
+
+	return 0;
+
+failed:
+	colrec_close(c);
+	return -1;
+}
+
+void colrec_close(colrec_t *c)
+{
+	if (c->map != NULL)
+	{
+		munmap((void *)c->map, c->size);
+	}
+	if (c->fd >= 0)
+	{
+		close(c->fd);
+	}
+	free(c->own_index);
+	free(c->own_offsets);
+	free(c->buf);
+	memset(c, 0, sizeof(*c));
+	c->fd = -1;
+}
+
+/* Returns 0, or -1 if a compressed block can't be decoded. */
+int colrec_block_span(colrec_t *c, uint64_t block, colrec_span_t *s)
+{
+	const uint8_t *b = c->map + COLREC_HEADER_SIZE + block*COLREC_BLOCK_SIZE;
+	const colrec_zblock_t *zb;
+	codec_cols_t cols;
+	int a;
+
+	if (c->hdr->codec == COLREC_CODEC_DELTA)
+	{
+		b = c->buf;
+		if (c->buf_block != block)
+		{
+			cols.t = (uint64_t *)(c->buf + COLREC_T_OFFSET);
+			for (a = 0; a < NUM_AXES; a++)
+			{
+				cols.axis[a] = (int16_t *)(c->buf + COLREC_AXIS_OFFSET(a));
+			}
+			cols.updated = c->buf + COLREC_UPDATED_OFFSET;
+
+			c->buf_block = UINT64_MAX;
+			zb = (const colrec_zblock_t *)(c->map + c->offsets[block]);
+			if (c->offsets[block] + sizeof(*zb) > c->size ||
+			    zb->size > c->size - c->offsets[block] - sizeof(*zb) ||
+			    codec_decode((const uint8_t *)(zb + 1), zb->size, c->index[block].count, &cols) != 0)
+			{
+				fprintf(stderr, "Block %llu is damaged.\n", (unsigned long long)block);
+				return -1;
+			}
+			c->buf_block = block;
+		}
+	}
+
+	s->t = (const uint64_t *)(b + COLREC_T_OFFSET);
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		s->axis[a] = (const int16_t *)(b + COLREC_AXIS_OFFSET(a));
+	}
+	s->updated = b + COLREC_UPDATED_OFFSET;
+	s->count = c->index[block].count;
+
+	return 0;
+}
+
+/* Returns the first block with samples at or after t_us, or num_blocks if
+ * there is none. */
+uint64_t colrec_find_block(const colrec_t *c, uint64_t t_us)
+{
+	uint64_t lo = 0;
+	uint64_t hi = c->num_blocks;
+	uint64_t mid;
+
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo)/2;
+		if (c->index[mid].t_last < t_us)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+/* first sample in the span at or after t_us */
+static uint32_t lower_bound(const uint64_t *t, uint32_t n, uint64_t t_us)
+{
+	uint32_t lo = 0;
+	uint32_t hi = n;
+	uint32_t mid;
+
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo)/2;
+		if (t[mid] < t_us)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+void colrec_iter_init(colrec_iter_t *it, colrec_t *c, uint64_t t0, uint64_t t1)
+{
+	it->c = c;
+	it->t0 = t0;
+	it->t1 = t1;
+	it->block = colrec_find_block(c, t0);
+}
+
+/* Returns 1 and the next span of samples in the range, 0 when there are no
+ * more or -1 if a block is damaged. */
+int colrec_iter_next(colrec_iter_t *it, colrec_span_t *s)
+{
+	const colrec_index_t *e;
+	uint32_t first;
+	uint32_t last;
+	int a;
+
+	if (it->block >= it->c->num_blocks)
+	{
+		return 0;
+	}
+	e = &it->c->index[it->block];
+	if (e->t_first >= it->t1)
+	{
+		return 0;
+	}
+
+	if (colrec_block_span(it->c, it->block, s) != 0)
+	{
+		return -1;
+	}
+	it->block++;
+
+	first = (e->t_first >= it->t0) ? 0 : lower_bound(s->t, s->count, it->t0);
+	last = (e->t_last < it->t1) ? s->count : lower_bound(s->t, s->count, it->t1);
+
+	s->t += first;
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		s->axis[a] += first;
+	}
+	s->updated += first;
+	s->count = last - first;
+
+	return 1;
+}
+
+/* FNV-1a, used to check that a block was written completely */
+uint32_t colrec_hash(const uint8_t *p, size_t len)
+{
+	uint32_t h = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		h = (h ^ p[i])*16777619u;
+	}
+
+	return h;
+}
+
+/* Finishes a recording that wasn't closed, e.g. after a crash or power
+ * loss: whatever follows the last complete block is cut off and the index
+ * and trailer are written, so it opens like any other recording. Sets
+ * *repaired if anything had to be done and it succeeded. */
+int colrec_repair(const char *path, int *repaired)
+{
+	colrec_t c;
+	colrec_trailer_t tr;
+	const colrec_zblock_t *zb;
+	uint64_t end;
+	int fd;
+	int err_code = 0;
+
+	*repaired = 0;
+	if (colrec_open(&c, path) != 0)
+	{
+		return -1;
+	}
+	if (c.own_index == NULL)
+	{
+		colrec_close(&c);
+		return 0;
+	}
+
+	if (c.hdr->codec == COLREC_CODEC_DELTA)
+	{
+		end = COLREC_HEADER_SIZE;
+		if (c.num_blocks > 0)
+		{
+			zb = (const colrec_zblock_t *)(c.map + c.offsets[c.num_blocks - 1]);
+			end = c.offsets[c.num_blocks - 1] + sizeof(*zb) + zb->size;
+		}
+	}
+	else
+	{
+		end = COLREC_HEADER_SIZE + c.num_blocks*COLREC_BLOCK_SIZE;
+	}
+
+	memset(&tr, 0, sizeof(tr));
+	memcpy(tr.magic, COLREC_TRAILER_MAGIC, sizeof(tr.magic));
+	tr.num_blocks = c.num_blocks;
+
+	fd = open(path, O_WRONLY);
+	if (fd == -1)
+	{
+		fprintf(stderr, "Couldn't open %s: %s.\n", path, strerror(errno));
+		colrec_close(&c);
+		return -1;
+	}
+
+	if (pwrite(fd, c.index, c.num_blocks*sizeof(colrec_index_t), end) !=
+	    (ssize_t)(c.num_blocks*sizeof(colrec_index_t)))
+	{
+		err_code = -1;
+	}
+	end += c.num_blocks*sizeof(colrec_index_t);
+	if (err_code == 0 && c.hdr->codec == COLREC_CODEC_DELTA)
+	{
+		if (pwrite(fd, c.offsets, c.num_blocks*sizeof(uint64_t), end) !=
+		    (ssize_t)(c.num_blocks*sizeof(uint64_t)))
+		{
+			err_code = -1;
+		}
+		end += c.num_blocks*sizeof(uint64_t);
+	}
+	if (err_code == 0 && pwrite(fd, &tr, sizeof(tr), end) != sizeof(tr))
+	{
+		err_code = -1;
+	}
+	end += sizeof(tr);
+	if (err_code == 0 && (ftruncate(fd, end) != 0 || fdatasync(fd) != 0))
+	{
+		err_code = -1;
+	}
+	if (err_code != 0)
+	{
+		fprintf(stderr, "Couldn't repair %s: %s.\n", path, strerror(errno));
+	}
+
+	close(fd);
+	colrec_close(&c);
+	*repaired = (err_code == 0);
+
+	return err_code;
+}
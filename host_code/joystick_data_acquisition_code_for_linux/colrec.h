@@ -0,0 +1,161 @@
+/* Columnar recording format and its reader.
+ *
+ * A columnar recording is laid out so it can be mapped into memory and
+ * used in place:
+ *
+ *   header         COLREC_HEADER_SIZE bytes, see colrec_header_t
+ *   block 0        COLREC_BLOCK_SIZE bytes
+ *   block 1
+ *   ...
+ *   index          one colrec_index_t per block
+ *   trailer        colrec_trailer_t
+ *
+ * Each block holds up to COLREC_BLOCK_SAMPLES samples stored column by
+ * column: a colrec_block_hdr_t padded to COLREC_BLOCK_HDR_SIZE bytes, the
+ * time stamps, the x, y and z values and the updated flags. All the
+ * blocks are the same size, the last one is simply not full, so block i
+ * starts at COLREC_HEADER_SIZE + i*COLREC_BLOCK_SIZE.
+ *
+ * The index at the end, with the time span and the smallest and largest
+ * value of every axis of each block, is only written when the recording is
+ * closed. If the samples came with peaks (SAMPLE_PEAKS) the smallest and
+ * largest values are those of the peaks, which include the readings in
+ * between samples. If they came with sums of squares (SAMPLE_SUMSQ) the
+ * index also holds the number of readings behind the block and the sums
+ * of their squares, so the RMS of every block, over every reading, is
+ * sqrt(sumsq/readings). If the recorder died before that the reader rebuilds the index
+ * from the copies at the start of the blocks, so everything up to the last
+ * complete block can still be read. The hash of the columns in the block
+ * header tells a complete block from one whose header reached the disk but
+ * not all of its columns.
+ *
+ * A compressed recording (codec COLREC_CODEC_DELTA) stores each block as a
+ * colrec_zblock_t followed by the block encoded with codec.h, so its
+ * blocks vary in size. The index is then followed by the file offset of
+ * every block. Blocks are decoded one at a time when they are read, which
+ * keeps random access to any time range cheap.
+ *
+ * All fields are little endian.
+ */
+
+#ifndef COLREC_H
+#define COLREC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sample.h"
+
+#define COLREC_MAGIC "JSCOL\0\0\3"
+#define COLREC_TRAILER_MAGIC "JSCIDX\0\1"
+
+#define COLREC_HEADER_SIZE 4096
+#define COLREC_BLOCK_SAMPLES 4096
+#define COLREC_BLOCK_HDR_SIZE 128    /* holds a colrec_block_hdr_t */
+#define COLREC_BLOCK_SIZE 65536
+
+/* offsets of the columns in a block */
+#define COLREC_T_OFFSET COLREC_BLOCK_HDR_SIZE
+#define COLREC_AXIS_OFFSET(a) (COLREC_T_OFFSET + COLREC_BLOCK_SAMPLES*8 + (a)*COLREC_BLOCK_SAMPLES*2)
+#define COLREC_UPDATED_OFFSET COLREC_AXIS_OFFSET(NUM_AXES)
+
+#define COLREC_CODEC_NONE 0
+#define COLREC_CODEC_DELTA 1
+
+typedef struct
+{
+	char magic[8];
+	uint32_t header_size;
+	uint32_t block_size;
+	uint32_t block_samples;
+	uint32_t num_axes;
+	double sample_rate;       /* nominal samples/s, 0 if not known */
+	uint64_t created_us;      /* wall clock time the recording was started, for a
+	                             segment that of its first sample */
+	char device[128];         /* device node the samples came from */
+	char filter[32];          /* filter in the firmware, e.g. chebyshev */
+	uint32_t codec;           /* COLREC_CODEC_NONE or COLREC_CODEC_DELTA */
+	uint32_t reserved;
+} colrec_header_t;
+
+typedef struct
+{
+	uint64_t t_first;         /* time stamp of the first sample in us */
+	uint64_t t_last;          /* time stamp of the last sample in us */
+	uint32_t count;           /* samples in the block */
+	uint32_t seq;             /* block number */
+	int16_t min[NUM_AXES];
+	int16_t max[NUM_AXES];
+	uint32_t readings;        /* sensor readings behind the samples, 0 if not known */
+	uint64_t sumsq[NUM_AXES]; /* sums of the squares of those readings */
+} colrec_index_t;
+
+/* start of an uncompressed block */
+typedef struct
+{
+	colrec_index_t e;
+	uint32_t check;           /* FNV-1a hash of the rest of the block */
+} colrec_block_hdr_t;
+
+/* start of a compressed block */
+typedef struct
+{
+	colrec_index_t e;
+	uint32_t size;            /* bytes of encoded samples that follow */
+	uint32_t check;           /* FNV-1a hash of the encoded samples */
+} colrec_zblock_t;
+
+typedef struct
+{
+	char magic[8];
+	uint64_t num_blocks;
+} colrec_trailer_t;
+
+/* Samples in one block, pointing straight into the mapped file, or for a
+ * compressed recording into the block last decoded. */
+typedef struct
+{
+	const uint64_t *t;
+	const int16_t *axis[NUM_AXES];
+	const uint8_t *updated;
+	uint32_t count;
+} colrec_span_t;
+
+typedef struct
+{
+	int fd;
+	const uint8_t *map;
+	size_t size;
+	const colrec_header_t *hdr;
+	const colrec_index_t *index;
+	colrec_index_t *own_index;  /* rebuilt index of a recording that wasn't closed */
+	const uint64_t *offsets;    /* of the blocks of a compressed recording */
+	uint64_t *own_offsets;
+	uint8_t *buf;               /* last block decoded */
+	uint64_t buf_block;
+	uint64_t num_blocks;
+	uint64_t num_samples;
+} colrec_t;
+
+typedef struct
+{
+	colrec_t *c;
+	uint64_t block;
+	uint64_t t0;
+	uint64_t t1;
+} colrec_iter_t;
+
+int colrec_open(colrec_t *c, const char *path);
+void colrec_close(colrec_t *c);
+
+int colrec_block_span(colrec_t *c, uint64_t block, colrec_span_t *s);
+uint64_t colrec_find_block(const colrec_t *c, uint64_t t_us);
+
+/* Iterates over the samples with t0 <= t_us < t1 one block at a time. */
+void colrec_iter_init(colrec_iter_t *it, colrec_t *c, uint64_t t0, uint64_t t1);
+int colrec_iter_next(colrec_iter_t *it, colrec_span_t *s);
+
+uint32_t colrec_hash(const uint8_t *p, size_t len);
+int colrec_repair(const char *path, int *repaired);
+
+#endif
@@ -0,0 +1,350 @@
+/* Tests of the crash recovery of columnar recordings in colrec.c and of
+ * segments in segidx.c. Built and run with
+ *
+ *   make check
+ *
+ * A recording of three full blocks and part of a fourth is written with
+ * colsink, uncompressed and compressed, and copies of it are cut short or
+ * damaged the way a crash leaves them. The tests check that
+ *   - the whole recording reads back,
+ *   - cut in the trailer or the index, every sample is recovered,
+ *   - cut in a block or in a block header, or with a block whose header
+ *     reached the disk but not all of its samples, the blocks before it
+ *     are recovered and nothing after,
+ *   - colrec_repair() leaves a recording that opens without rebuilding its
+ *     index, and has nothing to do the second time,
+ *   - segidx_recover() adds an entry for a segment that was cut short, with
+ *     the samples recovered, leaves the segments it has entries for alone,
+ *     and moves one that can't be opened out of the way.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "acq.h"
+#include "colrec.h"
+#include "segidx.h"
+
+#define NUM_SAMPLES (3*COLREC_BLOCK_SAMPLES + 1000)
+
+static int failures;
+static char dir[] = "/tmp/colrec_testXXXXXX";
+static int saved_stderr = -1;
+
+static uint8_t *whole;        /* the recording as it was closed */
+static size_t whole_size;
+
+static void check(int ok, const char *what, uint32_t codec)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "FAIL: %s (%s)\n", what, codec == COLREC_CODEC_NONE ? "uncompressed" : "compressed");
+		failures++;
+	}
+}
+
+/* Repairs and recovery print what they do, which is expected here. */
+static void quiet(void)
+{
+	int fd = open("/dev/null", O_WRONLY);
+
+	fflush(stderr);
+	saved_stderr = dup(2);
+	dup2(fd, 2);
+	close(fd);
+}
+
+static void loud(void)
+{
+	fflush(stderr);
+	dup2(saved_stderr, 2);
+	close(saved_stderr);
+}
+
+static void make(sample_t *s, uint64_t i)
+{
+	int a;
+
+	memset(s, 0, sizeof(*s));
+	s->t_us = 1000000 + 8000*i;
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		s->axis[a] = (int32_t)((i*7 + a*300) % 2000) - 1000;
+	}
+	s->updated = (1 << NUM_AXES) - 1;
+}
+
+static char *path_of(const char *name)
+{
+	static char path[128];
+
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	return path;
+}
+
+static int write_recording(const char *path, uint32_t codec)
+{
+	bufwriter_cfg_t cfg = BUFWRITER_DEFAULT_CFG;
+	colsink_info_t info = { "test", NULL, 125, codec, 0 };
+	sample_t s[100];
+	sink_t *sink;
+	uint64_t i;
+	size_t n, j;
+	int err_code = 0;
+
+	cfg.fsync_policy = FSYNC_NEVER;
+	sink = colsink_open(path, &info, &cfg);
+	if (sink == NULL)
+	{
+		return -1;
+	}
+	for (i = 0; i < NUM_SAMPLES && err_code == 0; i += n)
+	{
+		n = (NUM_SAMPLES - i < 100) ? NUM_SAMPLES - i : 100;
+		for (j = 0; j < n; j++)
+		{
+			make(&s[j], i + j);
+		}
+		err_code = sink->write(sink, s, n);
+	}
+	err_code |= sink->close(sink);
+
+	return err_code;
+}
+
+static int read_file(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	long size;
+
+	if (f == NULL || fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) <= 0)
+	{
+		if (f != NULL)
+		{
+			fclose(f);
+		}
+		return -1;
+	}
+	rewind(f);
+	free(whole);
+	whole = malloc(size);
+	whole_size = (whole != NULL && fread(whole, 1, size, f) == (size_t)size) ? size : 0;
+	fclose(f);
+
+	return (whole_size > 0) ? 0 : -1;
+}
+
+/* Writes the first size bytes of the whole recording to path, with the
+ * bytes from zero_at to zero_at + zero_len cleared. */
+static int write_copy(const char *path, size_t size, size_t zero_at, size_t zero_len)
+{
+	FILE *f = fopen(path, "wb");
+	size_t n;
+
+	if (f == NULL)
+	{
+		return -1;
+	}
+	n = fwrite(whole, 1, zero_at < size ? zero_at : size, f);
+	if (zero_at < size)
+	{
+		for (; n < zero_at + zero_len && n < size; n++)
+		{
+			fputc(0, f);
+		}
+		n += fwrite(whole + n, 1, size - n, f);
+	}
+
+	return (fclose(f) == 0 && n == size) ? 0 : -1;
+}
+
+/* Checks that the recording holds the samples written, from the first on
+ * with none missing. Returns how many it holds, or -1 if it can't be read
+ * or they aren't right. *rebuilt is set if it had to rebuild its index. */
+static long count_samples(const char *path, int *rebuilt)
+{
+	colrec_t c;
+	colrec_iter_t it;
+	colrec_span_t sp;
+	sample_t want;
+	uint64_t k = 0;
+	uint32_t i;
+	int ok = 1;
+	int a;
+
+	if (colrec_open(&c, path) != 0)
+	{
+		return -1;
+	}
+	*rebuilt = (c.own_index != NULL);
+	colrec_iter_init(&it, &c, 0, UINT64_MAX);
+	while (colrec_iter_next(&it, &sp) > 0)
+	{
+		for (i = 0; i < sp.count; i++, k++)
+		{
+			make(&want, k);
+			ok &= (sp.t[i] == want.t_us && sp.updated[i] == want.updated);
+			for (a = 0; a < NUM_AXES; a++)
+			{
+				ok &= (sp.axis[a][i] == want.axis[a]);
+			}
+		}
+	}
+	ok &= (k == c.num_samples);
+	colrec_close(&c);
+
+	return ok ? (long)k : -1;
+}
+
+/* Repairs a damaged copy and checks that num samples are recovered. */
+static void check_repair(uint32_t codec, size_t size, size_t zero_at, size_t zero_len, long num, const char *what)
+{
+	const char *path = path_of("damaged.jsc");
+	int repaired = 0;
+	int rebuilt = 0;
+	int err_code;
+	long before;
+
+	if (write_copy(path, size, zero_at, zero_len) != 0)
+	{
+		check(0, "writing a damaged copy", codec);
+		return;
+	}
+
+	quiet();
+	before = count_samples(path, &rebuilt);
+	err_code = colrec_repair(path, &repaired);
+	loud();
+	check(before == num && rebuilt, what, codec);
+	check(err_code == 0 && repaired, "colrec_repair", codec);
+	check(count_samples(path, &rebuilt) == num && !rebuilt, what, codec);
+	check(colrec_repair(path, &repaired) == 0 && !repaired, "a repaired recording needs no repair", codec);
+	unlink(path);
+}
+
+/* file offset of block i of the whole recording */
+static size_t block_at(uint32_t codec, uint64_t i)
+{
+	colrec_t c;
+	size_t off = COLREC_HEADER_SIZE + i*COLREC_BLOCK_SIZE;
+
+	if (codec == COLREC_CODEC_DELTA && colrec_open(&c, path_of("whole.jsc")) == 0)
+	{
+		off = c.offsets[i];
+		colrec_close(&c);
+	}
+
+	return off;
+}
+
+static void test_repair(uint32_t codec)
+{
+	size_t index_at, b2, b3;
+	int rebuilt;
+
+	if (write_recording(path_of("whole.jsc"), codec) != 0 || read_file(path_of("whole.jsc")) != 0)
+	{
+		check(0, "writing a recording", codec);
+		return;
+	}
+	check(count_samples(path_of("whole.jsc"), &rebuilt) == NUM_SAMPLES && !rebuilt, "a closed recording reads back", codec);
+
+	index_at = block_at(codec, 3) + ((codec == COLREC_CODEC_NONE) ? COLREC_BLOCK_SIZE :
+	                                 sizeof(colrec_zblock_t) + ((colrec_zblock_t *)(whole + block_at(codec, 3)))->size);
+	b2 = block_at(codec, 2);
+	b3 = block_at(codec, 3);
+
+	check_repair(codec, whole_size - 5, whole_size, 0, NUM_SAMPLES, "cut in the trailer, every sample is recovered");
+	check_repair(codec, index_at + 100, whole_size, 0, NUM_SAMPLES, "cut in the index, every sample is recovered");
+	check_repair(codec, index_at, whole_size, 0, NUM_SAMPLES, "cut after the last block, every sample is recovered");
+	check_repair(codec, b2 + (b3 - b2)/2, whole_size, 0, 2*COLREC_BLOCK_SAMPLES,
+	             "cut in a block, the blocks before it are recovered");
+	check_repair(codec, b2 + 10, whole_size, 0, 2*COLREC_BLOCK_SAMPLES,
+	             "cut in a block header, the blocks before it are recovered");
+	check_repair(codec, index_at, b3 - (b3 - b2)/4, (b3 - b2)/8, 2*COLREC_BLOCK_SAMPLES,
+	             "a block that didn't all reach the disk and what follows it are dropped");
+	check_repair(codec, COLREC_HEADER_SIZE, whole_size, 0, 0, "cut after the header, nothing is recovered");
+
+	unlink(path_of("whole.jsc"));
+}
+
+static void test_recover(uint32_t codec)
+{
+	segidx_entry_t e;
+	segidx_entry_t *entries;
+	size_t n;
+	int rebuilt;
+
+	if (write_recording(path_of("whole.jsc"), codec) != 0 || read_file(path_of("whole.jsc")) != 0)
+	{
+		check(0, "writing a recording", codec);
+		return;
+	}
+
+	/* a segment that was closed, one cut short in its third block and
+	 * one that died before its header was written */
+	write_copy(path_of("a-1.jsc"), whole_size, whole_size, 0);
+	check(segidx_entry_of(dir, "a-1.jsc", &e) == 0 && segidx_append(dir, &e) == 0, "segidx_append", codec);
+	write_copy(path_of("a-2.jsc"), block_at(codec, 2) + 1000, whole_size, 0);
+	unlink(path_of("whole.jsc"));
+	write_copy(path_of("a-3.jsc"), 100, whole_size, 0);
+
+	quiet();
+	check(segidx_recover(dir) == 0, "segidx_recover", codec);
+	loud();
+	check(segidx_read(dir, &entries, &n) == 0 && n == 2, "an entry is added for the segment cut short", codec);
+	if (n == 2)
+	{
+		check(strcmp(entries[0].name, "a-1.jsc") == 0 && entries[0].num_samples == NUM_SAMPLES,
+		      "the entry of a closed segment is kept", codec);
+		check(strcmp(entries[1].name, "a-2.jsc") == 0 && entries[1].num_samples == 2*COLREC_BLOCK_SAMPLES,
+		      "the entry of a segment cut short has the samples recovered", codec);
+		check(entries[1].t_first == 1000000 && entries[1].t_last == 1000000 + 8000*(2*COLREC_BLOCK_SAMPLES - 1),
+		      "the entry of a segment cut short has the time span recovered", codec);
+	}
+	free(entries);
+	check(count_samples(path_of("a-2.jsc"), &rebuilt) == 2*COLREC_BLOCK_SAMPLES && !rebuilt,
+	      "a recovered segment opens like a closed one", codec);
+	check(access(path_of("a-3.jsc"), F_OK) != 0 && access(path_of("a-3.jsc.bad"), F_OK) == 0,
+	      "a segment that can't be recovered is moved out of the way", codec);
+
+	quiet();
+	check(segidx_recover(dir) == 0 && segidx_read(dir, &entries, &n) == 0 && n == 2,
+	      "recovering again adds nothing", codec);
+	loud();
+	free(entries);
+
+	unlink(path_of("a-1.jsc"));
+	unlink(path_of("a-2.jsc"));
+	unlink(path_of("a-3.jsc.bad"));
+	unlink(path_of(SEGIDX_NAME));
+}
+
+int main(void)
+{
+	if (mkdtemp(dir) == NULL)
+	{
+		fprintf(stderr, "Couldn't make a directory for the test files.\n");
+		return 1;
+	}
+
+	test_repair(COLREC_CODEC_NONE);
+	test_repair(COLREC_CODEC_DELTA);
+	test_recover(COLREC_CODEC_NONE);
+	test_recover(COLREC_CODEC_DELTA);
+	free(whole);
+	rmdir(dir);
+
+	if (failures > 0)
+	{
+		fprintf(stderr, "colrec_test: %d check(s) failed.\n", failures);
+		return 1;
+	}
+	fprintf(stdout, "colrec_test: all checks passed.\n");
+
+	return 0;
+}
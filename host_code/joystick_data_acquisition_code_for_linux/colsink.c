@@ -0,0 +1,327 @@
+/* Sink that writes samples to a columnar recording (see colrec.h).
+ *
+ * Samples are gathered column by column into a block in memory, which is
+ * handed to a bufwriter when it is full, compressed first if the recording
+ * is. A compressed recording also hands over a block that isn't full once
+ * its first sample is older than the flush interval, so the file is never
+ * further behind than that. An uncompressed one would spend a whole
+ * COLREC_BLOCK_SIZE on every short block, so it waits for full blocks.
+ * The index entries are kept until the
+ * recording is closed and then written after the last block.
+ *
+ * Once a block couldn't be written the recording is abandoned: the block
+ * is dropped and every later call fails without touching the buffers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "acq.h"
+#include "codec.h"
+#include "colrec.h"
+
+typedef struct
+{
+	sink_t sink;
+	bufwriter_t w;
+	uint8_t *block;
+	colrec_index_t cur;       /* index entry of the block being filled */
+	colrec_index_t *index;
+	uint64_t num_blocks;
+	uint64_t index_size;
+	uint32_t codec;
+	uint8_t *zbuf;            /* compressed block */
+	uint64_t *offsets;        /* of the compressed blocks */
+	uint64_t offset;          /* of the next block */
+	uint64_t block_ms;        /* when the block being filled got its first sample */
+	int failed;               /* a block couldn't be written */
+} colsink_t;
+
+static int write_zblock(colsink_t *cs)
+{
+	colrec_zblock_t *zb = (colrec_zblock_t *)cs->zbuf;
+	codec_cols_t cols;
+	size_t size;
+	int a;
+
+	cols.t = (uint64_t *)(cs->block + COLREC_T_OFFSET);
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		cols.axis[a] = (int16_t *)(cs->block + COLREC_AXIS_OFFSET(a));
+	}
+	cols.updated = cs->block + COLREC_UPDATED_OFFSET;
+
+	size = codec_encode(&cols, cs->cur.count, cs->zbuf + sizeof(*zb));
+	zb->e = cs->cur;
+	zb->size = size;
+	zb->check = colrec_hash(cs->zbuf + sizeof(*zb), size);
+
+	cs->offsets[cs->num_blocks - 1] = cs->offset;
+	cs->offset += sizeof(*zb) + size;
+
+	return bufwriter_write(&cs->w, cs->zbuf, sizeof(*zb) + size);
+}
+
+static int write_block(colsink_t *cs)
+{
+	colrec_block_hdr_t *bh = (colrec_block_hdr_t *)cs->block;
+	colrec_index_t *index;
+	uint64_t *offsets;
+
+	if (cs->num_blocks == cs->index_size)
+	{
+		cs->index_size = (cs->index_size > 0) ? 2*cs->index_size : 256;
+		index = realloc(cs->index, cs->index_size*sizeof(colrec_index_t));
+		if (index == NULL)
+		{
+			return -1;
+		}
+		cs->index = index;
+		offsets = realloc(cs->offsets, cs->index_size*sizeof(uint64_t));
+		if (offsets == NULL)
+		{
+			return -1;
+		}
+		cs->offsets = offsets;
+	}
+
+	bh->e = cs->cur;
+	cs->index[cs->num_blocks++] = cs->cur;
+
+	if (cs->codec == COLREC_CODEC_DELTA)
+	{
+		if (write_zblock(cs) != 0)
+		{
+			return -1;
+		}
+	}
+	else
+	{
+		bh->check = colrec_hash(cs->block + COLREC_BLOCK_HDR_SIZE, COLREC_BLOCK_SIZE - COLREC_BLOCK_HDR_SIZE);
+		if (bufwriter_write(&cs->w, cs->block, COLREC_BLOCK_SIZE) != 0)
+		{
+			return -1;
+		}
+		memset(cs->block, 0, COLREC_BLOCK_SIZE);
+	}
+
+	memset(&cs->cur, 0, sizeof(cs->cur));
+	cs->cur.seq = cs->num_blocks;
+
+	return 0;
+}
+
+/* Writes out the block being filled. If that fails the block is dropped
+ * and the sink marked as failed. */
+static int end_block(colsink_t *cs)
+{
+	if (write_block(cs) != 0)
+	{
+		memset(&cs->cur, 0, sizeof(cs->cur));
+		cs->failed = 1;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int colsink_write(sink_t *s, const sample_t *samples, size_t n)
+{
+	colsink_t *cs = (colsink_t *)s;
+	uint64_t *t = (uint64_t *)(cs->block + COLREC_T_OFFSET);
+	int16_t *axis[NUM_AXES];
+	uint8_t *updated = cs->block + COLREC_UPDATED_OFFSET;
+	colrec_index_t *e = &cs->cur;
+	size_t i;
+	int16_t v, lo, hi;
+	int a;
+
+	if (cs->failed)
+	{
+		return -1;
+	}
+
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		axis[a] = (int16_t *)(cs->block + COLREC_AXIS_OFFSET(a));
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		if (e->count == 0)
+		{
+			cs->block_ms = bufwriter_now_ms();
+			e->t_first = samples[i].t_us;
+			for (a = 0; a < NUM_AXES; a++)
+			{
+				e->min[a] = INT16_MAX;
+				e->max[a] = INT16_MIN;
+			}
+		}
+		e->t_last = samples[i].t_us;
+
+		t[e->count] = samples[i].t_us;
+		for (a = 0; a < NUM_AXES; a++)
+		{
+			v = (int16_t)samples[i].axis[a];
+			axis[a][e->count] = v;
+			if (samples[i].updated & SAMPLE_PEAKS)
+			{
+				lo = samples[i].min[a];
+				hi = samples[i].max[a];
+			}
+			else
+			{
+				lo = hi = v;
+			}
+			if (lo < e->min[a])
+			{
+				e->min[a] = lo;
+			}
+			if (hi > e->max[a])
+			{
+				e->max[a] = hi;
+			}
+			if (samples[i].updated & SAMPLE_SUMSQ)
+			{
+				e->sumsq[a] += samples[i].sumsq[a];
+			}
+		}
+		if (samples[i].updated & SAMPLE_SUMSQ)
+		{
+			e->readings += samples[i].readings;
+		}
+		updated[e->count] = (uint8_t)samples[i].updated;
+
+		if (++e->count == COLREC_BLOCK_SAMPLES && end_block(cs) != 0)
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int colsink_tick(sink_t *s)
+{
+	colsink_t *cs = (colsink_t *)s;
+
+	if (cs->failed)
+	{
+		return -1;
+	}
+	if (cs->codec == COLREC_CODEC_DELTA && cs->cur.count > 0 && cs->w.cfg.flush_ms > 0 &&
+	    bufwriter_now_ms() - cs->block_ms >= cs->w.cfg.flush_ms && end_block(cs) != 0)
+	{
+		return -1;
+	}
+	if (bufwriter_tick(&cs->w) != 0)
+	{
+		cs->failed = 1;
+		return -1;
+	}
+
+	return 0;
+}
+
+static uint64_t colsink_bytes(sink_t *s)
+{
+	colsink_t *cs = (colsink_t *)s;
+
+	return cs->w.bytes_written + cs->w.len;
+}
+
+static int colsink_close(sink_t *s)
+{
+	colsink_t *cs = (colsink_t *)s;
+	colrec_trailer_t tr;
+	int err_code = cs->failed ? -1 : 0;
+
+	if (err_code == 0 && cs->cur.count > 0)
+	{
+		err_code = write_block(cs);
+	}
+
+	if (err_code == 0)
+	{
+		memset(&tr, 0, sizeof(tr));
+		memcpy(tr.magic, COLREC_TRAILER_MAGIC, sizeof(tr.magic));
+		tr.num_blocks = cs->num_blocks;
+		err_code = bufwriter_write(&cs->w, cs->index, cs->num_blocks*sizeof(colrec_index_t));
+		if (cs->codec == COLREC_CODEC_DELTA)
+		{
+			err_code |= bufwriter_write(&cs->w, cs->offsets, cs->num_blocks*sizeof(uint64_t));
+		}
+		err_code |= bufwriter_write(&cs->w, &tr, sizeof(tr));
+	}
+
+	err_code |= bufwriter_close(&cs->w);
+	free(cs->block);
+	free(cs->zbuf);
+	free(cs->index);
+	free(cs->offsets);
+	free(cs);
+
+	return err_code;
+}
+
+sink_t *colsink_open(const char *path, const colsink_info_t *info, const bufwriter_cfg_t *cfg)
+{
+	colsink_t *cs;
+	colrec_header_t *hdr;
+	uint8_t *h;
+	struct timespec ts;
+
+	cs = calloc(1, sizeof(*cs));
+	if (cs == NULL)
+	{
+		return NULL;
+	}
+	cs->sink.write = colsink_write;
+	cs->sink.tick = colsink_tick;
+	cs->sink.close = colsink_close;
+	cs->sink.bytes = colsink_bytes;
+
+	cs->codec = info->codec;
+	cs->offset = COLREC_HEADER_SIZE;
+	cs->block = calloc(1, COLREC_BLOCK_SIZE);
+	if (cs->codec == COLREC_CODEC_DELTA)
+	{
+		cs->zbuf = malloc(sizeof(colrec_zblock_t) + CODEC_MAX_SIZE(COLREC_BLOCK_SAMPLES));
+	}
+	h = calloc(1, COLREC_HEADER_SIZE);
+	if (cs->block == NULL || (cs->codec == COLREC_CODEC_DELTA && cs->zbuf == NULL) || h == NULL ||
+	    bufwriter_open(&cs->w, path, cfg) != 0)
+	{
+		free(h);
+		free(cs->block);
+		free(cs->zbuf);
+		free(cs);
+		return NULL;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	hdr = (colrec_header_t *)h;
+	memcpy(hdr->magic, COLREC_MAGIC, sizeof(hdr->magic));
+	hdr->header_size = COLREC_HEADER_SIZE;
+	hdr->block_size = COLREC_BLOCK_SIZE;
+	hdr->block_samples = COLREC_BLOCK_SAMPLES;
+	hdr->num_axes = NUM_AXES;
+	hdr->sample_rate = info->sample_rate;
+	hdr->created_us = (info->created_us != 0) ? info->created_us : (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+	hdr->codec = cs->codec;
+	snprintf(hdr->device, sizeof(hdr->device), "%s", info->device != NULL ? info->device : "");
+	snprintf(hdr->filter, sizeof(hdr->filter), "%s", info->filter != NULL ? info->filter : "");
+
+	if (bufwriter_write(&cs->w, h, COLREC_HEADER_SIZE) != 0)
+	{
+		free(h);
+		colsink_close(&cs->sink);
+		return NULL;
+	}
+	free(h);
+
+	return &cs->sink;
+}
@@ -0,0 +1,57 @@
+/* Writing captures of raw device events. See evcap.h. */
+
+#include <string.h>
+#include <time.h>
+
+#include "evcap.h"
+
+FILE *evcap_create(const char *path)
+{
+	FILE *f;
+
+	f = fopen(path, "wb");
+	if (f != NULL)
+	{
+		setvbuf(f, NULL, _IOFBF, EVCAP_BUF_SIZE);
+	}
+
+	return f;
+}
+
+int evcap_write_header(FILE *f, const char *source, const char *path, const char *name,
+                       const sample_t *initial)
+{
+	evcap_header_t h;
+	struct timespec ts;
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, EVCAP_MAGIC, sizeof(h.magic));
+	strncpy(h.source, source, sizeof(h.source) - 1);
+	strncpy(h.path, path, sizeof(h.path) - 1);
+	strncpy(h.name, name, sizeof(h.name) - 1);
+	memcpy(h.axis, initial->axis, sizeof(h.axis));
+	h.updated = initial->updated;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	h.t_start_us = (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+
+	return (fwrite(&h, sizeof(h), 1, f) == 1) ? 0 : -1;
+}
+
+/* Appends what one read() returned, or a state, stamped with the time now. */
+int evcap_write(FILE *f, uint32_t kind, const void *data, uint32_t len)
+{
+	evcap_record_t r;
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	r.t_us = (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+	r.len = len;
+	r.kind = kind;
+
+	if (fwrite(&r, sizeof(r), 1, f) != 1 || fwrite(data, 1, len, f) != len)
+	{
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,69 @@
+/* Captures of the raw event stream of a device, for replaying later.
+ *
+ * A capture holds exactly what each read() of the device returned, the
+ * js_events of the joystick API or the input_events of the event
+ * interface, together with the time the read returned. Replaying it runs
+ * the same bytes through the same source backend in the same batches, so
+ * the whole pipeline can be exercised, benchmarked and bisected without a
+ * nunchuk, and the samples that come out are the ones recorded live.
+ *
+ * The replay source reads captures named replay:file or *.evc. Reads are
+ * paced from a timerfd at the original timing divided by the replay speed
+ * (see replay_set_speed()), or come as fast as the pipeline takes them for
+ * speed 0. A replay as fast as possible only matches the live recording
+ * sample for sample if the writer can keep up, i.e. with -q 0 or a queue
+ * big enough to hold the whole capture.
+ *
+ * What a backend asks the device for outside of reads, such as the axes
+ * the event interface reads back after the kernel dropped events, is kept
+ * in state records that the backend gets back at the same point of the
+ * replay.
+ *
+ * hidraw reports are stamped when they are read rather than by the
+ * kernel, so hidraw devices can't be captured.
+ *
+ * The format is a header followed by one record per read or state, each a
+ * record header followed by len bytes. All fields are little endian.
+ */
+
+#ifndef EVCAP_H
+#define EVCAP_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sample.h"
+
+#define EVCAP_MAGIC "JSEVCAP\1"
+#define EVCAP_MAX_READ 65536
+#define EVCAP_BUF_SIZE (1 << 16)
+
+#define EVCAP_READ 0
+#define EVCAP_STATE 1
+
+typedef struct
+{
+	char magic[8];            /* EVCAP_MAGIC */
+	char source[16];          /* backend that read it, joydev or evdev */
+	char path[256];           /* device node */
+	char name[80];            /* name the device reported */
+	int32_t axis[NUM_AXES];   /* values read from the device when it was opened */
+	uint16_t updated;         /* which of them were read */
+	uint16_t reserved;
+	uint32_t reserved2;
+	uint64_t t_start_us;      /* CLOCK_MONOTONIC when it was opened */
+} evcap_header_t;
+
+typedef struct
+{
+	uint64_t t_us;            /* CLOCK_MONOTONIC when the read returned */
+	uint32_t len;
+	uint32_t kind;            /* EVCAP_READ or EVCAP_STATE */
+} evcap_record_t;
+
+FILE *evcap_create(const char *path);
+int evcap_write_header(FILE *f, const char *source, const char *path, const char *name,
+                       const sample_t *initial);
+int evcap_write(FILE *f, uint32_t kind, const void *data, uint32_t len);
+
+#endif
@@ -0,0 +1,297 @@
+/* Exports a recording made by record_joystick_data to one csv file per axis,
+ * e.g. js0.jsc becomes js0_x-axis.csv, js0_y-axis.csv and js0_z-axis.csv.
+ * Both columnar and raw recordings can be exported.
+ * Each line holds a time stamp in milliseconds and the axis value, which is
+ * the format the octave scripts load.
+ *
+ * By default only the values that changed are written, just like the
+ * joystick driver reports them. With -a every sample is written for every
+ * axis, so the files are regularly sampled and don't need fillin.m.
+ * With -R the samples are resampled onto a regular grid instead (see
+ * resample.h), which does what fillin.m did for recordings of any length.
+ * The grid starts at the first sample, like fillin.m, or with -G falls on
+ * the multiples of the sample period of the device clock, so exports of
+ * devices that share a clock line up.
+ *
+ * To compile: make export_csv
+ * To run: ./export_csv js0.jsc
+ *         ./export_csv -a js0.jsc
+ *         ./export_csv -R 125 js0.jsc          (like fillin.m)
+ *         ./export_csv -R 100:sinc js0.jsc
+ *         ./export_csv -G -R 125 js0.jsc
+ *
+ * license: Unknown
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "colrec.h"
+#include "resample.h"
+#include "sample.h"
+
+#define RECORD_BATCH 4096
+
+static const char axis_name[NUM_AXES] = { 'x', 'y', 'z' };
+
+static int all = 0;
+static int resampling = 0;
+static resampler_t rs;
+
+static void write_sample(FILE *fout[], uint64_t t_us, const int16_t *axis, uint8_t updated)
+{
+	int i;
+
+	for (i = 0; i < NUM_AXES; i++)
+	{
+		if (all || (updated & (1 << i)))
+		{
+			fprintf(fout[i], "%llu, %d\n", (unsigned long long)(t_us/1000), axis[i]);
+		}
+	}
+}
+
+static int write_resampled(void *ctx, const rsample_t *out, size_t n)
+{
+	FILE **fout = ctx;
+	size_t j;
+	int i;
+
+	for (j = 0; j < n; j++)
+	{
+		for (i = 0; i < NUM_AXES; i++)
+		{
+			fprintf(fout[i], "%.3f, %.10g\n", out[j].t_us/1000.0, out[j].axis[i]);
+		}
+	}
+
+	return 0;
+}
+
+static int put_sample(FILE *fout[], uint64_t t_us, const int16_t *axis, uint8_t updated)
+{
+	sample_t s;
+	int i;
+
+	if (!resampling)
+	{
+		write_sample(fout, t_us, axis, updated);
+		return 0;
+	}
+
+	s.t_us = t_us;
+	for (i = 0; i < NUM_AXES; i++)
+	{
+		s.axis[i] = axis[i];
+	}
+	s.dev = 0;
+	s.updated = updated;
+
+	return resampler_push(&rs, &s, 1);
+}
+
+static int export_raw(FILE *fin, FILE *fout[])
+{
+	rawrec_t *recs;
+	size_t j = 0;
+	size_t n = 0;
+
+	recs = malloc(RECORD_BATCH*sizeof(rawrec_t));
+	if (recs == NULL)
+	{
+		return -1;
+	}
+
+	while ((n = fread(recs, sizeof(rawrec_t), RECORD_BATCH, fin)) > 0)
+	{
+		for (j = 0; j < n; j++)
+		{
+			if (put_sample(fout, recs[j].t_us, recs[j].axis, recs[j].updated) != 0)
+			{
+				free(recs);
+				return -1;
+			}
+		}
+	}
+	free(recs);
+
+	return 0;
+}
+
+static int export_col(const char *path, FILE *fout[])
+{
+	colrec_t c;
+	colrec_iter_t it;
+	colrec_span_t s;
+	int16_t axis[NUM_AXES];
+	uint32_t j;
+	int i;
+	int err_code = 0;
+
+	if (colrec_open(&c, path) != 0)
+	{
+		return -1;
+	}
+
+	colrec_iter_init(&it, &c, 0, UINT64_MAX);
+	while ((err_code = colrec_iter_next(&it, &s)) > 0)
+	{
+		for (j = 0; j < s.count; j++)
+		{
+			for (i = 0; i < NUM_AXES; i++)
+			{
+				axis[i] = s.axis[i][j];
+			}
+			if (put_sample(fout, s.t[j], axis, s.updated[j]) != 0)
+			{
+				colrec_close(&c);
+				return -1;
+			}
+		}
+	}
+	colrec_close(&c);
+
+	return (err_code < 0) ? -1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+	int err_code = 0;
+	int opt;
+	int i = 0;
+	int col = 0;
+	size_t len;
+	char *prefix = NULL;
+	char *path;
+	FILE *fin = NULL;
+	FILE *fout[NUM_AXES] = { NULL };
+	rawrec_header_t hdr;
+	double rate = 0;
+	int method = RESAMPLE_HOLD;
+	int absolute = 0;
+	char *p;
+
+	while ((opt = getopt(argc, argv, "aGR:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'a':
+			all = 1;
+			break;
+		case 'G':
+			absolute = 1;
+			break;
+		case 'R':
+			rate = strtod(optarg, &p);
+			if (*p == ':')
+			{
+				method = resample_method(p + 1);
+			}
+			else if (*p != '\0')
+			{
+				method = -1;
+			}
+			if (!(rate > 0) || method < 0)
+			{
+				fprintf(stderr, "Invalid resampling, expected e.g. 125:linear.\n");
+				return -1;
+			}
+			resampling = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-a] [-G] [-R rate[:hold|linear|sinc]] recording\n", argv[0]);
+			return -1;
+		}
+	}
+
+	if (optind >= argc)
+	{
+		fprintf(stderr, "usage: %s [-a] [-G] [-R rate[:hold|linear|sinc]] recording\n", argv[0]);
+		return -1;
+	}
+
+	fin = fopen(argv[optind], "rb");
+	if (fin == NULL)
+	{
+		fprintf(stderr, "Couldn't open %s: %s.\n", argv[optind], strerror(errno));
+		return -1;
+	}
+
+	if (fread(&hdr, sizeof(hdr), 1, fin) != 1)
+	{
+		hdr.magic[0] = '\0';
+	}
+	if (memcmp(hdr.magic, COLREC_MAGIC, sizeof(hdr.magic)) == 0)
+	{
+		col = 1;
+	}
+	else if (memcmp(hdr.magic, RAWREC_MAGIC, sizeof(hdr.magic)) != 0 ||
+	         hdr.record_size != sizeof(rawrec_t))
+	{
+		fprintf(stderr, "%s is not a joystick recording.\n", argv[optind]);
+		err_code = -1;
+		goto finished;
+	}
+
+	/* strip the extension to get the prefix of the csv files */
+	len = strlen(argv[optind]);
+	prefix = malloc(len + 16);
+	if (prefix == NULL)
+	{
+		err_code = -1;
+		goto finished;
+	}
+	strcpy(prefix, argv[optind]);
+	path = strrchr(prefix, '.');
+	if (path != NULL && strchr(path, '/') == NULL)
+	{
+		*path = '\0';
+	}
+	len = strlen(prefix);
+
+	for (i = 0; i < NUM_AXES; i++)
+	{
+		sprintf(prefix + len, "_%c-axis.csv", axis_name[i]);
+		fout[i] = fopen(prefix, "w");
+		if (fout[i] == NULL)
+		{
+			fprintf(stderr, "Couldn't open %s: %s.\n", prefix, strerror(errno));
+			err_code = -1;
+			goto finished;
+		}
+	}
+
+	if (resampling && resampler_init(&rs, rate, method, RESAMPLE_DEFAULT_TAPS,
+	                                 RESAMPLE_DEFAULT_MAX_GAP_US, write_resampled, fout) != 0)
+	{
+		err_code = -1;
+		goto finished;
+	}
+	if (resampling)
+	{
+		resampler_set_absolute(&rs, absolute);
+	}
+
+	err_code = col ? export_col(argv[optind], fout) : export_raw(fin, fout);
+	if (resampling)
+	{
+		err_code |= resampler_flush(&rs);
+		resampler_free(&rs);
+	}
+
+finished:
+	for (i = 0; i < NUM_AXES; i++)
+	{
+		if (fout[i] != NULL)
+		{
+			fclose(fout[i]);
+		}
+	}
+	fclose(fin);
+	free(prefix);
+
+	return err_code;
+}
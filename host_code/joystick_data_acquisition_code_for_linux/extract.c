@@ -0,0 +1,749 @@
+/* Extracts a window of wall clock time from one or more recordings, e.g.
+ * 10 seconds around 02:13:05 from js0 and js1:
+ *
+ *   ./extract -a 2026-10-18T02:13:05 -d 10 data/js0 data/js1
+ *
+ * Each source is a daemon mode directory of segments (see segidx.h) or a
+ * single columnar recording. Only the segments that overlap the window are
+ * opened and only the blocks that overlap it are read (and decoded if the
+ * recording is compressed), so the time taken depends on the length of the
+ * window and not on the size of the archive. Segments the recorder is still
+ * writing are included too, up to their last complete block.
+ *
+ * One file is written per source, named <prefix><source>.<format>:
+ *
+ *   csv     t, x, y, z per line, t in seconds since 1970 (UTC)
+ *   bin     raw recording (see sample.h) with wall clock time stamps
+ *   mseed   miniSEED 2 with 512 byte records of 32-bit integers, one
+ *           channel per axis. A record ends at a gap, so it needs
+ *           regularly sampled data, e.g. recorded with the hidraw backend.
+ *
+ * Times are UTC, either as 2026-10-18T02:13:05[.fraction] or in seconds
+ * since 1970.
+ *
+ * To compile: make extract
+ * Options:
+ *   -s time     start of the window
+ *   -e time     end of the window
+ *   -a time     center of the window
+ *   -d secs     length of the window (default 10)
+ *   -f format   csv (default), bin or mseed
+ *   -o prefix   prefix of the output files, e.g. a directory ending in /
+ *   -N net      miniSEED network code (default XX)
+ *
+ * license: Unknown
+ */
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "colrec.h"
+#include "sample.h"
+#include "segidx.h"
+
+#define FORMAT_CSV 0
+#define FORMAT_BIN 1
+#define FORMAT_MSEED 2
+
+#define MSEED_RECORD_SIZE 512
+#define MSEED_DATA_OFFSET 64
+#define MSEED_SAMPLES ((MSEED_RECORD_SIZE - MSEED_DATA_OFFSET)/4)
+
+static const char *const format_ext[] = { "csv", "bin", "mseed" };
+
+typedef struct
+{
+	char channel[4];
+	int32_t data[MSEED_SAMPLES];
+	int n;
+	uint64_t start_us;        /* wall clock time of data[0] */
+} mseed_chan_t;
+
+typedef struct
+{
+	FILE *f;
+	int format;
+	const char *name;         /* of the source */
+	char station[6];
+	char network[3];
+	double rate;
+	uint64_t period_us;
+	uint32_t seq;             /* of the last miniSEED record */
+	uint8_t dev;
+	mseed_chan_t chan[NUM_AXES];
+	uint64_t num_samples;
+} output_t;
+
+/* a segment, or a single recording, that may overlap the window */
+typedef struct
+{
+	char *path;
+	int64_t wall_offset_us;
+	uint64_t t_first;
+	uint64_t t_last;
+} piece_t;
+
+static int parse_time(const char *arg, uint64_t *us)
+{
+	struct tm tm;
+	char *p;
+	double frac = 0;
+	double secs;
+
+	memset(&tm, 0, sizeof(tm));
+	p = strptime(arg, "%Y-%m-%dT%H:%M:%S", &tm);
+	if (p == NULL)
+	{
+		p = strptime(arg, "%Y-%m-%d %H:%M:%S", &tm);
+	}
+	if (p != NULL)
+	{
+		if (*p == '.')
+		{
+			frac = strtod(p, &p);
+		}
+		if (*p != '\0' && strcmp(p, "Z") != 0)
+		{
+			return -1;
+		}
+		*us = (uint64_t)timegm(&tm)*1000000 + (uint64_t)llround(frac*1e6);
+		return 0;
+	}
+
+	errno = 0;
+	secs = strtod(arg, &p);
+	if (errno != 0 || *p != '\0' || p == arg || secs < 0)
+	{
+		return -1;
+	}
+	*us = (uint64_t)llround(secs*1e6);
+
+	return 0;
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+	p[0] = v >> 8;
+	p[1] = v;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static void put_text(uint8_t *p, const char *s, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+	{
+		p[i] = (*s != '\0') ? *s++ : ' ';
+	}
+}
+
+/* Writes the samples collected for one channel as a miniSEED record with a
+ * fixed header, blockette 1000 and big endian 32-bit integers. */
+static int mseed_flush(output_t *out, mseed_chan_t *c)
+{
+	uint8_t rec[MSEED_RECORD_SIZE];
+	char seq[7];
+	struct tm tm;
+	time_t secs = c->start_us/1000000;
+	int16_t factor;
+	int16_t mult;
+	int i;
+
+	if (c->n == 0)
+	{
+		return 0;
+	}
+
+	if (out->rate == floor(out->rate) && out->rate <= 32767)
+	{
+		factor = (int16_t)out->rate;
+		mult = 1;
+	}
+	else
+	{
+		factor = (int16_t)lround(out->rate*10);
+		mult = -10;
+	}
+
+	memset(rec, 0, sizeof(rec));
+	snprintf(seq, sizeof(seq), "%06u", (unsigned)(++out->seq % 1000000));
+	memcpy(rec, seq, 6);
+	rec[6] = 'D';
+	rec[7] = ' ';
+	put_text(rec + 8, out->station, 5);
+	put_text(rec + 13, "", 2);
+	put_text(rec + 15, c->channel, 3);
+	put_text(rec + 18, out->network, 2);
+
+	gmtime_r(&secs, &tm);
+	put16(rec + 20, tm.tm_year + 1900);
+	put16(rec + 22, tm.tm_yday + 1);
+	rec[24] = tm.tm_hour;
+	rec[25] = tm.tm_min;
+	rec[26] = tm.tm_sec;
+	put16(rec + 28, (c->start_us % 1000000)/100);
+
+	put16(rec + 30, c->n);
+	put16(rec + 32, (uint16_t)factor);
+	put16(rec + 34, (uint16_t)mult);
+	rec[39] = 1;                        /* blockettes that follow */
+	put16(rec + 44, MSEED_DATA_OFFSET);
+	put16(rec + 46, 48);
+
+	/* blockette 1000 */
+	put16(rec + 48, 1000);
+	put16(rec + 50, 0);
+	rec[52] = 3;                        /* 32-bit integers */
+	rec[53] = 1;                        /* big endian */
+	rec[54] = 9;                        /* 2^9 byte records */
+
+	for (i = 0; i < c->n; i++)
+	{
+		put32(rec + MSEED_DATA_OFFSET + 4*i, (uint32_t)c->data[i]);
+	}
+	c->n = 0;
+
+	return (fwrite(rec, sizeof(rec), 1, out->f) == 1) ? 0 : -1;
+}
+
+static int mseed_put(output_t *out, mseed_chan_t *c, uint64_t t_us, int32_t v)
+{
+	uint64_t expected = c->start_us + c->n*out->period_us;
+	uint64_t err = (t_us > expected) ? t_us - expected : expected - t_us;
+
+	/* a record holds evenly spaced samples, so a gap ends it */
+	if (c->n > 0 && err > out->period_us/2 && mseed_flush(out, c) != 0)
+	{
+		return -1;
+	}
+	if (c->n == 0)
+	{
+		c->start_us = t_us;
+	}
+	c->data[c->n++] = v;
+	if (c->n == MSEED_SAMPLES)
+	{
+		return mseed_flush(out, c);
+	}
+
+	return 0;
+}
+
+static int put_samples(output_t *out, const colrec_span_t *s, int64_t wall_offset_us)
+{
+	rawrec_t r;
+	uint64_t t;
+	uint32_t j;
+	int a;
+
+	for (j = 0; j < s->count; j++)
+	{
+		t = s->t[j] + wall_offset_us;
+		switch (out->format)
+		{
+		case FORMAT_CSV:
+			fprintf(out->f, "%llu.%06llu, %d, %d, %d\n",
+			        (unsigned long long)(t/1000000), (unsigned long long)(t%1000000),
+			        s->axis[0][j], s->axis[1][j], s->axis[2][j]);
+			break;
+		case FORMAT_BIN:
+			memset(&r, 0, sizeof(r));
+			r.t_us = t;
+			for (a = 0; a < NUM_AXES; a++)
+			{
+				r.axis[a] = s->axis[a][j];
+			}
+			r.dev = out->dev;
+			r.updated = s->updated[j];
+			if (fwrite(&r, sizeof(r), 1, out->f) != 1)
+			{
+				return -1;
+			}
+			break;
+		case FORMAT_MSEED:
+			for (a = 0; a < NUM_AXES; a++)
+			{
+				if (mseed_put(out, &out->chan[a], t, s->axis[a][j]) != 0)
+				{
+					return -1;
+				}
+			}
+			break;
+		}
+	}
+	out->num_samples += s->count;
+
+	return 0;
+}
+
+/* Sample rate for miniSEED, from the recording or else from the samples. */
+static double sample_rate_of(colrec_t *c, uint64_t t0, uint64_t t1)
+{
+	colrec_iter_t it;
+	colrec_span_t s;
+	uint64_t n = 0;
+	uint64_t first = 0;
+	uint64_t last = 0;
+
+	if (c->hdr->sample_rate > 0)
+	{
+		return c->hdr->sample_rate;
+	}
+
+	colrec_iter_init(&it, c, t0, t1);
+	while (colrec_iter_next(&it, &s) > 0)
+	{
+		if (s.count == 0)
+		{
+			continue;
+		}
+		if (n == 0)
+		{
+			first = s.t[0];
+		}
+		last = s.t[s.count - 1];
+		n += s.count;
+	}
+
+	return (n > 1 && last > first) ? (n - 1)*1e6/(last - first) : 0;
+}
+
+static int extract_piece(output_t *out, const piece_t *p, uint64_t w0, uint64_t w1)
+{
+	colrec_t c;
+	colrec_iter_t it;
+	colrec_span_t s;
+	uint64_t t0, t1;
+	const char *base;
+	int r;
+	int err_code = 0;
+
+	/* the window in the time of the device */
+	t0 = ((int64_t)w0 > p->wall_offset_us) ? w0 - p->wall_offset_us : 0;
+	t1 = ((int64_t)w1 > p->wall_offset_us) ? w1 - p->wall_offset_us : 0;
+	if (t1 <= p->t_first || t0 > p->t_last)
+	{
+		return 0;
+	}
+
+	if (colrec_open(&c, p->path) != 0)
+	{
+		return -1;
+	}
+
+	/* the station is named after the device, e.g. js0 */
+	if (out->station[0] == '\0')
+	{
+		base = strrchr(c.hdr->device, '/');
+		base = (base != NULL) ? base + 1 : c.hdr->device;
+		snprintf(out->station, sizeof(out->station), "%.5s", (*base != '\0') ? base : out->name);
+	}
+
+	if (out->format == FORMAT_MSEED && out->rate == 0)
+	{
+		out->rate = sample_rate_of(&c, t0, t1);
+		if (out->rate <= 0)
+		{
+			fprintf(stderr, "The sample rate of %s isn't known.\n", p->path);
+			colrec_close(&c);
+			return -1;
+		}
+		out->period_us = llround(1e6/out->rate);
+		out->chan[0].channel[0] = out->chan[1].channel[0] = out->chan[2].channel[0] =
+			(out->rate >= 80) ? 'H' : 'B';
+	}
+
+	colrec_iter_init(&it, &c, t0, t1);
+	while ((r = colrec_iter_next(&it, &s)) > 0)
+	{
+		if (put_samples(out, &s, p->wall_offset_us) != 0)
+		{
+			err_code = -1;
+			break;
+		}
+	}
+	if (r < 0)
+	{
+		err_code = -1;
+	}
+	colrec_close(&c);
+
+	return err_code;
+}
+
+static char *join(const char *dir, const char *name)
+{
+	char *path = malloc(strlen(dir) + strlen(name) + 2);
+
+	if (path != NULL)
+	{
+		sprintf(path, "%s/%s", dir, name);
+	}
+
+	return path;
+}
+
+/* Reads the time span of a recording that has no index entry. Like a
+ * segment, a recording is assumed to have been created when its first
+ * sample arrived. */
+static int piece_of(const char *path, piece_t *p)
+{
+	colrec_t c;
+
+	memset(p, 0, sizeof(*p));
+	if (colrec_open(&c, path) != 0)
+	{
+		return -1;
+	}
+	if (c.num_blocks > 0)
+	{
+		p->t_first = c.index[0].t_first;
+		p->t_last = c.index[c.num_blocks - 1].t_last;
+	}
+	p->wall_offset_us = (int64_t)c.hdr->created_us - (int64_t)p->t_first;
+	if (c.num_samples == 0)
+	{
+		colrec_close(&c);
+		return -1;
+	}
+	colrec_close(&c);
+
+	p->path = strdup(path);
+	if (p->path == NULL)
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+static int add_piece(piece_t **pieces, size_t *n, const piece_t *p)
+{
+	piece_t *more;
+
+	if ((*n & 63) == 0)
+	{
+		more = realloc(*pieces, (*n + 64)*sizeof(piece_t));
+		if (more == NULL)
+		{
+			return -1;
+		}
+		*pieces = more;
+	}
+	(*pieces)[(*n)++] = *p;
+
+	return 0;
+}
+
+/* Collects the segments of a daemon mode directory that overlap the window:
+ * the ones in the index, and the ones still being written, which have no
+ * entry yet. */
+static int find_pieces(const char *dir, uint64_t w0, uint64_t w1, piece_t **pieces, size_t *n)
+{
+	segidx_entry_t *entries;
+	size_t num_entries;
+	struct dirent *de;
+	DIR *d;
+	piece_t p;
+	size_t i, len;
+	char *path;
+	int err_code = 0;
+
+	if (segidx_read(dir, &entries, &num_entries) != 0)
+	{
+		return -1;
+	}
+
+	for (i = 0; i < num_entries && err_code == 0; i++)
+	{
+		if (entries[i].num_samples == 0 ||
+		    (int64_t)(entries[i].t_last + 1) + entries[i].wall_offset_us <= (int64_t)w0 ||
+		    (int64_t)entries[i].t_first + entries[i].wall_offset_us >= (int64_t)w1)
+		{
+			continue;
+		}
+		p.path = join(dir, entries[i].name);
+		p.wall_offset_us = entries[i].wall_offset_us;
+		p.t_first = entries[i].t_first;
+		p.t_last = entries[i].t_last;
+		if (p.path == NULL || add_piece(pieces, n, &p) != 0)
+		{
+			free(p.path);
+			err_code = -1;
+		}
+	}
+
+	d = opendir(dir);
+	if (d == NULL)
+	{
+		fprintf(stderr, "Couldn't open %s: %s.\n", dir, strerror(errno));
+		err_code = -1;
+	}
+	while (err_code == 0 && (de = readdir(d)) != NULL)
+	{
+		len = strlen(de->d_name);
+		if (len < 5 || strcmp(de->d_name + len - 4, ".jsc") != 0)
+		{
+			continue;
+		}
+		for (i = 0; i < num_entries; i++)
+		{
+			if (strncmp(entries[i].name, de->d_name, sizeof(entries[i].name)) == 0)
+			{
+				break;
+			}
+		}
+		if (i < num_entries)
+		{
+			continue;
+		}
+		/* an empty or just created segment has nothing to read yet */
+		path = join(dir, de->d_name);
+		if (path != NULL && piece_of(path, &p) == 0 && add_piece(pieces, n, &p) != 0)
+		{
+			free(p.path);
+			err_code = -1;
+		}
+		free(path);
+	}
+	if (d != NULL)
+	{
+		closedir(d);
+	}
+	free(entries);
+
+	return err_code;
+}
+
+static int extract_source(const char *src, int dev, const char *prefix, int format,
+                          const char *network, uint64_t w0, uint64_t w1)
+{
+	output_t out;
+	rawrec_header_t hdr;
+	piece_t *pieces = NULL;
+	size_t num_pieces = 0;
+	piece_t p;
+	struct stat st;
+	char name[64];
+	char *path = NULL;
+	const char *base;
+	size_t len;
+	size_t i;
+	int a;
+	int err_code = 0;
+
+	if (stat(src, &st) != 0)
+	{
+		fprintf(stderr, "Couldn't open %s: %s.\n", src, strerror(errno));
+		return -1;
+	}
+
+	/* name of the device, e.g. js0 for data/js0/ or data/js0.jsc */
+	len = strlen(src);
+	while (len > 1 && src[len - 1] == '/')
+	{
+		len--;
+	}
+	for (base = src + len; base > src && base[-1] != '/'; base--)
+		;
+	len -= base - src;
+	if (!S_ISDIR(st.st_mode) && len > 4 && strncmp(base + len - 4, ".jsc", 4) == 0)
+	{
+		len -= 4;
+	}
+	snprintf(name, sizeof(name), "%.*s", (int)len, base);
+
+	if (S_ISDIR(st.st_mode))
+	{
+		err_code = find_pieces(src, w0, w1, &pieces, &num_pieces);
+	}
+	else if (piece_of(src, &p) != 0 || add_piece(&pieces, &num_pieces, &p) != 0)
+	{
+		fprintf(stderr, "%s is not a columnar recording with samples.\n", src);
+		err_code = -1;
+	}
+
+	memset(&out, 0, sizeof(out));
+	out.format = format;
+	out.name = name;
+	snprintf(out.network, sizeof(out.network), "%.2s", network);
+	snprintf(out.chan[0].channel, sizeof(out.chan[0].channel), "BN1");
+	snprintf(out.chan[1].channel, sizeof(out.chan[1].channel), "BN2");
+	snprintf(out.chan[2].channel, sizeof(out.chan[2].channel), "BNZ");
+
+	if (err_code == 0)
+	{
+		path = malloc(strlen(prefix) + strlen(name) + 8);
+		if (path == NULL)
+		{
+			err_code = -1;
+		}
+		else
+		{
+			sprintf(path, "%s%s.%s", prefix, name, format_ext[format]);
+			out.f = fopen(path, "wb");
+			if (out.f == NULL)
+			{
+				fprintf(stderr, "Couldn't open %s: %s.\n", path, strerror(errno));
+				err_code = -1;
+			}
+		}
+	}
+
+	if (err_code == 0 && format == FORMAT_BIN)
+	{
+		memset(&hdr, 0, sizeof(hdr));
+		memcpy(hdr.magic, RAWREC_MAGIC, sizeof(hdr.magic));
+		hdr.record_size = sizeof(rawrec_t);
+		if (fwrite(&hdr, sizeof(hdr), 1, out.f) != 1)
+		{
+			err_code = -1;
+		}
+	}
+	out.dev = dev;
+
+	for (i = 0; i < num_pieces && err_code == 0; i++)
+	{
+		if (extract_piece(&out, &pieces[i], w0, w1) != 0)
+		{
+			fprintf(stderr, "Couldn't read %s.\n", pieces[i].path);
+			err_code = -1;
+		}
+	}
+	for (a = 0; a < NUM_AXES && err_code == 0; a++)
+	{
+		err_code = mseed_flush(&out, &out.chan[a]);
+	}
+
+	if (out.f != NULL && fclose(out.f) != 0)
+	{
+		err_code = -1;
+	}
+	if (err_code == 0)
+	{
+		fprintf(stderr, "%s: %llu samples written to %s.\n", src,
+		        (unsigned long long)out.num_samples, path);
+	}
+
+	for (i = 0; i < num_pieces; i++)
+	{
+		free(pieces[i].path);
+	}
+	free(pieces);
+	free(path);
+
+	return err_code;
+}
+
+int main(int argc, char **argv)
+{
+	const char *prefix = "";
+	const char *network = "XX";
+	int format = FORMAT_CSV;
+	uint64_t start = 0;
+	uint64_t end = 0;
+	uint64_t center = 0;
+	uint64_t len_us = 10000000;
+	int have_start = 0;
+	int have_end = 0;
+	int have_center = 0;
+	double secs;
+	char *p;
+	int opt;
+	int i;
+	int err_code = 0;
+
+	while ((opt = getopt(argc, argv, "s:e:a:d:f:o:N:")) != -1)
+	{
+		switch (opt)
+		{
+		case 's':
+		case 'e':
+		case 'a':
+			if (parse_time(optarg, (opt == 's') ? &start : (opt == 'e') ? &end : &center) != 0)
+			{
+				fprintf(stderr, "Invalid time %s, expected e.g. 2026-10-18T02:13:05.\n", optarg);
+				return -1;
+			}
+			have_start |= (opt == 's');
+			have_end |= (opt == 'e');
+			have_center |= (opt == 'a');
+			break;
+		case 'd':
+			secs = strtod(optarg, &p);
+			if (*p != '\0' || !(secs > 0))
+			{
+				fprintf(stderr, "Invalid window length.\n");
+				return -1;
+			}
+			len_us = (uint64_t)llround(secs*1e6);
+			break;
+		case 'f':
+			for (format = 0; format <= FORMAT_MSEED; format++)
+			{
+				if (strcmp(optarg, format_ext[format]) == 0)
+				{
+					break;
+				}
+			}
+			if (format > FORMAT_MSEED)
+			{
+				fprintf(stderr, "Invalid output format.\n");
+				return -1;
+			}
+			break;
+		case 'o':
+			prefix = optarg;
+			break;
+		case 'N':
+			network = optarg;
+			break;
+		default:
+			fprintf(stderr, "usage: %s (-s time [-e time] | -a time) [-d secs] [-f csv|bin|mseed] [-o prefix] [-N net] recording ...\n", argv[0]);
+			return -1;
+		}
+	}
+
+	if (have_center + have_start != 1 || optind >= argc)
+	{
+		fprintf(stderr, "usage: %s (-s time [-e time] | -a time) [-d secs] [-f csv|bin|mseed] [-o prefix] [-N net] recording ...\n", argv[0]);
+		return -1;
+	}
+	if (have_center)
+	{
+		start = (center > len_us/2) ? center - len_us/2 : 0;
+	}
+	if (!have_end)
+	{
+		end = start + len_us;
+	}
+	if (end <= start)
+	{
+		fprintf(stderr, "The window ends before it starts.\n");
+		return -1;
+	}
+
+	for (i = optind; i < argc; i++)
+	{
+		err_code |= extract_source(argv[i], i - optind, prefix, format, network, start, end);
+	}
+
+	return err_code;
+}
@@ -0,0 +1,170 @@
+/* Radix-2 FFT of real data. See fft.h.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fft.h"
+
+typedef double v4d __attribute__((vector_size(32)));
+
+int fft_init(fft_t *f, size_t n)
+{
+	size_t h, j, k, bits;
+
+	memset(f, 0, sizeof(*f));
+	if (n < 4 || (n & (n - 1)) != 0)
+	{
+		return -1;
+	}
+	f->n = n;
+	f->m = n/2;
+
+	f->rev = malloc(f->m*sizeof(size_t));
+	f->wr = malloc(f->m*sizeof(double));
+	f->wi = malloc(f->m*sizeof(double));
+	f->ur = malloc((f->m + 1)*sizeof(double));
+	f->ui = malloc((f->m + 1)*sizeof(double));
+	f->re = malloc(f->m*sizeof(double));
+	f->im = malloc(f->m*sizeof(double));
+	if (f->rev == NULL || f->wr == NULL || f->wi == NULL || f->ur == NULL || f->ui == NULL ||
+	    f->re == NULL || f->im == NULL)
+	{
+		fft_free(f);
+		return -1;
+	}
+
+	for (bits = 0; ((size_t)1 << bits) < f->m; bits++)
+		;
+	for (k = 0; k < f->m; k++)
+	{
+		f->rev[k] = 0;
+		for (j = 0; j < bits; j++)
+		{
+			f->rev[k] |= ((k >> j) & 1) << (bits - 1 - j);
+		}
+	}
+
+	/* the twiddles of the pass with butterflies h apart start at h - 1 */
+	for (h = 1; h < f->m; h *= 2)
+	{
+		for (j = 0; j < h; j++)
+		{
+			f->wr[h - 1 + j] = cos(-M_PI*j/h);
+			f->wi[h - 1 + j] = sin(-M_PI*j/h);
+		}
+	}
+	for (k = 0; k <= f->m; k++)
+	{
+		f->ur[k] = cos(-2*M_PI*k/n);
+		f->ui[k] = sin(-2*M_PI*k/n);
+	}
+
+	return 0;
+}
+
+void fft_free(fft_t *f)
+{
+	free(f->rev);
+	free(f->wr);
+	free(f->wi);
+	free(f->ur);
+	free(f->ui);
+	free(f->re);
+	free(f->im);
+	memset(f, 0, sizeof(*f));
+}
+
+static void pass(double *re, double *im, const double *wr, const double *wi, size_t m, size_t h)
+{
+	size_t g, j;
+	double tr, ti;
+
+	for (g = 0; g < m; g += 2*h)
+	{
+		for (j = 0; j < h; j++)
+		{
+			tr = re[g + h + j]*wr[j] - im[g + h + j]*wi[j];
+			ti = re[g + h + j]*wi[j] + im[g + h + j]*wr[j];
+			re[g + h + j] = re[g + j] - tr;
+			im[g + h + j] = im[g + j] - ti;
+			re[g + j] += tr;
+			im[g + j] += ti;
+		}
+	}
+}
+
+static void pass4(double *re, double *im, const double *wr, const double *wi, size_t m, size_t h)
+{
+	size_t g, j;
+	v4d ar, ai, br, bi, w_r, w_i, tr, ti;
+
+	for (g = 0; g < m; g += 2*h)
+	{
+		for (j = 0; j < h; j += 4)
+		{
+			memcpy(&ar, re + g + j, sizeof(ar));
+			memcpy(&ai, im + g + j, sizeof(ai));
+			memcpy(&br, re + g + h + j, sizeof(br));
+			memcpy(&bi, im + g + h + j, sizeof(bi));
+			memcpy(&w_r, wr + j, sizeof(w_r));
+			memcpy(&w_i, wi + j, sizeof(w_i));
+			tr = br*w_r - bi*w_i;
+			ti = br*w_i + bi*w_r;
+			br = ar - tr;
+			bi = ai - ti;
+			ar += tr;
+			ai += ti;
+			memcpy(re + g + j, &ar, sizeof(ar));
+			memcpy(im + g + j, &ai, sizeof(ai));
+			memcpy(re + g + h + j, &br, sizeof(br));
+			memcpy(im + g + h + j, &bi, sizeof(bi));
+		}
+	}
+}
+
+/* Squared magnitude of the n/2 + 1 bins of the transform of the n values
+ * in x. */
+void fft_power(fft_t *f, const double *x, double *power)
+{
+	double *re = f->re;
+	double *im = f->im;
+	size_t m = f->m;
+	size_t h, k;
+	double zr, zi, cr, ci, er, ei, o_r, o_i, xr, xi;
+
+	for (k = 0; k < m; k++)
+	{
+		re[f->rev[k]] = x[2*k];
+		im[f->rev[k]] = x[2*k + 1];
+	}
+
+	for (h = 1; h < m; h *= 2)
+	{
+		if (h >= 4)
+		{
+			pass4(re, im, f->wr + h - 1, f->wi + h - 1, m, h);
+		}
+		else
+		{
+			pass(re, im, f->wr + h - 1, f->wi + h - 1, m, h);
+		}
+	}
+
+	/* untangle the even and odd values */
+	for (k = 0; k <= m; k++)
+	{
+		zr = re[k % m];
+		zi = im[k % m];
+		cr = re[(m - k) % m];
+		ci = -im[(m - k) % m];
+		er = (zr + cr)/2;
+		ei = (zi + ci)/2;
+		o_r = (zi - ci)/2;
+		o_i = -(zr - cr)/2;
+		xr = er + f->ur[k]*o_r - f->ui[k]*o_i;
+		xi = ei + f->ur[k]*o_i + f->ui[k]*o_r;
+		power[k] = xr*xr + xi*xi;
+	}
+}
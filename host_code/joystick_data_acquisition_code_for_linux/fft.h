@@ -0,0 +1,31 @@
+/* Radix-2 FFT of real data.
+ *
+ * A real sequence of n values is transformed as a complex sequence of n/2
+ * values, which is then untangled into the n/2 + 1 bins of the real
+ * transform. The complex transform keeps the real and imaginary parts in
+ * separate arrays and stores the twiddle factors of each pass one after
+ * another, so the butterflies of every pass but the first two run over
+ * contiguous memory and are done four at a time with the vector types of
+ * gcc, which compile to SSE2/AVX on x86 and NEON on ARM.
+ */
+
+#ifndef FFT_H
+#define FFT_H
+
+#include <stddef.h>
+
+typedef struct
+{
+	size_t n;                 /* real values, a power of two >= 4 */
+	size_t m;                 /* complex values, n/2 */
+	size_t *rev;              /* bit reversed indexes of m */
+	double *wr, *wi;          /* twiddles of the complex passes */
+	double *ur, *ui;          /* twiddles of the real untangling */
+	double *re, *im;          /* work space */
+} fft_t;
+
+int fft_init(fft_t *f, size_t n);
+void fft_free(fft_t *f);
+void fft_power(fft_t *f, const double *x, double *power);
+
+#endif
@@ -0,0 +1,346 @@
+/* Tests of the raw HID source in src_hidraw.c, which is included here so
+ * its static functions can be reached. Built and run with
+ *
+ *   make check
+ *
+ * The report descriptors are those of the firmware in uc_code, written
+ * with the same LUFA macros. The tests check that
+ *   - each descriptor gives the size of its report and whether its axes
+ *     are signed, and picks the matching layout: 7 bytes, 19 bytes with
+ *     the peaks, unsigned or high resolution, and 32 bytes with the sums
+ *     of squares,
+ *   - a descriptor cut off in the middle of an item isn't read past,
+ *   - each decoder reads the axes, peaks, count and sums of squares from
+ *     the right bytes, at the ends of their ranges,
+ *   - reports read together are spaced HIDRAW_REPORT_US apart back from
+ *     the last, however many there are, or evenly since the last report
+ *     when that would go back past it.
+ * The reports are read from a SOCK_SEQPACKET socket, which like hidraw
+ * hands out one report per read.
+ */
+
+#include <sys/socket.h>
+
+#include "src_hidraw.c"
+#include "LUFA/Drivers/USB/Class/Common/HIDReportData.h"
+
+static int failures;
+
+static sample_t emitted[1000];
+static size_t num_emitted;
+
+static void check(int ok, const char *what)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "FAIL: %s\n", what);
+		failures++;
+	}
+}
+
+/* stands in for the one in acq.c */
+int device_emit(device_t *d, const sample_t *samples, size_t n)
+{
+	(void)d;
+	if (num_emitted + n > sizeof(emitted)/sizeof(emitted[0]))
+	{
+		return -1;
+	}
+	memcpy(emitted + num_emitted, samples, n*sizeof(*samples));
+	num_emitted += n;
+
+	return 0;
+}
+
+#define AXES_ITEMS \
+	HID_RI_USAGE_PAGE(8, 0x01), \
+	HID_RI_USAGE(8, 0x04), \
+	HID_RI_COLLECTION(8, 0x01), \
+	    HID_RI_USAGE(8, 0x01), \
+	    HID_RI_COLLECTION(8, 0x00), \
+	        HID_RI_USAGE(8, 0x30), \
+	        HID_RI_USAGE(8, 0x31), \
+	        HID_RI_USAGE(8, 0x32)
+
+#define UNSIGNED_ITEMS \
+	        HID_RI_LOGICAL_MINIMUM(8, 0), \
+	        HID_RI_LOGICAL_MAXIMUM(16, 0x03ff), \
+	        HID_RI_PHYSICAL_MINIMUM(8, 0x00), \
+	        HID_RI_PHYSICAL_MAXIMUM(16, 0x03ff)
+
+#define HIRES_ITEMS \
+	        HID_RI_LOGICAL_MINIMUM(16, 0x8000), \
+	        HID_RI_LOGICAL_MAXIMUM(16, 0x7fff), \
+	        HID_RI_PHYSICAL_MINIMUM(16, 0x8000), \
+	        HID_RI_PHYSICAL_MAXIMUM(16, 0x7fff)
+
+#define PEAK_USAGES \
+	        HID_RI_USAGE(8, 0x33), \
+	        HID_RI_USAGE(8, 0x34), \
+	        HID_RI_USAGE(8, 0x35), \
+	        HID_RI_USAGE(8, 0x36), \
+	        HID_RI_USAGE(8, 0x37), \
+	        HID_RI_USAGE(8, 0x38)
+
+#define INPUT_ITEMS(count) \
+	        HID_RI_REPORT_SIZE(8, 0x10), \
+	        HID_RI_REPORT_COUNT(8, count), \
+	        HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE), \
+	    HID_RI_END_COLLECTION(0)
+
+#define BUTTON_ITEMS \
+	    HID_RI_USAGE_PAGE(8, 0x09), \
+	    HID_RI_USAGE_MINIMUM(8, 0x01), \
+	    HID_RI_USAGE_MAXIMUM(8, 0x08), \
+	    HID_RI_LOGICAL_MINIMUM(8, 0x00), \
+	    HID_RI_LOGICAL_MAXIMUM(8, 0x01), \
+	    HID_RI_REPORT_COUNT(8, 0x08), \
+	    HID_RI_REPORT_SIZE(8, 0x01), \
+	    HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE)
+
+#define SUMSQ_ITEMS \
+	    HID_RI_USAGE_PAGE(16, 0xFF00), \
+	    HID_RI_USAGE(8, 0x01), \
+	    HID_RI_LOGICAL_MINIMUM(8, 0x00), \
+	    HID_RI_LOGICAL_MAXIMUM(16, 0x00ff), \
+	    HID_RI_REPORT_SIZE(8, 0x08), \
+	    HID_RI_REPORT_COUNT(8, 0x01), \
+	    HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE), \
+	    HID_RI_USAGE(8, 0x02), \
+	    HID_RI_USAGE(8, 0x03), \
+	    HID_RI_USAGE(8, 0x04), \
+	    HID_RI_LOGICAL_MAXIMUM(32, 0x7fffffff), \
+	    HID_RI_REPORT_SIZE(8, 0x20), \
+	    HID_RI_REPORT_COUNT(8, 0x03), \
+	    HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE)
+
+/* before peak-hold */
+static const uint8_t desc_7[] =
+{
+	AXES_ITEMS, UNSIGNED_ITEMS, INPUT_ITEMS(3), BUTTON_ITEMS, HID_RI_END_COLLECTION(0)
+};
+
+/* moving_average with HIRES, before peak-hold */
+static const uint8_t desc_7_hires[] =
+{
+	AXES_ITEMS, HIRES_ITEMS, INPUT_ITEMS(3), BUTTON_ITEMS, HID_RI_END_COLLECTION(0)
+};
+
+/* no_filter, moving_average and chebyshev */
+static const uint8_t desc_19[] =
+{
+	AXES_ITEMS, PEAK_USAGES, UNSIGNED_ITEMS, INPUT_ITEMS(9), BUTTON_ITEMS, HID_RI_END_COLLECTION(0)
+};
+
+/* moving_average with HIRES */
+static const uint8_t desc_19_hires[] =
+{
+	AXES_ITEMS, PEAK_USAGES, HIRES_ITEMS, INPUT_ITEMS(9), BUTTON_ITEMS, HID_RI_END_COLLECTION(0)
+};
+
+/* chebyshev with REPORT_SUMSQ */
+static const uint8_t desc_32[] =
+{
+	AXES_ITEMS, PEAK_USAGES, UNSIGNED_ITEMS, INPUT_ITEMS(9), BUTTON_ITEMS, SUMSQ_ITEMS,
+	HID_RI_END_COLLECTION(0)
+};
+
+static const report_layout_t *layout_of(const uint8_t *d, int len, int size, int is_signed, const char *what)
+{
+	int input_bits;
+	int sign;
+
+	parse_descriptor(d, len, &input_bits, &sign);
+	check(input_bits == 8*size && sign == is_signed, what);
+
+	return find_layout(input_bits, sign);
+}
+
+static void test_descriptors(void)
+{
+	const report_layout_t *l;
+	int input_bits;
+	int sign;
+
+	l = layout_of(desc_7, sizeof(desc_7), 7, 0, "7 byte descriptor");
+	check(l != NULL && l->decode == decode_xyz_u16, "7 byte layout");
+	l = layout_of(desc_7_hires, sizeof(desc_7_hires), 7, 1, "7 byte high resolution descriptor");
+	check(l != NULL && l->decode == decode_xyz_s16, "7 byte high resolution layout");
+	l = layout_of(desc_19, sizeof(desc_19), 19, 0, "19 byte descriptor");
+	check(l != NULL && l->decode == decode_peaks_u16 && l->n_offset < 0, "19 byte layout");
+	l = layout_of(desc_19_hires, sizeof(desc_19_hires), 19, 1, "19 byte high resolution descriptor");
+	check(l != NULL && l->decode == decode_peaks_s16, "19 byte high resolution layout");
+	l = layout_of(desc_32, sizeof(desc_32), 32, 0, "32 byte descriptor");
+	check(l != NULL && l->decode == decode_sumsq_u16 && l->n_offset == 19, "32 byte layout");
+
+	check(find_layout(8*20, 0) == NULL, "an unknown report size has no layout");
+	check(find_layout(8*32, 1) == NULL, "signed sums of squares have no layout");
+
+	/* cut in the 32 bit logical maximum, before the last input item */
+	parse_descriptor(desc_32, sizeof(desc_32) - 10, &input_bits, &sign);
+	check(input_bits == 8*20, "a descriptor cut short is read up to the cut");
+	parse_descriptor(desc_32, 1, &input_bits, &sign);
+	check(input_bits == 0, "a descriptor of one byte");
+}
+
+static void put16(uint8_t *p, int v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+	put16(p, v & 0xffff);
+	put16(p + 2, v >> 16);
+}
+
+static void test_decoders(void)
+{
+	uint8_t r[32];
+	sample_t s;
+	int a;
+
+	memset(r, 0, sizeof(r));
+	put16(r, 0);
+	put16(r + 2, 1023);
+	put16(r + 4, 512);
+	r[6] = 0x5a;
+	memset(&s, 0, sizeof(s));
+	decode_xyz_u16(r, &s);
+	check(s.axis[0] == 0 && s.axis[1] == 1023 && s.axis[2] == 512 && s.updated == 0, "7 byte report");
+
+	put16(r, -32768);
+	put16(r + 2, 32767);
+	put16(r + 4, -1);
+	memset(&s, 0, sizeof(s));
+	decode_xyz_s16(r, &s);
+	check(s.axis[0] == -32768 && s.axis[1] == 32767 && s.axis[2] == -1, "7 byte high resolution report");
+
+	memset(&s, 0, sizeof(s));
+	decode_xyz_u16(r, &s);
+	check(s.axis[0] == 32768 && s.axis[2] == 65535, "unsigned axes aren't sign extended");
+
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		put16(r + 2*a, 500 + a);
+		put16(r + 6 + 2*a, 400 + a);
+		put16(r + 12 + 2*a, 600 + a);
+	}
+	r[18] = 0x01;
+	memset(&s, 0, sizeof(s));
+	decode_peaks_u16(r, &s);
+	check(s.axis[1] == 501 && s.min[0] == 400 && s.min[2] == 402 && s.max[0] == 600 && s.max[2] == 602 &&
+	      s.updated == SAMPLE_PEAKS, "19 byte report");
+
+	put16(r + 6, -20000);
+	put16(r + 12, 20000);
+	memset(&s, 0, sizeof(s));
+	decode_peaks_s16(r, &s);
+	check(s.min[0] == -20000 && s.max[0] == 20000 && s.updated == SAMPLE_PEAKS, "19 byte high resolution report");
+
+	put16(r + 6, 400);
+	put16(r + 12, 600);
+	r[19] = 255;
+	put32(r + 20, 0);
+	put32(r + 24, 0x7fffffff);
+	put32(r + 28, 255u*1023*1023);
+	memset(&s, 0, sizeof(s));
+	decode_sumsq_u16(r, &s);
+	check(s.axis[0] == 500 && s.min[0] == 400 && s.max[0] == 600 && s.readings == 255 &&
+	      s.sumsq[0] == 0 && s.sumsq[1] == 0x7fffffff && s.sumsq[2] == 255u*1023*1023 &&
+	      s.updated == (SAMPLE_PEAKS | SAMPLE_SUMSQ), "32 byte report");
+}
+
+static int spaced(size_t first, size_t n, uint64_t last, uint64_t period)
+{
+	size_t k;
+	int ok = (num_emitted == first + n);
+
+	for (k = 0; ok && k < n; k++)
+	{
+		ok = (emitted[first + k].t_us == last - (n - 1 - k)*period);
+	}
+
+	return ok;
+}
+
+static void test_stamps(void)
+{
+	device_t d;
+	hidraw_t *hr = calloc(1, sizeof(*hr));
+	uint8_t r[19];
+	struct timespec ts;
+	uint64_t before, after;
+	int sv[2];
+	int i;
+
+	memset(&d, 0, sizeof(d));
+	d.fd = -1;
+	d.priv = hr;
+	hr->layout = find_layout(8*19, 0);
+
+	num_emitted = 0;
+	check(emit_reports(&d, hr, 5, 1000000) == 0 && spaced(0, 5, 1000000, HIDRAW_REPORT_US),
+	      "reports read together are backdated by the poll interval");
+	check(emit_reports(&d, hr, 1, 1000000 + HIDRAW_REPORT_US) == 0 && spaced(5, 1, 1000000 + HIDRAW_REPORT_US, 0),
+	      "a report on its own gets the time it was read");
+	check(emit_reports(&d, hr, 4, 1000000 + 3*HIDRAW_REPORT_US) == 0 &&
+	      spaced(6, 4, 1000000 + 3*HIDRAW_REPORT_US, HIDRAW_REPORT_US/2),
+	      "reports are spaced evenly when backdating would go past the last one");
+
+	/* a backlog longer than the kernel's queue, read from a socket, and a
+	 * report of the wrong size */
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0, sv) != 0)
+	{
+		check(0, "socketpair");
+		free(hr);
+		return;
+	}
+	memset(r, 0, sizeof(r));
+	for (i = 0; i < 200; i++)
+	{
+		put16(r, i);
+		check(write(sv[1], r, sizeof(r)) == sizeof(r), "writing a report");
+	}
+	check(write(sv[1], r, 7) == 7, "writing a report");
+	d.fd = sv[0];
+	d.index = 3;
+	hr->t_last = 0;
+	num_emitted = 0;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	before = (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+	check(hidraw_drain(&d) == 0, "hidraw_drain");
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	after = (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+
+	check(num_emitted == 200, "a report of the wrong size is skipped");
+	check(num_emitted == 200 && emitted[199].t_us >= before && emitted[199].t_us <= after,
+	      "the last report of a backlog gets the time it was read");
+	check(num_emitted == 200 && spaced(0, 200, emitted[199].t_us, HIDRAW_REPORT_US),
+	      "a backlog longer than a batch is spaced by the poll interval");
+	check(num_emitted == 200 && emitted[0].axis[0] == 0 && emitted[199].axis[0] == 199 && emitted[7].dev == 3 &&
+	      emitted[7].updated == (((1 << NUM_AXES) - 1) | SAMPLE_PEAKS), "the reports are decoded in order");
+	check(hr->num_reports == 200 && hr->num_readings == 200, "the reports are counted");
+
+	close(sv[1]);
+	check(hidraw_drain(&d) != 0, "the device going away ends the drain");
+	close(sv[0]);
+	free(hr);
+}
+
+int main(void)
+{
+	test_descriptors();
+	test_decoders();
+	test_stamps();
+
+	if (failures > 0)
+	{
+		fprintf(stderr, "hidraw_test: %d check(s) failed.\n", failures);
+		return 1;
+	}
+	fprintf(stdout, "hidraw_test: all checks passed.\n");
+
+	return 0;
+}
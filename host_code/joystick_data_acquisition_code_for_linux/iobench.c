@@ -0,0 +1,270 @@
+/* Compares the ways record_joystick_data can write its recordings (see
+ * aio.h). A number of streams are written at once, a block at a time and
+ * round robin the way the writer thread does it, through bufwriter with
+ * each of the write backends in turn. For each one it prints a line of
+ * name=value pairs:
+ *
+ *   backend   the backend that actually ran (uring falls back to threads)
+ *   streams, mib_per_stream, buf_kib, fsync
+ *             the settings
+ *   seconds   time to write and close every stream
+ *   mib_s     throughput
+ *   syscalls  system calls made to write and fsync, io_uring_enter included
+ *   writes, fsyncs
+ *   max_stall_ms, mean_stall_us
+ *             longest and mean time a write of one block held up the
+ *             caller, i.e. how long the reading thread would have been
+ *             kept from the joysticks
+ *
+ * The files are written to a directory (default the current one) and
+ * removed afterwards. Use the filesystem and card that will hold the
+ * recordings, since that is what the fsync policy is about.
+ *
+ * To compile: make iobench
+ * To run: ./iobench
+ *         ./iobench -m 16 -n 64 -s flush -d /media/sdcard
+ * Options:
+ *   -m N        number of streams (default 8)
+ *   -n MiB      written to each stream (default 16)
+ *   -k bytes    size of the blocks written (default 4096, a columnar block)
+ *   -b KiB      size of the write buffer (default 1024)
+ *   -s policy   fsync policy: never, flush or an interval in ms (default
+ *               flush)
+ *   -a backend  sync, uring or threads, may be given more than once
+ *               (default all three)
+ *   -d dir      directory to write to
+ *
+ * license: Unknown
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "aio.h"
+#include "bufwriter.h"
+
+#define MAX_BACKENDS 8
+
+static int num_streams = 8;
+static long mib_per_stream = 16;
+static size_t block_size = 4096;
+static char *dir = ".";
+static bufwriter_cfg_t cfg = BUFWRITER_DEFAULT_CFG;
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static char *stream_path(int i)
+{
+	char *path = malloc(strlen(dir) + 32);
+
+	if (path != NULL)
+	{
+		sprintf(path, "%s/iobench%d.tmp", dir, i);
+	}
+	return path;
+}
+
+static int run(int backend, const char *fsync_name)
+{
+	bufwriter_t *w = calloc(num_streams, sizeof(bufwriter_t));
+	char *block = malloc(block_size);
+	char *path;
+	uint64_t num_blocks = ((uint64_t)mib_per_stream << 20)/block_size;
+	uint64_t b;
+	double t0, t1, t, stall, max_stall = 0, sum_stall = 0;
+	int used = AIO_SYNC;
+	int i, opened = 0;
+	int err_code = 0;
+
+	if (w == NULL || block == NULL)
+	{
+		free(w);
+		free(block);
+		return -1;
+	}
+	for (i = 0; (size_t)i < block_size; i++)
+	{
+		block[i] = rand();
+	}
+
+	memset(&aio_stats, 0, sizeof(aio_stats));
+	if (backend != AIO_SYNC)
+	{
+		used = aio_init(backend, cfg.buf_size, 3*num_streams + 2);
+		if (used < 0)
+		{
+			fprintf(stderr, "Couldn't start the %s write backend.\n", aio_backend_name(backend));
+			free(w);
+			free(block);
+			return -1;
+		}
+	}
+
+	t0 = now_s();
+	for (i = 0; i < num_streams && err_code == 0; i++)
+	{
+		path = stream_path(i);
+		if (path == NULL || bufwriter_open(&w[i], path, &cfg) != 0)
+		{
+			err_code = -1;
+		}
+		else
+		{
+			opened++;
+		}
+		free(path);
+	}
+
+	for (b = 0; b < num_blocks && err_code == 0; b++)
+	{
+		for (i = 0; i < num_streams; i++)
+		{
+			t = now_s();
+			err_code |= bufwriter_write(&w[i], block, block_size);
+			err_code |= bufwriter_tick(&w[i]);
+			stall = now_s() - t;
+			sum_stall += stall;
+			if (stall > max_stall)
+			{
+				max_stall = stall;
+			}
+		}
+		aio_kick();
+	}
+
+	for (i = 0; i < opened; i++)
+	{
+		err_code |= bufwriter_close(&w[i]);
+	}
+	t1 = now_s();
+	aio_shutdown();
+
+	for (i = 0; i < opened; i++)
+	{
+		path = stream_path(i);
+		if (path != NULL)
+		{
+			unlink(path);
+		}
+		free(path);
+	}
+	free(w);
+	free(block);
+
+	if (err_code != 0)
+	{
+		fprintf(stderr, "Couldn't run the %s write backend.\n", aio_backend_name(backend));
+		return -1;
+	}
+
+	printf("backend=%s streams=%d mib_per_stream=%ld buf_kib=%zu fsync=%s seconds=%.3f mib_s=%.1f "
+	       "syscalls=%llu writes=%llu fsyncs=%llu max_stall_ms=%.3f mean_stall_us=%.2f\n",
+	       aio_backend_name(used), num_streams, mib_per_stream, cfg.buf_size/1024, fsync_name, t1 - t0,
+	       num_streams*(double)mib_per_stream/(t1 - t0), (unsigned long long)aio_stats.syscalls,
+	       (unsigned long long)aio_stats.writes, (unsigned long long)aio_stats.fsyncs, max_stall*1e3,
+	       sum_stall*1e6/(num_blocks*num_streams));
+	fflush(stdout);
+
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	int backends[MAX_BACKENDS];
+	int num_backends = 0;
+	const char *fsync_name = "flush";
+	int opt;
+	int i;
+	char *p;
+	long val;
+	int err_code = 0;
+
+	cfg.fsync_policy = FSYNC_ON_FLUSH;
+
+	while ((opt = getopt(argc, argv, "m:n:k:b:s:a:d:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'm':
+			num_streams = strtol(optarg, &p, 10);
+			if (*p != '\0' || num_streams < 1)
+			{
+				fprintf(stderr, "Invalid number of streams.\n");
+				return -1;
+			}
+			break;
+		case 'n':
+			mib_per_stream = strtol(optarg, &p, 10);
+			if (*p != '\0' || mib_per_stream < 1)
+			{
+				fprintf(stderr, "Invalid stream size.\n");
+				return -1;
+			}
+			break;
+		case 'k':
+			val = strtol(optarg, &p, 10);
+			if (*p != '\0' || val < 1)
+			{
+				fprintf(stderr, "Invalid block size.\n");
+				return -1;
+			}
+			block_size = val;
+			break;
+		case 'b':
+			val = strtol(optarg, &p, 10);
+			if (*p != '\0' || val < 1)
+			{
+				fprintf(stderr, "Invalid buffer size.\n");
+				return -1;
+			}
+			cfg.buf_size = val*1024;
+			break;
+		case 's':
+			if (parse_fsync_policy(optarg, &cfg) != 0)
+			{
+				fprintf(stderr, "Invalid fsync policy.\n");
+				return -1;
+			}
+			fsync_name = optarg;
+			break;
+		case 'a':
+			if (num_backends == MAX_BACKENDS || (backends[num_backends] = aio_backend_of(optarg)) < 0)
+			{
+				fprintf(stderr, "Invalid write backend.\n");
+				return -1;
+			}
+			num_backends++;
+			break;
+		case 'd':
+			dir = optarg;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-m streams] [-n MiB] [-k bytes] [-b KiB] [-s never|flush|ms] [-a sync|uring|threads] [-d dir]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	if (num_backends == 0)
+	{
+		backends[num_backends++] = AIO_SYNC;
+		backends[num_backends++] = AIO_URING;
+		backends[num_backends++] = AIO_THREADS;
+	}
+
+	for (i = 0; i < num_backends; i++)
+	{
+		err_code |= run(backends[i], fsync_name);
+	}
+
+	return err_code;
+}
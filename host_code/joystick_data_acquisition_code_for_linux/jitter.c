@@ -0,0 +1,113 @@
+/* Distribution of the time between arrivals. See jitter.h. */
+
+#include <math.h>
+#include <time.h>
+
+#include "jitter.h"
+
+uint64_t jitter_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+static int bucket_of(uint64_t v)
+{
+	int shift;
+
+	if (v < 2*JITTER_SUB)
+	{
+		return v;
+	}
+	if (v >> 32)
+	{
+		return JITTER_BUCKETS - 1;
+	}
+	shift = 63 - __builtin_clzll(v) - JITTER_SUB_BITS;
+	return 2*JITTER_SUB + (shift - 1)*JITTER_SUB + (int)(v >> shift) - JITTER_SUB;
+}
+
+/* smallest value that falls in bucket b, and the width of the bucket */
+static double bucket_low(int b, double *width)
+{
+	int shift;
+
+	if (b < 2*JITTER_SUB)
+	{
+		*width = 1;
+		return b;
+	}
+	shift = (b - 2*JITTER_SUB)/JITTER_SUB + 1;
+	*width = (double)(1ULL << shift);
+	return (double)((uint64_t)((b - 2*JITTER_SUB) % JITTER_SUB + JITTER_SUB) << shift);
+}
+
+/* Adds an arrival at t_us. The first one only starts the clock. */
+void jitter_add(jitter_t *j, uint64_t t_us)
+{
+	uint64_t d;
+
+	if (j->last_us != 0 && t_us >= j->last_us)
+	{
+		d = t_us - j->last_us;
+		j->buckets[bucket_of(d)]++;
+		j->count++;
+		j->sum += d;
+		j->sum2 += (double)d*d;
+		if (d > j->max_us)
+		{
+			j->max_us = d;
+		}
+	}
+	j->last_us = t_us;
+}
+
+/* Interval in us that a fraction p of the intervals don't exceed, taken as
+ * the middle of the bucket it falls in but never more than the longest. */
+double jitter_percentile(const jitter_t *j, double p)
+{
+	uint64_t rank = (uint64_t)ceil(p*j->count);
+	uint64_t seen = 0;
+	double low, width;
+	int b;
+
+	if (j->count == 0)
+	{
+		return 0;
+	}
+	if (rank == 0)
+	{
+		rank = 1;
+	}
+	for (b = 0; b < JITTER_BUCKETS; b++)
+	{
+		seen += j->buckets[b];
+		if (seen >= rank)
+		{
+			break;
+		}
+	}
+	low = bucket_low(b, &width);
+
+	return (width == 1) ? low : fmin(low + width/2, j->max_us);
+}
+
+void jitter_print(const jitter_t *j, const char *name, FILE *f)
+{
+	double mean, sd;
+
+	if (j->count == 0)
+	{
+		fprintf(f, "%s: no arrivals\n", name);
+		return;
+	}
+	mean = j->sum/j->count;
+	sd = sqrt(fmax(j->sum2/j->count - mean*mean, 0));
+	fprintf(f, "%s: %llu intervals between arrivals [ms]: mean %.3f, sd %.3f, "
+	        "median %.3f, 90%% %.3f, 99%% %.3f, 99.9%% %.3f, max %.3f\n",
+	        name, (unsigned long long)j->count, mean/1e3, sd/1e3,
+	        jitter_percentile(j, 0.5)/1e3, jitter_percentile(j, 0.9)/1e3,
+	        jitter_percentile(j, 0.99)/1e3, jitter_percentile(j, 0.999)/1e3, j->max_us/1e3);
+}
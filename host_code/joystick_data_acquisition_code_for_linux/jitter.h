@@ -0,0 +1,39 @@
+/* Distribution of the time between arrivals.
+ *
+ * Every time a device is found to have new samples the time since the last
+ * time is added to a histogram, so the report shows how regularly the
+ * reading thread got to the data, which is what scheduling, paging and
+ * load spoil. At 125 reports/s a well behaved recorder sees intervals
+ * close to 8 ms; long ones are the reader running late and are followed by
+ * short ones as it catches up.
+ *
+ * The buckets are exact up to 64 us and then 32 to an octave (about 3%
+ * wide) up to 2^32 us, so percentiles come out to within a bucket with no
+ * memory allocated and no time spent sorting.
+ */
+
+#ifndef JITTER_H
+#define JITTER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define JITTER_SUB_BITS 5
+#define JITTER_SUB (1 << JITTER_SUB_BITS)
+#define JITTER_BUCKETS (2*JITTER_SUB + (32 - JITTER_SUB_BITS - 1)*JITTER_SUB)
+
+typedef struct
+{
+	uint64_t last_us;         /* time of the previous arrival, 0 = none yet */
+	uint64_t count;
+	uint64_t max_us;
+	double sum, sum2;
+	uint64_t buckets[JITTER_BUCKETS];
+} jitter_t;
+
+uint64_t jitter_now_us(void);
+void jitter_add(jitter_t *j, uint64_t t_us);
+double jitter_percentile(const jitter_t *j, double p);
+void jitter_print(const jitter_t *j, const char *name, FILE *f);
+
+#endif
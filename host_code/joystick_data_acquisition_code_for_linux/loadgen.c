@@ -0,0 +1,791 @@
+/* Load generator for finding how many sensors one host can record.
+ *
+ * It creates virtual joysticks through /dev/uinput with the axes of the
+ * firmware's report descriptor (see Descriptors.c in uc_code): x, y and z
+ * from 0 to 1023 and 8 buttons, plus the min and max of each axis for the
+ * chebyshev firmware's peak hold layout (-l peak). The kernel then offers
+ * each one as /dev/input/eventN and /dev/input/jsN, exactly as it would a
+ * real sensor.
+ *
+ * Every device is driven with its own synthetic seismogram at the report
+ * rate: the resting values of a nunchuk with gaussian noise, earthquakes
+ * arriving at random with a P wave, mostly on z, followed a few seconds
+ * later by a larger and slower S wave, mostly on x and y, and, if asked
+ * for, glitches that look like the 0xFE spikes of the nunchuk had the
+ * firmware let them through.
+ *
+ * Given a recorder command after --, it runs the recorder against the
+ * first N devices for each N in the sweep, appending -M file and the
+ * device nodes to the command, stops it with SIGINT, and prints a line of
+ * name=value pairs per step:
+ *
+ *   devices, rate, seconds
+ *             the settings
+ *   sent      reports that changed an axis; the input layer passes nothing
+ *             on for a report that doesn't, so only these can be recorded
+ *   recorded  samples the recorder read (joystick_samples_total)
+ *   lost, loss_pct
+ *             sent but never recorded
+ *   missing   report periods the recorder saw skipped in the time stamps
+ *   dropped   samples its queues had no room for
+ *   recorder_cpu_pct, loadgen_cpu_pct
+ *             CPU time of the recorder and of this generator over the step
+ *   mean_arrival_ms, mean_write_us
+ *             mean time between the recorder's reads that found samples
+ *             and mean time its sinks took over a batch (see metrics.h)
+ *   late      periods the generator itself fell behind by, which make the
+ *             other numbers meaningless if there are many
+ *
+ * Without a command it just drives the devices, e.g. to watch them with
+ * joytestv2 or an already running recorder.
+ *
+ * Creating uinput devices needs write access to /dev/uinput (root, or a
+ * udev rule), and the uinput module.
+ *
+ * To compile: make loadgen
+ * To run: ./loadgen -n 4 -d 0          (four devices until interrupted)
+ *         ./loadgen -n 1,2,4,8,16,32,64 -d 30 -- ./record_joystick_data -n 0 -o /tmp/rec
+ *
+ * Options:
+ *   -n N[,N...] numbers of devices to sweep through (default 1)
+ *   -r rate     reports/s of every device (default 125)
+ *   -d secs     length of each step (default 10, 0 = until interrupted
+ *               without a command)
+ *   -i js|event which nodes are handed to the recorder (default event)
+ *   -l layout   basic (x, y, z, default) or peak (x, y, z, min, max)
+ *   -k N        samples the firmware takes per report (default 4), the
+ *               peak hold layout reports their min and max
+ *   -N counts   rms of the noise of each sample the firmware takes
+ *               (default 1.5)
+ *   -q N        earthquakes per minute on each device (default 1)
+ *   -A counts   peak of the S wave (default 60)
+ *   -g p        probability of a glitch in a report (default 0)
+ *   -s seed     for the random numbers (default 1)
+ *   -w secs     wait for the recorder to open the devices (default 1)
+ *   -M file     metrics file of the recorder (default loadgen.prom)
+ */
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+
+#define UINPUT_PATH "/dev/uinput"
+#define SYSFS_INPUT "/sys/devices/virtual/input"
+#define MAX_DEVICES 256
+#define MAX_STEPS 32
+#define MAX_AXES 9
+#define NUM_BUTTONS 8
+#define AXIS_MAX 1023
+#define NODE_WAIT_MS 2000
+#define NODE_PATH_SIZE (sizeof("/dev/input/") + 256)
+
+/* the firmware's VendorID and ProductID */
+#define VENDOR_ID 0x03EB
+#define PRODUCT_ID 0x2043
+
+#define LAYOUT_BASIC 0
+#define LAYOUT_PEAK 1
+
+/* The hid driver maps the report's usages X, Y, Z, Rx, Ry, Rz, Slider,
+ * Dial and Wheel to these. */
+static const int axis_code[MAX_AXES] =
+{
+	ABS_X, ABS_Y, ABS_Z, ABS_RX, ABS_RY, ABS_RZ, ABS_THROTTLE, ABS_RUDDER, ABS_WHEEL
+};
+
+/* a nunchuk lying flat reads about 1 g on z */
+static const double rest[3] = { 512, 512, 716 };
+
+typedef struct
+{
+	int fd;
+	char event_path[NODE_PATH_SIZE];
+	char js_path[NODE_PATH_SIZE];
+	int value[MAX_AXES];
+	int have_value;
+	uint64_t rng;
+
+	/* the earthquake in progress, if any */
+	double next_quake_s;
+	double p_s, s_s;          /* arrival times of the P and S waves */
+	double amp;
+	double phase[3];
+} vdev_t;
+
+static vdev_t devs[MAX_DEVICES];
+static int num_devs;
+static int layout = LAYOUT_BASIC;
+static int num_axes = 3;
+static double rate = 125;
+static int oversample = 4;
+static double noise = 1.5;
+static double quakes_per_min = 1;
+static double s_amp = 60;
+static double glitch_p = 0;
+static volatile sig_atomic_t stop_requested;
+
+static void handle_signal(int sig)
+{
+	(void)sig;
+	stop_requested = 1;
+}
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/* xorshift64*, so a seed gives the same seismograms on every machine */
+static double uniform(vdev_t *v)
+{
+	v->rng ^= v->rng >> 12;
+	v->rng ^= v->rng << 25;
+	v->rng ^= v->rng >> 27;
+	return ((v->rng*2685821657736338717ULL) >> 11)*(1.0/9007199254740992.0);
+}
+
+static double gaussian(vdev_t *v)
+{
+	double u = uniform(v);
+
+	return sqrt(-2*log(u > 0 ? u : 1e-300))*cos(2*M_PI*uniform(v));
+}
+
+static double exponential(vdev_t *v, double mean)
+{
+	return -mean*log(1 - uniform(v));
+}
+
+static void schedule_quake(vdev_t *v, double t)
+{
+	v->next_quake_s = (quakes_per_min > 0) ? t + exponential(v, 60/quakes_per_min) : INFINITY;
+}
+
+/* ground motion in counts on axis a at t seconds */
+static double seismogram(vdev_t *v, int a, double t)
+{
+	double x = 0;
+	double tau;
+
+	if (t >= v->next_quake_s)
+	{
+		v->p_s = v->next_quake_s;
+		v->s_s = v->p_s + 2 + 6*uniform(v);
+		v->amp = s_amp*(0.25 + 0.75*uniform(v));
+		v->phase[0] = 2*M_PI*uniform(v);
+		v->phase[1] = 2*M_PI*uniform(v);
+		v->phase[2] = 2*M_PI*uniform(v);
+		schedule_quake(v, t);
+	}
+
+	tau = t - v->p_s;
+	if (v->amp > 0 && tau >= 0 && tau < 20)
+	{
+		/* P wave, 6 Hz, a quarter of the S wave and mostly vertical */
+		x += v->amp*0.25*(a == 2 ? 1 : 0.3)*(1 - exp(-tau/0.1))*exp(-tau/3)*sin(2*M_PI*6*tau + v->phase[a]);
+	}
+	tau = t - v->s_s;
+	if (v->amp > 0 && tau >= 0 && tau < 30)
+	{
+		/* S wave, 2 Hz and mostly horizontal */
+		x += v->amp*(a == 2 ? 0.3 : 1)*(1 - exp(-tau/0.3))*exp(-tau/5)*sin(2*M_PI*2*tau + v->phase[a]);
+	}
+
+	return x;
+}
+
+static int clamp(double x)
+{
+	long i = lround(x);
+
+	return (i < 0) ? 0 : (i > AXIS_MAX) ? AXIS_MAX : (int)i;
+}
+
+/* Works out the next report of v at t and writes whatever changed.
+ * Returns 1 if it changed an axis, 0 if not and -1 if the write failed. */
+static int send_report(vdev_t *v, double t)
+{
+	struct input_event ev[MAX_AXES + 1];
+	int value[MAX_AXES];
+	double sum[3] = { 0, 0, 0 };
+	double x;
+	int lo[3] = { AXIS_MAX, AXIS_MAX, AXIS_MAX };
+	int hi[3] = { 0, 0, 0 };
+	int a, k, s;
+	int n = 0;
+
+	for (k = 0; k < oversample; k++)
+	{
+		for (a = 0; a < 3; a++)
+		{
+			x = rest[a] + noise*gaussian(v) + seismogram(v, a, t + k/(rate*oversample));
+			s = clamp(x);
+			sum[a] += s;
+			lo[a] = (s < lo[a]) ? s : lo[a];
+			hi[a] = (s > hi[a]) ? s : hi[a];
+		}
+	}
+	for (a = 0; a < 3; a++)
+	{
+		value[a] = clamp(sum[a]/oversample);
+		value[3 + a] = lo[a];
+		value[6 + a] = hi[a];
+	}
+
+	/* the bytes of a spike are 0xFE from byte 4 on, so z reads 0xFE << 2
+	 * and the low bits of x and y are set */
+	if (glitch_p > 0 && uniform(v) < glitch_p)
+	{
+		value[0] |= 3;
+		value[1] |= 3;
+		value[2] = (0xFE << 2) | 3;
+	}
+
+	memset(ev, 0, sizeof(ev));
+	for (a = 0; a < num_axes; a++)
+	{
+		if (!v->have_value || value[a] != v->value[a])
+		{
+			ev[n].type = EV_ABS;
+			ev[n].code = axis_code[a];
+			ev[n].value = value[a];
+			n++;
+			v->value[a] = value[a];
+		}
+	}
+	v->have_value = 1;
+	if (n == 0)
+	{
+		return 0;
+	}
+	ev[n].type = EV_SYN;
+	ev[n].code = SYN_REPORT;
+	n++;
+
+	if (write(v->fd, ev, n*sizeof(ev[0])) != (ssize_t)(n*sizeof(ev[0])))
+	{
+		return -1;
+	}
+
+	return 1;
+}
+
+/* Finds the event and joystick nodes the kernel made for v. */
+static int find_nodes(vdev_t *v)
+{
+	char sysname[32];
+	char dir_path[128];
+	struct dirent *e;
+	struct stat st;
+	DIR *dir;
+	int waited;
+
+	if (ioctl(v->fd, UI_GET_SYSNAME(sizeof(sysname)), sysname) < 0)
+	{
+		return -1;
+	}
+	snprintf(dir_path, sizeof(dir_path), "%s/%s", SYSFS_INPUT, sysname);
+
+	dir = opendir(dir_path);
+	if (dir == NULL)
+	{
+		return -1;
+	}
+	while ((e = readdir(dir)) != NULL)
+	{
+		if (strncmp(e->d_name, "event", 5) == 0)
+		{
+			snprintf(v->event_path, sizeof(v->event_path), "/dev/input/%s", e->d_name);
+		}
+		else if (strncmp(e->d_name, "js", 2) == 0)
+		{
+			snprintf(v->js_path, sizeof(v->js_path), "/dev/input/%s", e->d_name);
+		}
+	}
+	closedir(dir);
+
+	/* udev makes the nodes a moment after the device appears */
+	for (waited = 0; waited < NODE_WAIT_MS; waited += 10)
+	{
+		if (v->event_path[0] != 0 && stat(v->event_path, &st) == 0 &&
+		    (v->js_path[0] == 0 || stat(v->js_path, &st) == 0))
+		{
+			return 0;
+		}
+		usleep(10000);
+	}
+
+	return -1;
+}
+
+static int create_device(vdev_t *v, int index)
+{
+	struct uinput_setup setup;
+	struct uinput_abs_setup abs;
+	int a, b;
+
+	v->fd = open(UINPUT_PATH, O_WRONLY | O_NONBLOCK);
+	if (v->fd == -1)
+	{
+		fprintf(stderr, "Couldn't open %s: %s.\n", UINPUT_PATH, strerror(errno));
+		return -1;
+	}
+
+	/* BTN_TRIGGER and up are what makes the joystick driver take it */
+	ioctl(v->fd, UI_SET_EVBIT, EV_KEY);
+	for (b = 0; b < NUM_BUTTONS; b++)
+	{
+		ioctl(v->fd, UI_SET_KEYBIT, BTN_TRIGGER + b);
+	}
+	ioctl(v->fd, UI_SET_EVBIT, EV_ABS);
+	for (a = 0; a < num_axes; a++)
+	{
+		ioctl(v->fd, UI_SET_ABSBIT, axis_code[a]);
+		memset(&abs, 0, sizeof(abs));
+		abs.code = axis_code[a];
+		abs.absinfo.minimum = 0;
+		abs.absinfo.maximum = AXIS_MAX;
+		if (ioctl(v->fd, UI_ABS_SETUP, &abs) < 0)
+		{
+			fprintf(stderr, "Couldn't set up the axes: %s.\n", strerror(errno));
+			return -1;
+		}
+	}
+
+	memset(&setup, 0, sizeof(setup));
+	setup.id.bustype = BUS_USB;
+	setup.id.vendor = VENDOR_ID;
+	setup.id.product = PRODUCT_ID;
+	snprintf(setup.name, sizeof(setup.name), "Nunchuk Quake Sensor (virtual %d)", index);
+
+	if (ioctl(v->fd, UI_DEV_SETUP, &setup) < 0 || ioctl(v->fd, UI_DEV_CREATE) < 0)
+	{
+		fprintf(stderr, "Couldn't create a uinput device: %s.\n", strerror(errno));
+		return -1;
+	}
+	if (find_nodes(v) != 0)
+	{
+		fprintf(stderr, "Couldn't find the device nodes of virtual device %d.\n", index);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void destroy_device(vdev_t *v)
+{
+	if (v->fd >= 0)
+	{
+		ioctl(v->fd, UI_DEV_DESTROY);
+		close(v->fd);
+		v->fd = -1;
+	}
+}
+
+static double cpu_s(int who)
+{
+	struct rusage ru;
+
+	getrusage(who, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec*1e-6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec*1e-6;
+}
+
+/* Drives the first n devices for secs seconds, or until interrupted for 0.
+ * Returns the reports sent, or -1. */
+static long long drive(int n, double secs, long long *late)
+{
+	struct timespec next;
+	long long tick = 0;
+	long long sent = 0;
+	double t0 = now_s();
+	long period_ns = (long)(1e9/rate);
+	int i, r;
+
+	*late = 0;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!stop_requested && (secs <= 0 || tick < secs*rate))
+	{
+		for (i = 0; i < n; i++)
+		{
+			r = send_report(&devs[i], t0 + tick/rate);
+			if (r < 0)
+			{
+				fprintf(stderr, "Couldn't write to virtual device %d: %s.\n", i, strerror(errno));
+				return -1;
+			}
+			sent += r;
+		}
+		tick++;
+
+		next.tv_nsec += period_ns;
+		while (next.tv_nsec >= 1000000000L)
+		{
+			next.tv_sec++;
+			next.tv_nsec -= 1000000000L;
+		}
+		if (now_s() > next.tv_sec + next.tv_nsec*1e-9 + 1/rate)
+		{
+			(*late)++;
+		}
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR && !stop_requested)
+		{
+		}
+	}
+
+	return sent;
+}
+
+/* Sums a metric over every device in the recorder's metrics file. */
+static double metric(const char *path, const char *name)
+{
+	char line[512];
+	size_t len = strlen(name);
+	double sum = 0;
+	char *p;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (f == NULL)
+	{
+		return NAN;
+	}
+	while (fgets(line, sizeof(line), f) != NULL)
+	{
+		if (strncmp(line, name, len) == 0 && line[len] == '{')
+		{
+			p = strrchr(line, ' ');
+			if (p != NULL)
+			{
+				sum += strtod(p + 1, NULL);
+			}
+		}
+	}
+	fclose(f);
+
+	return sum;
+}
+
+static int run_step(int n, double secs, double wait_s, int use_js, char **cmd, int cmd_len,
+                    const char *metrics_path)
+{
+	char **argv;
+	struct rusage ru;
+	long long sent, late;
+	double t0, t1, self0, rec_cpu, recorded, arrivals, writes;
+	pid_t pid;
+	int status;
+	int i;
+
+	argv = calloc(cmd_len + n + 3, sizeof(char *));
+	if (argv == NULL)
+	{
+		return -1;
+	}
+	for (i = 0; i < cmd_len; i++)
+	{
+		argv[i] = cmd[i];
+	}
+	argv[cmd_len] = "-M";
+	argv[cmd_len + 1] = (char *)metrics_path;
+	for (i = 0; i < n; i++)
+	{
+		argv[cmd_len + 2 + i] = use_js ? devs[i].js_path : devs[i].event_path;
+	}
+	unlink(metrics_path);
+
+	pid = fork();
+	if (pid == 0)
+	{
+		/* the recorder's own summary isn't part of the report */
+		if (freopen("/dev/null", "w", stdout) == NULL)
+		{
+			_exit(127);
+		}
+		execvp(argv[0], argv);
+		fprintf(stderr, "Couldn't run %s: %s.\n", argv[0], strerror(errno));
+		_exit(127);
+	}
+	free(argv);
+	if (pid < 0)
+	{
+		fprintf(stderr, "Couldn't start the recorder: %s.\n", strerror(errno));
+		return -1;
+	}
+
+	usleep((useconds_t)(wait_s*1e6));
+	t0 = now_s();
+	self0 = cpu_s(RUSAGE_SELF);
+	sent = drive(n, secs, &late);
+	t1 = now_s();
+	self0 = cpu_s(RUSAGE_SELF) - self0;
+
+	/* let the recorder catch up before stopping it */
+	usleep(500000);
+	kill(pid, SIGINT);
+	if (wait4(pid, &status, 0, &ru) != pid || !WIFEXITED(status) || WEXITSTATUS(status) == 127)
+	{
+		fprintf(stderr, "The recorder failed with %d devices.\n", n);
+		return -1;
+	}
+	rec_cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec*1e-6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec*1e-6;
+	if (sent < 0)
+	{
+		return -1;
+	}
+
+	recorded = metric(metrics_path, "joystick_samples_total");
+	if (isnan(recorded))
+	{
+		fprintf(stderr, "The recorder left no metrics in %s.\n", metrics_path);
+		return -1;
+	}
+	arrivals = metric(metrics_path, "joystick_arrival_interval_seconds_count");
+	writes = metric(metrics_path, "joystick_write_latency_seconds_count");
+
+	printf("devices=%d rate=%g seconds=%.1f sent=%lld recorded=%.0f lost=%.0f loss_pct=%.3f missing=%.0f "
+	       "dropped=%.0f recorder_cpu_pct=%.1f loadgen_cpu_pct=%.1f mean_arrival_ms=%.3f mean_write_us=%.2f late=%lld\n",
+	       n, rate, t1 - t0, sent, recorded, sent - recorded, (sent > 0) ? 100*(sent - recorded)/sent : 0.0,
+	       metric(metrics_path, "joystick_missing_reports_total"), metric(metrics_path, "joystick_queue_dropped_total"),
+	       100*rec_cpu/(t1 - t0 + wait_s + 0.5), 100*self0/(t1 - t0),
+	       (arrivals > 0) ? 1e3*metric(metrics_path, "joystick_arrival_interval_seconds_sum")/arrivals : 0.0,
+	       (writes > 0) ? 1e6*metric(metrics_path, "joystick_write_latency_seconds_sum")/writes : 0.0, late);
+	fflush(stdout);
+
+	return 0;
+}
+
+static int parse_steps(char *arg, int *steps, int *num_steps)
+{
+	char *p = arg;
+
+	*num_steps = 0;
+	while (*p != '\0')
+	{
+		if (*num_steps == MAX_STEPS)
+		{
+			return -1;
+		}
+		steps[*num_steps] = strtol(p, &p, 10);
+		if (steps[*num_steps] < 1 || steps[*num_steps] > MAX_DEVICES || (*p != ',' && *p != '\0'))
+		{
+			return -1;
+		}
+		(*num_steps)++;
+		if (*p == ',')
+		{
+			p++;
+		}
+	}
+
+	return (*num_steps > 0) ? 0 : -1;
+}
+
+int main(int argc, char* argv[])
+{
+	int steps[MAX_STEPS] = { 1 };
+	int num_steps = 1;
+	double secs = 10;
+	double wait_s = 1;
+	int use_js = 0;
+	unsigned long seed = 1;
+	const char *metrics_path = "loadgen.prom";
+	struct sigaction sa;
+	long long late;
+	int opt;
+	int i;
+	char *p;
+	int err_code = 0;
+
+	while ((opt = getopt(argc, argv, "n:r:d:i:l:k:N:q:A:g:s:w:M:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			if (parse_steps(optarg, steps, &num_steps) != 0)
+			{
+				fprintf(stderr, "Invalid numbers of devices, expected e.g. 1,2,4 (at most %d).\n", MAX_DEVICES);
+				return -1;
+			}
+			break;
+		case 'r':
+			rate = strtod(optarg, &p);
+			if (*p != '\0' || rate <= 0 || rate > 10000)
+			{
+				fprintf(stderr, "Invalid rate.\n");
+				return -1;
+			}
+			break;
+		case 'd':
+			secs = strtod(optarg, &p);
+			if (*p != '\0' || secs < 0)
+			{
+				fprintf(stderr, "Invalid duration.\n");
+				return -1;
+			}
+			break;
+		case 'i':
+			if (strcmp(optarg, "js") != 0 && strcmp(optarg, "event") != 0)
+			{
+				fprintf(stderr, "Invalid interface, expected js or event.\n");
+				return -1;
+			}
+			use_js = (strcmp(optarg, "js") == 0);
+			break;
+		case 'l':
+			if (strcmp(optarg, "basic") == 0)
+			{
+				layout = LAYOUT_BASIC;
+			}
+			else if (strcmp(optarg, "peak") == 0)
+			{
+				layout = LAYOUT_PEAK;
+			}
+			else
+			{
+				fprintf(stderr, "Invalid layout, expected basic or peak.\n");
+				return -1;
+			}
+			break;
+		case 'k':
+			oversample = strtol(optarg, &p, 10);
+			if (*p != '\0' || oversample < 1 || oversample > 255)
+			{
+				fprintf(stderr, "Invalid number of samples per report.\n");
+				return -1;
+			}
+			break;
+		case 'N':
+			noise = strtod(optarg, &p);
+			if (*p != '\0' || noise < 0)
+			{
+				fprintf(stderr, "Invalid noise.\n");
+				return -1;
+			}
+			break;
+		case 'q':
+			quakes_per_min = strtod(optarg, &p);
+			if (*p != '\0' || quakes_per_min < 0)
+			{
+				fprintf(stderr, "Invalid earthquake rate.\n");
+				return -1;
+			}
+			break;
+		case 'A':
+			s_amp = strtod(optarg, &p);
+			if (*p != '\0' || s_amp < 0)
+			{
+				fprintf(stderr, "Invalid amplitude.\n");
+				return -1;
+			}
+			break;
+		case 'g':
+			glitch_p = strtod(optarg, &p);
+			if (*p != '\0' || glitch_p < 0 || glitch_p > 1)
+			{
+				fprintf(stderr, "Invalid glitch probability.\n");
+				return -1;
+			}
+			break;
+		case 's':
+			seed = strtoul(optarg, &p, 10);
+			if (*p != '\0')
+			{
+				fprintf(stderr, "Invalid seed.\n");
+				return -1;
+			}
+			break;
+		case 'w':
+			wait_s = strtod(optarg, &p);
+			if (*p != '\0' || wait_s < 0)
+			{
+				fprintf(stderr, "Invalid wait.\n");
+				return -1;
+			}
+			break;
+		case 'M':
+			metrics_path = optarg;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n N[,N...]] [-r rate] [-d secs] [-i js|event] [-l basic|peak] [-k N] [-N counts] [-q quakes_per_min] [-A counts] [-g p] [-s seed] [-w secs] [-M file] [-- recorder ...]\n", argv[0]);
+			return -1;
+		}
+	}
+	num_axes = (layout == LAYOUT_PEAK) ? MAX_AXES : 3;
+	if (optind < argc && secs <= 0)
+	{
+		fprintf(stderr, "A sweep needs a duration.\n");
+		return -1;
+	}
+
+	for (i = 0; i < num_steps; i++)
+	{
+		num_devs = (steps[i] > num_devs) ? steps[i] : num_devs;
+	}
+	for (i = 0; i < num_devs; i++)
+	{
+		devs[i].fd = -1;
+		devs[i].rng = (seed + 1)*0x9E3779B97F4A7C15ULL + i;
+		schedule_quake(&devs[i], now_s());
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = handle_signal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	for (i = 0; i < num_devs && err_code == 0; i++)
+	{
+		err_code = create_device(&devs[i], i);
+	}
+
+	if (err_code == 0 && optind < argc)
+	{
+		for (i = 0; i < num_steps && err_code == 0 && !stop_requested; i++)
+		{
+			err_code = run_step(steps[i], secs, wait_s, use_js, &argv[optind], argc - optind, metrics_path);
+		}
+	}
+	else if (err_code == 0)
+	{
+		for (i = 0; i < num_devs; i++)
+		{
+			fprintf(stdout, "%s %s\n", devs[i].event_path, devs[i].js_path);
+		}
+		fflush(stdout);
+		if (drive(num_devs, secs, &late) < 0)
+		{
+			err_code = -1;
+		}
+		else if (late > 0)
+		{
+			fprintf(stderr, "Fell behind %lld times.\n", late);
+		}
+	}
+
+	for (i = 0; i < num_devs; i++)
+	{
+		destroy_device(&devs[i]);
+	}
+
+	return err_code;
+}
@@ -0,0 +1,480 @@
+/* Run time metrics of the acquisition engine. See metrics.h. */
+
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "acq.h"
+#include "metrics.h"
+
+/* upper bounds of the buckets, in us and ns */
+static const uint64_t arrival_le_us[METRICS_ARRIVAL_BUCKETS] =
+{
+	1000, 2000, 4000, 6000, 8000, 10000, 12000, 16000, 24000, 50000, 100000, 500000
+};
+static const uint64_t latency_le_ns[METRICS_LATENCY_BUCKETS] =
+{
+	10000, 50000, 100000, 500000, 1000000, 5000000, 10000000, 50000000, 100000000,
+	500000000, 1000000000
+};
+
+int metrics_enabled;
+
+static uint64_t period_us = 1000000/METRICS_DEFAULT_RATE;
+
+static device_t *devices;
+static int num_devices;
+static char *file_path;
+static char *tmp_path;
+static int listen_fd = -1;
+static int stop_pipe[2] = { -1, -1 };
+static pthread_t exporter;
+static uint64_t *prev_samples;
+
+uint64_t metrics_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+static int bucket_of(const uint64_t *le, int num, uint64_t v)
+{
+	int b = 0;
+
+	while (b < num && v > le[b])
+	{
+		b++;
+	}
+	return b;
+}
+
+/* Counts samples and the gaps between them, where a gap is a jump in the
+ * time stamps of more than one and a half report periods. */
+void metrics_samples(dev_metrics_t *m, const sample_t *s, size_t n)
+{
+	uint64_t dt;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+	{
+		if (m->last_t_us != 0 && s[i].t_us > m->last_t_us)
+		{
+			dt = s[i].t_us - m->last_t_us;
+			if (2*dt > 3*period_us)
+			{
+				metrics_add(&m->gaps, 1);
+				metrics_add(&m->missing, (dt + period_us/2)/period_us - 1);
+			}
+		}
+		m->last_t_us = s[i].t_us;
+	}
+	metrics_add(&m->samples, n);
+}
+
+void metrics_arrival(dev_metrics_t *m, uint64_t t_us)
+{
+	uint64_t d;
+
+	if (m->last_arrival_us != 0 && t_us >= m->last_arrival_us)
+	{
+		d = t_us - m->last_arrival_us;
+		metrics_add(&m->arrival[bucket_of(arrival_le_us, METRICS_ARRIVAL_BUCKETS, d)], 1);
+		metrics_add(&m->arrival_sum_us, d);
+	}
+	m->last_arrival_us = t_us;
+}
+
+void metrics_latency(dev_metrics_t *m, uint64_t ns)
+{
+	metrics_add(&m->latency[bucket_of(latency_le_ns, METRICS_LATENCY_BUCKETS, ns)], 1);
+	metrics_add(&m->latency_sum_ns, ns);
+}
+
+static uint64_t get(const uint64_t *c)
+{
+	return __atomic_load_n(c, __ATOMIC_RELAXED);
+}
+
+/* Writes the device label, escaped as the format asks. */
+static void put_label(FILE *f, const device_t *d)
+{
+	const char *p;
+
+	fputs("{device=\"", f);
+	for (p = d->path; *p != '\0'; p++)
+	{
+		if (*p == '"' || *p == '\\')
+		{
+			fputc('\\', f);
+		}
+		fputc(*p, f);
+	}
+	fputc('"', f);
+}
+
+static void put_header(FILE *f, const char *name, const char *type, const char *help)
+{
+	fprintf(f, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void put_counter(FILE *f, const char *name, const char *type, const char *help, size_t offset)
+{
+	int i;
+
+	put_header(f, name, type, help);
+	for (i = 0; i < num_devices; i++)
+	{
+		fputs(name, f);
+		put_label(f, &devices[i]);
+		fprintf(f, "} %llu\n", (unsigned long long)get((const uint64_t *)((const char *)&devices[i].metrics + offset)));
+	}
+}
+
+static void put_histogram(FILE *f, const char *name, const char *help, const uint64_t *le, int num,
+                          size_t offset, size_t sum_offset, double scale)
+{
+	const dev_metrics_t *m;
+	uint64_t count;
+	int i, b;
+
+	put_header(f, name, "histogram", help);
+	for (i = 0; i < num_devices; i++)
+	{
+		m = &devices[i].metrics;
+		count = 0;
+		for (b = 0; b <= num; b++)
+		{
+			count += get((const uint64_t *)((const char *)m + offset) + b);
+			fputs(name, f);
+			fputs("_bucket", f);
+			put_label(f, &devices[i]);
+			if (b < num)
+			{
+				fprintf(f, ",le=\"%g\"} %llu\n", le[b]*scale, (unsigned long long)count);
+			}
+			else
+			{
+				fprintf(f, ",le=\"+Inf\"} %llu\n", (unsigned long long)count);
+			}
+		}
+		fprintf(f, "%s_sum", name);
+		put_label(f, &devices[i]);
+		fprintf(f, "} %.9g\n", get((const uint64_t *)((const char *)m + sum_offset))*scale);
+		fprintf(f, "%s_count", name);
+		put_label(f, &devices[i]);
+		fprintf(f, "} %llu\n", (unsigned long long)count);
+	}
+}
+
+/* Builds the text of every metric, with rates over the last elapsed_s. */
+static char *build(double elapsed_s, size_t *len)
+{
+	char *text = NULL;
+	uint64_t n;
+	FILE *f;
+	int i;
+
+	f = open_memstream(&text, len);
+	if (f == NULL)
+	{
+		return NULL;
+	}
+
+	put_counter(f, "joystick_samples_total", "counter", "Samples read from the device.",
+	            offsetof(dev_metrics_t, samples));
+	put_header(f, "joystick_samples_per_second", "gauge", "Samples read over the last refresh.");
+	for (i = 0; i < num_devices; i++)
+	{
+		n = get(&devices[i].metrics.samples);
+		fputs("joystick_samples_per_second", f);
+		put_label(f, &devices[i]);
+		fprintf(f, "} %.3f\n", (elapsed_s > 0) ? (n - prev_samples[i])/elapsed_s : 0);
+		prev_samples[i] = n;
+	}
+	put_histogram(f, "joystick_arrival_interval_seconds", "Time between reads that found samples.",
+	              arrival_le_us, METRICS_ARRIVAL_BUCKETS, offsetof(dev_metrics_t, arrival),
+	              offsetof(dev_metrics_t, arrival_sum_us), 1e-6);
+	put_counter(f, "joystick_sequence_gaps_total", "counter", "Jumps of more than one report period in the time stamps.",
+	            offsetof(dev_metrics_t, gaps));
+	put_counter(f, "joystick_missing_reports_total", "counter", "Report periods skipped by the gaps.",
+	            offsetof(dev_metrics_t, missing));
+	put_counter(f, "joystick_queue_samples", "gauge", "Samples waiting for the writer thread.",
+	            offsetof(dev_metrics_t, queued));
+	put_counter(f, "joystick_queue_high_water_samples", "gauge", "Most samples that have waited for the writer thread.",
+	            offsetof(dev_metrics_t, queue_high_water));
+	put_counter(f, "joystick_queue_dropped_total", "counter", "Samples the queue had no room for.",
+	            offsetof(dev_metrics_t, queue_dropped));
+	put_histogram(f, "joystick_write_latency_seconds", "Time the sinks took over a batch of samples.",
+	              latency_le_ns, METRICS_LATENCY_BUCKETS, offsetof(dev_metrics_t, latency),
+	              offsetof(dev_metrics_t, latency_sum_ns), 1e-9);
+	put_counter(f, "joystick_bytes_written_total", "counter", "Bytes handed to the recordings.",
+	            offsetof(dev_metrics_t, bytes));
+
+	if (fclose(f) != 0)
+	{
+		free(text);
+		return NULL;
+	}
+
+	return text;
+}
+
+static void write_file(const char *text, size_t len)
+{
+	FILE *f = fopen(tmp_path, "w");
+
+	if (f == NULL)
+	{
+		return;
+	}
+	if (fwrite(text, 1, len, f) != len)
+	{
+		fclose(f);
+		unlink(tmp_path);
+		return;
+	}
+	if (fclose(f) == 0)
+	{
+		rename(tmp_path, file_path);
+	}
+}
+
+static void serve(const char *text, size_t len)
+{
+	struct timeval tv = { 1, 0 };
+	char req[1024];
+	char hdr[128];
+	int fd;
+	int n;
+
+	fd = accept(listen_fd, NULL, NULL);
+	if (fd < 0)
+	{
+		return;
+	}
+	/* whatever was asked for, the answer is the metrics */
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	if (recv(fd, req, sizeof(req), 0) > 0)
+	{
+		n = snprintf(hdr, sizeof(hdr), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+		             "Content-Length: %zu\r\n\r\n", len);
+		if (send(fd, hdr, n, MSG_NOSIGNAL) == n)
+		{
+			send(fd, text, len, MSG_NOSIGNAL);
+		}
+	}
+	close(fd);
+}
+
+static void *exporter_main(void *arg)
+{
+	struct pollfd pfd[2];
+	uint64_t last = metrics_now_ns();
+	uint64_t next = last;
+	uint64_t now;
+	char *text = NULL;
+	size_t len = 0;
+	int timeout;
+
+	(void)arg;
+	pfd[0].fd = stop_pipe[0];
+	pfd[0].events = POLLIN;
+	pfd[1].fd = listen_fd;
+	pfd[1].events = POLLIN;
+
+	for (;;)
+	{
+		now = metrics_now_ns();
+		if (now >= next)
+		{
+			free(text);
+			text = build((now - last)*1e-9, &len);
+			last = now;
+			next += (uint64_t)METRICS_REFRESH_MS*1000000;
+			if (next <= now)
+			{
+				next = now + (uint64_t)METRICS_REFRESH_MS*1000000;
+			}
+			if (text != NULL && file_path != NULL)
+			{
+				write_file(text, len);
+			}
+		}
+
+		timeout = (next - now)/1000000 + 1;
+		if (poll(pfd, (listen_fd >= 0) ? 2 : 1, timeout) > 0)
+		{
+			if (pfd[0].revents != 0)
+			{
+				break;
+			}
+			if (listen_fd >= 0 && (pfd[1].revents & POLLIN) && text != NULL)
+			{
+				serve(text, len);
+			}
+		}
+	}
+
+	/* the last word goes to the file */
+	if (file_path != NULL)
+	{
+		free(text);
+		text = build((metrics_now_ns() - last)*1e-9, &len);
+		if (text != NULL)
+		{
+			write_file(text, len);
+		}
+	}
+	free(text);
+
+	return NULL;
+}
+
+/* where is host:port or :port (all interfaces are not offered, :port is
+ * the loopback interface) */
+static int open_listener(const char *where)
+{
+	struct addrinfo hints, *res, *ai;
+	const char *colon = strrchr(where, ':');
+	char *host;
+	int one = 1;
+	int fd = -1;
+	int err;
+
+	host = strndup(where, colon - where);
+	if (host == NULL)
+	{
+		return -1;
+	}
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	err = getaddrinfo((*host != '\0') ? host : "127.0.0.1", colon + 1, &hints, &res);
+	free(host);
+	if (err != 0)
+	{
+		fprintf(stderr, "Couldn't look up %s: %s.\n", where, gai_strerror(err));
+		return -1;
+	}
+
+	for (ai = res; ai != NULL && fd < 0; ai = ai->ai_next)
+	{
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC | SOCK_NONBLOCK, ai->ai_protocol);
+		if (fd < 0)
+		{
+			continue;
+		}
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (bind(fd, ai->ai_addr, ai->ai_addrlen) != 0 || listen(fd, 8) != 0)
+		{
+			close(fd);
+			fd = -1;
+		}
+	}
+	freeaddrinfo(res);
+	if (fd < 0)
+	{
+		fprintf(stderr, "Couldn't listen on %s: %s.\n", where, strerror(errno));
+	}
+
+	return fd;
+}
+
+/* Starts exporting the metrics of the devices to where, a file or a
+ * [host]:port to serve them on. rate is the nominal report rate, used to
+ * find gaps. */
+int metrics_start(device_t *devs, int num_devs, const char *where, double rate)
+{
+	const char *colon = strrchr(where, ':');
+
+	devices = devs;
+	num_devices = num_devs;
+	if (rate > 0)
+	{
+		period_us = llround(1e6/rate);
+	}
+
+	prev_samples = calloc(num_devs, sizeof(uint64_t));
+	if (prev_samples == NULL)
+	{
+		return -1;
+	}
+
+	if (colon != NULL && colon[1] != '\0' && strspn(colon + 1, "0123456789") == strlen(colon + 1))
+	{
+		listen_fd = open_listener(where);
+		if (listen_fd < 0)
+		{
+			free(prev_samples);
+			return -1;
+		}
+	}
+	else
+	{
+		file_path = strdup(where);
+		tmp_path = malloc(strlen(where) + 8);
+		if (file_path == NULL || tmp_path == NULL)
+		{
+			metrics_stop();
+			return -1;
+		}
+		sprintf(tmp_path, "%s.tmp", where);
+	}
+
+	if (pipe(stop_pipe) != 0)
+	{
+		metrics_stop();
+		return -1;
+	}
+	metrics_enabled = 1;
+	if (pthread_create(&exporter, NULL, exporter_main, NULL) != 0)
+	{
+		fprintf(stderr, "Couldn't start the metrics thread.\n");
+		metrics_enabled = 0;
+		metrics_stop();
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Writes the metrics a last time and stops. */
+void metrics_stop(void)
+{
+	if (metrics_enabled)
+	{
+		if (write(stop_pipe[1], "", 1) == 1)
+		{
+			pthread_join(exporter, NULL);
+		}
+		metrics_enabled = 0;
+	}
+	if (stop_pipe[0] >= 0)
+	{
+		close(stop_pipe[0]);
+		close(stop_pipe[1]);
+		stop_pipe[0] = stop_pipe[1] = -1;
+	}
+	if (listen_fd >= 0)
+	{
+		close(listen_fd);
+		listen_fd = -1;
+	}
+	free(file_path);
+	free(tmp_path);
+	free(prev_samples);
+	file_path = tmp_path = NULL;
+	prev_samples = NULL;
+}
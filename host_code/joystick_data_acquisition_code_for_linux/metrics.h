@@ -0,0 +1,85 @@
+/* Run time metrics of the acquisition engine, in the Prometheus text format.
+ *
+ * Each device keeps a set of counters that the reading and writer threads
+ * bump as they go, with no locks: every counter has a single thread that
+ * writes it and is stored atomically, so the exporter thread can read it
+ * at any time. Once a second the exporter turns them into Prometheus text
+ * and either writes it to a file (renamed into place, e.g. for the
+ * node_exporter textfile collector) or serves it over HTTP on a local
+ * port for Prometheus to scrape.
+ *
+ * Per device:
+ *
+ *   joystick_samples_total, joystick_samples_per_second
+ *   joystick_arrival_interval_seconds   histogram of the time between reads
+ *                                       that found samples (see jitter.h)
+ *   joystick_sequence_gaps_total        times the samples skipped at least
+ *                                       one report period, and
+ *   joystick_missing_reports_total      how many periods they skipped
+ *   joystick_queue_samples              samples waiting for the writer
+ *   joystick_queue_high_water_samples, joystick_queue_dropped_total
+ *   joystick_write_latency_seconds      histogram of the time the sinks
+ *                                       took over each batch of samples
+ *   joystick_bytes_written_total        bytes handed to the recordings
+ *
+ * The counters are only kept while the exporter runs.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sample.h"
+
+#define METRICS_ARRIVAL_BUCKETS 12
+#define METRICS_LATENCY_BUCKETS 11
+#define METRICS_REFRESH_MS 1000
+#define METRICS_DEFAULT_RATE 125
+
+typedef struct
+{
+	/* reading thread */
+	uint64_t samples;
+	uint64_t gaps;
+	uint64_t missing;
+	uint64_t arrival[METRICS_ARRIVAL_BUCKETS + 1];   /* the last is +Inf */
+	uint64_t arrival_sum_us;
+	uint64_t queue_dropped;
+	uint64_t last_t_us;
+	uint64_t last_arrival_us;
+
+	/* thread running the sinks */
+	uint64_t queued;
+	uint64_t queue_high_water;
+	uint64_t latency[METRICS_LATENCY_BUCKETS + 1];
+	uint64_t latency_sum_ns;
+	uint64_t bytes;
+} dev_metrics_t;
+
+extern int metrics_enabled;
+
+/* Counters are only written by one thread, so a plain add stored
+ * atomically is enough. */
+static inline void metrics_add(uint64_t *c, uint64_t n)
+{
+	__atomic_store_n(c, *c + n, __ATOMIC_RELAXED);
+}
+
+static inline void metrics_set(uint64_t *c, uint64_t v)
+{
+	__atomic_store_n(c, v, __ATOMIC_RELAXED);
+}
+
+uint64_t metrics_now_ns(void);
+void metrics_samples(dev_metrics_t *m, const sample_t *s, size_t n);
+void metrics_arrival(dev_metrics_t *m, uint64_t t_us);
+void metrics_latency(dev_metrics_t *m, uint64_t ns);
+
+struct device;
+
+int metrics_start(struct device *devs, int num_devs, const char *where, double rate);
+void metrics_stop(void);
+
+#endif
@@ -0,0 +1,461 @@
+/* Computes the power spectral density of each axis of one or more
+ * recordings made by record_joystick_data with Welch's method, e.g.
+ * js0.jsc gives js0_x-axis_psd.csv, js0_y-axis_psd.csv and
+ * js0_z-axis_psd.csv. Each line holds a frequency in Hz, the density in
+ * counts^2/Hz and the density in dB, ready for freqplots_js0js1_psd.m.
+ *
+ * The samples are resampled onto a regular grid (see resample.h) and
+ * averaged a segment at a time (see welch.h) as the recording is read, so
+ * recordings of any length take the same memory. Each recording is read
+ * once, by one thread, for all three axes; several recordings are worked
+ * out at once, up to one per processor.
+ *
+ * To compile: make psd
+ * To run: ./psd js0.jsc js1.jsc
+ *         ./psd -n 4096 -w blackman js0.jsc
+ * Options:
+ *   -n N        segment length, a power of two (default 1024)
+ *   -v overlap  overlap of the segments, 0 to 0.9 (default 0.5)
+ *   -w window   rect, hann (default), hamming or blackman
+ *   -r rate     samples/s to resample to (default the rate saved in a
+ *               columnar recording, otherwise 125)
+ *   -m method   resampling method: hold (default), linear or sinc
+ *   -j N        number of threads (default one per processor)
+ *
+ * license: Unknown
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "colrec.h"
+#include "resample.h"
+#include "sample.h"
+#include "welch.h"
+
+#define DEFAULT_RATE 125
+#define RECORD_BATCH 4096
+
+static const char axis_name[NUM_AXES] = { 'x', 'y', 'z' };
+
+typedef struct
+{
+	const char *path;
+	int col;
+	double rate;
+	welch_t w[NUM_AXES];
+	resampler_t r;
+	uint64_t t_next;          /* expected time of the next resampled value */
+	int err_code;
+} job_t;
+
+static job_t *jobs;
+static int num_jobs;
+static int next_job;
+
+static size_t seg_len = 1024;
+static double overlap = 0.5;
+static int window = WELCH_HANN;
+static int method = RESAMPLE_HOLD;
+
+static int to_welch(void *ctx, const rsample_t *out, size_t n)
+{
+	job_t *job = ctx;
+	double x[NUM_AXES][RESAMPLE_BATCH];
+	uint64_t period = llround(1e6/job->rate);
+	size_t i, m = 0;
+	int a;
+
+	for (i = 0; i < n; i++)
+	{
+		/* the resampler starts again after a gap, and so do the segments */
+		if (job->t_next != 0 && out[i].t_us > job->t_next + period/2)
+		{
+			for (a = 0; a < NUM_AXES; a++)
+			{
+				welch_push(&job->w[a], x[a], m);
+				welch_restart(&job->w[a]);
+			}
+			m = 0;
+		}
+		for (a = 0; a < NUM_AXES; a++)
+		{
+			x[a][m] = out[i].axis[a];
+		}
+		m++;
+		job->t_next = out[i].t_us + period;
+	}
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		welch_push(&job->w[a], x[a], m);
+	}
+
+	return 0;
+}
+
+static int read_raw(job_t *job)
+{
+	rawrec_t *recs;
+	sample_t s;
+	FILE *f;
+	size_t i, j, n;
+	int err_code = 0;
+
+	f = fopen(job->path, "rb");
+	recs = malloc(RECORD_BATCH*sizeof(rawrec_t));
+	if (f == NULL || recs == NULL || fseek(f, sizeof(rawrec_header_t), SEEK_SET) != 0)
+	{
+		err_code = -1;
+	}
+
+	while (err_code == 0 && (n = fread(recs, sizeof(rawrec_t), RECORD_BATCH, f)) > 0)
+	{
+		for (j = 0; j < n && err_code == 0; j++)
+		{
+			s.t_us = recs[j].t_us;
+			for (i = 0; i < NUM_AXES; i++)
+			{
+				s.axis[i] = recs[j].axis[i];
+			}
+			s.dev = recs[j].dev;
+			s.updated = recs[j].updated;
+			err_code = resampler_push(&job->r, &s, 1);
+		}
+	}
+
+	if (f != NULL)
+	{
+		fclose(f);
+	}
+	free(recs);
+
+	return err_code;
+}
+
+static int read_col(job_t *job)
+{
+	colrec_t c;
+	colrec_iter_t it;
+	colrec_span_t span;
+	sample_t s;
+	uint32_t j;
+	int i;
+	int err_code = 0;
+
+	if (colrec_open(&c, job->path) != 0)
+	{
+		return -1;
+	}
+
+	colrec_iter_init(&it, &c, 0, UINT64_MAX);
+	while (err_code == 0 && (err_code = colrec_iter_next(&it, &span)) > 0)
+	{
+		err_code = 0;
+		for (j = 0; j < span.count && err_code == 0; j++)
+		{
+			s.t_us = span.t[j];
+			for (i = 0; i < NUM_AXES; i++)
+			{
+				s.axis[i] = span.axis[i][j];
+			}
+			s.dev = 0;
+			s.updated = span.updated[j];
+			err_code = resampler_push(&job->r, &s, 1);
+		}
+	}
+	colrec_close(&c);
+
+	return (err_code < 0) ? -1 : 0;
+}
+
+static int write_psd(job_t *job, int axis)
+{
+	const char *dot = strrchr(job->path, '.');
+	size_t len = (dot != NULL && strchr(dot, '/') == NULL) ? (size_t)(dot - job->path) : strlen(job->path);
+	welch_t *w = &job->w[axis];
+	char *path = malloc(len + 16);
+	double *psd = malloc((w->n/2 + 1)*sizeof(double));
+	FILE *f = NULL;
+	size_t i;
+	int err_code = 0;
+
+	if (path == NULL || psd == NULL)
+	{
+		err_code = -1;
+		goto finished;
+	}
+	sprintf(path, "%.*s_%c-axis_psd.csv", (int)len, job->path, axis_name[axis]);
+	f = fopen(path, "w");
+	if (f == NULL)
+	{
+		fprintf(stderr, "Couldn't open %s: %s.\n", path, strerror(errno));
+		err_code = -1;
+		goto finished;
+	}
+
+	welch_psd(w, psd);
+	fprintf(f, "%% frequency [Hz], density [counts^2/Hz], density [dB]\n");
+	for (i = 0; i <= w->n/2; i++)
+	{
+		fprintf(f, "%.6f, %.6e, ", i*job->rate/w->n, psd[i]);
+		if (psd[i] > 0)
+		{
+			fprintf(f, "%.3f\n", 10*log10(psd[i]));
+		}
+		else
+		{
+			fprintf(f, "NaN\n");
+		}
+	}
+	if (fclose(f) != 0)
+	{
+		err_code = -1;
+	}
+
+	printf("%s: %llu segments of %zu samples at %g samples/s, %.4f Hz bins\n", path,
+	       (unsigned long long)w->num_segments, w->n, job->rate, job->rate/w->n);
+
+finished:
+	free(path);
+	free(psd);
+
+	return err_code;
+}
+
+static int run_job(job_t *job)
+{
+	int err_code = 0;
+	int a, num_init;
+
+	for (num_init = 0; num_init < NUM_AXES && err_code == 0; num_init++)
+	{
+		err_code = welch_init(&job->w[num_init], seg_len, overlap, window, job->rate);
+	}
+	if (err_code != 0)
+	{
+		num_init--;
+		goto finished;
+	}
+	if (resampler_init(&job->r, job->rate, method, RESAMPLE_DEFAULT_TAPS, RESAMPLE_DEFAULT_MAX_GAP_US,
+	                   to_welch, job) != 0)
+	{
+		err_code = -1;
+		goto finished;
+	}
+
+	err_code = job->col ? read_col(job) : read_raw(job);
+	err_code |= resampler_flush(&job->r);
+	if (err_code == 0)
+	{
+		for (a = 0; a < NUM_AXES; a++)
+		{
+			err_code |= write_psd(job, a);
+		}
+	}
+	else
+	{
+		fprintf(stderr, "Couldn't read %s.\n", job->path);
+	}
+	resampler_free(&job->r);
+
+finished:
+	for (a = 0; a < num_init; a++)
+	{
+		welch_free(&job->w[a]);
+	}
+
+	return err_code;
+}
+
+static void *worker(void *arg)
+{
+	int i;
+
+	(void)arg;
+	while ((i = __sync_fetch_and_add(&next_job, 1)) < num_jobs)
+	{
+		jobs[i].err_code = run_job(&jobs[i]);
+	}
+
+	return NULL;
+}
+
+/* Finds out the format and sample rate of a recording. */
+static int probe(const char *path, int *col, double *rate)
+{
+	rawrec_header_t hdr;
+	colrec_t c;
+	FILE *f;
+	int err_code = 0;
+
+	f = fopen(path, "rb");
+	if (f == NULL)
+	{
+		fprintf(stderr, "Couldn't open %s: %s.\n", path, strerror(errno));
+		return -1;
+	}
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1)
+	{
+		hdr.magic[0] = '\0';
+	}
+	fclose(f);
+
+	*col = (memcmp(hdr.magic, COLREC_MAGIC, sizeof(hdr.magic)) == 0);
+	if (*col)
+	{
+		if (colrec_open(&c, path) != 0)
+		{
+			return -1;
+		}
+		if (*rate == 0 && c.hdr->sample_rate > 0)
+		{
+			*rate = c.hdr->sample_rate;
+		}
+		colrec_close(&c);
+	}
+	else if (memcmp(hdr.magic, RAWREC_MAGIC, sizeof(hdr.magic)) != 0 || hdr.record_size != sizeof(rawrec_t))
+	{
+		fprintf(stderr, "%s is not a joystick recording.\n", path);
+		err_code = -1;
+	}
+	if (*rate == 0)
+	{
+		*rate = DEFAULT_RATE;
+	}
+
+	return err_code;
+}
+
+int main(int argc, char* argv[])
+{
+	pthread_t *threads;
+	long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	double rate = 0;
+	double file_rate;
+	int col;
+	int opt;
+	int i;
+	char *p;
+	int err_code = 0;
+
+	while ((opt = getopt(argc, argv, "n:v:w:r:m:j:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			seg_len = strtoul(optarg, &p, 10);
+			if (*p != '\0' || seg_len < 16 || (seg_len & (seg_len - 1)) != 0)
+			{
+				fprintf(stderr, "The segment length must be a power of two of at least 16.\n");
+				return -1;
+			}
+			break;
+		case 'v':
+			overlap = strtod(optarg, &p);
+			if (*p != '\0' || !(overlap >= 0 && overlap <= 0.9))
+			{
+				fprintf(stderr, "Invalid overlap.\n");
+				return -1;
+			}
+			break;
+		case 'w':
+			window = welch_window(optarg);
+			if (window < 0)
+			{
+				fprintf(stderr, "Invalid window.\n");
+				return -1;
+			}
+			break;
+		case 'r':
+			rate = strtod(optarg, &p);
+			if (*p != '\0' || !(rate > 0))
+			{
+				fprintf(stderr, "Invalid sample rate.\n");
+				return -1;
+			}
+			break;
+		case 'm':
+			method = resample_method(optarg);
+			if (method < 0)
+			{
+				fprintf(stderr, "Invalid resampling method.\n");
+				return -1;
+			}
+			break;
+		case 'j':
+			num_threads = strtol(optarg, &p, 10);
+			if (*p != '\0' || num_threads < 1)
+			{
+				fprintf(stderr, "Invalid number of threads.\n");
+				return -1;
+			}
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n N] [-v overlap] [-w rect|hann|hamming|blackman] [-r rate] [-m hold|linear|sinc] [-j threads] recording ...\n", argv[0]);
+			return -1;
+		}
+	}
+
+	if (optind >= argc)
+	{
+		fprintf(stderr, "usage: %s [-n N] [-v overlap] [-w rect|hann|hamming|blackman] [-r rate] [-m hold|linear|sinc] [-j threads] recording ...\n", argv[0]);
+		return -1;
+	}
+
+	jobs = calloc(argc - optind, sizeof(job_t));
+	if (jobs == NULL)
+	{
+		return -1;
+	}
+	for (i = optind; i < argc; i++)
+	{
+		file_rate = rate;
+		if (probe(argv[i], &col, &file_rate) != 0)
+		{
+			free(jobs);
+			return -1;
+		}
+		jobs[num_jobs].path = argv[i];
+		jobs[num_jobs].col = col;
+		jobs[num_jobs].rate = file_rate;
+		num_jobs++;
+	}
+
+	if (num_threads > num_jobs)
+	{
+		num_threads = num_jobs;
+	}
+	threads = calloc(num_threads, sizeof(pthread_t));
+	if (threads == NULL)
+	{
+		free(jobs);
+		return -1;
+	}
+	for (i = 0; i < num_threads - 1; i++)
+	{
+		if (pthread_create(&threads[i], NULL, worker, NULL) != 0)
+		{
+			break;
+		}
+	}
+	/* the calling thread takes jobs too, so a failed create only slows it down */
+	worker(NULL);
+	while (i-- > 0)
+	{
+		pthread_join(threads[i], NULL);
+	}
+
+	for (i = 0; i < num_jobs; i++)
+	{
+		err_code |= jobs[i].err_code;
+	}
+	free(threads);
+	free(jobs);
+
+	return err_code;
+}
@@ -0,0 +1,96 @@
+/* Sink that writes samples to a raw recording file (see sample.h) through
+ * a bufwriter.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "acq.h"
+
+#define RECORD_BATCH 256
+
+typedef struct
+{
+	sink_t sink;
+	bufwriter_t w;
+} rawsink_t;
+
+static int rawsink_write(sink_t *s, const sample_t *samples, size_t n)
+{
+	rawsink_t *rs = (rawsink_t *)s;
+	rawrec_t r[RECORD_BATCH];
+	size_t i, m;
+
+	while (n > 0)
+	{
+		m = (n < RECORD_BATCH) ? n : RECORD_BATCH;
+		for (i = 0; i < m; i++)
+		{
+			sample_to_rawrec(&samples[i], &r[i]);
+		}
+		if (bufwriter_write(&rs->w, r, m*sizeof(rawrec_t)) != 0)
+		{
+			return -1;
+		}
+		samples += m;
+		n -= m;
+	}
+
+	return 0;
+}
+
+static int rawsink_tick(sink_t *s)
+{
+	return bufwriter_tick(&((rawsink_t *)s)->w);
+}
+
+static uint64_t rawsink_bytes(sink_t *s)
+{
+	rawsink_t *rs = (rawsink_t *)s;
+
+	return rs->w.bytes_written + rs->w.len;
+}
+
+static int rawsink_close(sink_t *s)
+{
+	rawsink_t *rs = (rawsink_t *)s;
+	int err_code;
+
+	err_code = bufwriter_close(&rs->w);
+	free(rs);
+
+	return err_code;
+}
+
+sink_t *rawsink_open(const char *path, const bufwriter_cfg_t *cfg)
+{
+	rawsink_t *rs;
+	rawrec_header_t hdr;
+
+	rs = calloc(1, sizeof(*rs));
+	if (rs == NULL)
+	{
+		return NULL;
+	}
+	rs->sink.write = rawsink_write;
+	rs->sink.tick = rawsink_tick;
+	rs->sink.close = rawsink_close;
+	rs->sink.bytes = rawsink_bytes;
+
+	if (bufwriter_open(&rs->w, path, cfg) != 0)
+	{
+		free(rs);
+		return NULL;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, RAWREC_MAGIC, sizeof(hdr.magic));
+	hdr.record_size = sizeof(rawrec_t);
+	if (bufwriter_write(&rs->w, &hdr, sizeof(hdr)) != 0)
+	{
+		rawsink_close(&rs->sink);
+		return NULL;
+	}
+
+	return &rs->sink;
+}
@@ -0,0 +1,651 @@
+/* This code reads the three-axis accelerometer data from any number of
+ * joysticks and saves the data of each one to its own binary recording,
+ * named after the device, e.g. /dev/input/js0 is recorded to js0.jsc.
+ * Joysticks can be read through the joystick API (/dev/input/jsN), the
+ * event interface (/dev/input/eventN), which has microsecond time stamps,
+ * or as raw HID reports (/dev/hidrawN), which records every report and
+ * supports all the report layouts of the firmware.
+ * What the joystick and event interfaces return can be captured with -K
+ * and replayed later in place of the device, to rerun a recording without
+ * the sensor (see evcap.h).
+ * The backend is picked from the device name or can be given in front of
+ * the path, e.g. evdev:/dev/input/by-id/usb-...-joystick.
+ * For continuous monitoring run it in daemon mode with -S. Each joystick
+ * is then recorded until the recorder is stopped, to a directory of
+ * segments of the given length, e.g. /dev/input/js0 to js0/ with one
+ * segment per hour for -S 3600, along with an index of the segments (see
+ * segidx.h). Segments left unfinished by a crash or power loss are
+ * recovered when the recorder starts again.
+ *
+ * Recordings are columnar (see colrec.h) so they can be mapped and read in
+ * place, however long they are. The older raw format, one fixed record per
+ * sample, can still be written with -f raw. Use export_csv to turn either
+ * kind of recording into the per-axis csv files the octave scripts load.
+ *
+ * This is a heavily modified version of joytest.c found in the package
+ * JW_Linux_01.zip on the JoyWarrior website. This modified version contains
+ * code taken from the QCN forums for joystick correction. The joystick
+ * correction code prevents the the joystick driver from mangling the raw
+ * joystick data with calibration values.
+ *
+ * All the joysticks are read from a single epoll loop (see acq.h) that
+ * drains every joystick with data waiting, so one slow or unplugged
+ * joystick doesn't hold up the others. Records are collected in a large
+ * buffer that is only written to disk when it fills or has held data for
+ * longer than the flush interval, so recording costs a few system calls per
+ * second instead of several per axis value.
+ *
+ * To compile: make record_joystick_data
+ * To run: ./record_joystick_data                    (records /dev/input/js0)
+ *         ./record_joystick_data /dev/input/js0 /dev/input/js1
+ *         ./record_joystick_data /dev/input/event5
+ *         ./record_joystick_data /dev/hidraw2
+ *         ./record_joystick_data -n N   (where N is the desired number of samples)
+ *         ./record_joystick_data -n 0 -K /dev/input/js0   (also captures js0.evc)
+ *         ./record_joystick_data -n 0 -o replayed js0.evc
+ *
+ * Options:
+ *   -n N        number of samples to record from each joystick (0 = until
+ *               interrupted)
+ *   -S secs     daemon mode, record to segments of secs seconds
+ *   -c file     read the joysticks from a config file, one per line:
+ *                   device [recording, or directory in daemon mode]
+ *               blank lines and lines starting with # are ignored
+ *   -o dir      directory the recordings are written to
+ *   -f format   col (default) or raw
+ *   -z          compress the columnar recording (losslessly, see codec.h);
+ *               segments (-S) are always compressed
+ *   -F filter   filter in the firmware, saved in a columnar recording
+ *               (e.g. chebyshev, moving_average or no_filter)
+ *   -r rate     nominal samples/s, saved in a columnar recording
+ *   -R rate[:method]
+ *               resample to rate samples/s before recording, with the
+ *               method hold (default), linear or sinc (see resample.h),
+ *               on a grid starting at the first sample
+ *   -G          put the -R grid on the multiples of the sample period of
+ *               the device clock, so recordings of devices that share a
+ *               clock line up
+ *   -T file     run STA/LTA triggers on the channels in file (see trigger.h)
+ *   -E file     event log of the triggers (default triggers.log in the
+ *               recording directory)
+ *   -q N        samples each joystick can queue for the writer thread
+ *               (default 16384, over two minutes at 125 reports/s); 0
+ *               writes from the reading thread
+ *   -b KiB      size of the write buffer
+ *   -t ms       longest time a sample may wait in the buffer (0 = until full);
+ *               an uncompressed columnar recording only writes whole blocks
+ *               of 4096 samples, use -z or -f raw to see samples sooner
+ *   -s policy   fsync policy: never, flush (after every write) or an
+ *               interval in ms
+ *   -a backend  how the buffers are written: sync (default, by the writer
+ *               itself), uring (io_uring, falling back to threads) or
+ *               threads (see aio.h)
+ *   -P prio[:writer_prio]
+ *               run the reading thread, and the writer thread if given, at
+ *               SCHED_FIFO priority prio (1 to 99, see rt.h)
+ *   -C cpus[:writer_cpus]
+ *               pin the reading thread, and the writer thread if given, to
+ *               cpus, e.g. 3, 2-3 or isolated (the isolcpus= cores)
+ *   -L          lock all the memory of the recorder so it never pages
+ *   -J          report how regularly each joystick was read (see jitter.h);
+ *               run it with and without -P, -C and -L to compare
+ *   -M where    export metrics in the Prometheus text format every second
+ *               (see metrics.h), to a file or served over HTTP on [host]:port,
+ *               e.g. -M :9105 for port 9105 of the loopback interface
+ *   -K          capture what is read from each joystick, e.g. /dev/input/js0
+ *               to js0.evc in the recording directory
+ *   -x speed    replay captures speed times as fast as they were made
+ *               (default 1); 0 replays them as fast as they can be
+ *               recorded, which only keeps every sample with -q 0 or a
+ *               queue that holds the whole capture
+ *
+ * joytestv2 author: Jonathan Thomson
+ * license: Unknown
+ */
+
+#include <errno.h>
+#include <libgen.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "acq.h"
+#include "colrec.h"
+#include "evcap.h"
+#include "resample.h"
+
+#define DEFAULT_JOY_DEV "/dev/input/js0"
+/* 3000 samples is 24 seconds at 125 reports/s */
+#define DEFAULT_NUM_SAMPLES 3000
+#define TICK_MS 100
+#define DEFAULT_QUEUE_SIZE 16384
+#define BUFS_PER_JOYSTICK 3
+
+typedef struct
+{
+	char *dev_path;
+	char *rec_path;        /* NULL to name the recording after the device */
+} joystick_cfg_t;
+
+static joystick_cfg_t joysticks[MAX_DEVICES];
+static int num_joysticks;
+
+int parse_long(const char *arg, long *val)
+{
+	char *p;
+
+	errno = 0;
+	*val = strtol(arg, &p, 10);
+	if (errno != 0 || *p != 0 || p == arg || *val < 0)
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+int add_joystick(const char *dev_path, const char *rec_path)
+{
+	if (num_joysticks >= MAX_DEVICES)
+	{
+		fprintf(stderr, "Too many joysticks, at most %d can be recorded.\n", MAX_DEVICES);
+		return -1;
+	}
+
+	joysticks[num_joysticks].dev_path = strdup(dev_path);
+	joysticks[num_joysticks].rec_path = (rec_path != NULL) ? strdup(rec_path) : NULL;
+	num_joysticks++;
+
+	return 0;
+}
+
+int read_config(const char *path)
+{
+	FILE *f;
+	char line[1024];
+	char *dev_path;
+	char *rec_path;
+	int line_num = 0;
+	int err_code = 0;
+
+	f = fopen(path, "r");
+	if (f == NULL)
+	{
+		fprintf(stderr, "Couldn't open %s: %s.\n", path, strerror(errno));
+		return -1;
+	}
+
+	while (err_code == 0 && fgets(line, sizeof(line), f) != NULL)
+	{
+		line_num++;
+		dev_path = strtok(line, " \t\r\n");
+		if (dev_path == NULL || dev_path[0] == '#')
+		{
+			continue;
+		}
+		rec_path = strtok(NULL, " \t\r\n");
+		if (rec_path != NULL && strtok(NULL, " \t\r\n") != NULL)
+		{
+			fprintf(stderr, "%s:%d: expected a device and an optional recording.\n", path, line_num);
+			err_code = -1;
+			break;
+		}
+		err_code = add_joystick(dev_path, rec_path);
+	}
+
+	fclose(f);
+
+	return err_code;
+}
+
+/* /dev/input/js0 is recorded to <dir>/js0.jsc, or to the directory
+ * <dir>/js0 if ext is NULL. A replay of js0.evc is recorded the same way. */
+char *recording_path(const char *dir, const char *dev_path, const char *ext)
+{
+	char *tmp = strdup(dev_path);
+	char *path = NULL;
+
+	if (tmp != NULL)
+	{
+		path = malloc(strlen(dir) + strlen(tmp) + (ext != NULL ? strlen(ext) : 0) + 3);
+		if (path != NULL)
+		{
+			sprintf(path, "%s/%s", dir, basename(tmp));
+			if (strlen(path) > 4 && strcmp(path + strlen(path) - 4, ".evc") == 0)
+			{
+				path[strlen(path) - 4] = '\0';
+			}
+			if (ext != NULL)
+			{
+				strcat(path, ".");
+				strcat(path, ext);
+			}
+		}
+	}
+	free(tmp);
+
+	return path;
+}
+
+static void handle_signal(int sig)
+{
+	(void)sig;
+	acq_stop();
+}
+
+int main(int argc, char* argv[])
+{
+	int err_code = 0;
+	int opt;
+	int i;
+	long val;
+	long queue_size = DEFAULT_QUEUE_SIZE;
+	int backend = AIO_SYNC;
+	rt_cfg_t reader_rt = { 0, NULL };
+	rt_cfg_t writer_rt = { 0, NULL };
+	int lock_memory = 0;
+	int jitter_report = 0;
+	char *metrics_where = NULL;
+	int capture = 0;
+	double speed = 1;
+	long num_samples = DEFAULT_NUM_SAMPLES;
+	char *out_dir = ".";
+	char *path;
+	int raw = 0;
+	int compress = 0;
+	int have_num_samples = 0;
+	long seg_s = 0;
+	char *prefix;
+	char *filter = NULL;
+	double rate = 0;
+	double resample_rate = 0;
+	int method = RESAMPLE_HOLD;
+	int absolute = 0;
+	char *p;
+	trig_rule_t *rules = NULL;
+	size_t num_rules = 0;
+	char *log_path = NULL;
+	FILE *log = NULL;
+	colsink_info_t info;
+	sink_t *sink;
+	bufwriter_cfg_t cfg = BUFWRITER_DEFAULT_CFG;
+	device_t *devs = NULL;
+	struct sigaction sa;
+
+	while ((opt = getopt(argc, argv, "n:S:c:o:f:zF:r:R:GT:E:q:b:t:s:a:P:C:LJM:Kx:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			if (parse_long(optarg, &num_samples) != 0)
+			{
+				fprintf(stderr, "Invalid number of samples requested.\n");
+				return -1;
+			}
+			have_num_samples = 1;
+			break;
+		case 'S':
+			if (parse_long(optarg, &seg_s) != 0 || seg_s == 0)
+			{
+				fprintf(stderr, "Invalid segment length.\n");
+				return -1;
+			}
+			break;
+		case 'c':
+			if (read_config(optarg) != 0)
+			{
+				return -1;
+			}
+			break;
+		case 'o':
+			out_dir = optarg;
+			break;
+		case 'f':
+			if (strcmp(optarg, "raw") == 0)
+			{
+				raw = 1;
+			}
+			else if (strcmp(optarg, "col") == 0)
+			{
+				raw = 0;
+			}
+			else
+			{
+				fprintf(stderr, "Invalid recording format.\n");
+				return -1;
+			}
+			break;
+		case 'z':
+			compress = 1;
+			break;
+		case 'F':
+			filter = optarg;
+			break;
+		case 'r':
+			rate = atof(optarg);
+			if (rate <= 0)
+			{
+				fprintf(stderr, "Invalid sample rate.\n");
+				return -1;
+			}
+			break;
+		case 'R':
+			resample_rate = strtod(optarg, &p);
+			if (*p == ':')
+			{
+				method = resample_method(p + 1);
+			}
+			else if (*p != '\0')
+			{
+				method = -1;
+			}
+			if (!(resample_rate > 0) || method < 0)
+			{
+				fprintf(stderr, "Invalid resampling, expected e.g. 125:linear.\n");
+				return -1;
+			}
+			rate = resample_rate;
+			break;
+		case 'G':
+			absolute = 1;
+			break;
+		case 'T':
+			free(rules);
+			if (trig_read_config(optarg, &rules, &num_rules) != 0)
+			{
+				return -1;
+			}
+			break;
+		case 'E':
+			log_path = optarg;
+			break;
+		case 'q':
+			if (parse_long(optarg, &val) != 0)
+			{
+				fprintf(stderr, "Invalid queue size.\n");
+				return -1;
+			}
+			queue_size = val;
+			break;
+		case 'b':
+			if (parse_long(optarg, &val) != 0 || val == 0)
+			{
+				fprintf(stderr, "Invalid buffer size.\n");
+				return -1;
+			}
+			cfg.buf_size = val*1024;
+			break;
+		case 't':
+			if (parse_long(optarg, &val) != 0)
+			{
+				fprintf(stderr, "Invalid flush interval.\n");
+				return -1;
+			}
+			cfg.flush_ms = val;
+			break;
+		case 's':
+			if (parse_fsync_policy(optarg, &cfg) != 0)
+			{
+				fprintf(stderr, "Invalid fsync policy.\n");
+				return -1;
+			}
+			break;
+		case 'a':
+			backend = aio_backend_of(optarg);
+			if (backend < 0)
+			{
+				fprintf(stderr, "Invalid write backend.\n");
+				return -1;
+			}
+			break;
+		case 'P':
+			reader_rt.priority = strtol(optarg, &p, 10);
+			if (*p == ':')
+			{
+				writer_rt.priority = strtol(p + 1, &p, 10);
+			}
+			if (*p != '\0' || reader_rt.priority < 1 || reader_rt.priority > 99 ||
+			    writer_rt.priority < 0 || writer_rt.priority > 99)
+			{
+				fprintf(stderr, "Invalid priority, expected e.g. 80 or 80:40.\n");
+				return -1;
+			}
+			break;
+		case 'C':
+			reader_rt.cpus = optarg;
+			p = strchr(optarg, ':');
+			if (p != NULL)
+			{
+				*p = '\0';
+				writer_rt.cpus = p + 1;
+			}
+			if (rt_check_cpus(reader_rt.cpus) != 0 || (writer_rt.cpus != NULL && rt_check_cpus(writer_rt.cpus) != 0))
+			{
+				fprintf(stderr, "Invalid cpus, expected e.g. 3, 2-3 or isolated:0-1.\n");
+				return -1;
+			}
+			break;
+		case 'L':
+			lock_memory = 1;
+			break;
+		case 'J':
+			jitter_report = 1;
+			break;
+		case 'M':
+			metrics_where = optarg;
+			break;
+		case 'K':
+			capture = 1;
+			break;
+		case 'x':
+			speed = strtod(optarg, &p);
+			if (*p != '\0' || p == optarg || speed < 0)
+			{
+				fprintf(stderr, "Invalid replay speed.\n");
+				return -1;
+			}
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n samples] [-S secs] [-c config] [-o dir] [-f col|raw] [-z] [-F filter] [-r rate] [-R rate[:method]] [-G] [-T triggers] [-E log] [-q samples] [-b KiB] [-t flush_ms] [-s never|flush|ms] [-a sync|uring|threads] [-P prio[:prio]] [-C cpus[:cpus]] [-L] [-J] [-M file|[host]:port] [-K] [-x speed] [device ...]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	/* locked before the buffers are allocated, so they are faulted in and
+	 * locked as they are */
+	if (lock_memory && rt_lock_memory() != 0)
+	{
+		return -1;
+	}
+
+	for (i = optind; i < argc; i++)
+	{
+		if (add_joystick(argv[i], NULL) != 0)
+		{
+			return -1;
+		}
+	}
+	if (num_joysticks == 0)
+	{
+		add_joystick(DEFAULT_JOY_DEV, NULL);
+	}
+
+	/* daemon mode records until it is stopped */
+	if (seg_s > 0 && !have_num_samples)
+	{
+		num_samples = 0;
+	}
+
+	devs = calloc(num_joysticks, sizeof(device_t));
+	if (devs == NULL)
+	{
+		return -1;
+	}
+
+	/* each file fills one buffer while up to two are being written */
+	if (backend != AIO_SYNC)
+	{
+		i = aio_init(backend, cfg.buf_size, BUFS_PER_JOYSTICK*num_joysticks + 2);
+		if (i < 0)
+		{
+			fprintf(stderr, "Couldn't start the %s write backend.\n", aio_backend_name(backend));
+			return -1;
+		}
+		if (i != backend)
+		{
+			fprintf(stderr, "io_uring is unavailable, writing with %s.\n", aio_backend_name(i));
+		}
+	}
+
+	if (rules != NULL)
+	{
+		path = (log_path != NULL) ? strdup(log_path) : recording_path(out_dir, "triggers", "log");
+		log = (path != NULL) ? fopen(path, "a") : NULL;
+		if (log == NULL)
+		{
+			fprintf(stderr, "Couldn't open the event log %s.\n", (path != NULL) ? path : "");
+			free(path);
+			return -1;
+		}
+		if (ftell(log) == 0)
+		{
+			fprintf(log, "# time device axis on|off ratio [duration_s peak_ratio peak]\n");
+		}
+		free(path);
+	}
+
+	for (i = 0; i < num_joysticks; i++)
+	{
+		devs[i].path = joysticks[i].dev_path;
+		devs[i].ops = source_for_path(&devs[i].path);
+		devs[i].max_samples = num_samples;
+
+		if (capture)
+		{
+			if (devs[i].ops != &joydev_source && devs[i].ops != &evdev_source)
+			{
+				fprintf(stderr, "Can't capture %s, only the joystick and event interfaces can be.\n", devs[i].path);
+				err_code = -1;
+				continue;
+			}
+			path = recording_path(out_dir, devs[i].path, "evc");
+			devs[i].capture = (path != NULL) ? evcap_create(path) : NULL;
+			if (devs[i].capture == NULL)
+			{
+				fprintf(stderr, "Couldn't create the capture %s.\n", (path != NULL) ? path : "");
+				err_code = -1;
+			}
+			free(path);
+		}
+
+		path = (joysticks[i].rec_path != NULL) ? strdup(joysticks[i].rec_path)
+		                                       : recording_path(out_dir, devs[i].path, seg_s > 0 ? NULL : raw ? "bin" : "jsc");
+		if (path == NULL)
+		{
+			err_code = -1;
+			continue;
+		}
+		info.device = devs[i].path;
+		info.filter = filter;
+		info.sample_rate = rate;
+		info.codec = compress ? COLREC_CODEC_DELTA : COLREC_CODEC_NONE;
+		info.created_us = 0;
+		if (seg_s > 0)
+		{
+			prefix = strrchr(path, '/');
+			prefix = (prefix != NULL) ? prefix + 1 : path;
+			sink = segsink_open(path, prefix, seg_s, &info, &cfg);
+		}
+		else if (raw)
+		{
+			sink = rawsink_open(path, &cfg);
+		}
+		else
+		{
+			sink = colsink_open(path, &info, &cfg);
+		}
+		if (resample_rate > 0)
+		{
+			sink = resink_open(resample_rate, method, absolute, sink);
+		}
+		if (device_add_sink(&devs[i], sink) != 0)
+		{
+			err_code = -1;
+		}
+		if (log != NULL && device_add_sink(&devs[i], trigsink_open(devs[i].path, rules, num_rules, log)) != 0)
+		{
+			err_code = -1;
+		}
+		free(path);
+	}
+
+	/* stop cleanly on ^C so the buffered samples are written */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = handle_signal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	/* The USB polling rate for the JoyWarrior is one report every 8 ms (125 Hz).
+	 * A report contains all the updated data for each axis and button. All
+	 * the events waiting are read at once, so the loop only has to keep up
+	 * with the report rate rather than the event rate.
+	 */
+	if (err_code == 0)
+	{
+		acq_set_queue(queue_size);
+		replay_set_speed(speed);
+		acq_set_sched(&reader_rt, &writer_rt);
+		if (metrics_where != NULL && metrics_start(devs, num_joysticks, metrics_where, rate) != 0)
+		{
+			err_code = -1;
+		}
+	}
+	if (err_code == 0)
+	{
+		err_code = acq_run(devs, num_joysticks, TICK_MS);
+		metrics_stop();
+	}
+	else
+	{
+		for (i = 0; i < num_joysticks; i++)
+		{
+			while (devs[i].num_sinks > 0)
+			{
+				devs[i].num_sinks--;
+				devs[i].sinks[devs[i].num_sinks]->close(devs[i].sinks[devs[i].num_sinks]);
+			}
+			if (devs[i].capture != NULL)
+			{
+				fclose(devs[i].capture);
+			}
+		}
+	}
+
+	for (i = 0; i < num_joysticks; i++)
+	{
+		fprintf(stdout, "%s: %llu samples", devs[i].path, (unsigned long long)devs[i].num_samples);
+		if (queue_size > 0)
+		{
+			fprintf(stdout, ", at most %llu queued, %llu dropped", (unsigned long long)devs[i].queue_high_water,
+			        (unsigned long long)devs[i].queue_dropped);
+		}
+		fprintf(stdout, "\n");
+		if (jitter_report)
+		{
+			jitter_print(&devs[i].arrivals, devs[i].path, stdout);
+		}
+		free(joysticks[i].dev_path);
+		free(joysticks[i].rec_path);
+	}
+	free(devs);
+	aio_shutdown();
+	if (log != NULL)
+	{
+		fclose(log);
+	}
+	free(rules);
+
+	return err_code;
+}
@@ -0,0 +1,300 @@
+/* Streaming resampler onto a regular time grid. See resample.h.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "resample.h"
+
+#define HIST_MASK (RESAMPLE_HISTORY - 1)
+
+/* weight of the old estimate of the input spacing */
+#define PERIOD_SMOOTHING 64
+
+static const char *const method_name[] = { "hold", "linear", "sinc" };
+
+int resample_method(const char *name)
+{
+	int i;
+
+	for (i = 0; i < (int)(sizeof(method_name)/sizeof(method_name[0])); i++)
+	{
+		if (strcmp(name, method_name[i]) == 0)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static double grid_time(const resampler_t *r, uint64_t k)
+{
+	return r->t0 + k*1e6/r->rate;
+}
+
+static const rsample_t *hist_at(const resampler_t *r, uint64_t i)
+{
+	return &r->hist[i & HIST_MASK];
+}
+
+static int flush_batch(resampler_t *r)
+{
+	int err_code = 0;
+
+	if (r->num_batch > 0)
+	{
+		err_code = r->out(r->ctx, r->batch, r->num_batch);
+		r->num_out += r->num_batch;
+		r->num_batch = 0;
+	}
+
+	return err_code;
+}
+
+/* half width of the sinc window and its cut off frequency */
+static double sinc_window(const resampler_t *r, double *fc)
+{
+	double in_rate = (r->in_period_us > 0) ? 1e6/r->in_period_us : r->rate;
+
+	*fc = 0.45*((in_rate < r->rate) ? in_rate : r->rate);
+	return r->taps/(2*(*fc))*1e6;
+}
+
+static void value_at(resampler_t *r, double tk, double *v)
+{
+	const rsample_t *a;
+	const rsample_t *b;
+	double fc, half, d, x, w, sum_w;
+	double sum[NUM_AXES];
+	uint64_t i;
+	int j;
+
+	/* older samples have been overwritten */
+	if (r->num_in - r->lo > RESAMPLE_HISTORY)
+	{
+		r->lo = r->num_in - RESAMPLE_HISTORY;
+	}
+
+	if (r->method != RESAMPLE_SINC)
+	{
+		while (r->lo + 1 < r->num_in && hist_at(r, r->lo + 1)->t_us <= tk)
+		{
+			r->lo++;
+		}
+		a = hist_at(r, r->lo);
+		if (r->method == RESAMPLE_LINEAR && r->lo + 1 < r->num_in)
+		{
+			b = hist_at(r, r->lo + 1);
+			x = (tk - a->t_us)/(double)(b->t_us - a->t_us);
+			for (j = 0; j < NUM_AXES; j++)
+			{
+				v[j] = a->axis[j] + x*(b->axis[j] - a->axis[j]);
+			}
+		}
+		else
+		{
+			memcpy(v, a->axis, sizeof(a->axis));
+		}
+		return;
+	}
+
+	half = sinc_window(r, &fc);
+	while (r->lo + 1 < r->num_in && hist_at(r, r->lo)->t_us <= tk - half)
+	{
+		r->lo++;
+	}
+
+	sum_w = 0;
+	memset(sum, 0, sizeof(sum));
+	for (i = r->lo; i < r->num_in && hist_at(r, i)->t_us < tk + half; i++)
+	{
+		a = hist_at(r, i);
+		d = a->t_us - tk;
+		x = 2*fc*d/1e6;
+		w = (x == 0) ? 1 : sin(M_PI*x)/(M_PI*x);
+		w *= 0.42 + 0.5*cos(M_PI*d/half) + 0.08*cos(2*M_PI*d/half);
+		/* each sample stands for the time half way to its neighbours */
+		w *= ((i + 1 < r->num_in) ? hist_at(r, i + 1)->t_us : a->t_us + r->in_period_us) -
+		     ((i > r->lo) ? hist_at(r, i - 1)->t_us : a->t_us - r->in_period_us);
+		for (j = 0; j < NUM_AXES; j++)
+		{
+			sum[j] += w*a->axis[j];
+		}
+		sum_w += w;
+	}
+
+	/* nothing near enough, e.g. at the edge of a gap */
+	if (fabs(sum_w) < 1e-3)
+	{
+		memcpy(v, hist_at(r, r->lo)->axis, sizeof(sum));
+		return;
+	}
+	for (j = 0; j < NUM_AXES; j++)
+	{
+		v[j] = sum[j]/sum_w;
+	}
+}
+
+/* Produces every output before t_end the input allows, or that the input
+ * has at all if final is set. */
+static int emit_ready(resampler_t *r, uint64_t t_end, int final)
+{
+	const rsample_t *last = hist_at(r, r->num_in - 1);
+	double fc;
+	double lag = (r->method == RESAMPLE_SINC && !final) ? sinc_window(r, &fc) : 0;
+	double tk;
+	rsample_t *o;
+
+	for (tk = grid_time(r, r->k); (final || tk + lag < t_end) && tk <= last->t_us; tk = grid_time(r, ++r->k))
+	{
+		o = &r->batch[r->num_batch];
+		o->t_us = llround(tk);
+		value_at(r, tk, o->axis);
+		if (++r->num_batch == RESAMPLE_BATCH && flush_batch(r) != 0)
+		{
+			r->k++;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void start_grid(resampler_t *r, uint64_t t_us)
+{
+	if (r->absolute)
+	{
+		r->t0 = 0;
+		r->k = (uint64_t)ceil(t_us*r->rate/1e6);
+	}
+	else
+	{
+		r->t0 = t_us;
+		r->k = 0;
+	}
+	r->num_in = 0;
+	r->lo = 0;
+	r->in_period_us = 0;
+	r->started = 1;
+}
+
+int resampler_push(resampler_t *r, const sample_t *in, size_t n)
+{
+	rsample_t *h;
+	const rsample_t *last;
+	uint64_t dt;
+	uint64_t t_end;
+	size_t i;
+	int j;
+
+	for (i = 0; i < n; i++)
+	{
+		if (!r->started)
+		{
+			start_grid(r, in[i].t_us);
+		}
+		else
+		{
+			last = hist_at(r, r->num_in - 1);
+			if (in[i].t_us < last->t_us || in[i].t_us - last->t_us > r->max_gap_us)
+			{
+				/* a gap, or the clock went back: finish and start over */
+				if (emit_ready(r, last->t_us, 1) != 0)
+				{
+					return -1;
+				}
+				start_grid(r, in[i].t_us);
+			}
+			else if (in[i].t_us == last->t_us)
+			{
+				/* the later of two samples at the same time wins */
+				r->num_in--;
+			}
+			else
+			{
+				dt = in[i].t_us - last->t_us;
+				r->in_period_us = (r->in_period_us > 0) ? r->in_period_us + (dt - r->in_period_us)/PERIOD_SMOOTHING
+				                                        : dt;
+			}
+		}
+
+		h = &r->hist[r->num_in & HIST_MASK];
+		h->t_us = in[i].t_us;
+		for (j = 0; j < NUM_AXES; j++)
+		{
+			h->axis[j] = in[i].axis[j];
+		}
+		r->num_in++;
+
+		/* another sample at the same time would replace the newest, so
+		 * only what doesn't depend on it is final: up to its time for
+		 * hold and sinc, whose window stops short of it, and up to the
+		 * one before it for linear */
+		t_end = in[i].t_us;
+		if (r->method == RESAMPLE_LINEAR)
+		{
+			t_end = (r->num_in > 1) ? hist_at(r, r->num_in - 2)->t_us : 0;
+		}
+		if (emit_ready(r, t_end, 0) != 0)
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Produces the outputs still held back, e.g. at the end of a recording.
+ * Input pushed after this starts a new grid. */
+int resampler_flush(resampler_t *r)
+{
+	int err_code = 0;
+
+	if (r->started && r->num_in > 0)
+	{
+		err_code = emit_ready(r, hist_at(r, r->num_in - 1)->t_us, 1);
+	}
+	r->started = 0;
+	err_code |= flush_batch(r);
+
+	return err_code;
+}
+
+int resampler_init(resampler_t *r, double rate, int method, int taps, uint64_t max_gap_us,
+                   resample_out_t out, void *ctx)
+{
+	memset(r, 0, sizeof(*r));
+	if (!(rate > 0) || method < RESAMPLE_HOLD || method > RESAMPLE_SINC || taps < 1 || out == NULL)
+	{
+		return -1;
+	}
+
+	r->hist = malloc(RESAMPLE_HISTORY*sizeof(rsample_t));
+	if (r->hist == NULL)
+	{
+		return -1;
+	}
+	r->method = method;
+	r->rate = rate;
+	r->taps = taps;
+	r->max_gap_us = max_gap_us;
+	r->out = out;
+	r->ctx = ctx;
+
+	return 0;
+}
+
+/* Puts the grid on the multiples of 1/rate of the device clock rather
+ * than starting it at the first sample. Call before the first push. */
+void resampler_set_absolute(resampler_t *r, int absolute)
+{
+	r->absolute = absolute;
+}
+
+void resampler_free(resampler_t *r)
+{
+	free(r->hist);
+	r->hist = NULL;
+}
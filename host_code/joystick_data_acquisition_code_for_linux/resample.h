@@ -0,0 +1,86 @@
+/* Streaming resampler onto a regular time grid.
+ *
+ * Samples can arrive at irregular times, e.g. the joystick driver only
+ * reports an axis when its value changes. The resampler turns them into
+ * samples every 1/rate seconds from the first sample on, like fillin.m's
+ * t(1):8:t(end). With resampler_set_absolute() the grid is the multiples
+ * of 1/rate seconds of the device clock instead, so recordings of several
+ * devices that share a clock line up sample for sample. Output is produced
+ * as input arrives, in batches handed to a callback, and the memory used
+ * doesn't depend on how long it runs.
+ *
+ * Methods:
+ *   hold     the last value at or before the grid time (what fillin.m did)
+ *   linear   straight line between the samples either side. Output waits
+ *            for the input after the sample to its right, in case another
+ *            sample at the same time replaces that one.
+ *   sinc     Blackman windowed sinc over taps zero crossings either side,
+ *            low pass at 0.45 of the lower of the input and output rates
+ *            so downsampling doesn't alias. Each weight is scaled by the
+ *            time its sample stands for and the weights are normalised,
+ *            which copes with some jitter. Output lags the input by the
+ *            half width of the window, and the window is clipped to the
+ *            last RESAMPLE_HISTORY samples.
+ *
+ * A gap in the input longer than max_gap_us isn't filled in; the grid
+ * starts again after it, at the first sample unless it is absolute.
+ */
+
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sample.h"
+
+#define RESAMPLE_HOLD 0
+#define RESAMPLE_LINEAR 1
+#define RESAMPLE_SINC 2
+
+#define RESAMPLE_DEFAULT_TAPS 16
+#define RESAMPLE_DEFAULT_MAX_GAP_US 1000000
+#define RESAMPLE_HISTORY 4096     /* input samples kept, a power of two */
+#define RESAMPLE_BATCH 256        /* output samples per callback */
+
+typedef struct
+{
+	uint64_t t_us;
+	double axis[NUM_AXES];
+} rsample_t;
+
+/* receives the next n output samples, returns 0 or -1 to stop */
+typedef int (*resample_out_t)(void *ctx, const rsample_t *out, size_t n);
+
+typedef struct
+{
+	int method;
+	double rate;
+	int absolute;             /* grid on multiples of 1/rate, not from the first sample */
+	int taps;
+	uint64_t max_gap_us;
+	resample_out_t out;
+	void *ctx;
+
+	rsample_t *hist;          /* the last input samples, a ring */
+	uint64_t num_in;          /* input samples since the grid started */
+	uint64_t lo;              /* first input the next output can use */
+	double in_period_us;      /* running estimate of the input spacing */
+	uint64_t t0;              /* time of grid index 0 */
+	uint64_t k;               /* grid index of the next output */
+	int started;
+
+	rsample_t batch[RESAMPLE_BATCH];
+	size_t num_batch;
+	uint64_t num_out;
+} resampler_t;
+
+int resample_method(const char *name);
+int resampler_init(resampler_t *r, double rate, int method, int taps, uint64_t max_gap_us,
+                   resample_out_t out, void *ctx);
+void resampler_set_absolute(resampler_t *r, int absolute);
+int resampler_push(resampler_t *r, const sample_t *in, size_t n);
+int resampler_flush(resampler_t *r);
+void resampler_free(resampler_t *r);
+
+#endif
@@ -0,0 +1,363 @@
+/* Tests of the streaming resampler in resample.c. Built and run with
+ *
+ *   make check
+ *
+ * The input is pushed a few samples at a time, the way the sinks push it,
+ * and the output collected from the callback. The tests cover
+ *   - hold and linear on the input's own grid, which must give the input
+ *     back, and between its samples,
+ *   - linear on a ramp sampled at irregular times, which it must follow
+ *     exactly,
+ *   - sinc on a constant, which the normalised weights must keep exactly,
+ *     and on a sine well inside the pass band, jittered input included,
+ *   - the grid starting at the first sample, or on the multiples of the
+ *     period with resampler_set_absolute(),
+ *   - gaps longer than max_gap_us, which are not filled in and restart the
+ *     grid, and the clock going back,
+ *   - duplicate time stamps, where the later sample wins,
+ *   - a callback that asks to stop.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "resample.h"
+
+#define MAX_N 20000
+
+static int failures;
+
+static sample_t in[MAX_N];
+static rsample_t out[MAX_N];
+static size_t num_out;
+static size_t stop_after;
+
+static void check(int ok, const char *what)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "FAIL: %s\n", what);
+		failures++;
+	}
+}
+
+static int collect(void *ctx, const rsample_t *o, size_t n)
+{
+	(void)ctx;
+	if (num_out + n > MAX_N)
+	{
+		return -1;
+	}
+	memcpy(out + num_out, o, n*sizeof(*o));
+	num_out += n;
+
+	return (stop_after > 0 && num_out >= stop_after) ? -1 : 0;
+}
+
+static void put(size_t i, uint64_t t_us, double x)
+{
+	int a;
+
+	memset(&in[i], 0, sizeof(in[i]));
+	in[i].t_us = t_us;
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		in[i].axis[a] = (int32_t)lround(x) + a;
+	}
+}
+
+/* Resamples the first n inputs, pushed 7 at a time. Returns the result of
+ * the last call. */
+static int run(double rate, int method, int absolute, size_t n)
+{
+	resampler_t r;
+	size_t i;
+	size_t m;
+	int err_code = 0;
+
+	num_out = 0;
+	if (resampler_init(&r, rate, method, RESAMPLE_DEFAULT_TAPS, RESAMPLE_DEFAULT_MAX_GAP_US,
+	                   collect, NULL) != 0)
+	{
+		check(0, "resampler_init");
+		return -1;
+	}
+	resampler_set_absolute(&r, absolute);
+	for (i = 0; i < n && err_code == 0; i += m)
+	{
+		m = (n - i < 7) ? n - i : 7;
+		err_code = resampler_push(&r, in + i, m);
+	}
+	if (err_code == 0)
+	{
+		err_code = resampler_flush(&r);
+	}
+	resampler_free(&r);
+
+	return err_code;
+}
+
+/* the output at time t_us, or NULL */
+static const rsample_t *out_at(uint64_t t_us)
+{
+	size_t i;
+
+	for (i = 0; i < num_out; i++)
+	{
+		if (out[i].t_us == t_us)
+		{
+			return &out[i];
+		}
+	}
+
+	return NULL;
+}
+
+static int on_grid(uint64_t t0, double period_us)
+{
+	size_t i;
+
+	for (i = 0; i < num_out; i++)
+	{
+		if (out[i].t_us != (uint64_t)llround(t0 + i*period_us))
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static void test_hold(void)
+{
+	size_t n = 1000;
+	size_t i;
+	int ok = 1;
+	int a;
+
+	for (i = 0; i < n; i++)
+	{
+		put(i, 3000 + 8000*(uint64_t)i, 500 + (i*37) % 101);
+	}
+
+	run(125, RESAMPLE_HOLD, 0, n);
+	check(num_out == n, "hold on the input's grid gives every sample");
+	for (i = 0; i < num_out && i < n; i++)
+	{
+		for (a = 0; a < NUM_AXES; a++)
+		{
+			ok &= (out[i].t_us == in[i].t_us && out[i].axis[a] == in[i].axis[a]);
+		}
+	}
+	check(ok, "hold on the input's grid gives the input back");
+
+	/* twice the rate: every sample twice */
+	run(250, RESAMPLE_HOLD, 0, n);
+	check(num_out == 2*n - 1, "hold at twice the rate");
+	ok = on_grid(3000, 4000);
+	for (i = 0; i < num_out; i++)
+	{
+		ok &= (out[i].axis[0] == in[i/2].axis[0]);
+	}
+	check(ok, "hold holds the last sample at or before the grid time");
+}
+
+static void test_linear(void)
+{
+	size_t n = 2000;
+	size_t i;
+	uint64_t t = 1000000;
+	int ok = 1;
+	int a;
+
+	/* a ramp of 1 count per ms, sampled every 4 to 12 ms */
+	srand(1);
+	for (i = 0; i < n; i++)
+	{
+		put(i, t, (t - 1000000)/1000.0);
+		t += 4000 + 1000*(rand() % 9);
+	}
+
+	run(125, RESAMPLE_LINEAR, 0, n);
+	check(num_out == (in[n - 1].t_us - in[0].t_us)/8000 + 1, "linear gives every grid point up to the last sample");
+	check(on_grid(in[0].t_us, 8000), "the grid starts at the first sample");
+	for (i = 0; i < num_out; i++)
+	{
+		for (a = 0; a < NUM_AXES; a++)
+		{
+			ok &= (fabs(out[i].axis[a] - ((out[i].t_us - 1000000)/1000.0 + a)) < 1e-6);
+		}
+	}
+	check(ok, "linear follows a ramp exactly");
+
+	/* a grid that doesn't line up with the input: half way is the mean */
+	for (i = 0; i < 10; i++)
+	{
+		put(i, 8000*(uint64_t)i, (i % 2) ? 100 : 0);
+	}
+	run(125, RESAMPLE_LINEAR, 0, 10);
+	check(num_out == 10, "linear on the input's grid");
+	run(250, RESAMPLE_LINEAR, 0, 10);
+	check(num_out == 19 && out[1].axis[0] == 50 && out[2].axis[0] == 100 && out[3].axis[0] == 50,
+	      "linear half way between samples");
+}
+
+static void test_sinc(void)
+{
+	size_t n = 8000;
+	size_t i;
+	double err = 0;
+	double want;
+	int ok = 1;
+	int a;
+
+	for (i = 0; i < n; i++)
+	{
+		put(i, 5000 + 1000*(uint64_t)i, 700);
+	}
+	run(125, RESAMPLE_SINC, 0, n);
+	check(num_out == (n - 1)/8 + 1, "sinc gives every grid point up to the last sample");
+	for (i = 0; i < num_out; i++)
+	{
+		for (a = 0; a < NUM_AXES; a++)
+		{
+			ok &= (fabs(out[i].axis[a] - (700 + a)) < 1e-9);
+		}
+	}
+	check(ok, "sinc keeps a constant");
+
+	/* 5 Hz at 1000 samples/s with up to 200 us of jitter down to 125
+	 * samples/s, whose pass band ends at 56 Hz. Away from the ends the
+	 * sine must come through. */
+	srand(2);
+	for (i = 0; i < n; i++)
+	{
+		in[i].t_us = 5000 + 1000*(uint64_t)i + rand() % 200;
+		want = 1000*sin(2*M_PI*5*in[i].t_us/1e6);
+		for (a = 0; a < NUM_AXES; a++)
+		{
+			in[i].axis[a] = (int32_t)lround(want);
+		}
+	}
+	run(125, RESAMPLE_SINC, 0, n);
+	for (i = 0; i < num_out; i++)
+	{
+		if (out[i].t_us < in[0].t_us + 200000 || out[i].t_us > in[n - 1].t_us - 200000)
+		{
+			continue;
+		}
+		want = 1000*sin(2*M_PI*5*out[i].t_us/1e6);
+		if (fabs(out[i].axis[0] - want) > err)
+		{
+			err = fabs(out[i].axis[0] - want);
+		}
+	}
+	check(err < 5, "sinc passes a sine in its pass band");
+}
+
+static void test_absolute(void)
+{
+	size_t n = 100;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+	{
+		put(i, 3000 + 8000*(uint64_t)i, i);
+	}
+	run(125, RESAMPLE_HOLD, 1, n);
+	check(num_out > 0 && out[0].t_us == 8000 && on_grid(8000, 8000),
+	      "an absolute grid is on the multiples of the period");
+	check(num_out == n - 1, "an absolute grid ends at the last sample");
+	check(num_out > 0 && out[0].axis[0] == 0 && out[1].axis[0] == 1, "hold on an absolute grid");
+}
+
+static void test_gaps(void)
+{
+	size_t i;
+	int in_gap = 0;
+
+	/* 10 samples, a 2 s gap, 10 more that start off the old grid */
+	for (i = 0; i < 10; i++)
+	{
+		put(i, 8000*(uint64_t)i, 10);
+		put(10 + i, 2000000 + 3000 + 8000*(uint64_t)i, 20);
+	}
+	run(125, RESAMPLE_LINEAR, 0, 20);
+	check(num_out == 20, "a gap isn't filled in");
+	for (i = 0; i < num_out; i++)
+	{
+		in_gap |= (out[i].t_us > 72000 && out[i].t_us < 2003000);
+	}
+	check(!in_gap, "no output inside a gap");
+	check(out_at(2003000) != NULL && out_at(2003000)->axis[0] == 20 && out_at(2075000) != NULL,
+	      "the grid starts again at the first sample after a gap");
+	check(out_at(72000) != NULL && out_at(72000)->axis[0] == 10, "the grid runs up to the gap");
+
+	/* the clock going back starts the grid again too */
+	for (i = 0; i < 10; i++)
+	{
+		put(i, 1000000 + 8000*(uint64_t)i, 10);
+		put(10 + i, 500000 + 8000*(uint64_t)i, 20);
+	}
+	run(125, RESAMPLE_HOLD, 0, 20);
+	check(num_out == 20 && out[10].t_us == 500000 && out[10].axis[0] == 20,
+	      "the clock going back starts the grid again");
+}
+
+static void test_duplicates(void)
+{
+	put(0, 0, 1);
+	put(1, 8000, 2);
+	put(2, 8000, 5);
+	put(3, 16000, 3);
+	put(4, 16000, 7);
+	put(5, 16000, 9);
+	put(6, 24000, 4);
+
+	run(125, RESAMPLE_HOLD, 0, 7);
+	check(num_out == 4, "duplicate time stamps give one output");
+	check(num_out == 4 && out[1].axis[0] == 5 && out[2].axis[0] == 9 && out[3].axis[0] == 4,
+	      "the later of two samples at the same time wins");
+
+	run(250, RESAMPLE_LINEAR, 0, 7);
+	check(num_out == 7 && out[1].axis[0] == 3 && out[3].axis[0] == 7,
+	      "linear uses the later of two samples at the same time");
+}
+
+static void test_stop(void)
+{
+	size_t n = 10000;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+	{
+		put(i, 8000*(uint64_t)i, i);
+	}
+	stop_after = RESAMPLE_BATCH;
+	check(run(125, RESAMPLE_HOLD, 0, n) != 0, "a callback can stop the resampler");
+	check(num_out == RESAMPLE_BATCH, "nothing is output after the callback stops");
+	stop_after = 0;
+}
+
+int main(void)
+{
+	test_hold();
+	test_linear();
+	test_sinc();
+	test_absolute();
+	test_gaps();
+	test_duplicates();
+	test_stop();
+
+	if (failures > 0)
+	{
+		fprintf(stderr, "resample_test: %d check(s) failed.\n", failures);
+		return 1;
+	}
+	fprintf(stdout, "resample_test: all checks passed.\n");
+
+	return 0;
+}
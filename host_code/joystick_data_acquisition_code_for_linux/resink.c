@@ -0,0 +1,107 @@
+/* Sink that resamples samples onto a regular grid (see resample.h) and
+ * passes them on to another sink, which it owns.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "acq.h"
+#include "resample.h"
+
+typedef struct
+{
+	sink_t sink;
+	resampler_t r;
+	sink_t *next;
+	uint16_t dev;
+} resink_t;
+
+static int forward(void *ctx, const rsample_t *out, size_t n)
+{
+	resink_t *rs = ctx;
+	sample_t s[RESAMPLE_BATCH];
+	size_t i;
+	int a;
+
+	for (i = 0; i < n; i++)
+	{
+		s[i].t_us = out[i].t_us;
+		for (a = 0; a < NUM_AXES; a++)
+		{
+			s[i].axis[a] = (int32_t)lround(out[i].axis[a]);
+		}
+		s[i].dev = rs->dev;
+		s[i].updated = (1 << NUM_AXES) - 1;
+	}
+
+	return rs->next->write(rs->next, s, n);
+}
+
+static int resink_write(sink_t *s, const sample_t *samples, size_t n)
+{
+	resink_t *rs = (resink_t *)s;
+
+	if (n > 0)
+	{
+		rs->dev = samples[0].dev;
+	}
+
+	return resampler_push(&rs->r, samples, n);
+}
+
+static int resink_tick(sink_t *s)
+{
+	resink_t *rs = (resink_t *)s;
+
+	return (rs->next->tick != NULL) ? rs->next->tick(rs->next) : 0;
+}
+
+static uint64_t resink_bytes(sink_t *s)
+{
+	resink_t *rs = (resink_t *)s;
+
+	return (rs->next->bytes != NULL) ? rs->next->bytes(rs->next) : 0;
+}
+
+static int resink_close(sink_t *s)
+{
+	resink_t *rs = (resink_t *)s;
+	int err_code;
+
+	err_code = resampler_flush(&rs->r);
+	err_code |= rs->next->close(rs->next);
+	resampler_free(&rs->r);
+	free(rs);
+
+	return err_code;
+}
+
+/* Resamples to rate samples/s with one of the RESAMPLE_ methods before
+ * next, on the absolute grid if absolute is set (see resample.h). next is
+ * closed along with the sink, even if opening fails. */
+sink_t *resink_open(double rate, int method, int absolute, sink_t *next)
+{
+	resink_t *rs;
+
+	if (next == NULL)
+	{
+		return NULL;
+	}
+
+	rs = calloc(1, sizeof(*rs));
+	if (rs == NULL || resampler_init(&rs->r, rate, method, RESAMPLE_DEFAULT_TAPS,
+	                                 RESAMPLE_DEFAULT_MAX_GAP_US, forward, rs) != 0)
+	{
+		free(rs);
+		next->close(next);
+		return NULL;
+	}
+	resampler_set_absolute(&rs->r, absolute);
+	rs->sink.write = resink_write;
+	rs->sink.tick = resink_tick;
+	rs->sink.close = resink_close;
+	rs->sink.bytes = resink_bytes;
+	rs->next = next;
+
+	return &rs->sink;
+}
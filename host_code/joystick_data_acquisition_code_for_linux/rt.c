@@ -0,0 +1,159 @@
+/* Real-time settings for the acquisition threads. See rt.h. */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "rt.h"
+
+#define ISOLATED_PATH "/sys/devices/system/cpu/isolated"
+
+/* Parses a cpu list such as "0,2-3" into set. */
+static int parse_list(const char *s, cpu_set_t *set)
+{
+	char *p;
+	long lo, hi;
+
+	CPU_ZERO(set);
+	while (*s != '\0' && *s != '\n')
+	{
+		lo = strtol(s, &p, 10);
+		if (p == s || lo < 0)
+		{
+			return -1;
+		}
+		hi = lo;
+		if (*p == '-')
+		{
+			s = p + 1;
+			hi = strtol(s, &p, 10);
+			if (p == s || hi < lo)
+			{
+				return -1;
+			}
+		}
+		if (hi >= CPU_SETSIZE)
+		{
+			return -1;
+		}
+		for (; lo <= hi; lo++)
+		{
+			CPU_SET(lo, set);
+		}
+		s = p;
+		if (*s == ',')
+		{
+			s++;
+		}
+		else if (*s != '\0' && *s != '\n')
+		{
+			return -1;
+		}
+	}
+
+	return (CPU_COUNT(set) > 0) ? 0 : -1;
+}
+
+static int cpus_of(const char *cpus, cpu_set_t *set)
+{
+	char line[256];
+	FILE *f;
+	int err_code;
+
+	if (strcmp(cpus, "isolated") != 0)
+	{
+		return parse_list(cpus, set);
+	}
+
+	f = fopen(ISOLATED_PATH, "r");
+	if (f == NULL)
+	{
+		return -1;
+	}
+	err_code = (fgets(line, sizeof(line), f) != NULL) ? parse_list(line, set) : -1;
+	fclose(f);
+	if (err_code != 0)
+	{
+		fprintf(stderr, "No cores are isolated (see isolcpus= in the kernel parameters).\n");
+	}
+
+	return err_code;
+}
+
+/* Checks a cpu list when it is given, long before it is applied. */
+int rt_check_cpus(const char *cpus)
+{
+	cpu_set_t set;
+
+	return cpus_of(cpus, &set);
+}
+
+/* Applies cfg to thread, called name in the messages. */
+int rt_apply(const rt_cfg_t *cfg, pthread_t thread, const char *name)
+{
+	struct sched_param sp;
+	cpu_set_t set;
+	int err;
+	int err_code = 0;
+
+	if (cfg->cpus != NULL)
+	{
+		if (cpus_of(cfg->cpus, &set) != 0)
+		{
+			fprintf(stderr, "Invalid cpus %s for the %s thread.\n", cfg->cpus, name);
+			err_code = -1;
+		}
+		else if ((err = pthread_setaffinity_np(thread, sizeof(set), &set)) != 0)
+		{
+			fprintf(stderr, "Couldn't pin the %s thread to cpus %s: %s.\n", name, cfg->cpus, strerror(err));
+			err_code = -1;
+		}
+	}
+
+	if (cfg->priority > 0)
+	{
+		memset(&sp, 0, sizeof(sp));
+		sp.sched_priority = cfg->priority;
+		if ((err = pthread_setschedparam(thread, SCHED_FIFO, &sp)) != 0)
+		{
+			fprintf(stderr, "Couldn't run the %s thread at SCHED_FIFO priority %d: %s.\n",
+			        name, cfg->priority, strerror(err));
+			err_code = -1;
+		}
+	}
+
+	return err_code;
+}
+
+/* Locks all the memory of the process, now and to come, and faults in
+ * RT_STACK_PREFAULT bytes of the calling thread's stack. malloc is told to
+ * keep the memory it frees and to take big blocks from the heap too, so
+ * buffers allocated later are locked in and never given back to be
+ * faulted in again. */
+int rt_lock_memory(void)
+{
+	volatile char stack[RT_STACK_PREFAULT];
+	size_t i;
+
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+	{
+		fprintf(stderr, "Couldn't lock the memory: %s.\n", strerror(errno));
+		return -1;
+	}
+
+	for (i = 0; i < sizeof(stack); i += 4096)
+	{
+		stack[i] = 0;
+	}
+
+	return 0;
+}
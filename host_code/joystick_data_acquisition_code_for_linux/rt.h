@@ -0,0 +1,40 @@
+/* Real-time settings for the acquisition threads.
+ *
+ * A recorder running as an ordinary process is delayed by whatever else the
+ * machine is doing and can take a page fault in the middle of a read, which
+ * shows up as jitter in when the samples arrive (see jitter.h). Three
+ * things help:
+ *
+ *   - SCHED_FIFO, so the reading thread runs as soon as a report is ready
+ *     instead of waiting for its turn. Needs root or CAP_SYS_NICE (or an
+ *     rtprio limit in /etc/security/limits.conf).
+ *   - pinning the thread to a core of its own, ideally one kept free of
+ *     other tasks with the isolcpus= kernel parameter. "isolated" picks
+ *     the cores listed in /sys/devices/system/cpu/isolated.
+ *   - locking the memory, so nothing the threads touch is ever paged out
+ *     or faulted in for the first time while recording. Needs root or a
+ *     big enough RLIMIT_MEMLOCK.
+ *
+ * A setting that can't be applied is reported and the recorder gives up,
+ * since a recording made without it would not be what was asked for.
+ */
+
+#ifndef RT_H
+#define RT_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#define RT_STACK_PREFAULT (256*1024)
+
+typedef struct
+{
+	int priority;             /* SCHED_FIFO priority 1 to 99, 0 = leave as is */
+	const char *cpus;         /* e.g. "3", "2-3,6" or "isolated", NULL = any */
+} rt_cfg_t;
+
+int rt_check_cpus(const char *cpus);
+int rt_apply(const rt_cfg_t *cfg, pthread_t thread, const char *name);
+int rt_lock_memory(void);
+
+#endif
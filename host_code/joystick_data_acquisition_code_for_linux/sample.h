@@ -0,0 +1,70 @@
+/* Sample and record definitions shared by the acquisition tools.
+ *
+ * A sample holds one value for each accelerometer axis. The Linux joystick
+ * driver only reports an axis when its value changes, so the axes that
+ * actually changed are flagged in `updated'; the other axes hold the last
+ * value reported for them.
+ *
+ * Sources that report on what happened between two samples, such as the
+ * peak-hold firmware over hidraw, fill in the statistics fields and flag
+ * them in `updated' too. The fields aren't set otherwise.
+ */
+
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <stdint.h>
+
+#define NUM_AXES 3
+
+typedef struct
+{
+	uint64_t t_us;            /* time stamp in microseconds */
+	int32_t axis[NUM_AXES];   /* x, y and z */
+	uint16_t dev;             /* index of the device the sample came from */
+	uint16_t updated;         /* bit n is set if axis n changed, and SAMPLE_ flags */
+
+	/* statistics of the sensor readings since the previous sample */
+	int16_t min[NUM_AXES];    /* if SAMPLE_PEAKS is set */
+	int16_t max[NUM_AXES];
+	uint32_t sumsq[NUM_AXES]; /* if SAMPLE_SUMSQ is set */
+	uint32_t readings;
+} sample_t;
+
+#define SAMPLE_PEAKS (1 << 8)
+#define SAMPLE_SUMSQ (1 << 9)
+
+/* The raw recording format is a header followed by fixed width records,
+ * one per sample, with the axes interleaved. Records are 16 bytes so they
+ * never straddle a block boundary. All fields are little endian. */
+#define RAWREC_MAGIC "JSREC\0\0\1"
+
+typedef struct
+{
+	char magic[8];
+	uint32_t record_size;
+	uint32_t reserved;
+} rawrec_header_t;
+
+typedef struct
+{
+	uint64_t t_us;
+	int16_t axis[NUM_AXES];
+	uint8_t dev;
+	uint8_t updated;
+} rawrec_t;
+
+static inline void sample_to_rawrec(const sample_t *s, rawrec_t *r)
+{
+	int i;
+
+	r->t_us = s->t_us;
+	for (i = 0; i < NUM_AXES; i++)
+	{
+		r->axis[i] = (int16_t)s->axis[i];
+	}
+	r->dev = (uint8_t)s->dev;
+	r->updated = (uint8_t)s->updated;
+}
+
+#endif
@@ -0,0 +1,261 @@
+/* Segment index of a continuous recording. See segidx.h.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "colrec.h"
+#include "segidx.h"
+
+static char *join(const char *dir, const char *name)
+{
+	char *path = malloc(strlen(dir) + strlen(name) + 2);
+
+	if (path != NULL)
+	{
+		sprintf(path, "%s/%s", dir, name);
+	}
+
+	return path;
+}
+
+/* Reads all the entries of the index in dir. A missing index has none. */
+int segidx_read(const char *dir, segidx_entry_t **entries, size_t *n)
+{
+	char *path = join(dir, SEGIDX_NAME);
+	char magic[8];
+	struct stat st;
+	FILE *f;
+	int err_code = 0;
+
+	*entries = NULL;
+	*n = 0;
+	if (path == NULL)
+	{
+		return -1;
+	}
+
+	f = fopen(path, "rb");
+	free(path);
+	if (f == NULL)
+	{
+		return (errno == ENOENT) ? 0 : -1;
+	}
+
+	if (fread(magic, sizeof(magic), 1, f) != 1 || memcmp(magic, SEGIDX_MAGIC, sizeof(magic)) != 0 ||
+	    fstat(fileno(f), &st) != 0)
+	{
+		fprintf(stderr, "%s/%s is not a segment index.\n", dir, SEGIDX_NAME);
+		fclose(f);
+		return -1;
+	}
+
+	*n = (st.st_size - sizeof(magic))/sizeof(segidx_entry_t);
+	*entries = malloc((*n > 0 ? *n : 1)*sizeof(segidx_entry_t));
+	if (*entries == NULL || fread(*entries, sizeof(segidx_entry_t), *n, f) != *n)
+	{
+		free(*entries);
+		*entries = NULL;
+		*n = 0;
+		err_code = -1;
+	}
+	fclose(f);
+
+	return err_code;
+}
+
+int segidx_append(const char *dir, const segidx_entry_t *e)
+{
+	char *path = join(dir, SEGIDX_NAME);
+	struct stat st;
+	off_t extra;
+	int fd;
+	int err_code = 0;
+
+	if (path == NULL)
+	{
+		return -1;
+	}
+
+	fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if (fd == -1)
+	{
+		fprintf(stderr, "Couldn't open %s: %s.\n", path, strerror(errno));
+		free(path);
+		return -1;
+	}
+
+	if (fstat(fd, &st) != 0)
+	{
+		err_code = -1;
+	}
+	else if (st.st_size == 0)
+	{
+		if (write(fd, SEGIDX_MAGIC, 8) != 8)
+		{
+			err_code = -1;
+		}
+	}
+	else
+	{
+		/* drop a torn entry left by a crash */
+		extra = (st.st_size - 8) % sizeof(segidx_entry_t);
+		if (extra != 0 && ftruncate(fd, st.st_size - extra) != 0)
+		{
+			err_code = -1;
+		}
+	}
+
+	if (err_code == 0 && (write(fd, e, sizeof(*e)) != sizeof(*e) || fdatasync(fd) != 0))
+	{
+		err_code = -1;
+	}
+	if (err_code != 0)
+	{
+		fprintf(stderr, "Couldn't add %s to %s: %s.\n", e->name, path, strerror(errno));
+	}
+
+	close(fd);
+	free(path);
+
+	return err_code;
+}
+
+/* Makes the index entry of a closed segment from the segment itself. */
+int segidx_entry_of(const char *dir, const char *name, segidx_entry_t *e)
+{
+	char *path = join(dir, name);
+	colrec_t c;
+
+	memset(e, 0, sizeof(*e));
+	if (path == NULL || strlen(name) >= sizeof(e->name) || colrec_open(&c, path) != 0)
+	{
+		free(path);
+		return -1;
+	}
+	free(path);
+
+	strcpy(e->name, name);
+	e->num_samples = c.num_samples;
+	if (c.num_blocks > 0)
+	{
+		e->t_first = c.index[0].t_first;
+		e->t_last = c.index[c.num_blocks - 1].t_last;
+	}
+	/* segments are created when their first sample arrives */
+	e->wall_offset_us = (int64_t)c.hdr->created_us - (int64_t)e->t_first;
+	colrec_close(&c);
+
+	return 0;
+}
+
+static int by_name(const void *a, const void *b)
+{
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Finishes the segments in dir that have no index entry, oldest first. */
+int segidx_recover(const char *dir)
+{
+	segidx_entry_t *entries;
+	segidx_entry_t e;
+	size_t num_entries;
+	char **names = NULL;
+	char **more;
+	size_t num_names = 0;
+	struct dirent *de;
+	DIR *d;
+	size_t i, j, len;
+	char *path;
+	char *bad;
+	int repaired;
+	int err_code = 0;
+
+	if (segidx_read(dir, &entries, &num_entries) != 0)
+	{
+		return -1;
+	}
+
+	d = opendir(dir);
+	if (d == NULL)
+	{
+		free(entries);
+		return (errno == ENOENT) ? 0 : -1;
+	}
+	while ((de = readdir(d)) != NULL)
+	{
+		len = strlen(de->d_name);
+		if (len < 5 || strcmp(de->d_name + len - 4, ".jsc") != 0)
+		{
+			continue;
+		}
+		for (j = 0; j < num_entries; j++)
+		{
+			if (strncmp(entries[j].name, de->d_name, sizeof(entries[j].name)) == 0)
+			{
+				break;
+			}
+		}
+		if (j < num_entries)
+		{
+			continue;
+		}
+		if ((num_names & 63) == 0)
+		{
+			more = realloc(names, (num_names + 64)*sizeof(char *));
+			if (more == NULL)
+			{
+				err_code = -1;
+				break;
+			}
+			names = more;
+		}
+		if ((names[num_names] = strdup(de->d_name)) != NULL)
+		{
+			num_names++;
+		}
+	}
+	closedir(d);
+	free(entries);
+
+	if (names != NULL)
+	{
+		qsort(names, num_names, sizeof(char *), by_name);
+	}
+	for (i = 0; i < num_names; i++)
+	{
+		path = join(dir, names[i]);
+		if (path == NULL)
+		{
+			err_code = -1;
+		}
+		else if (colrec_repair(path, &repaired) != 0 || segidx_entry_of(dir, names[i], &e) != 0)
+		{
+			/* nothing usable made it to disk, keep it out of the way */
+			bad = join(path, "bad");
+			if (bad != NULL)
+			{
+				bad[strlen(path)] = '.';
+				fprintf(stderr, "Can't recover %s, moved to %s.\n", path, bad);
+				rename(path, bad);
+			}
+			free(bad);
+		}
+		else
+		{
+			fprintf(stderr, "Recovered %s, %llu samples.\n", path, (unsigned long long)e.num_samples);
+			err_code |= segidx_append(dir, &e);
+		}
+		free(path);
+		free(names[i]);
+	}
+	free(names);
+
+	return err_code;
+}
@@ -0,0 +1,47 @@
+/* Segment index of a continuous recording.
+ *
+ * In daemon mode each device is recorded to a directory of columnar
+ * recordings (see colrec.h), called segments, each covering a fixed stretch
+ * of wall clock time, e.g. an hour:
+ *
+ *   <dir>/<device>/<device>-20261018-020000.jsc
+ *   <dir>/<device>/<device>-20261018-030000.jsc
+ *   <dir>/<device>/segments.idx
+ *
+ * When a segment is closed an entry with its time span and sample count is
+ * appended to segments.idx, so a time range can be looked up without
+ * opening any segment. The index is only ever appended to with a single
+ * write per entry; a torn entry at the end is ignored.
+ *
+ * A segment that was still open when the recorder died has no entry. When
+ * recording starts again segidx_recover() finishes every such segment with
+ * colrec_repair() and adds its entry.
+ *
+ * Sample time stamps come from the device's clock. wall_offset_us is added
+ * to them to get the wall clock time, which is how segments are looked up.
+ */
+
+#ifndef SEGIDX_H
+#define SEGIDX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SEGIDX_MAGIC "JSSEGIX\1"
+#define SEGIDX_NAME "segments.idx"
+
+typedef struct
+{
+	char name[64];            /* file name of the segment in the directory */
+	uint64_t t_first;         /* time stamp of the first sample in us */
+	uint64_t t_last;          /* time stamp of the last sample in us */
+	int64_t wall_offset_us;   /* wall clock time minus sample time */
+	uint64_t num_samples;
+} segidx_entry_t;
+
+int segidx_read(const char *dir, segidx_entry_t **entries, size_t *n);
+int segidx_append(const char *dir, const segidx_entry_t *e);
+int segidx_entry_of(const char *dir, const char *name, segidx_entry_t *e);
+int segidx_recover(const char *dir);
+
+#endif
@@ -0,0 +1,271 @@
+/* Sink that writes samples to a series of columnar segments, starting a
+ * new segment whenever the samples pass a multiple of the segment length
+ * in wall clock time, and keeps the segment index of the directory (see
+ * segidx.h).
+ *
+ * The wall clock time of a sample is its time stamp plus an offset taken
+ * when the first samples arrive and kept from then on, so the split into
+ * segments doesn't depend on how long the samples waited to be written.
+ * A segment is created when its first sample arrives and is named after,
+ * and its header holds, the wall clock time of that sample, so the offset
+ * segidx_entry_of() works out from a recovered segment is the one its
+ * index entry would have had.
+ *
+ * Segments are always compressed. Blocks that aren't full are then
+ * written out every flush interval, so what is on disk is never older
+ * than that, for a few bytes a sample. Uncompressed, every flush would
+ * cost a whole 64 KiB block, about 5.5 GB a day per device at 125
+ * samples/s and a flush a second.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "acq.h"
+#include "colrec.h"
+#include "segidx.h"
+
+/* a segment is closed on time once its device has sent nothing for this long */
+#define QUIET_US 1000000
+
+typedef struct
+{
+	sink_t sink;
+	char *dir;
+	char *prefix;
+	uint64_t seg_us;          /* segment length */
+	colsink_info_t info;
+	bufwriter_cfg_t cfg;
+	sink_t *cur;              /* segment being written, NULL between segments */
+	uint64_t seg_end_us;      /* wall clock time the segment ends */
+	int64_t wall_offset_us;   /* wall clock time minus sample time */
+	int have_offset;
+	uint64_t last_write_us;   /* wall clock time of the last write */
+	segidx_entry_t e;         /* index entry of the segment */
+	uint64_t bytes;           /* written to the finished segments */
+} segsink_t;
+
+static uint64_t wall_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+static int open_segment(segsink_t *ss, uint64_t now)
+{
+	char name[sizeof(ss->e.name) - 4];   /* leaves room for .jsc */
+	char *path;
+	struct tm tm;
+	time_t secs = now/1000000;
+	int n = 0;
+	int i;
+
+	gmtime_r(&secs, &tm);
+	n = snprintf(name, sizeof(name), "%s-%04d%02d%02d-%02d%02d%02d", ss->prefix,
+	             tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+	path = malloc(strlen(ss->dir) + sizeof(name) + 16);
+	if (path == NULL || n < 0 || n >= (int)sizeof(name) - 8)
+	{
+		free(path);
+		return -1;
+	}
+
+	/* never overwrite a segment, e.g. after a quick restart */
+	for (i = 0; ; i++)
+	{
+		if (i > 0)
+		{
+			snprintf(name + n, sizeof(name) - n, "-%d", i);
+		}
+		sprintf(path, "%s/%s.jsc", ss->dir, name);
+		if (access(path, F_OK) != 0)
+		{
+			break;
+		}
+	}
+
+	/* the same time the index entry is made from, so a segment recovered
+	 * without one gets the same wall clock offset */
+	ss->info.created_us = now;
+	ss->cur = colsink_open(path, &ss->info, &ss->cfg);
+	free(path);
+	if (ss->cur == NULL)
+	{
+		return -1;
+	}
+
+	memset(&ss->e, 0, sizeof(ss->e));
+	snprintf(ss->e.name, sizeof(ss->e.name), "%s.jsc", name);
+	ss->seg_end_us = (now/ss->seg_us + 1)*ss->seg_us;
+
+	return 0;
+}
+
+static int close_segment(segsink_t *ss)
+{
+	int err_code;
+
+	if (ss->cur == NULL)
+	{
+		return 0;
+	}
+
+	ss->bytes += ss->cur->bytes(ss->cur);
+	err_code = ss->cur->close(ss->cur);
+	ss->cur = NULL;
+	if (err_code == 0 && ss->e.num_samples > 0)
+	{
+		err_code = segidx_append(ss->dir, &ss->e);
+	}
+
+	return err_code;
+}
+
+static uint64_t wall_of(const segsink_t *ss, const sample_t *sample)
+{
+	return (uint64_t)((int64_t)sample->t_us + ss->wall_offset_us);
+}
+
+static int segsink_write(sink_t *s, const sample_t *samples, size_t n)
+{
+	segsink_t *ss = (segsink_t *)s;
+	size_t i;
+
+	if (n == 0)
+	{
+		return 0;
+	}
+
+	/* the newest sample is the one that waited least */
+	ss->last_write_us = wall_us();
+	if (!ss->have_offset)
+	{
+		ss->wall_offset_us = (int64_t)ss->last_write_us - (int64_t)samples[n - 1].t_us;
+		ss->have_offset = 1;
+	}
+
+	while (n > 0)
+	{
+		if (ss->cur != NULL && wall_of(ss, &samples[0]) >= ss->seg_end_us && close_segment(ss) != 0)
+		{
+			return -1;
+		}
+		if (ss->cur == NULL)
+		{
+			if (open_segment(ss, wall_of(ss, &samples[0])) != 0)
+			{
+				return -1;
+			}
+			ss->e.t_first = samples[0].t_us;
+			ss->e.wall_offset_us = ss->wall_offset_us;
+		}
+
+		/* the samples that belong to this segment */
+		i = 1;
+		while (i < n && wall_of(ss, &samples[i]) < ss->seg_end_us)
+		{
+			i++;
+		}
+
+		ss->e.t_last = samples[i - 1].t_us;
+		ss->e.num_samples += i;
+		if (ss->cur->write(ss->cur, samples, i) != 0)
+		{
+			return -1;
+		}
+		samples += i;
+		n -= i;
+	}
+
+	return 0;
+}
+
+static int segsink_tick(sink_t *s)
+{
+	segsink_t *ss = (segsink_t *)s;
+	uint64_t now;
+
+	if (ss->cur == NULL)
+	{
+		return 0;
+	}
+	/* finish a segment on time even if its device has gone quiet. While it
+	 * sends samples, they end the segment. */
+	now = wall_us();
+	if (now >= ss->seg_end_us && now - ss->last_write_us >= QUIET_US)
+	{
+		return close_segment(ss);
+	}
+
+	return ss->cur->tick(ss->cur);
+}
+
+static uint64_t segsink_bytes(sink_t *s)
+{
+	segsink_t *ss = (segsink_t *)s;
+
+	return ss->bytes + ((ss->cur != NULL) ? ss->cur->bytes(ss->cur) : 0);
+}
+
+static int segsink_close(sink_t *s)
+{
+	segsink_t *ss = (segsink_t *)s;
+	int err_code;
+
+	err_code = close_segment(ss);
+	free(ss->dir);
+	free(ss->prefix);
+	free(ss);
+
+	return err_code;
+}
+
+/* Records to segments of seg_s seconds named <prefix>-<time>.jsc in dir,
+ * which is created if need be. Segments left unfinished by an earlier run
+ * are recovered first. */
+sink_t *segsink_open(const char *dir, const char *prefix, unsigned int seg_s,
+                     const colsink_info_t *info, const bufwriter_cfg_t *cfg)
+{
+	segsink_t *ss;
+
+	if (mkdir(dir, 0755) != 0 && errno != EEXIST)
+	{
+		fprintf(stderr, "Couldn't create %s: %s.\n", dir, strerror(errno));
+		return NULL;
+	}
+	if (segidx_recover(dir) != 0)
+	{
+		return NULL;
+	}
+
+	ss = calloc(1, sizeof(*ss));
+	if (ss == NULL)
+	{
+		return NULL;
+	}
+	ss->sink.write = segsink_write;
+	ss->sink.tick = segsink_tick;
+	ss->sink.close = segsink_close;
+	ss->sink.bytes = segsink_bytes;
+	ss->dir = strdup(dir);
+	ss->prefix = strdup(prefix);
+	ss->seg_us = (uint64_t)seg_s*1000000;
+	ss->info = *info;
+	ss->info.codec = COLREC_CODEC_DELTA;
+	ss->cfg = *cfg;
+
+	if (ss->dir == NULL || ss->prefix == NULL || ss->seg_us == 0)
+	{
+		segsink_close(&ss->sink);
+		return NULL;
+	}
+
+	return &ss->sink;
+}
@@ -0,0 +1,47 @@
+/* Lock-free single producer, single consumer ring of samples. See spsc.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "spsc.h"
+
+/* Opens a ring of size samples, rounded up to a power of two. */
+spsc_t *spsc_open(size_t size)
+{
+	spsc_t *q;
+	void *p;
+	size_t n = 1;
+
+	while (n < size)
+	{
+		n *= 2;
+	}
+
+	if (posix_memalign(&p, SPSC_CACHE_LINE, sizeof(spsc_t)) != 0)
+	{
+		return NULL;
+	}
+	q = p;
+	memset(q, 0, sizeof(*q));
+	q->size = n;
+	if (posix_memalign(&p, SPSC_CACHE_LINE, n*sizeof(sample_t)) != 0)
+	{
+		free(q);
+		return NULL;
+	}
+	q->buf = p;
+	/* touched now so the reader never takes a page fault on it */
+	memset(q->buf, 0, n*sizeof(sample_t));
+
+	return q;
+}
+
+void spsc_close(spsc_t *q)
+{
+	if (q != NULL)
+	{
+		free(q->buf);
+		free(q);
+	}
+}
@@ -0,0 +1,100 @@
+/* Lock-free single producer, single consumer ring of samples.
+ *
+ * The reading thread pushes samples and the writing thread takes them off,
+ * with no locks and no system calls. Each side keeps its own index on its
+ * own cache line, along with a copy of the other side's index that it only
+ * refreshes when the ring looks full (producer) or empty (consumer), so the
+ * two cores only share a cache line when they have to.
+ *
+ * The producer never waits: samples that don't fit are dropped and counted
+ * in overflows. high_water is the most samples the consumer has found
+ * waiting, so it shows how close the ring came to overflowing.
+ */
+
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sample.h"
+
+#define SPSC_CACHE_LINE 64
+
+typedef struct
+{
+	/* producer */
+	uint64_t head __attribute__((aligned(SPSC_CACHE_LINE)));
+	uint64_t tail_cache;
+	uint64_t overflows;
+
+	/* consumer */
+	uint64_t tail __attribute__((aligned(SPSC_CACHE_LINE)));
+	uint64_t head_cache;
+	uint64_t high_water;
+
+	/* both, never written after spsc_open() */
+	sample_t *buf __attribute__((aligned(SPSC_CACHE_LINE)));
+	size_t size;              /* a power of two */
+} spsc_t;
+
+spsc_t *spsc_open(size_t size);
+void spsc_close(spsc_t *q);
+
+/* Adds up to n samples, returns how many fit. */
+static inline size_t spsc_push(spsc_t *q, const sample_t *s, size_t n)
+{
+	uint64_t head = q->head;
+	size_t room = q->size - (head - q->tail_cache);
+	size_t i, m;
+
+	if (room < n)
+	{
+		q->tail_cache = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+		room = q->size - (head - q->tail_cache);
+		if (room < n)
+		{
+			q->overflows += n - room;
+			n = room;
+		}
+	}
+
+	i = head & (q->size - 1);
+	m = (n < q->size - i) ? n : q->size - i;
+	memcpy(q->buf + i, s, m*sizeof(sample_t));
+	memcpy(q->buf, s + m, (n - m)*sizeof(sample_t));
+	__atomic_store_n(&q->head, head + n, __ATOMIC_RELEASE);
+
+	return n;
+}
+
+/* Points *s at the oldest samples waiting and returns how many follow it
+ * in one piece, 0 if the ring is empty. */
+static inline size_t spsc_peek(spsc_t *q, const sample_t **s)
+{
+	uint64_t tail = q->tail;
+	size_t avail, i;
+
+	if (q->head_cache == tail)
+	{
+		q->head_cache = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+	}
+	avail = q->head_cache - tail;
+	if (avail > q->high_water)
+	{
+		q->high_water = avail;
+	}
+
+	i = tail & (q->size - 1);
+	*s = q->buf + i;
+	return (avail < q->size - i) ? avail : q->size - i;
+}
+
+/* Gives back the first n samples returned by spsc_peek(). */
+static inline void spsc_release(spsc_t *q, size_t n)
+{
+	__atomic_store_n(&q->tail, q->tail + n, __ATOMIC_RELEASE);
+}
+
+#endif
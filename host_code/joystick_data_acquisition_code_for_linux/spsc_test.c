@@ -0,0 +1,303 @@
+/* Tests of the single producer, single consumer ring in spsc.h. Built and
+ * run with
+ *
+ *   make check
+ *
+ * Each sample carries its sequence number in t_us. The tests check that
+ *   - the size is rounded up to a power of two,
+ *   - samples come out in order and whole across the end of the buffer,
+ *     where spsc_peek() returns them in two pieces,
+ *   - a push that doesn't fit takes what fits, drops the rest and counts
+ *     it in overflows, and high_water is the most found waiting,
+ *   - the indices wrapping around 2^64 make no difference,
+ *   - a producer and a consumer thread, with and without overflows, never
+ *     see a sample out of order, torn or twice, and every sample is either
+ *     taken off or counted as an overflow.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spsc.h"
+
+#define NUM_THREADED 1000000
+
+static int failures;
+
+static void check(int ok, const char *what)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "FAIL: %s\n", what);
+		failures++;
+	}
+}
+
+static void make(sample_t *s, uint64_t seq)
+{
+	int a;
+
+	memset(s, 0, sizeof(*s));
+	s->t_us = seq;
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		s->axis[a] = (int32_t)(seq*3 + a);
+	}
+}
+
+static int is(const sample_t *s, uint64_t seq)
+{
+	int ok = (s->t_us == seq);
+	int a;
+
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		ok &= (s->axis[a] == (int32_t)(seq*3 + a));
+	}
+
+	return ok;
+}
+
+/* Takes off everything waiting, checking it follows on from *next. */
+static size_t drain(spsc_t *q, uint64_t *next, int *ok)
+{
+	const sample_t *s;
+	size_t n, i;
+	size_t total = 0;
+
+	while ((n = spsc_peek(q, &s)) > 0)
+	{
+		for (i = 0; i < n; i++)
+		{
+			*ok &= is(&s[i], (*next)++);
+		}
+		spsc_release(q, n);
+		total += n;
+	}
+
+	return total;
+}
+
+static void test_rounding(void)
+{
+	spsc_t *q;
+
+	q = spsc_open(100);
+	check(q != NULL && q->size == 128, "the size is rounded up to a power of two");
+	spsc_close(q);
+	q = spsc_open(64);
+	check(q != NULL && q->size == 64, "a power of two is kept");
+	spsc_close(q);
+}
+
+/* Pushes and drains batches of 1 to 13 samples through a ring of 16, from
+ * indices that start at start, so they run across the end of the buffer
+ * in every position. */
+static void run_wrap(uint64_t start, const char *what)
+{
+	sample_t in[16];
+	const sample_t *s;
+	spsc_t *q;
+	uint64_t seq = 0;
+	uint64_t next = 0;
+	size_t n, i;
+	int ok = 1;
+	int split = 0;
+
+	q = spsc_open(16);
+	if (q == NULL)
+	{
+		check(0, "spsc_open");
+		return;
+	}
+	q->head = q->tail = q->tail_cache = q->head_cache = start;
+
+	for (n = 1; n <= 13; n++)
+	{
+		for (i = 0; i < 20; i++)
+		{
+			size_t j;
+
+			for (j = 0; j < n; j++)
+			{
+				make(&in[j], seq + j);
+			}
+			ok &= (spsc_push(q, in, n) == n);
+			seq += n;
+			split |= (spsc_peek(q, &s) < n);
+			drain(q, &next, &ok);
+		}
+	}
+	check(ok && next == seq && q->overflows == 0, what);
+	check(split, "a batch across the end of the buffer is peeked in two pieces");
+	check(q->head == start + seq && q->tail == start + seq, "the indices count every sample");
+	spsc_close(q);
+}
+
+static void test_overflow(void)
+{
+	sample_t in[40];
+	const sample_t *s;
+	spsc_t *q;
+	uint64_t next = 0;
+	size_t i;
+	int ok = 1;
+
+	q = spsc_open(32);
+	if (q == NULL)
+	{
+		check(0, "spsc_open");
+		return;
+	}
+	for (i = 0; i < 40; i++)
+	{
+		make(&in[i], i);
+	}
+
+	check(spsc_push(q, in, 20) == 20, "a push that fits");
+	check(spsc_push(q, in + 20, 20) == 12 && q->overflows == 8, "a push that doesn't fit takes what fits");
+	check(spsc_push(q, in, 1) == 0 && q->overflows == 9, "a full ring takes nothing");
+	check(spsc_peek(q, &s) == 32 && q->high_water == 32, "high_water is the most found waiting");
+
+	spsc_release(q, 5);
+	make(&in[0], 32);
+	check(spsc_push(q, in, 1) == 1, "room comes back when samples are taken off");
+	next = 5;
+	check(drain(q, &next, &ok) == 28 && ok, "what was pushed comes out in order");
+	check(spsc_peek(q, &s) == 0, "an empty ring");
+	check(q->high_water == 32, "high_water is kept");
+	spsc_close(q);
+}
+
+typedef struct
+{
+	spsc_t *q;
+	int batch;
+	int lossy;
+	int finished;
+} producer_t;
+
+/* Pushes NUM_THREADED samples in batches of 1 to batch. Unless lossy, what
+ * doesn't fit is pushed again until it does. Both sides yield when they
+ * can't get on, for machines with one core. */
+static void *producer(void *arg)
+{
+	producer_t *p = arg;
+	sample_t in[64];
+	uint64_t seq = 0;
+	size_t n, m, j;
+
+	while (seq < NUM_THREADED)
+	{
+		n = 1 + seq % p->batch;
+		if (n > NUM_THREADED - seq)
+		{
+			n = NUM_THREADED - seq;
+		}
+		for (j = 0; j < n; j++)
+		{
+			make(&in[j], seq + j);
+		}
+		m = spsc_push(p->q, in, n);
+		while (!p->lossy && m < n)
+		{
+			sched_yield();
+			m += spsc_push(p->q, in + m, n - m);
+		}
+		seq += n;
+	}
+	__atomic_store_n(&p->finished, 1, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+/* A consumer takes samples off until the producer has finished and the
+ * ring is empty. With lossy, samples are dropped when the ring is full, so
+ * the sequence numbers only need to go up. */
+static void run_threads(size_t size, int lossy, const char *what)
+{
+	producer_t p;
+	pthread_t th;
+	const sample_t *s;
+	uint64_t taken = 0;
+	uint64_t next = 0;
+	size_t n, i;
+	int finished = 0;
+	int ok = 1;
+
+	p.q = spsc_open(size);
+	p.batch = 50;
+	p.lossy = lossy;
+	p.finished = 0;
+	if (p.q == NULL || pthread_create(&th, NULL, producer, &p) != 0)
+	{
+		check(0, "starting the producer");
+		spsc_close(p.q);
+		return;
+	}
+
+	while (!finished)
+	{
+		/* read before the peeks, so the last samples aren't missed */
+		finished = __atomic_load_n(&p.finished, __ATOMIC_ACQUIRE);
+		while ((n = spsc_peek(p.q, &s)) > 0)
+		{
+			for (i = 0; i < n; i++)
+			{
+				ok &= (s[i].t_us >= next && is(&s[i], s[i].t_us));
+				ok &= (lossy || s[i].t_us == next);
+				next = s[i].t_us + 1;
+			}
+			spsc_release(p.q, n);
+			taken += n;
+			if (lossy)
+			{
+				/* a slow consumer, so the ring fills */
+				for (i = 0; i < 2000; i++)
+				{
+					__asm__ __volatile__("" ::: "memory");
+				}
+			}
+		}
+		if (!finished)
+		{
+			sched_yield();
+		}
+	}
+	pthread_join(th, NULL);
+
+	check(ok, what);
+	if (lossy)
+	{
+		check(p.q->overflows > 0, "a slow consumer makes the ring overflow");
+		check(taken + p.q->overflows == NUM_THREADED, "every sample is taken off or counted as an overflow");
+	}
+	else
+	{
+		check(taken == NUM_THREADED && next == NUM_THREADED, "every sample is taken off");
+	}
+	spsc_close(p.q);
+}
+
+int main(void)
+{
+	test_rounding();
+	run_wrap(0, "samples come out in order across the end of the buffer");
+	run_wrap(UINT64_MAX - 100, "samples come out in order across the indices wrapping around");
+	test_overflow();
+	run_threads(256, 0, "two threads, samples in order and whole");
+	run_threads(64, 1, "two threads with overflows, samples in order and whole");
+
+	if (failures > 0)
+	{
+		fprintf(stderr, "spsc_test: %d check(s) failed.\n", failures);
+		return 1;
+	}
+	fprintf(stdout, "spsc_test: all checks passed.\n");
+
+	return 0;
+}
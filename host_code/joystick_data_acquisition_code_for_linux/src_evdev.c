@@ -0,0 +1,258 @@
+/* Source backend for the Linux event interface (/dev/input/eventN).
+ *
+ * Unlike the joystick API the event interface delivers the kernel's own
+ * time stamps with microsecond resolution, and marks the end of every USB
+ * report with a SYN_REPORT event, so a sample is complete as soon as its
+ * report is. The time stamps are switched to CLOCK_MONOTONIC so they don't
+ * jump when the wall clock is set.
+ *
+ * The event interface doesn't apply the joystick API's calibration, but
+ * the input core does filter every axis before any handler sees it:
+ * hid-input gives joystick axes a fuzz of (max-min)>>8, and changes within
+ * the fuzz are dropped or averaged away. For the 0..1023 firmware that
+ * swallows changes of 1 or 2 counts and smooths those up to 5, which is
+ * the small signal the sensor is for. evdev_open() therefore sets the fuzz
+ * and flat of the axes to 0, so the values are the raw report values. If
+ * the kernel refuses, a warning is printed and the recording is lossy.
+ *
+ * If the kernel's event buffer overflows it sends SYN_DROPPED. Everything
+ * up to the next SYN_REPORT is then discarded and the axes are read back
+ * from the device, as described in the kernel's event-codes documentation.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/input.h>
+
+#include "acq.h"
+#include "evcap.h"
+
+#define EVENT_BATCH 256
+
+/* ABS_X, ABS_Y and ABS_Z are the x, y and z usages of the report */
+static const int axis_code[NUM_AXES] = { ABS_X, ABS_Y, ABS_Z };
+
+typedef struct
+{
+	sample_t cur;          /* sample being assembled until SYN_REPORT */
+	int dropped;           /* discarding events after SYN_DROPPED */
+	uint64_t num_dropped;
+	sample_t out[EVENT_BATCH];
+} evdev_t;
+
+static int axis_of(int code)
+{
+	int i;
+
+	for (i = 0; i < NUM_AXES; i++)
+	{
+		if (axis_code[i] == code)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/* read the current value of every axis, used on open and after SYN_DROPPED */
+static void read_axes(device_t *d, evdev_t *ev)
+{
+	struct input_absinfo abs;
+	int i;
+
+	for (i = 0; i < NUM_AXES; i++)
+	{
+		if (ioctl(d->fd, EVIOCGABS(axis_code[i]), &abs) == 0)
+		{
+			ev->cur.axis[i] = abs.value;
+			ev->cur.updated |= 1 << i;
+		}
+	}
+}
+
+/* after SYN_DROPPED, with what was read kept in the capture, or taken from
+ * the capture on replay */
+static void resync_axes(device_t *d, evdev_t *ev)
+{
+	uint16_t dev = ev->cur.dev;
+
+	if (d->replay != NULL)
+	{
+		replay_state(d, &ev->cur, sizeof(ev->cur));
+		ev->cur.dev = dev;
+		return;
+	}
+
+	read_axes(d, ev);
+	if (d->capture != NULL)
+	{
+		evcap_write(d->capture, EVCAP_STATE, &ev->cur, sizeof(ev->cur));
+	}
+}
+
+static int evdev_open(device_t *d)
+{
+	struct input_absinfo abs;
+	int clk = CLOCK_MONOTONIC;
+	evdev_t *ev;
+	int i;
+
+	ev = calloc(1, sizeof(*ev));
+	if (ev == NULL)
+	{
+		return -1;
+	}
+	d->priv = ev;
+
+	if (d->replay != NULL)
+	{
+		ev->cur = d->initial;
+		ev->cur.dev = d->index;
+		return 0;
+	}
+
+	d->fd = open(d->path, O_RDONLY | O_NONBLOCK);
+	if (d->fd == -1)
+	{
+		fprintf(stderr, "Couldn't open event device: %s.\n", d->path);
+		return -1;
+	}
+
+	if (ioctl(d->fd, EVIOCSCLOCKID, &clk) != 0)
+	{
+		fprintf(stderr, "Couldn't switch %s to monotonic time stamps, using real time.\n", d->path);
+	}
+
+	ioctl(d->fd, EVIOCGNAME(sizeof(d->name)), d->name);
+
+	fprintf(stdout, "Event device detected %s: %s\n", d->path, d->name);
+	for (i = 0; i < NUM_AXES; i++)
+	{
+		if (ioctl(d->fd, EVIOCGABS(axis_code[i]), &abs) != 0)
+		{
+			fprintf(stderr, "%s has no axis %d.\n", d->path, axis_code[i]);
+			return -1;
+		}
+		fprintf(stdout, "\taxis %d: %d to %d\n", axis_code[i], abs.minimum, abs.maximum);
+		if (abs.fuzz != 0 || abs.flat != 0)
+		{
+			abs.fuzz = 0;
+			abs.flat = 0;
+			if (ioctl(d->fd, EVIOCSABS(axis_code[i]), &abs) != 0)
+			{
+				fprintf(stderr, "Couldn't turn off the fuzz filter of axis %d of %s, "
+				        "small changes will be lost.\n", axis_code[i], d->path);
+			}
+		}
+	}
+	fprintf(stdout, "\n");
+
+	ev->cur.dev = d->index;
+	read_axes(d, ev);
+	d->initial = ev->cur;
+
+	return 0;
+}
+
+static int evdev_drain(device_t *d)
+{
+	evdev_t *ev = d->priv;
+	struct input_event ie[EVENT_BATCH];
+	ssize_t num_bytes = 0;
+	int n = 0;
+	int m = 0;
+	int i = 0;
+	int a = 0;
+
+	while (!d->done)
+	{
+		num_bytes = device_read(d, ie, sizeof(ie));
+		if (num_bytes < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return (errno == EAGAIN) ? 0 : -1;
+		}
+		if (num_bytes < (ssize_t)sizeof(struct input_event))
+		{
+			/* end of file */
+			return -1;
+		}
+		n = num_bytes/sizeof(struct input_event);
+		m = 0;
+
+		for (i = 0; i < n; i++)
+		{
+			if (ie[i].type == EV_SYN)
+			{
+				if (ie[i].code == SYN_DROPPED)
+				{
+					ev->dropped = 1;
+					ev->num_dropped++;
+				}
+				else if (ie[i].code == SYN_REPORT)
+				{
+					if (ev->dropped)
+					{
+						ev->dropped = 0;
+						resync_axes(d, ev);
+					}
+					ev->cur.t_us = (uint64_t)ie[i].input_event_sec*1000000 + ie[i].input_event_usec;
+					ev->out[m++] = ev->cur;
+					ev->cur.updated = 0;
+				}
+			}
+			else if (ie[i].type == EV_ABS && !ev->dropped)
+			{
+				a = axis_of(ie[i].code);
+				if (a >= 0)
+				{
+					ev->cur.axis[a] = ie[i].value;
+					ev->cur.updated |= 1 << a;
+				}
+			}
+		}
+
+		if (m > 0 && device_emit(d, ev->out, m) != 0)
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void evdev_close(device_t *d)
+{
+	evdev_t *ev = d->priv;
+
+	if (ev != NULL && ev->num_dropped > 0)
+	{
+		fprintf(stderr, "%s: the kernel dropped events %llu times.\n",
+		        d->path, (unsigned long long)ev->num_dropped);
+	}
+	if (d->fd >= 0)
+	{
+		close(d->fd);
+		d->fd = -1;
+	}
+	free(ev);
+	d->priv = NULL;
+}
+
+const source_ops_t evdev_source =
+{
+	.name = "evdev",
+	.open = evdev_open,
+	.drain = evdev_drain,
+	.close = evdev_close,
+};
@@ -0,0 +1,410 @@
+/* Source backend for raw HID reports (/dev/hidrawN).
+ *
+ * Reading the reports directly bypasses the joystick and event layers
+ * completely: there is no calibration to switch off, every report becomes
+ * a sample whether or not an axis changed, and report layouts those layers
+ * can't represent, such as the high resolution output of the moving
+ * average firmware, arrive intact.
+ *
+ * The layout is worked out from the report descriptor when the device is
+ * opened and each report is then decoded by a decoder for that layout.
+ * The layouts are the USB_JoystickReport_Data_t variants of the firmware
+ * in uc_code, all little endian and packed:
+ *
+ *   7 bytes   x, y, z, buttons                  (firmware before peak-hold)
+ *   19 bytes  x, y, z, min x/y/z, max x/y/z, buttons
+ *   32 bytes  the 19 bytes followed by n and the sums of squares of x/y/z
+ *             (chebyshev with REPORT_SUMSQ)
+ *
+ * The axes are signed if the descriptor gives them a negative logical
+ * minimum (moving_average with HIRES). The min/max and sum of squares
+ * fields are passed on with each sample (SAMPLE_PEAKS and SAMPLE_SUMSQ in
+ * sample.h) and end up in the block index of a columnar recording.
+ *
+ * hidraw doesn't time stamp reports, so they are stamped with
+ * CLOCK_MONOTONIC when they are read. When the reader falls behind,
+ * several reports are waiting at once; they are all read before any is
+ * stamped, the last one gets the time it was read and the ones before it
+ * are backdated by HIDRAW_REPORT_US each, the interval the host polls the
+ * firmware at, rather than all getting the same time.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/hidraw.h>
+
+#include "acq.h"
+
+#define MAX_REPORT_SIZE 64
+
+/* Reports stamped together. The kernel queues at most 64 per reader, so a
+ * backlog is always read whole and the reports in it can be spaced back
+ * from the last. Only a device feeding reports faster than they are read
+ * fills this, and then the rest are spaced evenly after what was emitted. */
+#define HIDRAW_MAX_BACKLOG 256
+
+/* PollingIntervalMS in the firmware's Descriptors.c */
+#define HIDRAW_REPORT_US 8000
+
+typedef void (*decode_fn)(const uint8_t *r, sample_t *s);
+
+typedef struct
+{
+	const char *name;
+	int size;              /* bytes */
+	int is_signed;
+	int n_offset;          /* offset of the sample count, -1 if none */
+	decode_fn decode;
+} report_layout_t;
+
+typedef struct
+{
+	const report_layout_t *layout;
+	uint64_t num_reports;
+	uint64_t num_readings; /* sensor readings the reports were made from */
+	uint64_t t_last;       /* time stamp of the last report emitted */
+	sample_t out[HIDRAW_MAX_BACKLOG];
+} hidraw_t;
+
+static inline int32_t get_u16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static inline int32_t get_s16(const uint8_t *p)
+{
+	return (int16_t)(p[0] | p[1] << 8);
+}
+
+static inline uint32_t get_u32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/* x, y and z lead every layout */
+static void decode_xyz_u16(const uint8_t *r, sample_t *s)
+{
+	s->axis[0] = get_u16(r);
+	s->axis[1] = get_u16(r + 2);
+	s->axis[2] = get_u16(r + 4);
+}
+
+static void decode_xyz_s16(const uint8_t *r, sample_t *s)
+{
+	s->axis[0] = get_s16(r);
+	s->axis[1] = get_s16(r + 2);
+	s->axis[2] = get_s16(r + 4);
+}
+
+/* the min and max follow x, y and z */
+static void decode_peaks_u16(const uint8_t *r, sample_t *s)
+{
+	int a;
+
+	decode_xyz_u16(r, s);
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		s->min[a] = get_u16(r + 6 + 2*a);
+		s->max[a] = get_u16(r + 12 + 2*a);
+	}
+	s->updated |= SAMPLE_PEAKS;
+}
+
+static void decode_peaks_s16(const uint8_t *r, sample_t *s)
+{
+	int a;
+
+	decode_xyz_s16(r, s);
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		s->min[a] = get_s16(r + 6 + 2*a);
+		s->max[a] = get_s16(r + 12 + 2*a);
+	}
+	s->updated |= SAMPLE_PEAKS;
+}
+
+/* and the count and sums of squares follow the buttons */
+static void decode_sumsq_u16(const uint8_t *r, sample_t *s)
+{
+	int a;
+
+	decode_peaks_u16(r, s);
+	s->readings = r[19];
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		s->sumsq[a] = get_u32(r + 20 + 4*a);
+	}
+	s->updated |= SAMPLE_SUMSQ;
+}
+
+static const report_layout_t layouts[] =
+{
+	{ "x/y/z",                 7, 0, -1, decode_xyz_u16 },
+	{ "x/y/z high resolution", 7, 1, -1, decode_xyz_s16 },
+	{ "x/y/z min/max",        19, 0, -1, decode_peaks_u16 },
+	{ "x/y/z min/max high resolution", 19, 1, -1, decode_peaks_s16 },
+	{ "x/y/z min/max sumsq",  32, 0, 19, decode_sumsq_u16 },
+};
+
+#define NUM_LAYOUTS (sizeof(layouts)/sizeof(layouts[0]))
+
+/* Walks the short items of a report descriptor, adding up the size of the
+ * input fields and noting whether any logical minimum is negative. */
+static void parse_descriptor(const uint8_t *d, int len, int *input_bits, int *is_signed)
+{
+	int i = 0;
+	int size;
+	int32_t val;
+	int report_size = 0;
+	int report_count = 0;
+
+	*input_bits = 0;
+	*is_signed = 0;
+
+	while (i < len)
+	{
+		if (d[i] == 0xFE)
+		{
+			/* long item, not used by the firmware */
+			if (i + 1 >= len)
+			{
+				break;
+			}
+			i += 3 + d[i + 1];
+			continue;
+		}
+
+		size = d[i] & 0x03;
+		size = (size == 3) ? 4 : size;
+		if (i + size >= len)
+		{
+			break;
+		}
+
+		val = 0;
+		if (size == 1)
+		{
+			val = (int8_t)d[i + 1];
+		}
+		else if (size == 2)
+		{
+			val = (int16_t)(d[i + 1] | d[i + 2] << 8);
+		}
+		else if (size == 4)
+		{
+			val = (int32_t)((uint32_t)d[i + 1] | (uint32_t)d[i + 2] << 8 |
+			                (uint32_t)d[i + 3] << 16 | (uint32_t)d[i + 4] << 24);
+		}
+
+		switch (d[i] & 0xFC)
+		{
+		case 0x80: /* Input */
+			*input_bits += report_size*report_count;
+			break;
+		case 0x74: /* Report Size */
+			report_size = val;
+			break;
+		case 0x94: /* Report Count */
+			report_count = val;
+			break;
+		case 0x14: /* Logical Minimum */
+			if (val < 0)
+			{
+				*is_signed = 1;
+			}
+			break;
+		}
+
+		i += 1 + size;
+	}
+}
+
+/* the layout of reports of input_bits bits, NULL if there isn't one */
+static const report_layout_t *find_layout(int input_bits, int is_signed)
+{
+	size_t i;
+
+	for (i = 0; i < NUM_LAYOUTS; i++)
+	{
+		if (layouts[i].size*8 == input_bits && layouts[i].is_signed == is_signed)
+		{
+			return &layouts[i];
+		}
+	}
+
+	return NULL;
+}
+
+static int hidraw_open(device_t *d)
+{
+	struct hidraw_report_descriptor desc;
+	int desc_size = 0;
+	int input_bits = 0;
+	int is_signed = 0;
+	hidraw_t *hr;
+
+	hr = calloc(1, sizeof(*hr));
+	if (hr == NULL)
+	{
+		return -1;
+	}
+	d->priv = hr;
+
+	d->fd = open(d->path, O_RDONLY | O_NONBLOCK);
+	if (d->fd == -1)
+	{
+		fprintf(stderr, "Couldn't open hidraw device: %s.\n", d->path);
+		return -1;
+	}
+
+	ioctl(d->fd, HIDIOCGRAWNAME(sizeof(d->name)), d->name);
+
+	memset(&desc, 0, sizeof(desc));
+	if (ioctl(d->fd, HIDIOCGRDESCSIZE, &desc_size) != 0 || desc_size <= 0 ||
+	    desc_size > HID_MAX_DESCRIPTOR_SIZE)
+	{
+		fprintf(stderr, "Couldn't read the report descriptor of %s.\n", d->path);
+		return -1;
+	}
+	desc.size = desc_size;
+	if (ioctl(d->fd, HIDIOCGRDESC, &desc) != 0)
+	{
+		fprintf(stderr, "Couldn't read the report descriptor of %s.\n", d->path);
+		return -1;
+	}
+	parse_descriptor(desc.value, desc.size, &input_bits, &is_signed);
+
+	hr->layout = find_layout(input_bits, is_signed);
+	if (hr->layout == NULL)
+	{
+		fprintf(stderr, "%s has an unknown %d byte report.\n", d->path, input_bits/8);
+		return -1;
+	}
+
+	fprintf(stdout, "HID device detected %s: %s\n\t%d byte %s reports\n\n"
+	              , d->path
+	              , d->name
+	              , hr->layout->size
+	              , hr->layout->name);
+
+	return 0;
+}
+
+/* Stamps the m reports read since the last emit, the last of them read at
+ * t_read, and hands them on. Reports that were waiting together are
+ * spaced HIDRAW_REPORT_US apart, or evenly since the previous report if
+ * that would take them back past it. */
+static int emit_reports(device_t *d, hidraw_t *hr, int m, uint64_t t_read)
+{
+	uint64_t period = HIDRAW_REPORT_US;
+	int k;
+
+	if (hr->t_last > 0 && t_read - hr->t_last < m*period)
+	{
+		period = (t_read > hr->t_last) ? (t_read - hr->t_last)/m : 0;
+	}
+	for (k = 0; k < m; k++)
+	{
+		hr->out[k].t_us = t_read - (m-1-k)*period;
+	}
+	hr->t_last = t_read;
+
+	return device_emit(d, hr->out, m);
+}
+
+static int hidraw_drain(device_t *d)
+{
+	hidraw_t *hr = d->priv;
+	const report_layout_t *layout = hr->layout;
+	uint8_t report[MAX_REPORT_SIZE];
+	struct timespec ts;
+	uint64_t t_read = 0;
+	sample_t *s;
+	ssize_t num_bytes = 0;
+	int m = 0;
+
+	while (!d->done)
+	{
+		/* hidraw hands out one report per read */
+		num_bytes = read(d->fd, report, sizeof(report));
+		if (num_bytes < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			if (errno != EAGAIN)
+			{
+				return -1;
+			}
+			break;
+		}
+		if (num_bytes == 0)
+		{
+			/* end of file */
+			return -1;
+		}
+		if (num_bytes != layout->size)
+		{
+			continue;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		t_read = (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+		s = &hr->out[m++];
+		s->dev = d->index;
+		s->updated = (1 << NUM_AXES) - 1;
+		layout->decode(report, s);
+
+		hr->num_reports++;
+		hr->num_readings += (layout->n_offset >= 0) ? report[layout->n_offset] : 1;
+
+		if (m == HIDRAW_MAX_BACKLOG)
+		{
+			if (emit_reports(d, hr, m, t_read) != 0)
+			{
+				return -1;
+			}
+			m = 0;
+		}
+	}
+
+	if (m > 0 && emit_reports(d, hr, m, t_read) != 0)
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+static void hidraw_close(device_t *d)
+{
+	hidraw_t *hr = d->priv;
+
+	if (hr != NULL && hr->layout != NULL && hr->layout->n_offset >= 0)
+	{
+		fprintf(stdout, "%s: %llu reports made from %llu sensor readings\n", d->path,
+		        (unsigned long long)hr->num_reports, (unsigned long long)hr->num_readings);
+	}
+	if (d->fd >= 0)
+	{
+		close(d->fd);
+		d->fd = -1;
+	}
+	free(hr);
+	d->priv = NULL;
+}
+
+const source_ops_t hidraw_source =
+{
+	.name = "hidraw",
+	.open = hidraw_open,
+	.drain = hidraw_drain,
+	.close = hidraw_close,
+};
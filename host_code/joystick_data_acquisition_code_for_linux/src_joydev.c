@@ -0,0 +1,187 @@
+/* Source backend for the Linux joystick API (/dev/input/jsN).
+ *
+ * The joystick correction code taken from the QCN forums puts every axis
+ * in raw mode so the joystick driver doesn't mangle the data with
+ * calibration values.
+ *
+ * Joystick events are read in batches and the axis events belonging to one
+ * USB report (they share a time stamp) are combined into a single sample.
+ * The joystick driver time stamps only have millisecond resolution, and
+ * being 32 bits they wrap after 49.7 days; the wraps are counted so the
+ * sample time stamps keep increasing.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/joystick.h>
+
+#include "acq.h"
+
+#define MAX_AXES 9
+#define EVENT_BATCH 64
+
+typedef struct
+{
+	int num_of_axis;
+	int num_of_buttons;
+	sample_t cur;          /* sample being assembled from axis events */
+	uint32_t cur_time;     /* joystick driver time stamp of cur in ms */
+	uint64_t wraps;        /* times the driver time stamp wrapped */
+	int have_cur;
+	sample_t out[EVENT_BATCH];
+} joydev_t;
+
+static int joydev_open(device_t *d)
+{
+	int i = 0;
+	int j = 0;
+	struct js_corr corr[MAX_AXES];
+	joydev_t *js;
+
+	js = calloc(1, sizeof(*js));
+	if (js == NULL)
+	{
+		return -1;
+	}
+	d->priv = js;
+	js->cur.dev = d->index;
+
+	/* a replay has no device to set up, see src_replay.c */
+	if (d->replay != NULL)
+	{
+		return 0;
+	}
+
+	d->fd = open(d->path, O_RDONLY | O_NONBLOCK);
+	if (d->fd == -1)
+	{
+		fprintf(stderr, "Couldn't open joystick: %s.\n", d->path);
+		return -1;
+	}
+
+	/* Zero correction coefficient structure and set all axes to Raw mode. */
+	for (i=0; i<MAX_AXES; i++)
+	{
+		corr[i].type = JS_CORR_NONE;
+		corr[i].prec = 0;
+		for (j=0; j<8; j++)
+		{
+			corr[i].coef[j] = 0;
+		}
+	}
+
+	if (ioctl(d->fd, JSIOCSCORR, &corr))
+	{
+		fprintf(stderr, "Error setting joystick correction.\n");
+		return -1;
+	}
+
+	ioctl(d->fd, JSIOCGAXES, &(js->num_of_axis));
+	ioctl(d->fd, JSIOCGBUTTONS, &(js->num_of_buttons));
+	ioctl(d->fd, JSIOCGNAME(sizeof(d->name)), d->name);
+
+	fprintf(stdout, "Joystick detected %s: %s\n\t%d axis\n\t%d buttons\n\n"
+	              , d->path
+	              , d->name
+	              , js->num_of_axis
+	              , js->num_of_buttons);
+
+	return 0;
+}
+
+static int joydev_drain(device_t *d)
+{
+	joydev_t *js = d->priv;
+	struct js_event jse[EVENT_BATCH];
+	ssize_t num_bytes = 0;
+	int n = 0;
+	int m = 0;
+	int i = 0;
+
+	while (!d->done)
+	{
+		num_bytes = device_read(d, jse, sizeof(jse));
+		if (num_bytes < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return (errno == EAGAIN) ? 0 : -1;
+		}
+		if (num_bytes < (ssize_t)sizeof(struct js_event))
+		{
+			/* end of file */
+			return -1;
+		}
+		n = num_bytes/sizeof(struct js_event);
+		m = 0;
+
+		for (i = 0; i < n; i++)
+		{
+			if ((jse[i].type & ~JS_EVENT_INIT) != JS_EVENT_AXIS || jse[i].number >= NUM_AXES)
+			{
+				continue;
+			}
+
+			/* all the axis events from one USB report carry the same time
+			 * stamp, so a new time stamp means the previous sample is
+			 * complete. */
+			if (js->have_cur && jse[i].time != js->cur_time)
+			{
+				js->out[m++] = js->cur;
+				js->cur.updated = 0;
+			}
+
+			/* a jump back of more than half the range is a wrap */
+			if (js->have_cur && jse[i].time < js->cur_time && js->cur_time - jse[i].time > UINT32_MAX/2)
+			{
+				js->wraps++;
+			}
+			js->cur_time = jse[i].time;
+			js->cur.t_us = ((js->wraps << 32) + jse[i].time)*1000;
+			js->cur.axis[jse[i].number] = jse[i].value;
+			js->cur.updated |= 1 << jse[i].number;
+			js->have_cur = 1;
+		}
+
+		if (m > 0 && device_emit(d, js->out, m) != 0)
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void joydev_close(device_t *d)
+{
+	joydev_t *js = d->priv;
+
+	/* the last sample is only complete once the next one starts, but it
+	 * is still worth keeping when the recording ends */
+	if (js != NULL && js->have_cur && js->cur.updated)
+	{
+		device_emit(d, &js->cur, 1);
+	}
+	if (d->fd >= 0)
+	{
+		close(d->fd);
+		d->fd = -1;
+	}
+	free(js);
+	d->priv = NULL;
+}
+
+const source_ops_t joydev_source =
+{
+	.name = "joydev",
+	.open = joydev_open,
+	.drain = joydev_drain,
+	.close = joydev_close,
+};
@@ -0,0 +1,280 @@
+/* Source backend replaying a capture of a device (see evcap.h).
+ *
+ * The capture is fed, read by read, to the backend that made it, which
+ * can't tell it from the device: the reads return the same bytes in the
+ * same batches, so the samples and their time stamps come out exactly as
+ * they did live. What the reads wait on is a timerfd armed for when the
+ * next read is due, so a replay goes through the same epoll loop as a
+ * device. At most REPLAY_BATCH reads are returned per wakeup, so a replay
+ * as fast as possible still takes turns with the other devices.
+ *
+ * The states a backend captured outside of reads (see evcap.h) are
+ * handed back to it with replay_state().
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "acq.h"
+#include "evcap.h"
+
+#define REPLAY_BATCH 64
+
+typedef struct
+{
+	FILE *f;
+	const source_ops_t *inner;    /* backend that made the capture */
+	evcap_header_t hdr;
+	evcap_record_t next;
+	int have_next;
+	int budget;                   /* reads left before the next wakeup */
+	uint64_t start_us;            /* when the replay started */
+	uint64_t num_reads;
+	uint64_t last_t_us;
+} replay_t;
+
+static double replay_speed = 1.0;
+
+/* 2 replays twice as fast as the capture was made, 0 as fast as the
+ * recorder takes it. */
+void replay_set_speed(double speed)
+{
+	replay_speed = speed;
+}
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+/* Wakes the device at t_us, or right away if that has passed. */
+static void arm(device_t *d, uint64_t t_us)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	if (t_us == 0)
+	{
+		t_us = 1;
+	}
+	its.it_value.tv_sec = t_us/1000000;
+	its.it_value.tv_nsec = (t_us % 1000000)*1000;
+	timerfd_settime(d->fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static int next_record(replay_t *rp)
+{
+	if (!rp->have_next)
+	{
+		if (fread(&rp->next, sizeof(rp->next), 1, rp->f) != 1)
+		{
+			return -1;
+		}
+		rp->have_next = 1;
+	}
+
+	return 0;
+}
+
+/* Stands in for read() on a replayed device, see device_read(). The end
+ * of the capture marks the device done. */
+ssize_t replay_read(device_t *d, void *buf, size_t len)
+{
+	replay_t *rp = d->replay;
+	uint64_t due;
+
+	/* a state the backend didn't ask for is of no use to it */
+	while (next_record(rp) == 0 && rp->next.kind != EVCAP_READ)
+	{
+		fseek(rp->f, rp->next.len, SEEK_CUR);
+		rp->have_next = 0;
+	}
+	if (!rp->have_next)
+	{
+		d->done = 1;
+		errno = EAGAIN;
+		return -1;
+	}
+
+	if (rp->budget <= 0)
+	{
+		arm(d, 0);
+		errno = EAGAIN;
+		return -1;
+	}
+	if (replay_speed > 0)
+	{
+		due = rp->start_us + (uint64_t)((rp->next.t_us - rp->hdr.t_start_us)/replay_speed);
+		if (due > now_us())
+		{
+			arm(d, due);
+			errno = EAGAIN;
+			return -1;
+		}
+	}
+
+	if (rp->next.len > len || rp->next.len > EVCAP_MAX_READ)
+	{
+		fprintf(stderr, "%s: a read of %u bytes doesn't fit, the capture is corrupt.\n", d->path, rp->next.len);
+		errno = EIO;
+		return -1;
+	}
+	if (fread(buf, 1, rp->next.len, rp->f) != rp->next.len)
+	{
+		fprintf(stderr, "%s is truncated, replaying what there is.\n", d->path);
+		d->done = 1;
+		errno = EAGAIN;
+		return -1;
+	}
+	rp->have_next = 0;
+	rp->budget--;
+	rp->num_reads++;
+	rp->last_t_us = rp->next.t_us;
+
+	return rp->next.len;
+}
+
+/* Gets back a state the backend captured at this point, see evcap.h.
+ * Returns -1, leaving buf as it is, if there is none. */
+int replay_state(device_t *d, void *buf, size_t len)
+{
+	replay_t *rp = d->replay;
+
+	if (next_record(rp) != 0 || rp->next.kind != EVCAP_STATE || rp->next.len != len)
+	{
+		return -1;
+	}
+	if (fread(buf, 1, len, rp->f) != len)
+	{
+		return -1;
+	}
+	rp->have_next = 0;
+
+	return 0;
+}
+
+static int replay_open(device_t *d)
+{
+	replay_t *rp;
+
+	rp = calloc(1, sizeof(*rp));
+	if (rp == NULL)
+	{
+		return -1;
+	}
+	d->replay = rp;
+
+	rp->f = fopen(d->path, "rb");
+	if (rp->f == NULL)
+	{
+		fprintf(stderr, "Couldn't open capture: %s.\n", d->path);
+		return -1;
+	}
+	if (fread(&rp->hdr, sizeof(rp->hdr), 1, rp->f) != 1 ||
+	    memcmp(rp->hdr.magic, EVCAP_MAGIC, sizeof(rp->hdr.magic)) != 0)
+	{
+		fprintf(stderr, "%s isn't a capture.\n", d->path);
+		return -1;
+	}
+	rp->hdr.source[sizeof(rp->hdr.source) - 1] = 0;
+	rp->hdr.path[sizeof(rp->hdr.path) - 1] = 0;
+	rp->hdr.name[sizeof(rp->hdr.name) - 1] = 0;
+
+	if (strcmp(rp->hdr.source, joydev_source.name) == 0)
+	{
+		rp->inner = &joydev_source;
+	}
+	else if (strcmp(rp->hdr.source, evdev_source.name) == 0)
+	{
+		rp->inner = &evdev_source;
+	}
+	else
+	{
+		fprintf(stderr, "%s: can't replay a capture made by %s.\n", d->path, rp->hdr.source);
+		return -1;
+	}
+
+	memcpy(d->name, rp->hdr.name, sizeof(d->name));
+	memcpy(d->initial.axis, rp->hdr.axis, sizeof(d->initial.axis));
+	d->initial.updated = rp->hdr.updated;
+	if (rp->inner->open(d) != 0)
+	{
+		return -1;
+	}
+
+	d->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (d->fd == -1)
+	{
+		fprintf(stderr, "Couldn't create a timer for %s: %s.\n", d->path, strerror(errno));
+		return -1;
+	}
+	rp->start_us = now_us();
+	arm(d, 0);
+
+	fprintf(stdout, "Replaying %s, %s %s: %s\n\n", d->path, rp->hdr.source, rp->hdr.path, d->name);
+
+	return 0;
+}
+
+static int replay_drain(device_t *d)
+{
+	replay_t *rp = d->replay;
+	uint64_t expirations;
+
+	if (read(d->fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+	{
+		return -1;
+	}
+	rp->budget = REPLAY_BATCH;
+
+	return rp->inner->drain(d);
+}
+
+static void replay_close(device_t *d)
+{
+	replay_t *rp = d->replay;
+	double secs;
+
+	if (rp == NULL)
+	{
+		return;
+	}
+	if (rp->inner != NULL)
+	{
+		rp->inner->close(d);
+	}
+	else if (d->fd >= 0)
+	{
+		close(d->fd);
+		d->fd = -1;
+	}
+	if (rp->num_reads > 0)
+	{
+		secs = (now_us() - rp->start_us)/1e6;
+		fprintf(stdout, "%s: replayed %llu reads, %.1f s of capture in %.1f s (%.0f samples/s)\n",
+		        d->path, (unsigned long long)rp->num_reads, (rp->last_t_us - rp->hdr.t_start_us)/1e6,
+		        secs, (secs > 0) ? d->num_samples/secs : 0.0);
+	}
+	if (rp->f != NULL)
+	{
+		fclose(rp->f);
+	}
+	free(rp);
+	d->replay = NULL;
+}
+
+const source_ops_t replay_source =
+{
+	.name = "replay",
+	.open = replay_open,
+	.drain = replay_drain,
+	.close = replay_close,
+};
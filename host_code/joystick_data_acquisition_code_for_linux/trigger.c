@@ -0,0 +1,196 @@
+/* Recursive STA/LTA event trigger. See trigger.h.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trigger.h"
+
+static const char axis_name[] = "xyz";
+
+int trig_read_config(const char *path, trig_rule_t **rules, size_t *n)
+{
+	FILE *f;
+	char line[1024];
+	char channel[80];
+	char extra[2];
+	trig_rule_t r;
+	trig_rule_t *more;
+	char *colon;
+	int line_num = 0;
+	int err_code = 0;
+
+	*rules = NULL;
+	*n = 0;
+	f = fopen(path, "r");
+	if (f == NULL)
+	{
+		fprintf(stderr, "Couldn't open %s: %s.\n", path, strerror(errno));
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f) != NULL)
+	{
+		line_num++;
+		if (sscanf(line, " %1s", extra) != 1 || extra[0] == '#')
+		{
+			continue;
+		}
+
+		memset(&r, 0, sizeof(r));
+		r.axis = -1;
+		if (sscanf(line, "%79s %lf %lf %lf %lf %1s", channel, &r.cfg.sta_s, &r.cfg.lta_s,
+		           &r.cfg.on, &r.cfg.off, extra) != 5 ||
+		    !(r.cfg.sta_s > 0) || !(r.cfg.lta_s > r.cfg.sta_s) || !(r.cfg.off > 0) || r.cfg.on < r.cfg.off)
+		{
+			fprintf(stderr, "%s:%d: expected a channel, sta_s, lta_s, on and off, with sta_s < lta_s and off <= on.\n",
+			        path, line_num);
+			err_code = -1;
+			break;
+		}
+
+		colon = strrchr(channel, ':');
+		if (colon != NULL)
+		{
+			if (colon[1] == '\0' || colon[2] != '\0' || strchr(axis_name, colon[1]) == NULL)
+			{
+				fprintf(stderr, "%s:%d: the axis must be x, y or z.\n", path, line_num);
+				err_code = -1;
+				break;
+			}
+			r.axis = strchr(axis_name, colon[1]) - axis_name;
+			*colon = '\0';
+		}
+		strcpy(r.channel, channel);
+
+		if ((*n & 15) == 0)
+		{
+			more = realloc(*rules, (*n + 16)*sizeof(trig_rule_t));
+			if (more == NULL)
+			{
+				err_code = -1;
+				break;
+			}
+			*rules = more;
+		}
+		(*rules)[(*n)++] = r;
+	}
+	fclose(f);
+
+	if (err_code != 0)
+	{
+		free(*rules);
+		*rules = NULL;
+		*n = 0;
+	}
+
+	return err_code;
+}
+
+/* The configuration of one axis of a device, or NULL if it isn't
+ * triggered. */
+const trig_cfg_t *trig_cfg_for(const trig_rule_t *rules, size_t n, const char *device, int axis)
+{
+	const trig_cfg_t *cfg = NULL;
+	const char *name = strrchr(device, '/');
+	size_t i;
+
+	name = (name != NULL) ? name + 1 : device;
+	for (i = 0; i < n; i++)
+	{
+		if ((strcmp(rules[i].channel, "*") == 0 || strcmp(rules[i].channel, device) == 0 ||
+		     strcmp(rules[i].channel, name) == 0) && (rules[i].axis == -1 || rules[i].axis == axis))
+		{
+			cfg = &rules[i].cfg;
+		}
+	}
+
+	return cfg;
+}
+
+void trig_init(trig_chan_t *c, const trig_cfg_t *cfg)
+{
+	memset(c, 0, sizeof(*c));
+	c->cfg = *cfg;
+}
+
+/* Adds the sample x taken at t_us, returns TRIG_ON or TRIG_OFF when the
+ * channel triggers or detriggers and TRIG_NONE otherwise. */
+int trig_update(trig_chan_t *c, uint64_t t_us, double x)
+{
+	double hp, cf;
+
+	if (!c->started)
+	{
+		c->started = 1;
+		c->t_start = t_us;
+		c->t_last = t_us;
+		c->held = x;
+		c->mean = x;
+		return TRIG_NONE;
+	}
+	if (t_us <= c->t_last)
+	{
+		c->held = x;
+		return TRIG_NONE;
+	}
+
+	/* the decays only change with the time step, which rarely does */
+	if (t_us - c->t_last != c->dt)
+	{
+		c->dt = t_us - c->t_last;
+		c->d_mean = exp(-(c->dt/1e6)/TRIG_HIGHPASS_S);
+		c->d_sta = exp(-(c->dt/1e6)/c->cfg.sta_s);
+		c->d_lta = exp(-(c->dt/1e6)/c->cfg.lta_s);
+	}
+
+	/* the held value over the time since the last sample */
+	hp = c->held - c->mean;
+	cf = hp*hp;
+	c->mean = c->held + (c->mean - c->held)*c->d_mean;
+	c->sta = cf + (c->sta - cf)*c->d_sta;
+	if (!c->on)
+	{
+		c->lta = cf + (c->lta - cf)*c->d_lta;
+	}
+	c->t_last = t_us;
+	c->held = x;
+	c->ratio = c->sta/((c->lta > TRIG_LTA_FLOOR) ? c->lta : TRIG_LTA_FLOOR);
+
+	if (t_us - c->t_start < c->cfg.lta_s*1e6)
+	{
+		return TRIG_NONE;
+	}
+
+	if (!c->on)
+	{
+		if (c->ratio >= c->cfg.on)
+		{
+			c->on = 1;
+			c->t_on = t_us;
+			c->peak_ratio = c->ratio;
+			c->peak = fabs(hp);
+			return TRIG_ON;
+		}
+		return TRIG_NONE;
+	}
+
+	if (c->ratio > c->peak_ratio)
+	{
+		c->peak_ratio = c->ratio;
+	}
+	if (fabs(hp) > c->peak)
+	{
+		c->peak = fabs(hp);
+	}
+	if (c->ratio < c->cfg.off)
+	{
+		c->on = 0;
+		return TRIG_OFF;
+	}
+
+	return TRIG_NONE;
+}
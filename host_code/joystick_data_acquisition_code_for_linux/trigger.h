@@ -0,0 +1,83 @@
+/* Recursive STA/LTA event trigger.
+ *
+ * Each channel (one axis of one device) is high passed to remove gravity
+ * and slow tilt, squared, and averaged over a short (STA) and a long (LTA)
+ * time constant. The channel triggers when STA/LTA reaches the on ratio
+ * and detriggers when it falls below the off ratio. The LTA is held while
+ * the channel is triggered so a long event doesn't raise its own
+ * threshold, and is never taken below 1 count^2 so a sensor sitting
+ * perfectly still doesn't trigger on a one count change. No trigger is
+ * declared until the LTA has run for its time constant.
+ *
+ * The averages are updated with the time between samples, taking each
+ * value as held until the next sample, so samples that only arrive when a
+ * value changes (the joystick API) are handled as well as regular ones.
+ * Each update costs the same whatever the window lengths.
+ *
+ * The configuration file has one line per channel or group of channels:
+ *
+ *   # channel  sta_s  lta_s  on   off
+ *   *          1      60     4    1.5
+ *   js0        0.5    30     3    1.5
+ *   js0:z      0.5    30     5    2
+ *
+ * A channel is a device, by name (e.g. js0 or hidraw2) or path, optionally
+ * followed by :x, :y or :z, or * for every device. The last matching line
+ * wins; channels that match no line aren't triggered.
+ */
+
+#ifndef TRIGGER_H
+#define TRIGGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRIG_NONE 0
+#define TRIG_ON 1
+#define TRIG_OFF 2
+
+#define TRIG_HIGHPASS_S 1.0       /* time constant of the high pass */
+#define TRIG_LTA_FLOOR 1.0        /* count^2 */
+
+typedef struct
+{
+	double sta_s;
+	double lta_s;
+	double on;
+	double off;
+} trig_cfg_t;
+
+typedef struct
+{
+	char channel[80];
+	int axis;                 /* -1 for every axis */
+	trig_cfg_t cfg;
+} trig_rule_t;
+
+typedef struct
+{
+	trig_cfg_t cfg;
+	int started;
+	uint64_t t_start;
+	uint64_t t_last;
+	double held;              /* value since t_last */
+	double mean;
+	double sta;
+	double lta;
+	double ratio;
+
+	uint64_t dt;              /* time step the decays below are for */
+	double d_mean, d_sta, d_lta;
+
+	int on;
+	uint64_t t_on;
+	double peak_ratio;
+	double peak;              /* largest high passed value while on */
+} trig_chan_t;
+
+int trig_read_config(const char *path, trig_rule_t **rules, size_t *n);
+const trig_cfg_t *trig_cfg_for(const trig_rule_t *rules, size_t n, const char *device, int axis);
+void trig_init(trig_chan_t *c, const trig_cfg_t *cfg);
+int trig_update(trig_chan_t *c, uint64_t t_us, double x);
+
+#endif
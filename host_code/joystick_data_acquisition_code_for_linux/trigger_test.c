@@ -0,0 +1,233 @@
+/* Tests of the STA/LTA trigger in trigger.c. Built and run with
+ *
+ *   make check
+ *
+ * A channel is fed 125 samples/s of noise of a few counts around a
+ * resting value, with bursts added. The tests check that
+ *   - a burst well above the noise triggers once, within a second of its
+ *     start, and detriggers once within a few seconds of its end,
+ *   - nothing triggers on the noise alone,
+ *   - nothing triggers before the LTA has run for its time constant,
+ *   - the LTA is held while the channel is triggered,
+ *   - a sensor sitting perfectly still doesn't trigger on a one count
+ *     change, thanks to the LTA floor,
+ *   - the configuration file picks the last matching line for a channel,
+ *     and rejects lines that don't make sense.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "trigger.h"
+
+#define PERIOD_US 8000
+
+static int failures;
+
+static void check(int ok, const char *what)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "FAIL: %s\n", what);
+		failures++;
+	}
+}
+
+static uint32_t lcg = 12345;
+
+/* -5 to 5 counts */
+static int noise(void)
+{
+	lcg = lcg*1664525 + 1013904223;
+	return (int)((lcg >> 8) % 11) - 5;
+}
+
+typedef struct
+{
+	int num_on;
+	int num_off;
+	uint64_t t_on;
+	uint64_t t_off;
+	double lta_on;            /* LTA when the channel triggered */
+	int lta_held;             /* the LTA didn't change while on */
+} result_t;
+
+/* Runs a channel for secs seconds of noise around 500, with a burst of
+ * amplitude amp counts at 10 Hz from burst_s for burst_len_s seconds. */
+static void run(trig_chan_t *c, double secs, double burst_s, double burst_len_s, int amp, result_t *res)
+{
+	uint64_t t;
+	double x;
+	int r;
+
+	memset(res, 0, sizeof(*res));
+	res->lta_held = 1;
+	for (t = 0; t < secs*1e6; t += PERIOD_US)
+	{
+		x = 500 + noise();
+		if (t >= burst_s*1e6 && t < (burst_s + burst_len_s)*1e6)
+		{
+			x += ((t/50000) % 2) ? amp : -amp;
+		}
+		r = trig_update(c, t, x);
+		if (r == TRIG_ON)
+		{
+			res->num_on++;
+			res->t_on = t;
+			res->lta_on = c->lta;
+		}
+		else if (r == TRIG_OFF)
+		{
+			res->num_off++;
+			res->t_off = t;
+		}
+		else if (c->on && c->lta != res->lta_on)
+		{
+			res->lta_held = 0;
+		}
+	}
+}
+
+static const trig_cfg_t cfg = { 1, 30, 4, 1.5 };
+
+static void test_burst(void)
+{
+	trig_chan_t c;
+	result_t res;
+
+	trig_init(&c, &cfg);
+	run(&c, 120, 80, 2, 100, &res);
+	check(res.num_on == 1 && res.num_off == 1, "a burst triggers and detriggers once");
+	check(res.t_on >= 80000000 && res.t_on < 81000000, "the trigger comes within a second of the burst");
+	check(res.t_off >= 82000000 && res.t_off < 90000000, "the channel detriggers after the burst");
+	check(res.lta_held, "the LTA is held while triggered");
+	check(c.peak >= 100, "the peak of the burst is kept");
+	check(c.peak_ratio >= cfg.on, "the peak ratio is kept");
+}
+
+static void test_noise(void)
+{
+	trig_chan_t c;
+	result_t res;
+
+	trig_init(&c, &cfg);
+	run(&c, 300, 0, 0, 0, &res);
+	check(res.num_on == 0, "noise alone doesn't trigger");
+	check(c.lta > 5 && c.lta < 15, "the LTA settles at the variance of the noise");
+}
+
+static void test_warm_up(void)
+{
+	trig_chan_t c;
+	result_t res;
+
+	trig_init(&c, &cfg);
+	run(&c, 29, 10, 2, 100, &res);
+	check(res.num_on == 0, "nothing triggers before the LTA has run for its time constant");
+
+	trig_init(&c, &cfg);
+	run(&c, 40, 30.5, 2, 100, &res);
+	check(res.num_on == 1 && res.t_on >= 30500000, "a burst right after the warm up triggers");
+}
+
+static void test_lta_floor(void)
+{
+	trig_chan_t c;
+	uint64_t t;
+	int num_on = 0;
+
+	/* perfectly still, then one count up for good */
+	trig_init(&c, &cfg);
+	for (t = 0; t < 120000000; t += PERIOD_US)
+	{
+		num_on += (trig_update(&c, t, (t < 60000000) ? 500 : 501) == TRIG_ON);
+	}
+	check(c.lta < TRIG_LTA_FLOOR, "the LTA of a still sensor is below the floor");
+	check(num_on == 0, "a one count change of a still sensor doesn't trigger");
+
+	/* while a real event still does */
+	trig_init(&c, &cfg);
+	for (t = 0; t < 120000000; t += PERIOD_US)
+	{
+		num_on += (trig_update(&c, t, (t < 60000000) ? 500 : (t/50000 % 2) ? 520 : 480) == TRIG_ON);
+	}
+	check(num_on == 1, "an event after a still sensor triggers");
+}
+
+static void test_config(void)
+{
+	char path[] = "/tmp/trigger_testXXXXXX";
+	const char *text =
+		"# channel  sta_s  lta_s  on   off\n"
+		"*          1      60     4    1.5\n"
+		"\n"
+		"js0        0.5    30     3    1.5\n"
+		"js0:z      0.5    30     5    2\n";
+	trig_rule_t *rules;
+	const trig_cfg_t *c;
+	size_t n;
+	FILE *f;
+	int fd;
+
+	fd = mkstemp(path);
+	f = (fd >= 0) ? fdopen(fd, "w") : NULL;
+	if (f == NULL)
+	{
+		check(0, "temporary configuration file");
+		return;
+	}
+	fputs(text, f);
+	fclose(f);
+
+	check(trig_read_config(path, &rules, &n) == 0 && n == 3, "a configuration is read");
+	if (n == 3)
+	{
+		c = trig_cfg_for(rules, n, "/dev/input/js0", 0);
+		check(c != NULL && c->on == 3, "a device line matches by name");
+		c = trig_cfg_for(rules, n, "/dev/input/js0", 2);
+		check(c != NULL && c->on == 5, "the last matching line wins");
+		c = trig_cfg_for(rules, n, "/dev/hidraw1", 2);
+		check(c != NULL && c->on == 4 && c->lta_s == 60, "* matches every device");
+		check(trig_cfg_for(rules, 1, "js0", 0) == &rules[0].cfg, "* alone");
+		check(trig_cfg_for(rules + 1, 2, "js1", 0) == NULL, "a channel that matches no line isn't triggered");
+	}
+	free(rules);
+
+	f = fopen(path, "w");
+	fputs("js0 30 1 4 1.5\n", f);
+	fclose(f);
+	check(trig_read_config(path, &rules, &n) != 0 && rules == NULL && n == 0, "sta_s >= lta_s is rejected");
+
+	f = fopen(path, "w");
+	fputs("js0 1 30 1 4\n", f);
+	fclose(f);
+	check(trig_read_config(path, &rules, &n) != 0, "on < off is rejected");
+
+	f = fopen(path, "w");
+	fputs("js0:w 1 30 4 1.5\n", f);
+	fclose(f);
+	check(trig_read_config(path, &rules, &n) != 0, "an unknown axis is rejected");
+
+	unlink(path);
+}
+
+int main(void)
+{
+	test_burst();
+	test_noise();
+	test_warm_up();
+	test_lta_floor();
+	test_config();
+
+	if (failures > 0)
+	{
+		fprintf(stderr, "trigger_test: %d check(s) failed.\n", failures);
+		return 1;
+	}
+	fprintf(stdout, "trigger_test: all checks passed.\n");
+
+	return 0;
+}
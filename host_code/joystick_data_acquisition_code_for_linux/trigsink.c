@@ -0,0 +1,132 @@
+/* Sink that runs an STA/LTA trigger (see trigger.h) on each axis of a
+ * device and writes the triggers to an event log, one line each:
+ *
+ *   2026-10-18T02:13:05.123456Z js0 z on 4.21
+ *   2026-10-18T02:13:17.423456Z js0 z off 1.49 12.300 8.10 143
+ *
+ * that is the wall clock time (UTC), the device, the axis, on or off and
+ * the STA/LTA ratio, and for off the length of the event in seconds, the
+ * largest ratio and the largest high passed value during the event. The
+ * log may be shared by the sinks of several devices.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "acq.h"
+#include "trigger.h"
+
+typedef struct
+{
+	sink_t sink;
+	char name[80];
+	FILE *log;
+	trig_chan_t chan[NUM_AXES];
+	int enabled[NUM_AXES];
+	int64_t wall_offset_us;   /* wall clock time minus sample time */
+	int started;
+} trigsink_t;
+
+static const char axis_name[] = "xyz";
+
+static void log_event(trigsink_t *ts, int a, int ev)
+{
+	trig_chan_t *c = &ts->chan[a];
+	uint64_t t = c->t_last + ts->wall_offset_us;
+	time_t secs = t/1000000;
+	struct tm tm;
+
+	gmtime_r(&secs, &tm);
+	fprintf(ts->log, "%04d-%02d-%02dT%02d:%02d:%02d.%06uZ %s %c %s %.2f",
+	        tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+	        (unsigned)(t % 1000000), ts->name, axis_name[a], (ev == TRIG_ON) ? "on" : "off", c->ratio);
+	if (ev == TRIG_OFF)
+	{
+		fprintf(ts->log, " %.3f %.2f %.0f", (c->t_last - c->t_on)/1e6, c->peak_ratio, c->peak);
+	}
+	fprintf(ts->log, "\n");
+	/* events are rare and wanted at once */
+	fflush(ts->log);
+}
+
+static int trigsink_write(sink_t *s, const sample_t *samples, size_t n)
+{
+	trigsink_t *ts = (trigsink_t *)s;
+	struct timespec now;
+	size_t i;
+	int a, ev;
+
+	if (n > 0 && !ts->started)
+	{
+		clock_gettime(CLOCK_REALTIME, &now);
+		ts->wall_offset_us = (int64_t)now.tv_sec*1000000 + now.tv_nsec/1000 - (int64_t)samples[0].t_us;
+		ts->started = 1;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		for (a = 0; a < NUM_AXES; a++)
+		{
+			if (ts->enabled[a] && (ev = trig_update(&ts->chan[a], samples[i].t_us, samples[i].axis[a])) != TRIG_NONE)
+			{
+				log_event(ts, a, ev);
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int trigsink_close(sink_t *s)
+{
+	trigsink_t *ts = (trigsink_t *)s;
+	int a;
+
+	/* end the events still going on */
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		if (ts->enabled[a] && ts->chan[a].on)
+		{
+			log_event(ts, a, TRIG_OFF);
+		}
+	}
+	free(ts);
+
+	return 0;
+}
+
+/* Triggers the axes of device that have a configuration in rules and
+ * writes to log, which is left open. */
+sink_t *trigsink_open(const char *device, const trig_rule_t *rules, size_t num_rules, FILE *log)
+{
+	trigsink_t *ts;
+	const trig_cfg_t *cfg;
+	const char *name = strrchr(device, '/');
+	int a;
+
+	ts = calloc(1, sizeof(*ts));
+	if (ts == NULL)
+	{
+		return NULL;
+	}
+	ts->sink.write = trigsink_write;
+	ts->sink.tick = NULL;
+	ts->sink.bytes = NULL;
+	ts->sink.close = trigsink_close;
+	ts->log = log;
+	snprintf(ts->name, sizeof(ts->name), "%s", (name != NULL) ? name + 1 : device);
+
+	for (a = 0; a < NUM_AXES; a++)
+	{
+		cfg = trig_cfg_for(rules, num_rules, device, a);
+		if (cfg != NULL)
+		{
+			trig_init(&ts->chan[a], cfg);
+			ts->enabled[a] = 1;
+		}
+	}
+
+	return &ts->sink;
+}
@@ -0,0 +1,153 @@
+/* Streaming Welch power spectral density. See welch.h.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "welch.h"
+
+static const char *const window_name[] = { "rect", "hann", "hamming", "blackman" };
+
+int welch_window(const char *name)
+{
+	int i;
+
+	for (i = 0; i < (int)(sizeof(window_name)/sizeof(window_name[0])); i++)
+	{
+		if (strcmp(name, window_name[i]) == 0)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+int welch_init(welch_t *w, size_t n, double overlap, int window, double rate)
+{
+	double a;
+	size_t i;
+
+	memset(w, 0, sizeof(*w));
+	if (!(overlap >= 0 && overlap < 1) || !(rate > 0) || window < WELCH_RECT || window > WELCH_BLACKMAN ||
+	    fft_init(&w->fft, n) != 0)
+	{
+		return -1;
+	}
+	w->n = n;
+	w->hop = n - (size_t)(overlap*n);
+	w->rate = rate;
+
+	w->win = malloc(n*sizeof(double));
+	w->buf = malloc(n*sizeof(double));
+	w->seg = malloc(n*sizeof(double));
+	w->power = malloc((n/2 + 1)*sizeof(double));
+	w->sum = calloc(n/2 + 1, sizeof(double));
+	if (w->win == NULL || w->buf == NULL || w->seg == NULL || w->power == NULL || w->sum == NULL)
+	{
+		welch_free(w);
+		return -1;
+	}
+
+	/* periodic windows, which overlap add evenly */
+	for (i = 0; i < n; i++)
+	{
+		a = 2*M_PI*i/n;
+		switch (window)
+		{
+		case WELCH_RECT:
+			w->win[i] = 1;
+			break;
+		case WELCH_HANN:
+			w->win[i] = 0.5 - 0.5*cos(a);
+			break;
+		case WELCH_HAMMING:
+			w->win[i] = 0.54 - 0.46*cos(a);
+			break;
+		case WELCH_BLACKMAN:
+			w->win[i] = 0.42 - 0.5*cos(a) + 0.08*cos(2*a);
+			break;
+		}
+		w->win_ss += w->win[i]*w->win[i];
+	}
+
+	return 0;
+}
+
+static void add_segment(welch_t *w)
+{
+	double mean = 0;
+	size_t i;
+
+	for (i = 0; i < w->n; i++)
+	{
+		mean += w->buf[i];
+	}
+	mean /= w->n;
+	for (i = 0; i < w->n; i++)
+	{
+		w->seg[i] = (w->buf[i] - mean)*w->win[i];
+	}
+
+	fft_power(&w->fft, w->seg, w->power);
+	for (i = 0; i <= w->n/2; i++)
+	{
+		w->sum[i] += w->power[i];
+	}
+	w->num_segments++;
+}
+
+void welch_push(welch_t *w, const double *x, size_t count)
+{
+	size_t m;
+
+	while (count > 0)
+	{
+		m = w->n - w->fill;
+		if (m > count)
+		{
+			m = count;
+		}
+		memcpy(w->buf + w->fill, x, m*sizeof(double));
+		w->fill += m;
+		x += m;
+		count -= m;
+
+		if (w->fill == w->n)
+		{
+			add_segment(w);
+			memmove(w->buf, w->buf + w->hop, (w->n - w->hop)*sizeof(double));
+			w->fill = w->n - w->hop;
+		}
+	}
+}
+
+void welch_restart(welch_t *w)
+{
+	w->fill = 0;
+}
+
+/* The average one-sided density of the segments so far in counts^2/Hz,
+ * n/2 + 1 bins from 0 to rate/2 Hz. */
+void welch_psd(const welch_t *w, double *psd)
+{
+	double scale = (w->num_segments > 0) ? 1/(w->num_segments*w->rate*w->win_ss) : 0;
+	size_t i;
+
+	for (i = 0; i <= w->n/2; i++)
+	{
+		psd[i] = w->sum[i]*scale*((i == 0 || i == w->n/2) ? 1 : 2);
+	}
+}
+
+void welch_free(welch_t *w)
+{
+	fft_free(&w->fft);
+	free(w->win);
+	free(w->buf);
+	free(w->seg);
+	free(w->power);
+	free(w->sum);
+	memset(w, 0, sizeof(*w));
+}
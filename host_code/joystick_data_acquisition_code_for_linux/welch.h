@@ -0,0 +1,50 @@
+/* Streaming Welch power spectral density.
+ *
+ * Regularly sampled values (see resample.h) are cut into segments of n
+ * values that overlap by a given fraction. Each segment has its mean
+ * removed, is windowed and transformed (see fft.h), and its power is added
+ * to a running sum, so a recording of any length is averaged in the
+ * memory of one segment. welch_psd() gives the one-sided density in
+ * counts^2/Hz at any point.
+ *
+ * welch_restart() drops the segment being collected, e.g. at a gap in the
+ * data, so no segment spans the gap.
+ */
+
+#ifndef WELCH_H
+#define WELCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fft.h"
+
+#define WELCH_RECT 0
+#define WELCH_HANN 1
+#define WELCH_HAMMING 2
+#define WELCH_BLACKMAN 3
+
+typedef struct
+{
+	size_t n;                 /* segment length, a power of two */
+	size_t hop;               /* values between the starts of segments */
+	double rate;              /* samples/s */
+	double *win;
+	double win_ss;            /* sum of the squared window */
+	double *buf;              /* the segment being collected */
+	size_t fill;
+	double *seg;
+	double *power;
+	double *sum;              /* n/2 + 1 bins */
+	uint64_t num_segments;
+	fft_t fft;
+} welch_t;
+
+int welch_window(const char *name);
+int welch_init(welch_t *w, size_t n, double overlap, int window, double rate);
+void welch_push(welch_t *w, const double *x, size_t count);
+void welch_restart(welch_t *w);
+void welch_psd(const welch_t *w, double *psd);
+void welch_free(welch_t *w);
+
+#endif
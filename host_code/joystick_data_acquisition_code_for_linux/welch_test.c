@@ -0,0 +1,254 @@
+/* Tests of the FFT in fft.c and the Welch PSD in welch.c. Built and run
+ * with
+ *
+ *   make check
+ *
+ * The tests check that
+ *   - fft_power() agrees with a naive DFT for every size from 4 to 2048,
+ *     and sizes that aren't a power of two >= 4 are refused,
+ *   - the PSD of white noise is flat at 2*variance/rate with each window,
+ *   - the PSD of a sine adds up to its power and peaks at its frequency,
+ *     and a constant offset added to it is removed,
+ *   - the number of segments follows from the overlap, pushing in pieces
+ *     gives the same result as pushing everything at once, and
+ *     welch_restart() drops the segment being collected.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fft.h"
+#include "welch.h"
+
+#define MAX_N 2048
+
+static int failures;
+
+static void check(int ok, const char *what, size_t n)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "FAIL: %s (n = %zu)\n", what, n);
+		failures++;
+	}
+}
+
+static uint32_t lcg = 12345;
+
+/* uniform in [-1, 1) */
+static double uniform(void)
+{
+	lcg = lcg*1664525 + 1013904223;
+	return (lcg >> 8)/8388608.0 - 1;
+}
+
+static void test_fft(void)
+{
+	static double x[MAX_N], power[MAX_N/2 + 1];
+	fft_t f;
+	double re, im, want, err, total;
+	size_t n, j, k;
+
+	for (n = 4; n <= MAX_N; n *= 2)
+	{
+		if (fft_init(&f, n) != 0)
+		{
+			check(0, "fft_init", n);
+			continue;
+		}
+		for (j = 0; j < n; j++)
+		{
+			x[j] = 1000*uniform();
+		}
+		fft_power(&f, x, power);
+
+		err = 0;
+		total = 0;
+		for (k = 0; k <= n/2; k++)
+		{
+			re = 0;
+			im = 0;
+			for (j = 0; j < n; j++)
+			{
+				re += x[j]*cos(2*M_PI*(double)(j*k % n)/n);
+				im -= x[j]*sin(2*M_PI*(double)(j*k % n)/n);
+			}
+			want = re*re + im*im;
+			total += want;
+			if (fabs(power[k] - want) > err)
+			{
+				err = fabs(power[k] - want);
+			}
+		}
+		check(err <= 1e-9*total, "fft_power agrees with a naive DFT", n);
+		fft_free(&f);
+	}
+
+	check(fft_init(&f, 2) != 0, "n = 2 is refused", 2);
+	check(fft_init(&f, 6) != 0, "n = 6 is refused", 6);
+	check(fft_init(&f, 1000) != 0, "n = 1000 is refused", 1000);
+}
+
+static void test_white_noise(void)
+{
+	static double x[1 << 16];
+	static double psd[257];
+	size_t n = 512;
+	size_t count = sizeof(x)/sizeof(x[0]);
+	double rate = 125;
+	double want, mean;
+	size_t i;
+	int window;
+	welch_t w;
+
+	/* uniform noise of variance 1/3 */
+	for (i = 0; i < count; i++)
+	{
+		x[i] = uniform();
+	}
+	want = 2*(1.0/3)/rate;
+
+	for (window = WELCH_RECT; window <= WELCH_BLACKMAN; window++)
+	{
+		if (welch_init(&w, n, 0.5, window, rate) != 0)
+		{
+			check(0, "welch_init", n);
+			continue;
+		}
+		welch_push(&w, x, count);
+		welch_psd(&w, psd);
+
+		mean = 0;
+		for (i = 1; i < n/2; i++)
+		{
+			mean += psd[i];
+		}
+		mean /= n/2 - 1;
+		check(fabs(mean/want - 1) < 0.03, "white noise is at 2*variance/rate", n);
+		check(psd[n/4] > want/2 && psd[n/4] < 2*want, "white noise is flat", n);
+		welch_free(&w);
+	}
+}
+
+static void test_sine(void)
+{
+	static double x[1 << 14];
+	static double psd[513];
+	size_t n = 1024;
+	size_t count = sizeof(x)/sizeof(x[0]);
+	double rate = 125;
+	double amp = 300;
+	double f0 = 10.3;
+	double total = 0;
+	double dc;
+	size_t peak = 0;
+	size_t i;
+	welch_t w;
+
+	for (i = 0; i < count; i++)
+	{
+		x[i] = 500 + amp*sin(2*M_PI*f0*i/rate);
+	}
+	if (welch_init(&w, n, 0.5, WELCH_HANN, rate) != 0)
+	{
+		check(0, "welch_init", n);
+		return;
+	}
+	welch_push(&w, x, count);
+	welch_psd(&w, psd);
+
+	for (i = 0; i <= n/2; i++)
+	{
+		total += psd[i]*rate/n;
+		if (psd[i] > psd[peak])
+		{
+			peak = i;
+		}
+	}
+	check(fabs(total/(amp*amp/2) - 1) < 0.01, "the PSD of a sine adds up to its power", n);
+	check(fabs(peak*rate/n - f0) <= rate/n, "the PSD of a sine peaks at its frequency", n);
+	welch_free(&w);
+
+	/* the offset makes no difference to bin 0 */
+	dc = psd[0];
+	for (i = 0; i < count; i++)
+	{
+		x[i] -= 500;
+	}
+	welch_init(&w, n, 0.5, WELCH_HANN, rate);
+	welch_push(&w, x, count);
+	welch_psd(&w, psd);
+	check(fabs(dc - psd[0]) <= 1e-9*psd[peak], "the mean is removed", n);
+	welch_free(&w);
+}
+
+static void test_segments(void)
+{
+	static double x[10000];
+	static double psd_a[129], psd_b[129];
+	size_t n = 256;
+	size_t i;
+	welch_t a, b;
+
+	for (i = 0; i < sizeof(x)/sizeof(x[0]); i++)
+	{
+		x[i] = 100*uniform();
+	}
+
+	welch_init(&a, n, 0.75, WELCH_HANN, 125);
+	welch_init(&b, n, 0.75, WELCH_HANN, 125);
+	check(a.hop == 64, "an overlap of 0.75 is a hop of n/4", n);
+
+	welch_push(&a, x, 10000);
+	for (i = 0; i < 10000; i += 37)
+	{
+		welch_push(&b, x + i, (10000 - i < 37) ? 10000 - i : 37);
+	}
+	check(a.num_segments == (10000 - n)/64 + 1, "the number of segments follows from the hop", n);
+	check(b.num_segments == a.num_segments, "pushing in pieces gives the same segments", n);
+	welch_psd(&a, psd_a);
+	welch_psd(&b, psd_b);
+	check(memcmp(psd_a, psd_b, sizeof(psd_a)) == 0, "pushing in pieces gives the same PSD", n);
+
+	/* a restart drops the 100 values collected, so 100 + 255 make no
+	 * segment and one more does */
+	welch_free(&b);
+	welch_init(&b, n, 0.5, WELCH_HANN, 125);
+	welch_push(&b, x, 100);
+	welch_restart(&b);
+	welch_push(&b, x, 255);
+	check(b.num_segments == 0, "welch_restart drops the segment being collected", n);
+	welch_push(&b, x, 1);
+	check(b.num_segments == 1, "a segment after a restart", n);
+
+	welch_psd(&b, psd_b);
+	welch_free(&b);
+	welch_init(&b, n, 0.5, WELCH_HANN, 125);
+	welch_psd(&b, psd_b);
+	check(psd_b[1] == 0, "no segments, no density", n);
+
+	check(welch_init(&b, 100, 0.5, WELCH_HANN, 125) != 0, "a segment length that isn't a power of two is refused", 100);
+	check(welch_init(&b, n, 1, WELCH_HANN, 125) != 0, "an overlap of 1 is refused", n);
+
+	welch_free(&a);
+}
+
+int main(void)
+{
+	test_fft();
+	test_white_noise();
+	test_sine();
+	test_segments();
+
+	if (failures > 0)
+	{
+		fprintf(stderr, "welch_test: %d check(s) failed.\n", failures);
+		return 1;
+	}
+	fprintf(stdout, "welch_test: all checks passed.\n");
+
+	return 0;
+}
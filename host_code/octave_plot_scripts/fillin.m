@@ -25,7 +25,8 @@
 % Subfunctions: none
 % MAT-files required: none
 %
-% See also: NONE
+% See also: export_csv -R, which resamples recordings of any length as they
+%           are read, with zero-order hold, linear or windowed-sinc interpolation.
 %
 % Author: Jonathan Thomson
 % Work:
@@ -0,0 +1,48 @@
+% Plot the power spectral density of the js0 and js1 data for each axis.
+% The densities are computed by the psd program from the recordings, e.g.
+%
+%   ./psd js0.jsc js1.jsc
+%
+% which averages the spectra of short overlapping segments (Welch's method)
+% as the recordings are read, so unlike freqplots_js0js1_fillin.m it works
+% for recordings of any length. Place one plot window over the other and
+% alt-tab between them to see the differences in the plots.
+
+
+%close all
+clear all
+clc
+
+filter_type = 'no filter';
+%filter_type = 'moving-average M=8';
+%filter_type = 'chebyshev';
+
+%acc_axis_list = ['x', 'y', 'z'];
+acc_axis_list = 'x';
+
+for acc_axis = acc_axis_list
+
+	%%% js0 %%%
+	% columns: frequency [Hz], density [counts^2/Hz], density [dB]
+	psd0 = load(['js0_' acc_axis '-axis_psd.csv']);
+
+	figure('Position', [1 1 835 523]);
+	plot(psd0(:,1), psd0(:,3), 'r')
+	a = axis();
+	grid on
+	xlabel('frequency [Hz]')
+	ylabel('dB re 1 count^2/Hz')
+	title(['nunchuk ' acc_axis '-axis ' '(' filter_type ')'])
+
+	%%% js1 %%%
+	psd1 = load(['js1_' acc_axis '-axis_psd.csv']);
+
+	figure('Position', [1 1 835 523]);
+	plot(psd1(:,1), psd1(:,3), 'b')
+	axis(a);
+	grid on
+	xlabel('frequency [Hz]')
+	ylabel('dB re 1 count^2/Hz')
+	title(['jw24f8 ' acc_axis '-axis '])
+
+end
@@ -53,12 +53,18 @@ const USB_Descriptor_HIDReport_Datatype_t PROGMEM JoystickReport[] =
 	        HID_RI_USAGE(8, 0x30), /* Usage Direction-X */
 	        HID_RI_USAGE(8, 0x31), /* Usage Direction-Y */
 	        HID_RI_USAGE(8, 0x32), /* Usage Direction-Z */
+	        HID_RI_USAGE(8, 0x33), /* Usage Rotation-X, minimum of X since last report */
+	        HID_RI_USAGE(8, 0x34), /* Usage Rotation-Y, minimum of Y since last report */
+	        HID_RI_USAGE(8, 0x35), /* Usage Rotation-Z, minimum of Z since last report */
+	        HID_RI_USAGE(8, 0x36), /* Usage Slider, maximum of X since last report */
+	        HID_RI_USAGE(8, 0x37), /* Usage Dial, maximum of Y since last report */
+	        HID_RI_USAGE(8, 0x38), /* Usage Wheel, maximum of Z since last report */
 	        HID_RI_LOGICAL_MINIMUM(8, 0), /* LOGICAL_MINIMUM (0) */
 	        HID_RI_LOGICAL_MAXIMUM(16, 0x03ff), /* LOGICAL_MAXIMUM (1023) */
 	        HID_RI_PHYSICAL_MINIMUM(8, 0x00), /* PHYSICAL_MINIMUM (0) */
 	        HID_RI_PHYSICAL_MAXIMUM(16, 0x03ff), /* PHYSICAL_MAXIMUM (1023) */
 	        HID_RI_REPORT_SIZE(8, 0x10), /* REPORT_SIZE (16) */
-	        HID_RI_REPORT_COUNT(8, 0x03), /* REPORT_COUNT (3) */
+	        HID_RI_REPORT_COUNT(8, 0x09), /* REPORT_COUNT (9) */
 	        HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
 	    HID_RI_END_COLLECTION(0),
 	    HID_RI_USAGE_PAGE(8, 0x09), /* Button */
@@ -69,6 +75,22 @@ const USB_Descriptor_HIDReport_Datatype_t PROGMEM JoystickReport[] =
 	    HID_RI_REPORT_COUNT(8, 0x08), /* REPORT_COUNT (8) */
 	    HID_RI_REPORT_SIZE(8, 0x01), /* REPORT_SIZE (1) */
 	    HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+#ifdef REPORT_SUMSQ
+	    HID_RI_USAGE_PAGE(16, 0xFF00), /* Vendor Defined */
+	    HID_RI_USAGE(8, 0x01), /* number of samples since last report */
+	    HID_RI_LOGICAL_MINIMUM(8, 0x00), /* LOGICAL_MINIMUM (0) */
+	    HID_RI_LOGICAL_MAXIMUM(16, 0x00ff), /* LOGICAL_MAXIMUM (255) */
+	    HID_RI_REPORT_SIZE(8, 0x08), /* REPORT_SIZE (8) */
+	    HID_RI_REPORT_COUNT(8, 0x01), /* REPORT_COUNT (1) */
+	    HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+	    HID_RI_USAGE(8, 0x02), /* sum of squares of X since last report */
+	    HID_RI_USAGE(8, 0x03), /* sum of squares of Y since last report */
+	    HID_RI_USAGE(8, 0x04), /* sum of squares of Z since last report */
+	    HID_RI_LOGICAL_MAXIMUM(32, 0x7fffffff), /* LOGICAL_MAXIMUM (2^31 - 1) */
+	    HID_RI_REPORT_SIZE(8, 0x20), /* REPORT_SIZE (32) */
+	    HID_RI_REPORT_COUNT(8, 0x03), /* REPORT_COUNT (3) */
+	    HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
+#endif
 	HID_RI_END_COLLECTION(0),
 };
 
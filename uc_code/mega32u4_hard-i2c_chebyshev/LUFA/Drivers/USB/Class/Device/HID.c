@@ -50,6 +50,14 @@ void HID_Device_ProcessControlRequest(USB_ClassInfo_HID_Device_t* const HIDInter
 		case HID_REQ_GetReport:
 			if (USB_ControlRequest.bmRequestType == (REQDIR_DEVICETOHOST | REQTYPE_CLASS | REQREC_INTERFACE))
 			{
+				#if defined(HID_DEVICE_STREAM_REPORTS)
+				/* Creating a report may consume what it reports, which would then be missing from the stream on the
+				 * IN endpoint, so the host is sent the last IN report again instead */
+				Endpoint_ClearSETUP();
+				Endpoint_Write_Control_Stream_LE(HIDInterfaceInfo->Config.PrevReportINBuffer,
+				                                 HIDInterfaceInfo->Config.PrevReportINBufferSize);
+				Endpoint_ClearOUT();
+				#else
 				uint16_t ReportSize = 0;
 				uint8_t  ReportID   = (USB_ControlRequest.wValue & 0xFF);
 				uint8_t  ReportType = (USB_ControlRequest.wValue >> 8) - 1;
@@ -70,6 +78,7 @@ void HID_Device_ProcessControlRequest(USB_ClassInfo_HID_Device_t* const HIDInter
 				Endpoint_ClearSETUP();
 				Endpoint_Write_Control_Stream_LE(ReportData, ReportSize);
 				Endpoint_ClearOUT();
+				#endif
 			}
 
 			break;
@@ -149,6 +158,41 @@ bool HID_Device_ConfigureEndpoints(USB_ClassInfo_HID_Device_t* const HIDInterfac
 	return true;
 }
 
+#if defined(HID_DEVICE_STREAM_REPORTS)
+void HID_Device_USBTask(USB_ClassInfo_HID_Device_t* const HIDInterfaceInfo)
+{
+	if (USB_DeviceState != DEVICE_STATE_Configured)
+	  return;
+
+	Endpoint_SelectEndpoint(HIDInterfaceInfo->Config.ReportINEndpointNumber);
+
+	if (!(Endpoint_IsReadWriteAllowed()))
+	  return;
+
+	uint8_t* ReportINData  = HIDInterfaceInfo->Config.PrevReportINBuffer;
+	uint8_t  ReportID      = 0;
+	uint16_t ReportINSize  = 0;
+
+	bool ForceSend = CALLBACK_HID_Device_CreateHIDReport(HIDInterfaceInfo, &ReportID, HID_REPORT_ITEM_In,
+	                                                     ReportINData, &ReportINSize);
+
+	/* The report is built in place over the previous one, so there is nothing left to compare it against; unless
+	 * forced, only the idle period can trigger a send */
+	if (ReportINSize && (ForceSend || (HIDInterfaceInfo->State.IdleCount && !(HIDInterfaceInfo->State.IdleMSRemaining))))
+	{
+		HIDInterfaceInfo->State.IdleMSRemaining = HIDInterfaceInfo->State.IdleCount;
+
+		Endpoint_SelectEndpoint(HIDInterfaceInfo->Config.ReportINEndpointNumber);
+
+		if (ReportID)
+		  Endpoint_Write_8(ReportID);
+
+		Endpoint_Write_Stream_LE(ReportINData, ReportINSize, NULL);
+
+		Endpoint_ClearIN();
+	}
+}
+#else
 void HID_Device_USBTask(USB_ClassInfo_HID_Device_t* const HIDInterfaceInfo)
 {
 	if (USB_DeviceState != DEVICE_STATE_Configured)
@@ -190,6 +234,7 @@ void HID_Device_USBTask(USB_ClassInfo_HID_Device_t* const HIDInterfaceInfo)
 		}
 	}
 }
+#endif
 
 #endif
 
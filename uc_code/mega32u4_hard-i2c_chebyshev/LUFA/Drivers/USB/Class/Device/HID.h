@@ -146,6 +146,12 @@
 			/** General management task for a given HID class interface, required for the correct operation of the interface. This should
 			 *  be called frequently in the main program loop, before the master USB management task \ref USB_USBTask().
 			 *
+			 *  \note When the \c HID_DEVICE_STREAM_REPORTS compile time token is defined, the IN report is created directly in the
+			 *        interface's \c PrevReportINBuffer (which must then not be \c NULL) without first being cleared, and no comparison
+			 *        against the previous report is made. The \ref CALLBACK_HID_Device_CreateHIDReport() callback must then fill in every
+			 *        byte of the report and return \c true for each report that is to be sent outside of the idle period. A
+			 *        GET_REPORT request from the host is answered with the last IN report created, without the callback being called.
+			 *
 			 *  \param[in,out] HIDInterfaceInfo  Pointer to a structure containing a HID Class configuration and state.
 			 */
 			void HID_Device_USBTask(USB_ClassInfo_HID_Device_t* const HIDInterfaceInfo) ATTR_NON_NULL_PTR_ARG(1);
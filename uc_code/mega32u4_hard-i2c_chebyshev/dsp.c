@@ -0,0 +1,84 @@
+/*
+   Signal processing core of the firmware. See dsp.h.
+*/
+
+#include "dsp.h"
+#include "lpf.h"
+
+#if (N != DSP_N)
+	#error DSP_N in dsp.h must be the filter length N of lpf.h.
+#endif
+
+#define next(i) (((i) == (N-1)) ? 0 : (i)+1)
+
+void Dsp_Init(Dsp_Filter_t* f)
+{
+	uint8_t i;
+
+	for (i = 0; i < N; i++)
+	{
+		f->xi[i] = f->yi[i] = f->zi[i] = 0;
+		f->xo[i] = f->yo[i] = f->zo[i] = 0;
+	}
+	f->cbi = 0;
+}
+
+/* Runs one sample through the direct form I filter
+ *     y[n] = b[0]x[n] + ... + b[N-1]x[n-N+1] - a[1]y[n-1] - ... - a[N-1]y[n-N+1]
+ * in the same order of operations the firmware has always used, so the
+ * output is bit for bit what it was. */
+void Dsp_Filter(Dsp_Filter_t* f, const Sensor_Sample_t* sample, Dsp_Output_t* out)
+{
+	float accum_x = 0;
+	float accum_y = 0;
+	float accum_z = 0;
+	uint8_t cbi;
+	uint8_t i;
+
+	/* the oldest slot becomes the newest */
+	cbi = next(f->cbi);
+	f->cbi = cbi;
+	f->xi[cbi] = sample->x;
+	f->yi[cbi] = sample->y;
+	f->zi[cbi] = sample->z;
+
+	// loop N-1 times, from the oldest sample to the one before the newest
+	cbi = next(cbi);
+	for (i=N-1; i > 0; i--)
+	{
+		accum_x = accum_x - a[i]*f->xo[cbi] + b[i]*f->xi[cbi];
+		accum_y = accum_y - a[i]*f->yo[cbi] + b[i]*f->yi[cbi];
+		accum_z = accum_z - a[i]*f->zo[cbi] + b[i]*f->zi[cbi];
+
+		cbi = next(cbi);
+	}
+
+	// cbi is now the index of the newest sample
+	f->xo[cbi] = accum_x + b[0]*f->xi[cbi];
+	f->yo[cbi] = accum_y + b[0]*f->yi[cbi];
+	f->zo[cbi] = accum_z + b[0]*f->zi[cbi];
+
+	out->x = f->xo[cbi];
+	out->y = f->yo[cbi];
+	out->z = f->zo[cbi];
+}
+
+/* Decodes one raw sample and filters it. A sample the driver rejects, such
+ * as the nunchuk's 0xFE spikes, is replaced by the previous one. Returns 0
+ * if the sample was rejected. */
+uint8_t Dsp_Process(Dsp_Filter_t* f, const uint8_t* raw, Dsp_Output_t* out)
+{
+	Sensor_Sample_t sample;
+	uint8_t ok;
+
+	ok = Sensor_Decode(raw, &sample);
+	if (!ok)
+	{
+		sample.x = f->xi[f->cbi];
+		sample.y = f->yi[f->cbi];
+		sample.z = f->zi[f->cbi];
+	}
+	Dsp_Filter(f, &sample, out);
+
+	return ok;
+}
@@ -0,0 +1,50 @@
+/*
+   Signal processing core of the firmware: decoding the sensor's raw
+   samples, rejecting the bad ones and low-pass filtering the result with
+   the Chebyshev filter designed by chebyshev_calc.m (lpf.h).
+
+   The core only needs stdint.h and the decoder of the sensor driver, so
+   the same code is compiled into the firmware, where the timer ISR feeds
+   it, and on a PC, where dsp_test.c checks it against the filter design
+   (make check).
+*/
+
+#ifndef _DSP_H_
+#define _DSP_H_
+
+	/* Includes: */
+		#include <stdint.h>
+
+		#include "sensor.h"
+
+	/* Macros: */
+		/** Filter length, the N of lpf.h. dsp.c checks that they agree. */
+		#define DSP_N 5
+
+	/* Type Defines: */
+		/** Filter state of the three axes. Set up with Dsp_Init(). */
+		typedef struct
+		{
+			float   xi[DSP_N]; /**< newest inputs, a circular buffer */
+			float   yi[DSP_N];
+			float   zi[DSP_N];
+			float   xo[DSP_N]; /**< newest outputs, in the same slots */
+			float   yo[DSP_N];
+			float   zo[DSP_N];
+			uint8_t cbi;   /**< slot of the newest input and output */
+		} Dsp_Filter_t;
+
+		/** One filter output. */
+		typedef struct
+		{
+			float x;
+			float y;
+			float z;
+		} Dsp_Output_t;
+
+	/* Function Prototypes: */
+		void Dsp_Init(Dsp_Filter_t* f);
+		void Dsp_Filter(Dsp_Filter_t* f, const Sensor_Sample_t* sample, Dsp_Output_t* out);
+		uint8_t Dsp_Process(Dsp_Filter_t* f, const uint8_t* raw, Dsp_Output_t* out);
+
+#endif
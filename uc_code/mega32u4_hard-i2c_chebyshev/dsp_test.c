@@ -0,0 +1,433 @@
+/*
+   Host test of the signal processing core in dsp.c. Built and run with
+
+     make check
+
+   It checks that
+     - the coefficients in lpf.h are the cheby1() design of
+       chebyshev_calc.m, which is redone here in double precision,
+     - the nunchuk decoder unpacks the 10 bit axes and rejects 0xFE spikes,
+       and a rejected sample filters the same as repeating the previous one,
+     - the filter settles to its DC gain and follows a double precision
+       model of the same difference equation to within MAX_ERROR counts,
+     - the filter output of a fixed synthetic stream is bit for bit the
+       same as it was, by comparing its CRC-32 with GOLDEN_CRC. Any change
+       to the order of the float operations, such as a fixed point version,
+       shows up here and must match the model instead before GOLDEN_CRC is
+       updated with the value printed by dsp_test -g.
+
+   Nunchuk byte streams, 6 bytes per sample as Sensor_BurstRead() stores
+   them, can be given as arguments. Each is run through the core and the
+   model and its CRC printed, so recordings can be checked the same way.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dsp.h"
+
+/* the coefficients of lpf.h, which defines them in dsp.c */
+#define N DSP_N
+extern float b[N];
+extern float a[N];
+
+/* the design in chebyshev_calc.m */
+#define DESIGN_FS     250.0
+#define DESIGN_FC     38.725
+#define DESIGN_ORDER  4
+#define DESIGN_RIPPLE 0.5
+
+/* %g keeps 6 significant digits */
+#define COEF_TOLERANCE 1e-5
+
+#define MAX_ERROR 0.01
+
+#define GOLDEN_SAMPLES 20000
+#define GOLDEN_CRC     0x61B93AADUL
+
+static int failures;
+
+static void check(int ok, const char* what)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "FAIL: %s\n", what);
+		failures++;
+	}
+}
+
+/* The same difference equation as Dsp_Filter(), in double. */
+typedef struct
+{
+	double x[N];
+	double y[N];
+} model_t;
+
+static double model_filter(model_t* m, double in)
+{
+	double out;
+	int i;
+
+	memmove(&m->x[1], &m->x[0], (N-1)*sizeof(m->x[0]));
+	memmove(&m->y[1], &m->y[0], (N-1)*sizeof(m->y[0]));
+	m->x[0] = in;
+
+	out = b[0]*m->x[0];
+	for (i = 1; i < N; i++)
+	{
+		out += b[i]*m->x[i] - a[i]*m->y[i];
+	}
+	m->y[0] = out;
+
+	return out;
+}
+
+/* Octave's cheby1(n, Rp, Wc): the analog prototype, scaled to the
+ * prewarped cutoff and mapped with the bilinear transform. */
+static void cheby1(int n, double rp, double wc, double* bd, double* ad)
+{
+	double eps, v0, w, th, re, im, gain_re, gain_im, t;
+	double pr[DESIGN_ORDER], pi_[DESIGN_ORDER];
+	double zr, zi, d;
+	double cr[DESIGN_ORDER+1], ci[DESIGN_ORDER+1];
+	int k, j;
+
+	eps = sqrt(pow(10, rp/10) - 1);
+	v0 = asinh(1/eps)/n;
+	w = tan(M_PI*wc/2);
+
+	/* gain = prod(-pole), and the z plane poles (1+p)/(1-p) */
+	gain_re = 1;
+	gain_im = 0;
+	for (k = 0; k < n; k++)
+	{
+		th = M_PI*(-(n-1) + 2*k)/(2*n);
+		re = -sinh(v0)*cos(th)*w;
+		im = cosh(v0)*sin(th)*w;
+
+		/* gain *= -p/(1-p) */
+		d = (1-re)*(1-re) + im*im;
+		zr = (-re*(1-re) + im*im)/d;
+		zi = (-im*(1-re) - re*im)/d;
+		t = gain_re*zr - gain_im*zi;
+		gain_im = gain_re*zi + gain_im*zr;
+		gain_re = t;
+
+		pr[k] = ((1+re)*(1-re) - im*im)/d;
+		pi_[k] = ((1+re)*im + im*(1-re))/d;
+	}
+	if (n % 2 == 0)
+	{
+		gain_re /= pow(10, rp/20);
+	}
+
+	/* a = poly(poles), b = gain*poly(-1, ..., -1) */
+	memset(cr, 0, sizeof(cr));
+	memset(ci, 0, sizeof(ci));
+	cr[0] = 1;
+	for (k = 0; k < n; k++)
+	{
+		for (j = k+1; j > 0; j--)
+		{
+			t = cr[j] - (pr[k]*cr[j-1] - pi_[k]*ci[j-1]);
+			ci[j] = ci[j] - (pr[k]*ci[j-1] + pi_[k]*cr[j-1]);
+			cr[j] = t;
+		}
+	}
+	for (k = 0; k <= n; k++)
+	{
+		ad[k] = cr[k];
+		bd[k] = gain_re;
+		for (j = 0; j < k; j++)
+		{
+			bd[k] = bd[k]*(n-j)/(j+1);
+		}
+	}
+}
+
+static void test_coefficients(void)
+{
+	double bd[DESIGN_ORDER+1], ad[DESIGN_ORDER+1];
+	double rp;
+	int i;
+
+	check(N == DESIGN_ORDER+1, "lpf.h has the filter length of the design");
+	if (N != DESIGN_ORDER+1)
+	{
+		return;
+	}
+
+	rp = 20*log10(100/(100-DESIGN_RIPPLE));
+	cheby1(DESIGN_ORDER, rp, DESIGN_FC/(DESIGN_FS/2), bd, ad);
+	for (i = 0; i < N; i++)
+	{
+		check(fabs(b[i] - bd[i]) <= COEF_TOLERANCE*fabs(bd[i]), "b[] matches cheby1()");
+		check(fabs(a[i] - ad[i]) <= COEF_TOLERANCE*fabs(ad[i]), "a[] matches cheby1()");
+	}
+}
+
+static void pack(uint16_t x, uint16_t y, uint16_t z, uint8_t* raw)
+{
+	raw[0] = 128;
+	raw[1] = 128;
+	raw[2] = x >> 2;
+	raw[3] = y >> 2;
+	raw[4] = z >> 2;
+	raw[5] = 0x03 | (x & 3) << 2 | (y & 3) << 4 | (z & 3) << 6;
+}
+
+static void test_decode(void)
+{
+	uint8_t raw[SENSOR_SAMPLE_SIZE];
+	uint8_t spike[SENSOR_SAMPLE_SIZE] = {128, 128, 0x80, 0x80, 0xFE, 0xFE};
+	Sensor_Sample_t s;
+	Dsp_Filter_t f1, f2;
+	Dsp_Output_t o1, o2;
+	int i;
+
+	pack(1023, 0, 513, raw);
+	check(Sensor_Decode(raw, &s) == 1, "a sample decodes");
+	check(s.x == 1023 && s.y == 0 && s.z == 513, "the 10 bit axes are unpacked");
+	check(Sensor_Decode(spike, &s) == 0, "a 0xFE spike is rejected");
+
+	/* the padding of the filter states is compared too */
+	memset(&f1, 0, sizeof(f1));
+	memset(&f2, 0, sizeof(f2));
+	Dsp_Init(&f1);
+	Dsp_Init(&f2);
+	for (i = 0; i < 10; i++)
+	{
+		pack(500 + 7*i, 510 - 3*i, 700 + i, raw);
+		Dsp_Process(&f1, raw, &o1);
+		Dsp_Process(&f2, raw, &o2);
+	}
+	check(Dsp_Process(&f1, spike, &o1) == 0, "Dsp_Process() reports the spike");
+	Dsp_Process(&f2, raw, &o2);
+	check(memcmp(&o1, &o2, sizeof(o1)) == 0 && memcmp(&f1, &f2, sizeof(f1)) == 0,
+	      "a spike filters the same as repeating the previous sample");
+}
+
+static void test_dc_gain(void)
+{
+	Dsp_Filter_t f;
+	Sensor_Sample_t s = {512, 0, 1023};
+	Dsp_Output_t o;
+	double gain_b = 0, gain_a = 0, gain;
+	int i;
+
+	for (i = 0; i < N; i++)
+	{
+		gain_b += b[i];
+		gain_a += a[i];
+	}
+	gain = gain_b/gain_a;
+
+	Dsp_Init(&f);
+	for (i = 0; i < 500; i++)
+	{
+		Dsp_Filter(&f, &s, &o);
+	}
+	check(fabs(o.x - 512*gain) < MAX_ERROR && o.y == 0 && fabs(o.z - 1023*gain) < MAX_ERROR,
+	      "the filter settles to its DC gain");
+}
+
+/* CRC-32 (IEEE 802.3) */
+static uint32_t crc32(uint32_t crc, const void* buf, size_t len)
+{
+	const uint8_t* p = buf;
+	int k;
+
+	crc = ~crc;
+	while (len--)
+	{
+		crc ^= *p++;
+		for (k = 0; k < 8; k++)
+		{
+			crc = (crc >> 1) ^ (0xEDB88320UL & -(crc & 1));
+		}
+	}
+
+	return ~crc;
+}
+
+/* Runs a byte stream through the core and the model. Returns the CRC of
+ * the core's output and stores the largest difference from the model. */
+static uint32_t run_stream(const uint8_t* raw, size_t num, double* max_err)
+{
+	Dsp_Filter_t f;
+	Dsp_Output_t o;
+	Sensor_Sample_t s, prev = {0, 0, 0};
+	model_t mx, my, mz;
+	double e;
+	uint32_t crc = 0;
+	size_t k;
+
+	Dsp_Init(&f);
+	memset(&mx, 0, sizeof(mx));
+	memset(&my, 0, sizeof(my));
+	memset(&mz, 0, sizeof(mz));
+	*max_err = 0;
+
+	for (k = 0; k < num; k++)
+	{
+		Dsp_Process(&f, &raw[k*SENSOR_SAMPLE_SIZE], &o);
+		crc = crc32(crc, &o, sizeof(o));
+
+		if (Sensor_Decode(&raw[k*SENSOR_SAMPLE_SIZE], &s))
+		{
+			prev = s;
+		}
+		e = fabs(o.x - model_filter(&mx, prev.x));
+		*max_err = (e > *max_err) ? e : *max_err;
+		e = fabs(o.y - model_filter(&my, prev.y));
+		*max_err = (e > *max_err) ? e : *max_err;
+		e = fabs(o.z - model_filter(&mz, prev.z));
+		*max_err = (e > *max_err) ? e : *max_err;
+	}
+
+	return crc;
+}
+
+/* A nunchuk at rest with noise, two quakes and a spike now and then. */
+static uint8_t* synthetic_stream(size_t num)
+{
+	uint8_t* raw;
+	uint32_t lcg = 12345;
+	double t, shake;
+	int noise[3];
+	size_t k;
+	int i;
+
+	raw = malloc(num*SENSOR_SAMPLE_SIZE);
+	if (raw == NULL)
+	{
+		return NULL;
+	}
+
+	for (k = 0; k < num; k++)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			lcg = lcg*1664525UL + 1013904223UL;
+			noise[i] = (int)(lcg >> 29) - 4;
+		}
+		t = k/DESIGN_FS;
+		shake = 0;
+		if (t > 20 && t < 30)
+		{
+			shake = 300*exp(-(t-20)/3)*sin(2*M_PI*7*t);
+		}
+		if (t > 50 && t < 55)
+		{
+			shake = 500*exp(-(t-50))*sin(2*M_PI*23*t);
+		}
+		pack(512 + noise[0] + shake, 512 + noise[1] - shake/2, 716 + noise[2] + shake/3,
+		     &raw[k*SENSOR_SAMPLE_SIZE]);
+		if (k % 997 == 0)
+		{
+			raw[k*SENSOR_SAMPLE_SIZE + 4] = 0xFE;
+			raw[k*SENSOR_SAMPLE_SIZE + 5] = 0xFE;
+		}
+	}
+
+	return raw;
+}
+
+static void test_golden(int print)
+{
+	uint8_t* raw;
+	uint32_t crc;
+	double max_err;
+
+	raw = synthetic_stream(GOLDEN_SAMPLES);
+	if (raw == NULL)
+	{
+		check(0, "memory for the synthetic stream");
+		return;
+	}
+
+	crc = run_stream(raw, GOLDEN_SAMPLES, &max_err);
+	check(max_err < MAX_ERROR, "the filter follows the double precision model");
+	if (print)
+	{
+		printf("golden_crc=0x%08lX\nmax_error=%g\n", (unsigned long)crc, max_err);
+	}
+	else
+	{
+		check(crc == GOLDEN_CRC, "the output is bit for bit the golden one");
+	}
+
+	free(raw);
+}
+
+static void test_file(const char* path)
+{
+	FILE* f;
+	uint8_t* raw = NULL;
+	size_t size = 0, len = 0, got;
+	uint32_t crc;
+	double max_err;
+
+	f = fopen(path, "rb");
+	if (f == NULL)
+	{
+		fprintf(stderr, "Couldn't open %s.\n", path);
+		failures++;
+		return;
+	}
+	do
+	{
+		if (len == size)
+		{
+			size = size ? 2*size : 65536;
+			raw = realloc(raw, size);
+			if (raw == NULL)
+			{
+				fclose(f);
+				check(0, "memory for the recorded stream");
+				return;
+			}
+		}
+		got = fread(raw + len, 1, size - len, f);
+		len += got;
+	} while (got > 0);
+	fclose(f);
+
+	crc = run_stream(raw, len/SENSOR_SAMPLE_SIZE, &max_err);
+	printf("%s: samples=%lu crc=0x%08lX max_error=%g\n", path,
+	       (unsigned long)(len/SENSOR_SAMPLE_SIZE), (unsigned long)crc, max_err);
+	check(max_err < MAX_ERROR, "the recorded stream follows the double precision model");
+
+	free(raw);
+}
+
+int main(int argc, char** argv)
+{
+	int print = 0;
+	int i;
+
+	if (argc > 1 && strcmp(argv[1], "-g") == 0)
+	{
+		print = 1;
+	}
+
+	test_coefficients();
+	test_decode();
+	test_dc_gain();
+	test_golden(print);
+	for (i = 1 + print; i < argc; i++)
+	{
+		test_file(argv[i]);
+	}
+
+	if (failures > 0)
+	{
+		fprintf(stderr, "dsp_test: %d check(s) failed.\n", failures);
+		return 1;
+	}
+	printf("dsp_test: all checks passed.\n");
+
+	return 0;
+}
@@ -0,0 +1,76 @@
+/*
+   Firmware side of the ISR benchmark (make isrbench). It stands in for
+   main() in nunchuk_quake_sensor.c, which is left out when ISR_BENCH is
+   defined, and is linked with twimock.c in place of twimaster.c, so the
+   timer ISR reads canned nunchuk samples instead of the bus.
+
+   The timer runs as it does in the firmware. Every 8 ms, the USB polling
+   interval, the report callback is called the way the HID class driver
+   would call it. The ISR and the callback mark their phases in GPIOR0
+   (see BENCH_MARK()), which isrbench_sim.c watches under simavr, and
+   BENCH_DONE ends the run after ISRBENCH_REPORTS reports.
+
+   The moving average and unfiltered firmwares are benchmarked with it too.
+   They are built with their own directory first in the include path,
+   which is why nunchuk_quake_sensor.h is included with <>, and with
+   ISRBENCH_NUNCHUK_INIT, as they set the nunchuk up with Nunchuk_Init()
+   rather than through sensor.h.
+*/
+
+#include <util/delay.h>
+
+#include <nunchuk_quake_sensor.h>
+#include "i2cmaster.h"
+#include "twimock.h"
+#if !defined(ISRBENCH_NUNCHUK_INIT)
+	#include "sensor.h"
+#endif
+
+#define ISRBENCH_REPORTS 64
+#define ISRBENCH_SAMPLE_SIZE 6 // bytes of a nunchuk sample, as twimock_load() takes them
+
+/* unencrypted nunchuk samples at rest, moving, and a 0xFE spike */
+static const uint8_t samples[] =
+{
+	0x80, 0x80, 0x80, 0x80, 0xB3, 0x57,
+	0x80, 0x80, 0x82, 0x7F, 0xB4, 0x93,
+	0x80, 0x80, 0x91, 0x70, 0xBA, 0x21,
+	0x80, 0x80, 0x6C, 0x88, 0xA9, 0xE4,
+	0x80, 0x80, 0x80, 0x80, 0xFE, 0xFE,
+	0x80, 0x80, 0x7E, 0x81, 0xB2, 0x6B,
+};
+
+int main(void)
+{
+	uint8_t report[sizeof(USB_JoystickReport_Data_t)];
+	uint8_t report_id = 0;
+	uint16_t report_size;
+	uint8_t k;
+
+	cli();
+
+	twimock_reset(1);
+	twimock_load(samples, sizeof(samples)/ISRBENCH_SAMPLE_SIZE);
+	i2c_init();
+
+#if defined(ISRBENCH_NUNCHUK_INIT)
+	if (Nunchuk_Init() == 1)
+#else
+	if (Sensor_Init() == 1 && Sensor_SetRate(SAMPLE_RATE) == 1)
+#endif
+	{
+		Timer_Init();
+		sei();
+
+		for (k = 0; k < ISRBENCH_REPORTS; k++)
+		{
+			_delay_ms(8);
+			CALLBACK_HID_Device_CreateHIDReport(NULL, &report_id, HID_REPORT_ITEM_In,
+			                                    report, &report_size);
+		}
+	}
+
+	cli();
+	BENCH_MARK(BENCH_DONE);
+	for (;;);
+}
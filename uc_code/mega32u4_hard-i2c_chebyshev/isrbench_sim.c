@@ -0,0 +1,239 @@
+/*
+   PC side of the ISR benchmark (make isrbench). Runs an isrbench ELF (see
+   isrbench.c) under simavr and times the phases the firmware marks in
+   GPIOR0, in CPU cycles.
+
+   To compile:
+     gcc -O2 -Wall -o isrbench_sim isrbench_sim.c -lsimavr -lelf
+
+   To run:
+     ./isrbench_sim [-c config] [-m mcu] [-f f_cpu] [-v vector] isrbench_config.elf
+
+   Options:
+     -c  name of the configuration, printed with the results
+     -m  simavr core (default atmega32u4)
+     -f  CPU clock in Hz (default 16000000)
+     -v  vector number of the timer interrupt (default 17, TIMER1_COMPA on
+         the atmega32u4)
+
+   It prints one name=value line per measurement: the whole ISR from the
+   vector to the reti, its read, filter and publish phases, the report
+   callback, the interval between ISRs and the share of the CPU the ISR
+   takes, the deepest the stack got, and the flash and RAM the ELF uses.
+   The RAM includes the 256 byte register file of twimock.c.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+
+#define GPIOR0_ADDR 0x3E // data space address of GPIOR0
+
+/* the phases marked by BENCH_MARK() in nunchuk_quake_sensor.h */
+#define BENCH_ISR_START      1
+#define BENCH_ISR_READ       2
+#define BENCH_ISR_FILTER     3
+#define BENCH_ISR_PUBLISH    4
+#define BENCH_REPORT_START   5
+#define BENCH_REPORT_END     6
+#define BENCH_DONE           7
+
+/* a run that doesn't finish within this many cycles has hung */
+#define MAX_CYCLES 400000000ULL
+
+typedef struct
+{
+	unsigned long n;
+	unsigned long long sum;
+	unsigned long long max;
+} stat_t;
+
+static void stat_add(stat_t* s, unsigned long long v)
+{
+	s->n++;
+	s->sum += v;
+	if (v > s->max)
+	{
+		s->max = v;
+	}
+}
+
+static double stat_mean(const stat_t* s)
+{
+	return (s->n > 0) ? (double)s->sum/s->n : 0;
+}
+
+typedef struct
+{
+	avr_cycle_count_t mark[BENCH_DONE+1];
+	stat_t read;
+	stat_t filter;
+	stat_t publish;
+	stat_t report;
+	int done;
+} bench_t;
+
+/* called by simavr when the firmware writes GPIOR0 */
+static void mark_written(avr_t* avr, avr_io_addr_t addr, uint8_t v, void* param)
+{
+	bench_t* b = param;
+
+	if (v > BENCH_DONE)
+	{
+		return;
+	}
+	b->mark[v] = avr->cycle;
+
+	switch (v)
+	{
+		case BENCH_ISR_READ:
+			stat_add(&b->read, b->mark[BENCH_ISR_READ] - b->mark[BENCH_ISR_START]);
+			break;
+		case BENCH_ISR_FILTER:
+			stat_add(&b->filter, b->mark[BENCH_ISR_FILTER] - b->mark[BENCH_ISR_READ]);
+			break;
+		case BENCH_ISR_PUBLISH:
+			stat_add(&b->publish, b->mark[BENCH_ISR_PUBLISH] - b->mark[BENCH_ISR_FILTER]);
+			break;
+		case BENCH_REPORT_END:
+			stat_add(&b->report, b->mark[BENCH_REPORT_END] - b->mark[BENCH_REPORT_START]);
+			break;
+		case BENCH_DONE:
+			b->done = 1;
+			break;
+	}
+}
+
+static void print_stat(const char* config, const char* name, const stat_t* s)
+{
+	fprintf(stdout, "config=%s phase=%s count=%lu cycles_mean=%.1f cycles_max=%llu\n",
+	        config, name, s->n, stat_mean(s), s->max);
+}
+
+int main(int argc, char** argv)
+{
+	const char* config = "default";
+	const char* mcu = "atmega32u4";
+	unsigned long f_cpu = 16000000;
+	int vector = 17;
+	elf_firmware_t fw;
+	avr_t* avr;
+	bench_t b;
+	stat_t isr, period;
+	avr_flashaddr_t vector_addr;
+	avr_cycle_count_t isr_start = 0, last_isr_start = 0;
+	uint16_t sp, min_sp;
+	int in_isr = 0;
+	int state;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "c:m:f:v:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'c':
+				config = optarg;
+				break;
+			case 'm':
+				mcu = optarg;
+				break;
+			case 'f':
+				f_cpu = strtoul(optarg, NULL, 10);
+				break;
+			case 'v':
+				vector = atoi(optarg);
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-c config] [-m mcu] [-f f_cpu] [-v vector] file.elf\n", argv[0]);
+				return 1;
+		}
+	}
+	if (optind != argc-1)
+	{
+		fprintf(stderr, "usage: %s [-c config] [-m mcu] [-f f_cpu] [-v vector] file.elf\n", argv[0]);
+		return 1;
+	}
+
+	memset(&fw, 0, sizeof(fw));
+	if (elf_read_firmware(argv[optind], &fw) != 0)
+	{
+		fprintf(stderr, "Couldn't read %s.\n", argv[optind]);
+		return 1;
+	}
+	avr = avr_make_mcu_by_name(mcu);
+	if (avr == NULL)
+	{
+		fprintf(stderr, "simavr doesn't know the %s.\n", mcu);
+		return 1;
+	}
+	avr_init(avr);
+	avr->frequency = f_cpu;
+	avr_load_firmware(avr, &fw);
+
+	memset(&b, 0, sizeof(b));
+	memset(&isr, 0, sizeof(isr));
+	memset(&period, 0, sizeof(period));
+	avr_register_io_write(avr, GPIOR0_ADDR, mark_written, &b);
+
+	vector_addr = vector*avr->vector_size;
+	min_sp = avr->ramend;
+
+	do
+	{
+		state = avr_run(avr);
+
+		sp = avr->data[R_SPL] | (avr->data[R_SPH] << 8);
+		if (sp < min_sp)
+		{
+			min_sp = sp;
+		}
+
+		/* the ISR runs from its vector until reti enables interrupts again */
+		if (!in_isr && avr->pc == vector_addr)
+		{
+			in_isr = 1;
+			isr_start = avr->cycle;
+			if (last_isr_start != 0)
+			{
+				stat_add(&period, isr_start - last_isr_start);
+			}
+			last_isr_start = isr_start;
+		}
+		else if (in_isr && avr->sreg[S_I])
+		{
+			in_isr = 0;
+			stat_add(&isr, avr->cycle - isr_start);
+		}
+	} while (!b.done && state != cpu_Done && state != cpu_Crashed && avr->cycle < MAX_CYCLES);
+
+	if (!b.done)
+	{
+		fprintf(stderr, "%s didn't finish, it %s.\n", argv[optind],
+		        (state == cpu_Crashed) ? "crashed" : "hung");
+		return 1;
+	}
+	if (isr.n == 0)
+	{
+		fprintf(stderr, "The ISR never ran, the sensor wasn't found.\n");
+		return 1;
+	}
+
+	print_stat(config, "isr", &isr);
+	print_stat(config, "isr_read", &b.read);
+	print_stat(config, "isr_filter", &b.filter);
+	print_stat(config, "isr_publish", &b.publish);
+	print_stat(config, "report", &b.report);
+	fprintf(stdout, "config=%s isr_period_cycles=%.1f isr_cpu_pct=%.2f isr_us_max=%.1f\n",
+	        config, stat_mean(&period),
+	        (period.n > 0) ? 100*stat_mean(&isr)/stat_mean(&period) : 0.0,
+	        isr.max*1e6/f_cpu);
+	fprintf(stdout, "config=%s stack_bytes=%u flash_bytes=%u ram_bytes=%u\n",
+	        config, (unsigned)(avr->ramend - min_sp), fw.flashsize, fw.datasize + fw.bsssize);
+
+	return 0;
+}
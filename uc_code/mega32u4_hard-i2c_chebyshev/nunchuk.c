@@ -0,0 +1,133 @@
+/*
+   Wii nunchuk driver for the accelerometer interface in sensor.h. The
+   nunchuk has no FIFO, so each burst is a single 6 byte sample.
+
+   The driver only uses the i2cmaster.h API, so it can be run on a PC
+   against the register level nunchuk model in twimock.c instead of
+   twimaster.c.
+*/
+
+#include "sensor.h"
+#include "i2cmaster.h"
+
+#if defined(__AVR__)
+	#include <util/delay.h>
+#else
+	#define _delay_us(us)
+#endif
+
+/*
+ * A genuine nunchuk outputs encrypted identification bytes when initialized
+ * with the old init method, and unencrypted identifications bytes when
+ * initialized with the new init method. A fake (6331 accelerometer) nunchuk
+ * always outputs the unencrypted identification bytes whatever the
+ * initialization method used. Therefore, to determine if the attached
+ * controller is a genuine nunchuk rather than a fake or some other type of
+ * Wii controller, the controller is initialized with the old method and the
+ * ID bytes are checked to see if they match the encrypted nunchuk ID bytes.
+ * encrypted ID bytes:   0xFE 0xFE 0x9A 0x1E 0xFE 0xFE
+ * unencrypted ID bytes: 0x00 0x00 0xA4 0x20 0x00 0x00
+ *
+ * After the ID bytes are checked the new initialization method is used so the
+ * nunchuk will output unencrypted data.
+ */
+uint8_t Nunchuk_Init(void)
+{
+	uint8_t i = 0;
+	uint8_t nc_data[NUM_BYTES] = { 0 };
+
+	/* old init method */
+	i2c_start_wait(DevAddr+I2C_WRITE);
+	i2c_write(0x40);
+	i2c_write(0x00);
+	i2c_stop();
+	_delay_us(500);
+
+	/* check nunchuk identification bytes */
+	i2c_start_wait(DevAddr+I2C_WRITE);
+	i2c_write(0xFA);
+	i2c_stop();
+	_delay_us(500);
+
+	i2c_rep_start(DevAddr+I2C_READ);
+
+	while(i < (NUM_BYTES-1))
+	{
+		nc_data[i] = i2c_readAck();
+		i++;
+	}
+	nc_data[i] = i2c_readNak();
+	i2c_stop();
+
+	if (nc_data[2] == 0x9A && nc_data[3] == 0x1E && nc_data[4] == 0xFE && nc_data[5] == 0xFE)
+	{ // genuine
+		i = 1;
+	}
+	else
+	{ // fake
+		i = 0;
+	}
+	/* end check nunchuk identification bytes */
+
+	_delay_us(500);
+
+	/* new init method */
+	i2c_start_wait(DevAddr+I2C_WRITE);      // set device address and write mode
+	i2c_write(0xF0);                        // write address = F0
+	i2c_write(0x55);                        // write value 0x55 to nunchuk
+	i2c_stop();                             // set stop conditon = release bus
+	_delay_us(500);
+
+	i2c_start_wait(DevAddr+I2C_WRITE);      // set device address and write mode
+	i2c_write(0xFB);                        // write address = FB
+	i2c_write(0x00);                        // write value 0x00 to nunchuk
+	i2c_stop();                             // set stop conditon = release bus
+	_delay_us(500);
+
+	/* tell nunchuk to prepare a new sample to be read at the next interrupt */
+	i2c_start_wait(DevAddr+I2C_WRITE);     // set device address and write mode
+	i2c_write(0x00);                       // write address = 00
+	i2c_stop();
+	_delay_us(500);
+
+	return i;
+}
+
+/* The nunchuk has no clock of its own, it takes a new sample whenever it is
+ * asked to, so the sample rate is set by Timer_Init(). */
+uint8_t Nunchuk_SetRate(uint16_t rate)
+{
+	return (rate <= NUNCHUK_MAX_RATE);
+}
+
+uint8_t Nunchuk_BurstRead(uint8_t* raw, uint8_t n)
+{
+	uint8_t i = 0;
+
+	if (n == 0)
+	{
+		return 0;
+	}
+
+	i2c_rep_start(DevAddr+I2C_READ);
+
+	while(i < (NUM_BYTES-1))
+	{
+		raw[i] = i2c_readAck();    // read one byte from nunchuk
+		i++;
+	}
+	raw[i] = i2c_readNak();
+	i2c_stop();
+
+	/* The STMicroelectronics based nunchuk needs a delay of 14 or more
+	 * microseconds between reading data and requesting new data. Use a 20
+	 * us delay to give a little padding. */
+	_delay_us(20);
+
+	/* tell nunchuk to prepare a new sample to be read at the next burst */
+	i2c_start_wait(DevAddr+I2C_WRITE);
+	i2c_write(0x00);
+	i2c_stop();
+
+	return 1;
+}
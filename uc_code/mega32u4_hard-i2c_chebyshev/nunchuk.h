@@ -0,0 +1,56 @@
+/*
+   Wii nunchuk driver for the accelerometer interface in sensor.h. Do not
+   include this file directly, include sensor.h instead.
+*/
+
+#ifndef _NUNCHUK_H_
+#define _NUNCHUK_H_
+
+	/* Includes: */
+		#include <stdint.h>
+
+	/* Macros: */
+		#define DevAddr  0xA4 // 0xA4 = 0x52 << 1, shifted device address of wii nunchuk
+		#define NUM_BYTES 6 // number of bytes of nunchuk data
+
+		/* at 16 MHz with an I2C clock of 100 kHz, 618 samples/s is the
+		 * fastest the STMicro based nunchuk can be sampled. See Timer_Init(). */
+		#define NUNCHUK_MAX_RATE 618
+
+		#define SENSOR_SAMPLE_SIZE NUM_BYTES
+		#define SENSOR_FIFO_DEPTH  1
+
+		#define Sensor_Init()                Nunchuk_Init()
+		#define Sensor_SetRate(rate)         Nunchuk_SetRate(rate)
+		#define Sensor_BurstRead(raw, n)     Nunchuk_BurstRead(raw, n)
+		#define Sensor_Decode(raw, sample)   Nunchuk_Decode(raw, sample)
+
+	/* Function Prototypes: */
+		uint8_t Nunchuk_Init(void);
+		uint8_t Nunchuk_SetRate(uint16_t rate);
+		uint8_t Nunchuk_BurstRead(uint8_t* raw, uint8_t n);
+
+	/* Inline Functions: */
+		/* Sometimes the data for one or more axes will spike or dip. If this
+		 * happens, then discard those samples. A spike is always indicated by
+		 * bytes 4 and 5 being equal to 0xFE. */
+		static inline uint8_t Nunchuk_Decode(const uint8_t* raw, Sensor_Sample_t* sample)
+		{
+			if (raw[4] == 0xFE && raw[5] == 0xFE)
+			{
+				return 0;
+			}
+
+			/* byte raw[5] contains the two lowest bits of accelerometer
+			 * data for each axis */
+			// ((x >> (p+1-n)) & ~(~0 << n)) gives the bits p:(p-(n-1)) of x.
+			// This expression is more portable because it is independent of
+			// word length. The C Programming Language, p.45
+			sample->x = (raw[2] << 2) | ((raw[5] >> 2) & ~(~0 << 2));
+			sample->y = (raw[3] << 2) | ((raw[5] >> 4) & ~(~0 << 2));
+			sample->z = (raw[4] << 2) | ((raw[5] >> 6) & ~(~0 << 2));
+
+			return 1;
+		}
+
+#endif
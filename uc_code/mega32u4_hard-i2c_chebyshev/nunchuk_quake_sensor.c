@@ -73,16 +73,12 @@
 
 #include "nunchuk_quake_sensor.h"
 #include "i2cmaster.h"
-#include "lpf.h"
+#include "sensor.h"
+#include "dsp.h"
+#include "snapshot.h"
 
-#define next_cbi() (cbi == (N-1)) ? 0 : cbi+1
-
-// newest sample index
-static volatile uint8_t nsi;
-// filter accelerometer data buffers
-static volatile float xo[N];
-static volatile float yo[N];
-static volatile float zo[N];
+// filter state of the accelerometer axes
+static Dsp_Filter_t filter;
 
 /** Buffer to hold the previously generated HID report, for comparison purposes inside the HID class driver. */
 static uint8_t PrevJoystickHIDReportBuffer[sizeof(USB_JoystickReport_Data_t)];
@@ -111,96 +107,65 @@ USB_ClassInfo_HID_Device_t Joystick_HID_Interface =
 ISR(TIMER1_COMPA_vect)
 {
 
-	// accelerometer data buffers
-	static float xi[N];
-	static float yi[N];
-	static float zi[N];
-
-	float accum_x = 0;
-	float accum_y = 0;
-	float accum_z = 0;
-
-	uint8_t i = 0;
-	static uint8_t cbi;
-	uint8_t nc_data[NUM_BYTES] = { 0 };
+	uint8_t k = 0;
+	uint8_t n = 0;
+	uint8_t raw[SENSOR_FIFO_DEPTH*SENSOR_SAMPLE_SIZE];
+	Dsp_Output_t out;
 
-	/* read a new sample */
-	i2c_rep_start(DevAddr+I2C_READ);
-
-	while(i < (NUM_BYTES-1))
-	{
-		nc_data[i] = i2c_readAck();    // read one byte from nunchuk
-		i++;
-	}
-	nc_data[i] = i2c_readNak();
-	i2c_stop();
+	// statistics of the samples in this burst
+	Snapshot_t burst;
+	Snapshot_t sample_stats;
 
+	BENCH_MARK(BENCH_ISR_START);
 
+	/* read every sample the sensor has ready in one burst */
+	n = Sensor_BurstRead(raw, SENSOR_FIFO_DEPTH);
 
-	/* increment the circular buffer index. cbi is now the index of the 
-	 * oldest sample, which will become the newest sample index as soon as
-	 * the oldest sample is overwritten. */
-	i = cbi;
-	cbi = next_cbi();
+	BENCH_MARK(BENCH_ISR_READ);
 
-	/* Sometimes the data for one or more axes will spike or dip. If this
-	 * happens, then discard those samples. A spike is always indicated by
-	 * bytes 4 and 5 being equal to 0xFE. */
-	if ( !(nc_data[4] == 0xFE && nc_data[5] == 0xFE) )
+	if (n == 0)
 	{
-		/* byte nc_data[5] contains the two lowest bits of accelerometer
-		 * data for each axis */
-		// ((x >> (p+1-n)) & ~(~0 << n)) gives the bits p:(p-(n-1)) of x.
-		// This expression is more portable because it is independent of
-		// word length. The C Programming Language, p.45
-		xi[cbi] = (nc_data[2] << 2) | ((nc_data[5] >> 2) & ~(~0 << 2));
-		yi[cbi] = (nc_data[3] << 2) | ((nc_data[5] >> 4) & ~(~0 << 2));
-		zi[cbi] = (nc_data[4] << 2) | ((nc_data[5] >> 6) & ~(~0 << 2));
+		return;
 	}
-	else
-	{
-		/* since the newest sample was bad, reuse the previous sample
-		 * and save it in the buffer's slot for the newest sample */
-		xi[cbi] = xi[i];
-		yi[cbi] = yi[i];
-		zi[cbi] = zi[i];
-	}
-
-	cbi = next_cbi();
-	// cbi is now the index of the oldest sample
 
-	// loop N-1 times
-	for (i=N-1; i > 0; i--)
+	for (k=0; k < n; k++)
 	{
-		accum_x = accum_x - a[i]*xo[cbi] + b[i]*xi[cbi];
-		accum_y = accum_y - a[i]*yo[cbi] + b[i]*yi[cbi];
-		accum_z = accum_z - a[i]*zo[cbi] + b[i]*zi[cbi];
-
-		cbi = next_cbi();
+		/* a bad sample, such as a 0xFE spike, is replaced by the previous
+		 * one before it reaches the filter */
+		Dsp_Process(&filter, &raw[k*SENSOR_SAMPLE_SIZE], &out);
+
+		/* Only the newest sample is sent with each report, so keep track of
+		 * the peaks in between reports. Otherwise a short transient between
+		 * USB polls would never reach the host. */
+		sample_stats.x = sample_stats.x_min = sample_stats.x_max = out.x;
+		sample_stats.y = sample_stats.y_min = sample_stats.y_max = out.y;
+		sample_stats.z = sample_stats.z_min = sample_stats.z_max = out.z;
+		sample_stats.n = 1;
+#ifdef REPORT_SUMSQ
+		sample_stats.x_sumsq = out.x*out.x;
+		sample_stats.y_sumsq = out.y*out.y;
+		sample_stats.z_sumsq = out.z*out.z;
+#endif
+		if (k == 0)
+		{
+			burst = sample_stats;
+		}
+		else
+		{
+			Snapshot_Merge(&burst, &sample_stats);
+		}
 	}
 
-	// cbi is now the index of the newest sample
+	BENCH_MARK(BENCH_ISR_FILTER);
 
-	xo[cbi] = accum_x + b[0]*xi[cbi];
-	yo[cbi] = accum_y + b[0]*yi[cbi];
-	zo[cbi] = accum_z + b[0]*zi[cbi];
+	Snapshot_Publish(&burst);
 
-	nsi = cbi;
-
-	/* The STMicroelectronics based nunchuk needs a delay of 14 or more
-	 * microseconds between reading data and requesting new data. Use a 15
-	 * us delay to give a little padding. The buffer store if block
-	 * also adds some more cushion (around 5 us). */
-	_delay_us(15);
-
-	/* tell nunchuk to prepare a new sample to be read at the next interrupt */
-	i2c_start_wait(DevAddr+I2C_WRITE);
-	i2c_write(0x00);
-	i2c_stop();
+	BENCH_MARK(BENCH_ISR_PUBLISH);
 }
 
 
 
+#if !defined(ISR_BENCH)
 int main(void)
 {
 	uint16_t i = 0;
@@ -219,7 +184,7 @@ int main(void)
 
 	i2c_init();
 
-	if (Nunchuk_Init() == 1)
+	if (Sensor_Init() == 1 && Sensor_SetRate(SAMPLE_RATE) == 1)
 	{
 		Timer_Init();
 		USB_Init();
@@ -262,92 +227,27 @@ int main(void)
 		}
 	}
 }
-
-/* 
- * A genuine nunchuk outputs encrypted identification bytes when initialized
- * with the old init method, and unencrypted identifications bytes when
- * initialized with the new init method. A fake (6331 accelerometer) nunchuk
- * always outputs the unencrypted identification bytes whatever the
- * initialization method used. Therefore, to determine if the attached
- * controller is a genuine nunchuk rather than a fake or some other type of
- * Wii controller, the controller is initialized with the old method and the
- * ID bytes are checked to see if they match the encrypted nunchuk ID bytes.
- * encrypted ID bytes:   0xFE 0xFE 0x9A 0x1E 0xFE 0xFE
- * unencrypted ID bytes: 0x00 0x00 0xA4 0x20 0x00 0x00
- *
- * After the ID bytes are checked the new initialization method is used so the
- * nunchuk will output unencrypted data.
- */
-uint8_t Nunchuk_Init(void)
-{
-	uint8_t i = 0;
-	uint8_t nc_data[NUM_BYTES] = { 0 };
-
-	/* old init method */
-	i2c_start_wait(DevAddr+I2C_WRITE);
-	i2c_write(0x40);
-	i2c_write(0x00);
-	i2c_stop();
-	_delay_us(500);
-
-	/* check nunchuk identification bytes */
-	i2c_start_wait(DevAddr+I2C_WRITE);
-	i2c_write(0xFA);
-	i2c_stop();
-	_delay_us(500);
-
-	i2c_rep_start(DevAddr+I2C_READ);
-
-	while(i < (NUM_BYTES-1))
-	{
-		nc_data[i] = i2c_readAck();
-		i++;
-	}
-	nc_data[i] = i2c_readNak();
-	i2c_stop();
-
-	if (nc_data[2] == 0x9A && nc_data[3] == 0x1E && nc_data[4] == 0xFE && nc_data[5] == 0xFE)
-	{ // genuine
-		i = 1;
-	}
-	else
-	{ // fake
-		i = 0;
-	}
-	/* end check nunchuk identification bytes */
-
-	_delay_us(500);
-
-	/* new init method */
-	i2c_start_wait(DevAddr+I2C_WRITE);      // set device address and write mode
-	i2c_write(0xF0);                        // write address = F0
-	i2c_write(0x55);                        // write value 0x55 to nunchuk
-	i2c_stop();                             // set stop conditon = release bus
-	_delay_us(500);
-
-	i2c_start_wait(DevAddr+I2C_WRITE);      // set device address and write mode
-	i2c_write(0xFB);                        // write address = FB
-	i2c_write(0x00);                        // write value 0x00 to nunchuk
-	i2c_stop();                             // set stop conditon = release bus
-	_delay_us(500);
-
-	/* tell nunchuk to prepare a new sample to be read at the next interrupt */
-	i2c_start_wait(DevAddr+I2C_WRITE);     // set device address and write mode
-	i2c_write(0x00);                       // write address = 00
-	i2c_stop();
-	_delay_us(500);
-
-	return i;
-}
+#endif
 
 void Timer_Init(void)
 {
 	TIMSK1 &= ~_BV(OCIE1A);  // disable timer compare interrupt
 	TIFR1 = _BV(OCF1A);      // clear interrupt flag
+	Dsp_Init(&filter);
+	Snapshot_Init();
 	TCNT1 = 0;
 
 	TCCR1B |= _BV(WGM12);    // CTC mode
 
+#if SENSOR_FIFO_DEPTH > 1
+	/* A sensor with a FIFO samples itself at SAMPLE_RATE, so it only has to
+	 * be drained once per USB poll. The FIFO must be deep enough to hold
+	 * 8 ms worth of samples. */
+	OCR1A = 15999; // 16000 ticks @ 2 MHz = 8000 us
+
+	TIMSK1 |= _BV(OCIE1A);  // enable timer compare interrupt
+	TCCR1B |= _BV(CS11);    // start timer (clk/8 prescaling)
+#else
 	/* at 16 MHz with an I2C clock of 100 kHz, 25888 is the fastest the 
          * STMicro based nunchuk can be sampled. */
 	//OCR1A = 25888; // 25888 ticks @ 16 MHz = 1618 us, 618.04 samples/s
@@ -360,6 +260,7 @@ void Timer_Init(void)
 
 	TIMSK1 |= _BV(OCIE1A);  // enable timer compare interrupt
 	TCCR1B |= _BV(CS10);    // start timer (no prescaling)
+#endif
 }
 
 void EVENT_USB_Device_Connect(void)
@@ -410,14 +311,38 @@ bool CALLBACK_HID_Device_CreateHIDReport(USB_ClassInfo_HID_Device_t* const HIDIn
 {
 	USB_JoystickReport_Data_t* JoystickReport = (USB_JoystickReport_Data_t*)ReportData;
 
+	/* Each report covers the samples taken since the previous one. If
+	 * there are none yet, or no consistent snapshot could be taken, the
+	 * report repeats the last output with no samples; the ISR keeps
+	 * accumulating until a snapshot is sent, so nothing is lost or counted
+	 * twice. */
+	static Snapshot_t s;
+	BENCH_MARK(BENCH_REPORT_START);
+	Snapshot_Read(&s);
+
 	// non-inverted for all axices for knockoff and official
-	JoystickReport->ax = round(xo[nsi]);
-	JoystickReport->ay = round(yo[nsi]);
-	JoystickReport->az = round(zo[nsi]);
+	JoystickReport->ax = round(s.x);
+	JoystickReport->ay = round(s.y);
+	JoystickReport->az = round(s.z);
+
+	JoystickReport->ax_min = round(s.x_min);
+	JoystickReport->ay_min = round(s.y_min);
+	JoystickReport->az_min = round(s.z_min);
+	JoystickReport->ax_max = round(s.x_max);
+	JoystickReport->ay_max = round(s.y_max);
+	JoystickReport->az_max = round(s.z_max);
 
 	JoystickReport->buttons = 0;
 
+#ifdef REPORT_SUMSQ
+	JoystickReport->n = s.n;
+	JoystickReport->ax_sumsq = round(s.x_sumsq);
+	JoystickReport->ay_sumsq = round(s.y_sumsq);
+	JoystickReport->az_sumsq = round(s.z_sumsq);
+#endif
+
 	*ReportSize = sizeof(USB_JoystickReport_Data_t);
+	BENCH_MARK(BENCH_REPORT_END);
 	return true;
 }
 
@@ -57,15 +57,42 @@
 			uint16_t  ax; /**< accelerometer x axis */
 			uint16_t  ay; /**< accelerometer y axis */
 			uint16_t  az; /**< accelerometer z axis */
+			uint16_t  ax_min; /**< smallest accelerometer x axis value since the last report */
+			uint16_t  ay_min; /**< smallest accelerometer y axis value since the last report */
+			uint16_t  az_min; /**< smallest accelerometer z axis value since the last report */
+			uint16_t  ax_max; /**< largest accelerometer x axis value since the last report */
+			uint16_t  ay_max; /**< largest accelerometer y axis value since the last report */
+			uint16_t  az_max; /**< largest accelerometer z axis value since the last report */
 			uint8_t buttons; /**< Bit mask of the currently pressed joystick buttons */
+#ifdef REPORT_SUMSQ
+			uint8_t   n; /**< number of samples taken since the last report */
+			uint32_t  ax_sumsq; /**< sum of the squares of the x axis samples taken since the last report */
+			uint32_t  ay_sumsq; /**< sum of the squares of the y axis samples taken since the last report */
+			uint32_t  az_sumsq; /**< sum of the squares of the z axis samples taken since the last report */
+#endif
 		} USB_JoystickReport_Data_t;
 
 	/* Macros: */
-		#define DevAddr  0xA4 // 0xA4 = 0x52 << 1, shifted device address of wii nunchuk
-		#define NUM_BYTES 6 // number of bytes of nunchuk data
+		#define SAMPLE_RATE 250 // samples/s, must match the rate lpf.h was designed for
+
+		/** Phases of the ISR and the report callback, marked for isrbench.c by writing them to GPIOR0. The
+		 *  markers compile to nothing unless ISR_BENCH is defined.
+		 */
+		#define BENCH_ISR_START      1
+		#define BENCH_ISR_READ       2
+		#define BENCH_ISR_FILTER     3
+		#define BENCH_ISR_PUBLISH    4
+		#define BENCH_REPORT_START   5
+		#define BENCH_REPORT_END     6
+		#define BENCH_DONE           7
+
+		#if defined(ISR_BENCH)
+			#define BENCH_MARK(phase)  GPIOR0 = (phase)
+		#else
+			#define BENCH_MARK(phase)
+		#endif
 
 	/* Function Prototypes: */
-		uint8_t Nunchuk_Init(void);
 		void Timer_Init(void);
 
 		void EVENT_USB_Device_Connect(void);
@@ -0,0 +1,120 @@
+/*
+   Host test of the nunchuk driver in nunchuk.c, run against the register
+   level nunchuk model in twimock.c in place of twimaster.c. Built and run
+   with
+
+     make check
+
+   It checks that
+     - a genuine nunchuk is found, and left unencrypted by the new init
+       method with a conversion already requested,
+     - a fake (6331 accelerometer) nunchuk, whose ID bytes come back
+       unencrypted after the old init method, is rejected,
+     - Sensor_SetRate() refuses rates above NUNCHUK_MAX_RATE,
+     - a burst reads the canned samples in order and requests the next
+       conversion, and a burst of 0 samples leaves the bus alone,
+     - Sensor_Decode() unpacks the 10 bit axes, and rejects a 0xFE spike.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "i2cmaster.h"
+#include "sensor.h"
+#include "twimock.h"
+
+static int failures;
+
+static void check(int ok, const char* what)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "FAIL: %s\n", what);
+		failures++;
+	}
+}
+
+/* unencrypted nunchuk samples: at rest, the low bits set and a 0xFE spike */
+static const uint8_t samples[] =
+{
+	0x80, 0x80, 0x80, 0x80, 0xB3, 0x57,
+	0x80, 0x80, 0x12, 0x34, 0x56, 0xE4,
+	0x80, 0x80, 0x80, 0x80, 0xFE, 0xFE,
+};
+
+static void test_init(void)
+{
+	twimock_reset(1);
+	twimock_load(samples, sizeof(samples)/SENSOR_SAMPLE_SIZE);
+	check(Sensor_Init() == 1, "a genuine nunchuk is found");
+	check(twimock_conversions() == 1, "Sensor_Init() requests a conversion");
+
+	twimock_reset(0);
+	twimock_load(samples, sizeof(samples)/SENSOR_SAMPLE_SIZE);
+	check(Sensor_Init() == 0, "a fake nunchuk is rejected");
+
+	check(Sensor_SetRate(250) == 1, "250 samples/s can be reached");
+	check(Sensor_SetRate(NUNCHUK_MAX_RATE) == 1, "NUNCHUK_MAX_RATE can be reached");
+	check(Sensor_SetRate(NUNCHUK_MAX_RATE+1) == 0, "faster than NUNCHUK_MAX_RATE is refused");
+}
+
+static void test_burst_read(void)
+{
+	uint8_t raw[SENSOR_SAMPLE_SIZE*SENSOR_FIFO_DEPTH];
+	uint16_t count = sizeof(samples)/SENSOR_SAMPLE_SIZE;
+	uint16_t k;
+
+	twimock_reset(1);
+	twimock_load(samples, count);
+	Sensor_Init();
+
+	/* twice round, the model repeats the samples */
+	for (k = 0; k < 2*count; k++)
+	{
+		memset(raw, 0, sizeof(raw));
+		check(Sensor_BurstRead(raw, SENSOR_FIFO_DEPTH) == 1, "a burst reads one sample");
+		check(memcmp(raw, &samples[(k % count)*SENSOR_SAMPLE_SIZE], SENSOR_SAMPLE_SIZE) == 0,
+		      "a burst reads the samples unencrypted and in order");
+		check(twimock_conversions() == k+2, "a burst requests the next conversion");
+	}
+
+	check(Sensor_BurstRead(raw, 0) == 0, "a burst of 0 samples reads nothing");
+	check(twimock_conversions() == 2*count+1, "a burst of 0 samples leaves the bus alone");
+}
+
+static void test_decode(void)
+{
+	Sensor_Sample_t sample;
+
+	check(Sensor_Decode(&samples[0], &sample) == 1, "a sample at rest is decoded");
+	check(sample.x == (0x80 << 2 | 1) && sample.y == (0x80 << 2 | 1) && sample.z == (0xB3 << 2 | 1),
+	      "the axes of a sample at rest");
+
+	/* 0xE4 = 11 10 01 00, the low bits of z, y and x */
+	check(Sensor_Decode(&samples[SENSOR_SAMPLE_SIZE], &sample) == 1, "a sample is decoded");
+	check(sample.x == (0x12 << 2 | 1) && sample.y == (0x34 << 2 | 2) && sample.z == (0x56 << 2 | 3),
+	      "the low bits of the axes come from byte 5");
+
+	memset(&sample, 0x55, sizeof(sample));
+	check(Sensor_Decode(&samples[2*SENSOR_SAMPLE_SIZE], &sample) == 0, "a 0xFE spike is rejected");
+	check(sample.x == 0x5555 && sample.y == 0x5555 && sample.z == 0x5555,
+	      "a rejected sample is left alone");
+}
+
+int main(void)
+{
+	i2c_init();
+
+	test_init();
+	test_burst_read();
+	test_decode();
+
+	if (failures > 0)
+	{
+		fprintf(stderr, "nunchuk_test: %d check(s) failed.\n", failures);
+		return 1;
+	}
+	fprintf(stdout, "nunchuk_test: all checks passed.\n");
+
+	return 0;
+}
@@ -0,0 +1,62 @@
+/*
+   Accelerometer driver interface. The filter and USB code only talk to the
+   accelerometer through the functions and macros below, so that sensors
+   other than the Wii nunchuk can be used without touching the rest of the
+   firmware. The driver is chosen at compile time with the SENSOR makefile
+   value, in the same way LUFA chooses its board drivers with BOARD.
+
+   Every driver must provide:
+
+     SENSOR_SAMPLE_SIZE   number of raw bytes in one sample
+     SENSOR_FIFO_DEPTH    largest number of samples the sensor can buffer
+                          internally (1 for sensors without a FIFO)
+
+     uint8_t Sensor_Init(void)
+         Initializes the sensor. Returns 1 if a supported sensor was found,
+         otherwise 0.
+
+     uint8_t Sensor_SetRate(uint16_t rate)
+         Sets the sensor's internal sample rate in samples/s. Sensors
+         without an internal clock are sampled on demand, in which case this
+         only checks that the rate can be reached. Returns 1 on success.
+
+     uint8_t Sensor_BurstRead(uint8_t* raw, uint8_t n)
+         Reads up to n samples from the sensor in a single I2C transaction
+         and stores their raw bytes one after another in raw, which must
+         hold n*SENSOR_SAMPLE_SIZE bytes. Returns the number of samples read.
+
+     uint8_t Sensor_Decode(const uint8_t* raw, Sensor_Sample_t* sample)
+         Converts one raw sample to axis values. Returns 0 if the sample is
+         known to be bad and should be discarded.
+*/
+
+#ifndef _SENSOR_H_
+#define _SENSOR_H_
+
+	/* Includes: */
+		#include <stdint.h>
+
+	/* Type Defines: */
+		/** One decoded accelerometer sample. */
+		typedef struct
+		{
+			int16_t x; /**< accelerometer x axis */
+			int16_t y; /**< accelerometer y axis */
+			int16_t z; /**< accelerometer z axis */
+		} Sensor_Sample_t;
+
+	/* Macros: */
+		#define SENSOR_NUNCHUK  1 // Wii nunchuk (genuine, STMicroelectronics accelerometer)
+
+		#if !defined(SENSOR)
+			#define SENSOR SENSOR_NUNCHUK
+		#endif
+
+	/* Includes: */
+		#if (SENSOR == SENSOR_NUNCHUK)
+			#include "nunchuk.h"
+		#else
+			#error The selected SENSOR does not have a driver.
+		#endif
+
+#endif
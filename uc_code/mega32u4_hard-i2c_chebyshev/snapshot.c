@@ -0,0 +1,141 @@
+/*
+   Hand-off of the filter output from the timer ISR to the report callback.
+   See snapshot.h.
+*/
+
+#include "snapshot.h"
+
+/* snapshot_test.c defines SNAPSHOT_HOOK to run the ISR at the points of
+ * Snapshot_Read() it marks */
+#if defined(SNAPSHOT_HOOK)
+	void SNAPSHOT_HOOK(uint8_t point);
+#else
+	#define SNAPSHOT_HOOK(point)
+#endif
+
+/* The ISR fills in snap[(gen+1) & 1], the snapshot the callback is not
+ * reading, and then increments gen. The callback copies snap[gen & 1] and
+ * writes the gen it sent to consumed. */
+static volatile Snapshot_t snap[2];
+static volatile uint8_t gen;
+static volatile uint8_t consumed;
+
+// statistics since the last report, and of the samples in the last burst
+static Snapshot_t acc;
+static Snapshot_t prev_burst;
+static uint8_t last_consumed;
+
+void Snapshot_Init(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < sizeof(Snapshot_t); i++)
+	{
+		((volatile uint8_t*)&snap[0])[i] = 0;
+		((volatile uint8_t*)&snap[1])[i] = 0;
+		((uint8_t*)&acc)[i] = 0;
+		((uint8_t*)&prev_burst)[i] = 0;
+	}
+	gen = 0;
+	consumed = 0;
+	last_consumed = 0;
+}
+
+/* Called by the ISR with the statistics of the samples of one burst. */
+void Snapshot_Publish(const Snapshot_t* burst)
+{
+	uint8_t c;
+	uint8_t g;
+	uint8_t i;
+
+	/* Restart the statistics once the report callback has sent a snapshot.
+	 * The callback may have sent the newest snapshot, or the one before it
+	 * if this ISR ran between the callback copying the snapshot and writing
+	 * consumed, in which case the last burst hasn't been reported yet. */
+	c = consumed;
+	g = gen;
+	if (c != last_consumed)
+	{
+		last_consumed = c;
+		if (c == g)
+		{
+			acc.n = 0;
+		}
+		else if (c == (uint8_t)(g-1))
+		{
+			acc = prev_burst;
+		}
+	}
+	Snapshot_Merge(&acc, burst);
+	prev_burst = *burst;
+
+	/* publish the statistics in the snapshot the callback isn't reading */
+	for (i = 0; i < sizeof(Snapshot_t); i++)
+	{
+		((volatile uint8_t*)&snap[(g+1) & 1])[i] = ((uint8_t*)&acc)[i];
+	}
+	gen = g+1;
+}
+
+/* Turns s into a report of no samples, which keeps the newest output but
+ * adds nothing to the host's counts and sums. */
+static void make_empty(Snapshot_t* s)
+{
+	s->x_min = s->x_max = s->x;
+	s->y_min = s->y_max = s->y;
+	s->z_min = s->z_max = s->z;
+	s->n = 0;
+#ifdef REPORT_SUMSQ
+	s->x_sumsq = 0;
+	s->y_sumsq = 0;
+	s->z_sumsq = 0;
+#endif
+}
+
+/* Copies the newest snapshot into s and marks it as sent. Returns the
+ * number of copies it took, or 0 if no consistent copy could be made in
+ * SNAPSHOT_TRIES, in which case the ISR keeps accumulating.
+ *
+ * The host adds up the counts and sums of every report, so a snapshot is
+ * never sent twice. If the ISR hasn't published since the last read, which
+ * happens when the timer period equals the poll interval or on a
+ * GET_REPORT, or if the read fails, s becomes a report of no samples with
+ * the last output sent. */
+uint8_t Snapshot_Read(Snapshot_t* s)
+{
+	uint8_t g;
+	uint8_t i;
+	uint8_t tries;
+	Snapshot_t tmp;
+
+	for (tries = 1; tries <= SNAPSHOT_TRIES; tries++)
+	{
+		SNAPSHOT_HOOK(0);
+		g = gen;
+
+		for (i = 0; i < sizeof(Snapshot_t); i++)
+		{
+			((uint8_t*)&tmp)[i] = ((volatile uint8_t*)&snap[g & 1])[i];
+			SNAPSHOT_HOOK(i+1);
+		}
+
+		if (g == gen)
+		{
+			SNAPSHOT_HOOK(sizeof(Snapshot_t)+1);
+			if (g == consumed)
+			{
+				s->x = tmp.x;
+				s->y = tmp.y;
+				s->z = tmp.z;
+				make_empty(s);
+				return tries;
+			}
+			consumed = g;
+			*s = tmp;
+			return tries;
+		}
+	}
+
+	make_empty(s);
+	return 0;
+}
@@ -0,0 +1,101 @@
+/*
+   Hand-off of the filter output and its statistics from the timer ISR to
+   the report callback, without either side disabling interrupts.
+
+   The ISR fills in the snapshot the callback is not reading and then
+   increments a generation counter, which makes it the newest snapshot.
+   The callback copies the newest snapshot and starts over if the counter
+   moved during the copy, then tells the ISR which snapshot it sent, so the
+   ISR can restart the statistics without losing or double counting a
+   burst.
+
+   Only stdint.h is needed, so the same code is compiled into the firmware
+   and on a PC, where snapshot_test.c runs the ISR at every point of the
+   callback's copy (make check).
+*/
+
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+	/* Includes: */
+		#include <stdint.h>
+
+	/* Macros: */
+		/** Define to append the number of samples taken since the last report and the sum of their squares
+		 *  for each axis to the joystick report, so that the host can compute the RMS acceleration over the
+		 *  full sample rate rather than just the reported samples. Building with NO_REPORT_SUMSQ defined
+		 *  leaves them out.
+		 */
+		#if !defined(NO_REPORT_SUMSQ)
+			#define REPORT_SUMSQ
+		#endif
+
+		/** Most copies Snapshot_Read() makes. A retry is only needed if the ISR ran during the copy. The copy
+		 *  takes a few microseconds and the ISR runs every 4000 us (or 8000 us for FIFO sensors), so once
+		 *  the ISR has interrupted one copy the next cannot be interrupted and two are always enough.
+		 *  snapshot_test.c checks that.
+		 */
+		#define SNAPSHOT_TRIES 3
+
+	/* Type Defines: */
+		/** Type define for the newest filter output and its statistics since the last report, as handed from
+		 *  the timer ISR to the report callback.
+		 */
+		typedef struct
+		{
+			float     x; /**< newest x axis filter output */
+			float     y; /**< newest y axis filter output */
+			float     z; /**< newest z axis filter output */
+			float     x_min; /**< smallest x axis filter output since the last report */
+			float     y_min; /**< smallest y axis filter output since the last report */
+			float     z_min; /**< smallest z axis filter output since the last report */
+			float     x_max; /**< largest x axis filter output since the last report */
+			float     y_max; /**< largest y axis filter output since the last report */
+			float     z_max; /**< largest z axis filter output since the last report */
+			uint8_t   n; /**< number of samples since the last report */
+#ifdef REPORT_SUMSQ
+			float     x_sumsq; /**< sum of the squares of the x axis filter output since the last report */
+			float     y_sumsq; /**< sum of the squares of the y axis filter output since the last report */
+			float     z_sumsq; /**< sum of the squares of the z axis filter output since the last report */
+#endif
+		} Snapshot_t;
+
+	/* Function Prototypes: */
+		void Snapshot_Init(void);
+		void Snapshot_Publish(const Snapshot_t* burst);
+		uint8_t Snapshot_Read(Snapshot_t* s);
+
+	/* Inline Functions: */
+		/** Folds the statistics in b into a. */
+		static inline void Snapshot_Merge(Snapshot_t* a, const Snapshot_t* b)
+		{
+			if (a->n == 0)
+			{
+				*a = *b;
+				return;
+			}
+
+			a->x = b->x;
+			a->y = b->y;
+			a->z = b->z;
+
+			if (b->x_min < a->x_min) a->x_min = b->x_min;
+			if (b->x_max > a->x_max) a->x_max = b->x_max;
+			if (b->y_min < a->y_min) a->y_min = b->y_min;
+			if (b->y_max > a->y_max) a->y_max = b->y_max;
+			if (b->z_min < a->z_min) a->z_min = b->z_min;
+			if (b->z_max > a->z_max) a->z_max = b->z_max;
+
+			/* stop accumulating rather than wrap if the host stops polling */
+			if (a->n <= (255 - b->n))
+			{
+				a->n += b->n;
+#ifdef REPORT_SUMSQ
+				a->x_sumsq += b->x_sumsq;
+				a->y_sumsq += b->y_sumsq;
+				a->z_sumsq += b->z_sumsq;
+#endif
+			}
+		}
+
+#endif
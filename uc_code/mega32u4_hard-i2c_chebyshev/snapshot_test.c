@@ -0,0 +1,244 @@
+/*
+   Host test of the ISR to report callback hand-off in snapshot.c. Built with
+   SNAPSHOT_HOOK defined to snapshot_hook(), which Snapshot_Read() calls
+   before it reads gen, after every byte it copies and between the gen
+   compare and marking the snapshot as sent. Built and run, with and without
+   REPORT_SUMSQ, with
+
+     make check
+
+   The model ISR publishes burst k as one sample of value k on every axis,
+   so a report covering bursts j to k must hold x = max = k, min = j,
+   n = k-j+1 and the sum of the squares from j to k, and the next report
+   must start at k+1. It checks that
+     - with the ISR run once at any point of a read, the read takes at most
+       2 copies and no burst is lost or counted twice,
+     - with the ISR run at the same point of every copy, the read gives up
+       after SNAPSHOT_TRIES copies with a report of no samples, and the
+       next read still reports every burst since the last report,
+     - a read with no burst published since the last one gives a report of
+       no samples rather than sending the last snapshot again.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "snapshot.h"
+
+// points at which Snapshot_Read() calls snapshot_hook()
+#define HOOK_POINTS (sizeof(Snapshot_t)+2)
+
+static int failures;
+
+// bursts published so far, and the last one reported
+static uint16_t bursts;
+static uint16_t reported;
+
+// point at which to run the ISR, and how many more times
+static uint8_t isr_point;
+static uint8_t isr_runs;
+
+static void check(int ok, const char* what, uint8_t point)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "FAIL: %s (ISR at point %u)\n", what, point);
+		failures++;
+	}
+}
+
+static void isr(void)
+{
+	Snapshot_t burst;
+	float k;
+
+	bursts++;
+	k = bursts;
+
+	burst.x = burst.y = burst.z = k;
+	burst.x_min = burst.y_min = burst.z_min = k;
+	burst.x_max = burst.y_max = burst.z_max = k;
+	burst.n = 1;
+#ifdef REPORT_SUMSQ
+	burst.x_sumsq = burst.y_sumsq = burst.z_sumsq = k*k;
+#endif
+
+	Snapshot_Publish(&burst);
+}
+
+void snapshot_hook(uint8_t point)
+{
+	if (point == isr_point && isr_runs > 0)
+	{
+		isr_runs--;
+		isr();
+	}
+}
+
+static int axis_ok(float v, float min, float max, float sumsq, uint16_t j, uint16_t k)
+{
+	float expected = 0;
+	uint16_t i;
+
+	for (i = j; i <= k; i++)
+	{
+		expected += (float)i*i;
+	}
+
+	return v == k && min == j && max == k && sumsq == expected;
+}
+
+/* Checks that s reports the bursts from the one after the last report up
+ * to a later one. */
+static void check_report(const Snapshot_t* s, uint8_t point)
+{
+	uint16_t j = reported+1;
+	uint16_t k = (uint16_t)s->x_max;
+	float x_sumsq = 0, y_sumsq = 0, z_sumsq = 0;
+
+#ifdef REPORT_SUMSQ
+	x_sumsq = s->x_sumsq;
+	y_sumsq = s->y_sumsq;
+	z_sumsq = s->z_sumsq;
+#else
+	{
+		uint16_t i;
+
+		for (i = j; i <= k; i++)
+		{
+			x_sumsq += (float)i*i;
+		}
+		y_sumsq = z_sumsq = x_sumsq;
+	}
+#endif
+
+	check(k >= j && k <= bursts, "the report holds new bursts", point);
+	check(s->n == k-j+1, "no burst is lost or counted twice", point);
+	check(axis_ok(s->x, s->x_min, s->x_max, x_sumsq, j, k) &&
+	      axis_ok(s->y, s->y_min, s->y_max, y_sumsq, j, k) &&
+	      axis_ok(s->z, s->z_min, s->z_max, z_sumsq, j, k),
+	      "the report is consistent", point);
+
+	reported = k;
+}
+
+/* Checks that s is a report of no samples holding the last burst. */
+static void check_empty(const Snapshot_t* s, uint8_t point)
+{
+	float k = reported;
+
+	check(s->n == 0, "a report of no samples has n = 0", point);
+	check(s->x == k && s->y == k && s->z == k, "a report of no samples holds the last output", point);
+	check(s->x_min == k && s->x_max == k && s->y_min == k && s->y_max == k &&
+	      s->z_min == k && s->z_max == k, "a report of no samples has no peaks", point);
+#ifdef REPORT_SUMSQ
+	check(s->x_sumsq == 0 && s->y_sumsq == 0 && s->z_sumsq == 0,
+	      "a report of no samples has no sums of squares", point);
+#endif
+}
+
+static void start(void)
+{
+	Snapshot_Init();
+	bursts = 0;
+	reported = 0;
+	isr_runs = 0;
+}
+
+static void test_one_interruption(void)
+{
+	Snapshot_t s;
+	uint8_t point;
+	uint8_t tries;
+
+	start();
+	for (point = 0; point < HOOK_POINTS; point++)
+	{
+		isr();
+		isr();
+
+		isr_point = point;
+		isr_runs = 1;
+		tries = Snapshot_Read(&s);
+		check(isr_runs == 0, "the ISR ran", point);
+		check(tries >= 1 && tries <= 2, "two copies are enough", point);
+		if (tries > 0)
+		{
+			check_report(&s, point);
+		}
+	}
+
+	// pick up the bursts published at the last points
+	isr();
+	check(Snapshot_Read(&s) == 1, "an uninterrupted read takes one copy", HOOK_POINTS);
+	check_report(&s, HOOK_POINTS);
+	check(reported == bursts, "every burst is reported", HOOK_POINTS);
+}
+
+static void test_every_copy_interrupted(void)
+{
+	Snapshot_t s;
+	uint8_t point;
+
+	// the callback's snapshot is static, so it starts out zeroed
+	memset(&s, 0, sizeof(s));
+	start();
+	for (point = 1; point <= sizeof(Snapshot_t); point++)
+	{
+		isr();
+
+		isr_point = point;
+		isr_runs = SNAPSHOT_TRIES;
+		check(Snapshot_Read(&s) == 0, "a read interrupted every copy gives up", point);
+		check_empty(&s, point);
+
+		check(Snapshot_Read(&s) == 1, "the next read takes one copy", point);
+		check_report(&s, point);
+		check(reported == bursts, "the next read reports every burst", point);
+	}
+}
+
+static void test_no_new_burst(void)
+{
+	Snapshot_t s;
+	uint8_t point;
+
+	start();
+	check(Snapshot_Read(&s) == 1, "a read before the first burst takes one copy", 0);
+	check_empty(&s, 0);
+
+	for (point = 0; point < 4; point++)
+	{
+		isr();
+		isr();
+		check(Snapshot_Read(&s) == 1, "a read takes one copy", point);
+		check_report(&s, point);
+
+		// the timer period equals the poll interval, or a GET_REPORT
+		check(Snapshot_Read(&s) == 1, "a repeated read takes one copy", point);
+		check_empty(&s, point);
+		check(Snapshot_Read(&s) == 1, "a repeated read takes one copy", point);
+		check_empty(&s, point);
+	}
+
+	isr();
+	check(Snapshot_Read(&s) == 1, "a read after the repeats takes one copy", point);
+	check_report(&s, point);
+	check(reported == bursts, "every burst is reported once", point);
+}
+
+int main(void)
+{
+	test_one_interruption();
+	test_every_copy_interrupted();
+	test_no_new_burst();
+
+	if (failures > 0)
+	{
+		fprintf(stderr, "snapshot_test: %d check(s) failed.\n", failures);
+		return 1;
+	}
+	fprintf(stdout, "snapshot_test: all checks passed.\n");
+
+	return 0;
+}
@@ -0,0 +1,168 @@
+/*
+   Register level model of a Wii nunchuk behind the i2cmaster.h API. It lets
+   nunchuk.c, and anything built on it, be run on a PC without the hardware:
+
+     gcc -I. my_program.c nunchuk.c twimock.c
+
+   The model keeps the nunchuk's register file and register pointer. Writing
+   to register 0x40 (the old init method) turns on the encryption of
+   everything read back, writing 0x55 to register 0xF0 (the new init method)
+   turns it off again, and writing just the register address 0x00 latches
+   the next canned sample into registers 0x00 to 0x05. The identification
+   bytes live in registers 0xFA to 0xFF.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "i2cmaster.h"
+#include "twimock.h"
+
+#define NUNCHUK_ADDR  0x52 // unshifted device address of wii nunchuk
+#define NUM_BYTES     6
+
+static uint8_t reg[256];
+static uint8_t ptr;
+static uint8_t is_genuine;
+static uint8_t encrypted;
+
+static uint8_t selected;      // nunchuk addressed since the last start
+static uint8_t bytes_written; // bytes written since the last start
+
+static const uint8_t* canned;
+static uint16_t canned_count;
+static uint16_t canned_next;
+static uint16_t conversions;
+
+/* The nunchuk's encryption with the all zero key used by the old init
+ * method. The host decrypts with (x ^ 0x17) + 0x17. */
+static uint8_t encrypt(uint8_t x)
+{
+	return (uint8_t)(x - 0x17) ^ 0x17;
+}
+
+static void convert(void)
+{
+	uint8_t i;
+
+	conversions++;
+
+	if (canned == NULL || canned_count == 0)
+	{
+		return;
+	}
+
+	for (i = 0; i < NUM_BYTES; i++)
+	{
+		reg[i] = canned[canned_next*NUM_BYTES + i];
+	}
+
+	canned_next = (canned_next == (canned_count-1)) ? 0 : canned_next+1;
+}
+
+void twimock_reset(uint8_t genuine)
+{
+	uint16_t i;
+
+	for (i = 0; i < sizeof(reg); i++)
+	{
+		reg[i] = 0;
+	}
+
+	/* unencrypted ID bytes: 0x00 0x00 0xA4 0x20 0x00 0x00 */
+	reg[0xFC] = 0xA4;
+	reg[0xFD] = 0x20;
+
+	ptr = 0;
+	is_genuine = genuine;
+	encrypted = 0;
+	selected = 0;
+	bytes_written = 0;
+	canned_next = 0;
+	conversions = 0;
+}
+
+void twimock_load(const uint8_t* samples, uint16_t count)
+{
+	canned = samples;
+	canned_count = count;
+	canned_next = 0;
+}
+
+uint16_t twimock_conversions(void)
+{
+	return conversions;
+}
+
+void i2c_init(void)
+{
+}
+
+void i2c_stop(void)
+{
+	/* writing only the register address 0x00 requests a new sample */
+	if (selected && bytes_written == 1 && ptr == 0x00)
+	{
+		convert();
+	}
+
+	selected = 0;
+	bytes_written = 0;
+}
+
+unsigned char i2c_start(unsigned char addr)
+{
+	selected = ((addr >> 1) == NUNCHUK_ADDR);
+	bytes_written = 0;
+
+	return !selected;
+}
+
+unsigned char i2c_rep_start(unsigned char addr)
+{
+	return i2c_start(addr);
+}
+
+void i2c_start_wait(unsigned char addr)
+{
+	i2c_start(addr);
+}
+
+unsigned char i2c_write(unsigned char data)
+{
+	if (!selected)
+	{
+		return 1;
+	}
+
+	if (bytes_written++ == 0)
+	{
+		ptr = data;
+		return 0;
+	}
+
+	if (ptr == 0x40)
+	{
+		encrypted = is_genuine;
+	}
+	else if (ptr == 0xF0 && data == 0x55)
+	{
+		encrypted = 0;
+	}
+
+	reg[ptr++] = data;
+
+	return 0;
+}
+
+unsigned char i2c_readAck(void)
+{
+	uint8_t x = reg[ptr++];
+
+	return encrypted ? encrypt(x) : x;
+}
+
+unsigned char i2c_readNak(void)
+{
+	return i2c_readAck();
+}
@@ -0,0 +1,22 @@
+/*
+   Register level model of a Wii nunchuk behind the i2cmaster.h API. Link
+   twimock.c in place of twimaster.c to run the nunchuk driver on a PC.
+*/
+
+#ifndef _TWIMOCK_H_
+#define _TWIMOCK_H_
+
+#include <stdint.h>
+
+/* Powers up the model. A genuine nunchuk encrypts its output after the old
+ * init method, a fake (6331 accelerometer) one never does. */
+extern void twimock_reset(uint8_t genuine);
+
+/* Gives the model the unencrypted 6 byte samples it should return, one per
+ * conversion request. The samples are repeated once they run out. */
+extern void twimock_load(const uint8_t* samples, uint16_t count);
+
+/* Number of conversions requested since the last reset. */
+extern uint16_t twimock_conversions(void);
+
+#endif
@@ -53,12 +53,25 @@ const USB_Descriptor_HIDReport_Datatype_t PROGMEM JoystickReport[] =
 	        HID_RI_USAGE(8, 0x30), /* Usage Direction-X */
 	        HID_RI_USAGE(8, 0x31), /* Usage Direction-Y */
 	        HID_RI_USAGE(8, 0x32), /* Usage Direction-Z */
+	        HID_RI_USAGE(8, 0x33), /* Usage Rotation-X, minimum of X since last report */
+	        HID_RI_USAGE(8, 0x34), /* Usage Rotation-Y, minimum of Y since last report */
+	        HID_RI_USAGE(8, 0x35), /* Usage Rotation-Z, minimum of Z since last report */
+	        HID_RI_USAGE(8, 0x36), /* Usage Slider, maximum of X since last report */
+	        HID_RI_USAGE(8, 0x37), /* Usage Dial, maximum of Y since last report */
+	        HID_RI_USAGE(8, 0x38), /* Usage Wheel, maximum of Z since last report */
+#ifdef HIRES
+	        HID_RI_LOGICAL_MINIMUM(16, 0x8000), /* LOGICAL_MINIMUM (-32768) */
+	        HID_RI_LOGICAL_MAXIMUM(16, 0x7fff), /* LOGICAL_MAXIMUM (32767) */
+	        HID_RI_PHYSICAL_MINIMUM(16, 0x8000), /* PHYSICAL_MINIMUM (-32768) */
+	        HID_RI_PHYSICAL_MAXIMUM(16, 0x7fff), /* PHYSICAL_MAXIMUM (32767) */
+#else
 	        HID_RI_LOGICAL_MINIMUM(8, 0), /* LOGICAL_MINIMUM (0) */
 	        HID_RI_LOGICAL_MAXIMUM(16, 0x03ff), /* LOGICAL_MAXIMUM (1023) */
 	        HID_RI_PHYSICAL_MINIMUM(8, 0x00), /* PHYSICAL_MINIMUM (0) */
 	        HID_RI_PHYSICAL_MAXIMUM(16, 0x03ff), /* PHYSICAL_MAXIMUM (1023) */
+#endif
 	        HID_RI_REPORT_SIZE(8, 0x10), /* REPORT_SIZE (16) */
-	        HID_RI_REPORT_COUNT(8, 0x03), /* REPORT_COUNT (3) */
+	        HID_RI_REPORT_COUNT(8, 0x09), /* REPORT_COUNT (9) */
 	        HID_RI_INPUT(8, HID_IOF_DATA | HID_IOF_VARIABLE | HID_IOF_ABSOLUTE),
 	    HID_RI_END_COLLECTION(0),
 	    HID_RI_USAGE_PAGE(8, 0x09), /* Button */
@@ -59,7 +59,12 @@
 		#define JOYSTICK_EPNUM               1
 
 		/** Size in bytes of the Joystick HID reporting IN endpoint. */
-		#define JOYSTICK_EPSIZE              8
+		#define JOYSTICK_EPSIZE              32
+
+		/** Define to report each axis as a signed 16-bit value that keeps the extra bits gained by summing the
+		 *  M oversampled readings, instead of rounding the average back down to the nunchuk's 10 bits.
+		 */
+		//#define HIRES
 
 	/* Function Prototypes: */
 		uint16_t CALLBACK_USB_GetDescriptor(const uint16_t wValue,
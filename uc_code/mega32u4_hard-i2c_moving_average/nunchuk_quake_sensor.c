@@ -80,6 +80,11 @@
 static uint16_t buff_x[M];
 static uint16_t buff_y[M];
 static uint16_t buff_z[M];
+// sums of the M newest readings, and their extremes since the last report
+static uint16_t sum_x, sum_y, sum_z;
+static uint16_t min_x = 0xffff, max_x = 0;
+static uint16_t min_y = 0xffff, max_y = 0;
+static uint16_t min_z = 0xffff, max_z = 0;
 
 /** Buffer to hold the previously generated HID report, for comparison purposes inside the HID class driver. */
 static uint8_t PrevJoystickHIDReportBuffer[sizeof(USB_JoystickReport_Data_t)];
@@ -110,6 +115,8 @@ ISR(TIMER1_COMPA_vect)
 	static uint8_t cbi = 0;
 	uint8_t nc_data[NUM_BYTES] = { 0 };
 
+	BENCH_MARK(BENCH_ISR_START);
+
 	/* read a new sample */
 	i2c_rep_start(DevAddr+I2C_READ);
 
@@ -121,6 +128,8 @@ ISR(TIMER1_COMPA_vect)
 	nc_data[i] = i2c_readNak();
 	i2c_stop();
 
+	BENCH_MARK(BENCH_ISR_READ);
+
 
 
 	/* increment the circular buffer index. cbi is now the index of the 
@@ -129,6 +138,11 @@ ISR(TIMER1_COMPA_vect)
 	i = cbi;
 	cbi = next_cbi();
 
+	/* the oldest reading leaves the sums */
+	sum_x -= buff_x[cbi];
+	sum_y -= buff_y[cbi];
+	sum_z -= buff_z[cbi];
+
 	/* Sometimes the data for one or more axes will spike or dip. If this
 	 * happens, then discard those samples. A spike is always indicated by
 	 * bytes 4 and 5 being equal to 0xFE. */
@@ -152,6 +166,23 @@ ISR(TIMER1_COMPA_vect)
 		buff_z[cbi] = buff_z[i];
 	}
 
+	sum_x += buff_x[cbi];
+	sum_y += buff_y[cbi];
+	sum_z += buff_z[cbi];
+
+	BENCH_MARK(BENCH_ISR_FILTER);
+
+	/* Only the newest average is sent with each report, so keep track of
+	 * the peaks of the average in between reports. Otherwise a short
+	 * transient between USB polls would never reach the host. */
+	if (sum_x < min_x) min_x = sum_x;
+	if (sum_x > max_x) max_x = sum_x;
+	if (sum_y < min_y) min_y = sum_y;
+	if (sum_y > max_y) max_y = sum_y;
+	if (sum_z < min_z) min_z = sum_z;
+	if (sum_z > max_z) max_z = sum_z;
+
+	BENCH_MARK(BENCH_ISR_PUBLISH);
 
 	/* The STMicroelectronics based nunchuk needs a delay of 14 or more
 	 * microseconds between reading data and requesting new data. Use a 15
@@ -167,6 +198,7 @@ ISR(TIMER1_COMPA_vect)
 
 
 
+#if !defined(ISR_BENCH)
 int main(void)
 {
 	uint16_t i = 0;
@@ -228,6 +260,7 @@ int main(void)
 		}
 	}
 }
+#endif
 
 /* 
  * A genuine nunchuk outputs encrypted identification bytes when initialized
@@ -362,6 +395,44 @@ void EVENT_USB_Device_StartOfFrame(void)
 	HID_Device_MillisecondElapsed(&Joystick_HID_Interface);
 }
 
+#ifdef HIRES
+/* Scales the sum of M readings to the full signed 16-bit range. */
+static int16_t hires(uint16_t sum)
+{
+	int32_t out = ((int32_t)sum << HIRES_SHIFT) - 32768;
+
+#ifdef HIRES_DITHER
+	/* 16-bit xorshift generator, plenty for dither */
+	static uint16_t r = 0xACE1;
+	uint16_t r1, r2;
+
+	r ^= r << 7;
+	r ^= r >> 9;
+	r ^= r << 8;
+	r1 = r & (_BV(HIRES_SHIFT)-1);
+
+	r ^= r << 7;
+	r ^= r >> 9;
+	r ^= r << 8;
+	r2 = r & (_BV(HIRES_SHIFT)-1);
+
+	/* the difference of two uniform values is triangular over one step of
+	 * the sum, i.e. +/- (2^HIRES_SHIFT - 1) */
+	out = out + (int32_t)r1 - (int32_t)r2;
+	if (out > 32767) out = 32767;
+	if (out < -32768) out = -32768;
+#endif
+
+	return out;
+}
+#else
+/* Rounds the sum of M readings to their average. */
+static uint16_t average(uint16_t sum)
+{
+	return (sum+_BV((LOG2F(M)-1))) >> LOG2F(M);
+}
+#endif
+
 /** HID class driver callback function for the creation of HID reports to the host.
  *
  *  \param[in]     HIDInterfaceInfo  Pointer to the HID class interface configuration structure being referenced
@@ -380,29 +451,56 @@ bool CALLBACK_HID_Device_CreateHIDReport(USB_ClassInfo_HID_Device_t* const HIDIn
 {
 	USB_JoystickReport_Data_t* JoystickReport = (USB_JoystickReport_Data_t*)ReportData;
 
-	uint8_t i;
+	uint16_t x, y, z;
+	uint16_t x_min, y_min, z_min;
+	uint16_t x_max, y_max, z_max;
 
-	uint16_t sum_x = 0;
-	uint16_t sum_y = 0;
-	uint16_t sum_z = 0;
+	BENCH_MARK(BENCH_REPORT_START);
 
+	/* Take a copy of the newest sums and their peaks, then restart the
+	 * peak tracking from the newest sums, so each report covers the
+	 * samples taken since the previous one. */
 	cli();
-	for (i=0; i<M; i++)
-	{
-		sum_x = sum_x + buff_x[i];
-		sum_y = sum_y + buff_y[i];
-		sum_z = sum_z + buff_z[i];
-	}
+	x = sum_x;
+	y = sum_y;
+	z = sum_z;
+	x_min = min_x; x_max = max_x;
+	y_min = min_y; y_max = max_y;
+	z_min = min_z; z_max = max_z;
+	min_x = max_x = x;
+	min_y = max_y = y;
+	min_z = max_z = z;
 	sei();
 
-	JoystickReport->ax = ((sum_x+_BV((LOG2F(M)-1))) >> LOG2F(M));
-	JoystickReport->ay = ((sum_y+_BV((LOG2F(M)-1))) >> LOG2F(M));
-	JoystickReport->az = ((sum_z+_BV((LOG2F(M)-1))) >> LOG2F(M));
+#ifdef HIRES
+	/* Averaging M readings gains LOG2F(M) bits of resolution, so keep
+	 * them instead of shifting them away. */
+	JoystickReport->ax = hires(x);
+	JoystickReport->ay = hires(y);
+	JoystickReport->az = hires(z);
+	JoystickReport->ax_min = hires(x_min);
+	JoystickReport->ay_min = hires(y_min);
+	JoystickReport->az_min = hires(z_min);
+	JoystickReport->ax_max = hires(x_max);
+	JoystickReport->ay_max = hires(y_max);
+	JoystickReport->az_max = hires(z_max);
+#else
+	JoystickReport->ax = average(x);
+	JoystickReport->ay = average(y);
+	JoystickReport->az = average(z);
+	JoystickReport->ax_min = average(x_min);
+	JoystickReport->ay_min = average(y_min);
+	JoystickReport->az_min = average(z_min);
+	JoystickReport->ax_max = average(x_max);
+	JoystickReport->ay_max = average(y_max);
+	JoystickReport->az_max = average(z_max);
+#endif
 
 	// output fake buttons to imitate joywarrior
 	JoystickReport->buttons = 0;
 
 	*ReportSize = sizeof(USB_JoystickReport_Data_t);
+	BENCH_MARK(BENCH_REPORT_END);
 	return true;
 }
 
@@ -54,9 +54,27 @@
 		 */
 		typedef struct
 		{
+#ifdef HIRES
+			int16_t   ax; /**< accelerometer x axis, sum of M readings scaled to 16 bits and centered on zero */
+			int16_t   ay; /**< accelerometer y axis, sum of M readings scaled to 16 bits and centered on zero */
+			int16_t   az; /**< accelerometer z axis, sum of M readings scaled to 16 bits and centered on zero */
+			int16_t   ax_min; /**< smallest accelerometer x axis value since the last report */
+			int16_t   ay_min; /**< smallest accelerometer y axis value since the last report */
+			int16_t   az_min; /**< smallest accelerometer z axis value since the last report */
+			int16_t   ax_max; /**< largest accelerometer x axis value since the last report */
+			int16_t   ay_max; /**< largest accelerometer y axis value since the last report */
+			int16_t   az_max; /**< largest accelerometer z axis value since the last report */
+#else
 			uint16_t  ax; /**< accelerometer x axis */
 			uint16_t  ay; /**< accelerometer y axis */
 			uint16_t  az; /**< accelerometer z axis */
+			uint16_t  ax_min; /**< smallest accelerometer x axis value since the last report */
+			uint16_t  ay_min; /**< smallest accelerometer y axis value since the last report */
+			uint16_t  az_min; /**< smallest accelerometer z axis value since the last report */
+			uint16_t  ax_max; /**< largest accelerometer x axis value since the last report */
+			uint16_t  ay_max; /**< largest accelerometer y axis value since the last report */
+			uint16_t  az_max; /**< largest accelerometer z axis value since the last report */
+#endif
 			uint8_t buttons; /**< Bit mask of the currently pressed joystick buttons */
 		} USB_JoystickReport_Data_t;
 
@@ -72,6 +90,33 @@
 		       	            (((x) >= 32) ? 1 : 0) + \
 		       	            (((x) >= 64) ? 1 : 0) )
 
+		/* The sum of M 10-bit readings has 10+LOG2F(M) bits, HIRES_SHIFT
+		 * moves them to the top of a 16-bit word. */
+		#define HIRES_SHIFT (16 - 10 - LOG2F(M))
+
+		/* Define to fill the HIRES_SHIFT bits below the sum with triangular
+		 * dither, so that the quantisation steps of the sum don't show up as
+		 * signal correlated noise in the host's spectra. */
+		//#define HIRES_DITHER
+
+		/** Phases of the ISR and the report callback, marked for the ISR benchmark in
+		 *  ../mega32u4_hard-i2c_chebyshev (make isrbench) by writing them to GPIOR0. The markers
+		 *  compile to nothing unless ISR_BENCH is defined.
+		 */
+		#define BENCH_ISR_START      1
+		#define BENCH_ISR_READ       2
+		#define BENCH_ISR_FILTER     3
+		#define BENCH_ISR_PUBLISH    4
+		#define BENCH_REPORT_START   5
+		#define BENCH_REPORT_END     6
+		#define BENCH_DONE           7
+
+		#if defined(ISR_BENCH)
+			#define BENCH_MARK(phase)  GPIOR0 = (phase)
+		#else
+			#define BENCH_MARK(phase)
+		#endif
+
 	/* Function Prototypes: */
 		uint8_t Nunchuk_Init(void);
 		void Timer_Init(void);
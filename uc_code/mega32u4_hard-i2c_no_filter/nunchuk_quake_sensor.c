@@ -78,6 +78,10 @@
 static uint16_t buff_x;
 static uint16_t buff_y;
 static uint16_t buff_z;
+/* extremes of the samples since the last report */
+static uint16_t min_x = 0x03ff, max_x = 0;
+static uint16_t min_y = 0x03ff, max_y = 0;
+static uint16_t min_z = 0x03ff, max_z = 0;
 
 /** Buffer to hold the previously generated HID report, for comparison purposes inside the HID class driver. */
 static uint8_t PrevJoystickHIDReportBuffer[sizeof(USB_JoystickReport_Data_t)];
@@ -108,6 +112,8 @@ ISR(TIMER1_COMPA_vect)
 	uint8_t i = 0;
 	uint8_t nc_data[NUM_BYTES] = { 0 };
 
+	BENCH_MARK(BENCH_ISR_START);
+
 	/* read a new sample */
 	i2c_rep_start(DevAddr+I2C_READ);
 
@@ -119,6 +125,11 @@ ISR(TIMER1_COMPA_vect)
 	nc_data[i] = i2c_readNak();
 	i2c_stop();
 
+	BENCH_MARK(BENCH_ISR_READ);
+
+	/* nothing to filter */
+	BENCH_MARK(BENCH_ISR_FILTER);
+
 	/* Sometimes the data for one or more axes will spike or dip. If this
 	 * happens, then discard those samples. A spike is always indicated by
 	 * bytes 4 and 5 being equal to 0xFE. */
@@ -132,8 +143,20 @@ ISR(TIMER1_COMPA_vect)
 		buff_x = (nc_data[2] << 2) | ((nc_data[5] >> 2) & ~(~0 << 2));
 		buff_y = (nc_data[3] << 2) | ((nc_data[5] >> 4) & ~(~0 << 2));
 		buff_z = (nc_data[4] << 2) | ((nc_data[5] >> 6) & ~(~0 << 2));
+
+		/* Only the newest sample is sent with each report, so keep track
+		 * of the peaks in between reports. Otherwise a short transient
+		 * between USB polls would never reach the host. */
+		if (buff_x < min_x) min_x = buff_x;
+		if (buff_x > max_x) max_x = buff_x;
+		if (buff_y < min_y) min_y = buff_y;
+		if (buff_y > max_y) max_y = buff_y;
+		if (buff_z < min_z) min_z = buff_z;
+		if (buff_z > max_z) max_z = buff_z;
 	}
 
+	BENCH_MARK(BENCH_ISR_PUBLISH);
+
 	/* The STMicroelectronics based nunchuk needs a delay of 14 or more
 	 * microseconds between reading data and requesting new data. Use a 15
 	 * us delay to give a little padding. The buffer store if block
@@ -148,6 +171,7 @@ ISR(TIMER1_COMPA_vect)
 
 
 
+#if !defined(ISR_BENCH)
 int main(void)
 {
 	uint16_t i = 0;
@@ -209,6 +233,7 @@ int main(void)
 		}
 	}
 }
+#endif
 
 /* 
  * A genuine nunchuk outputs encrypted identification bytes when initialized
@@ -360,14 +385,31 @@ bool CALLBACK_HID_Device_CreateHIDReport(USB_ClassInfo_HID_Device_t* const HIDIn
 {
 	USB_JoystickReport_Data_t* JoystickReport = (USB_JoystickReport_Data_t*)ReportData;
 
+	BENCH_MARK(BENCH_REPORT_START);
+
+	/* Take a copy of the newest sample and the peaks, then restart the
+	 * peak tracking from the newest sample, so each report covers the
+	 * samples taken since the previous one. */
+	cli();
 	JoystickReport->ax = buff_x;
 	JoystickReport->ay = buff_y;
 	JoystickReport->az = buff_z;
+	JoystickReport->ax_min = min_x;
+	JoystickReport->ay_min = min_y;
+	JoystickReport->az_min = min_z;
+	JoystickReport->ax_max = max_x;
+	JoystickReport->ay_max = max_y;
+	JoystickReport->az_max = max_z;
+	min_x = max_x = buff_x;
+	min_y = max_y = buff_y;
+	min_z = max_z = buff_z;
+	sei();
 
 	// output fake buttons to imitate joywarrior
 	JoystickReport->buttons = 0;
 
 	*ReportSize = sizeof(USB_JoystickReport_Data_t);
+	BENCH_MARK(BENCH_REPORT_END);
 	return true;
 }
 